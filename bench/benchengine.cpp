@@ -0,0 +1,286 @@
+/**
+ * @file benchengine.cpp
+ * @brief engine primitives: event dispatch, local & cross-core pipes, callbacks, actor lifecycle
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <atomic>
+#include <thread>
+#include <type_traits>
+
+#include "trz/engine/engine.h"
+
+#include "benchutil.h"
+
+using namespace tredzone;
+
+namespace
+{
+
+static const unsigned BATCH_EVENT_COUNT = 256; // events pushed per acknowledgement
+
+template <unsigned I> struct BenchEvent : Actor::Event
+{
+};
+struct BenchAckEvent : Actor::Event
+{
+};
+
+struct BenchContext
+{
+    const char *name;
+    uint64_t operationCount;
+    std::atomic<bool> destinationReadyFlag;
+    Actor::ActorId destinationActorId;
+    BenchWaitCondition doneCondition;
+    inline BenchContext(const char *pname, uint64_t poperationCount)
+        : name(pname), operationCount(poperationCount), destinationReadyFlag(false)
+    {
+    }
+};
+
+/**
+ * Registers handlers of BenchEvent<0> to BenchEvent<_HANDLER_COUNT - 1> (in that order),
+ * and receives BenchEvent<_HANDLER_COUNT - 1>, acknowledging every BATCH_EVENT_COUNT events.
+ */
+template <unsigned _HANDLER_COUNT> struct BenchDestinationActor : Actor
+{
+    uint64_t eventCount;
+
+    BenchDestinationActor(BenchContext *context) : eventCount(0)
+    {
+        registerEventHandlers(std::integral_constant<unsigned, _HANDLER_COUNT>());
+        context->destinationActorId = getActorId();
+        context->destinationReadyFlag.store(true, std::memory_order_release);
+    }
+    template <unsigned I> void registerEventHandlers(std::integral_constant<unsigned, I>)
+    {
+        registerEventHandlers(std::integral_constant<unsigned, I - 1>());
+        registerEventHandler<BenchEvent<I - 1>>(*this);
+    }
+    void registerEventHandlers(std::integral_constant<unsigned, 0>) {}
+    template <unsigned I> void onEvent(const BenchEvent<I> &event)
+    {
+        if (I == _HANDLER_COUNT - 1 && ++eventCount % BATCH_EVENT_COUNT == 0)
+        {
+            Event::Pipe(*this, event.getSourceActorId()).push<BenchAckEvent>();
+        }
+    }
+};
+
+template <unsigned _HANDLER_COUNT> struct BenchSourceActor : Actor, Actor::Callback
+{
+    BenchContext &context;
+    uint64_t pushedCount;
+    int64_t pushNanoseconds;
+    BenchTimer timer;
+
+    BenchSourceActor(BenchContext *pcontext) : context(*pcontext), pushedCount(0), pushNanoseconds(0)
+    {
+        registerEventHandler<BenchAckEvent>(*this);
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        if (!context.destinationReadyFlag.load(std::memory_order_acquire))
+        {
+            registerCallback(*this);
+            return;
+        }
+        timer.reset();
+        pushBatch();
+    }
+    void onEvent(const BenchAckEvent &)
+    {
+        if (pushedCount < context.operationCount)
+        {
+            pushBatch();
+            return;
+        }
+        const int64_t elapsedNanoseconds = timer.elapsedNanoseconds();
+        char name[128];
+        std::snprintf(name, sizeof(name), "%s (push only)", context.name);
+        benchReport(name, pushedCount, pushNanoseconds);
+        std::snprintf(name, sizeof(name), "%s (push+dispatch)", context.name);
+        benchReport(name, pushedCount, elapsedNanoseconds);
+        context.doneCondition.notify();
+    }
+    void pushBatch()
+    {
+        BenchTimer pushTimer;
+        Event::Pipe pipe(*this, context.destinationActorId);
+        for (unsigned i = 0; i < BATCH_EVENT_COUNT; ++i)
+        {
+            pipe.push<BenchEvent<_HANDLER_COUNT - 1>>();
+        }
+        pushNanoseconds += pushTimer.elapsedNanoseconds();
+        pushedCount += BATCH_EVENT_COUNT;
+    }
+};
+
+template <unsigned _HANDLER_COUNT>
+void benchPipe(const char *name, uint64_t operationCount, Actor::CoreId destinationCoreId)
+{
+    BenchContext context(name, operationCount);
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    coreSet.set(destinationCoreId);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<BenchDestinationActor<_HANDLER_COUNT>>(destinationCoreId, &context);
+    startSequence.addActor<BenchSourceActor<_HANDLER_COUNT>>(0, &context);
+    Engine engine(startSequence);
+    context.doneCondition.wait();
+}
+
+/**
+ * Each of _CALLBACK_COUNT callbacks registers itself again on every event-loop iteration.
+ */
+template <unsigned _CALLBACK_COUNT> struct BenchCallbackActor : Actor
+{
+    struct BenchCallback : Actor::Callback
+    {
+        BenchCallbackActor *actor;
+        void onCallback() { actor->onBenchCallback(*this); }
+    };
+
+    BenchContext &context;
+    uint64_t callbackCount;
+    BenchCallback callbacks[_CALLBACK_COUNT];
+    BenchTimer timer;
+
+    BenchCallbackActor(BenchContext *pcontext) : context(*pcontext), callbackCount(0)
+    {
+        for (unsigned i = 0; i < _CALLBACK_COUNT; ++i)
+        {
+            callbacks[i].actor = this;
+            registerCallback(callbacks[i]);
+        }
+    }
+    void onBenchCallback(BenchCallback &callback)
+    {
+        if (++callbackCount < context.operationCount)
+        {
+            registerCallback(callback);
+        }
+        else if (callbackCount == context.operationCount)
+        {
+            benchReport(context.name, callbackCount, timer.elapsedNanoseconds());
+            if (_CALLBACK_COUNT == 1)
+            {
+                benchRegistrationChurn();
+            }
+            context.doneCondition.notify();
+        }
+    }
+    void benchRegistrationChurn()
+    {
+        benchRun("Callback registerCallback+unregister", context.operationCount, [this](uint64_t i) {
+            BenchCallback &callback = callbacks[i % _CALLBACK_COUNT];
+            registerCallback(callback);
+            callback.unregister();
+        });
+    }
+};
+
+template <unsigned _CALLBACK_COUNT> void benchCallback(const char *name, uint64_t operationCount)
+{
+    BenchContext context(name, operationCount);
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<BenchCallbackActor<_CALLBACK_COUNT>>(0, &context);
+    Engine engine(startSequence);
+    context.doneCondition.wait();
+}
+
+struct BenchChildActor : Actor, Actor::Callback
+{
+    uint64_t &destroyedCount;
+
+    BenchChildActor(uint64_t *pdestroyedCount) : destroyedCount(*pdestroyedCount) { registerCallback(*this); }
+    ~BenchChildActor() noexcept { ++destroyedCount; }
+    void onCallback() { requestDestroy(); }
+};
+
+/**
+ * Creates rounds of ROUND_ACTOR_COUNT unreferenced actors, each one requesting its own destruction.
+ */
+struct BenchLifecycleActor : Actor, Actor::Callback
+{
+    static const uint64_t ROUND_ACTOR_COUNT = 1000;
+
+    BenchContext &context;
+    uint64_t createdCount;
+    uint64_t destroyedCount;
+    int64_t createNanoseconds;
+    BenchTimer timer;
+
+    BenchLifecycleActor(BenchContext *pcontext)
+        : context(*pcontext), createdCount(0), destroyedCount(0), createNanoseconds(0)
+    {
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        if (destroyedCount == context.operationCount)
+        {
+            const int64_t elapsedNanoseconds = timer.elapsedNanoseconds();
+            benchReport("newUnreferencedActor (create only)", createdCount, createNanoseconds);
+            benchReport("newUnreferencedActor+requestDestroy cycle", createdCount, elapsedNanoseconds);
+            context.doneCondition.notify();
+            return;
+        }
+        if (destroyedCount == createdCount)
+        {
+            BenchTimer createTimer;
+            for (uint64_t i = 0; i < ROUND_ACTOR_COUNT && createdCount < context.operationCount; ++i, ++createdCount)
+            {
+                newUnreferencedActor<BenchChildActor>(&destroyedCount);
+            }
+            createNanoseconds += createTimer.elapsedNanoseconds();
+        }
+        registerCallback(*this);
+    }
+};
+
+const uint64_t BenchLifecycleActor::ROUND_ACTOR_COUNT;
+
+void benchLifecycle(uint64_t operationCount)
+{
+    BenchContext context("actor lifecycle", operationCount);
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<BenchLifecycleActor>(0, &context);
+    Engine engine(startSequence);
+    context.doneCondition.wait();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const bool quickFlag = benchIsQuick(argc, argv);
+    const uint64_t eventCount = quickFlag ? 10 * BATCH_EVENT_COUNT : 10000 * BATCH_EVENT_COUNT;
+    const uint64_t callbackCount = quickFlag ? 10000 : 10000000;
+    const uint64_t actorCount = quickFlag ? 2000 : 1000000;
+
+    benchPipe<1>("Pipe::push local, dispatch (1 handler)", eventCount, 0);
+    benchPipe<8>("Pipe::push local, dispatch (8 handlers)", eventCount, 0);
+    benchPipe<64>("Pipe::push local, dispatch (64 handlers)", eventCount, 0);
+    if (std::thread::hardware_concurrency() >= 2)
+    {
+        benchPipe<1>("Pipe::push cross-core, dispatch (1 handler)", eventCount, 1);
+    }
+    else
+    {
+        std::printf("Pipe::push cross-core: skipped (single cpu)\n");
+    }
+    std::printf("\n");
+    benchCallback<1>("Callback churn (1 callback)", callbackCount);
+    benchCallback<64>("Callback churn (64 callbacks)", callbackCount);
+    std::printf("\n");
+    benchLifecycle(actorCount);
+    return 0;
+}
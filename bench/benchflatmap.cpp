@@ -0,0 +1,118 @@
+/**
+ * @file benchflatmap.cpp
+ * @brief flat hash map & sorted flat map vs stl containers
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "trz/util/flathashmap.h"
+#include "trz/util/sortedflatmap.h"
+
+#include "benchutil.h"
+
+using namespace tredzone;
+
+namespace
+{
+
+struct Order
+{
+    uint64_t price;
+    uint64_t quantity;
+    inline Order() noexcept : price(0), quantity(0) {}
+    inline Order(uint64_t pprice, uint64_t pquantity) noexcept : price(pprice), quantity(pquantity) {}
+};
+
+// all containers use std::allocator for an allocator-neutral comparison
+typedef std::unordered_map<uint64_t, Order> StdUnorderedMap;
+typedef std::map<uint64_t, Order> StdMap;
+typedef FlatHashMap<uint64_t, Order, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                    std::allocator<std::pair<const uint64_t, Order>>>
+    BenchFlatHashMap;
+typedef SortedFlatMap<uint64_t, Order, std::less<uint64_t>, std::allocator<std::pair<uint64_t, Order>>>
+    BenchSortedFlatMap;
+typedef std::unordered_set<uint64_t> StdUnorderedSet;
+typedef FlatHashSet<uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, std::allocator<uint64_t>> BenchFlatHashSet;
+
+inline uint64_t benchKey(uint64_t i) noexcept { return i * UINT64_C(0x9E3779B97F4A7C15) >> 16; }
+
+template <class _Map> void benchMap(const char *mapName, uint64_t n, uint64_t lookupCount)
+{
+    char name[128];
+    std::vector<uint64_t> keys;
+    keys.reserve(n);
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        keys.push_back(benchKey(i));
+    }
+
+    _Map map;
+    std::snprintf(name, sizeof(name), "%s insert (n=%llu)", mapName, (unsigned long long)n);
+    benchRun(name, n, [&](uint64_t i) { map.insert(std::make_pair(keys[i], Order(i, i))); });
+
+    uint64_t sum = 0;
+    std::snprintf(name, sizeof(name), "%s find hit (n=%llu)", mapName, (unsigned long long)n);
+    benchRun(name, lookupCount, [&](uint64_t i) { sum += map.find(keys[(i * 7919) % n])->second.quantity; });
+    benchDoNotOptimize(sum);
+
+    std::snprintf(name, sizeof(name), "%s find miss (n=%llu)", mapName, (unsigned long long)n);
+    benchRun(name, lookupCount, [&](uint64_t i) { sum += map.find(benchKey(n + i)) == map.end() ? 0 : 1; });
+    benchDoNotOptimize(sum);
+
+    std::snprintf(name, sizeof(name), "%s iterate (n=%llu)", mapName, (unsigned long long)n);
+    benchRun(name, n, [&](uint64_t i) {
+        if (i == 0)
+        {
+            for (typename _Map::const_iterator it = map.begin(), endit = map.end(); it != endit; ++it)
+            {
+                sum += it->second.price;
+            }
+        }
+    });
+    benchDoNotOptimize(sum);
+
+    std::snprintf(name, sizeof(name), "%s erase (n=%llu)", mapName, (unsigned long long)n);
+    benchRun(name, n, [&](uint64_t i) { map.erase(keys[i]); });
+}
+
+template <class _Set> void benchSet(const char *setName, uint64_t n, uint64_t lookupCount)
+{
+    char name[128];
+    _Set set;
+    std::snprintf(name, sizeof(name), "%s insert (n=%llu)", setName, (unsigned long long)n);
+    benchRun(name, n, [&](uint64_t i) { set.insert(benchKey(i)); });
+    uint64_t sum = 0;
+    std::snprintf(name, sizeof(name), "%s count (n=%llu)", setName, (unsigned long long)n);
+    benchRun(name, lookupCount, [&](uint64_t i) { sum += set.count(benchKey(i % (2 * n))); });
+    benchDoNotOptimize(sum);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const bool quickFlag = benchIsQuick(argc, argv);
+    const uint64_t sizes[] = {1000, 100000, 1000000};
+    const size_t sizeCount = quickFlag ? 1 : sizeof(sizes) / sizeof(sizes[0]);
+    const uint64_t lookupCount = quickFlag ? 10000 : 2000000;
+
+    for (size_t i = 0; i < sizeCount; ++i)
+    {
+        benchMap<StdUnorderedMap>("std::unordered_map", sizes[i], lookupCount);
+        benchMap<StdMap>("std::map", sizes[i], lookupCount);
+        benchMap<BenchFlatHashMap>("FlatHashMap", sizes[i], lookupCount);
+        if (sizes[i] <= 100000)
+        { // random-order insertion in a sorted vector is quadratic
+            benchMap<BenchSortedFlatMap>("SortedFlatMap", sizes[i], lookupCount);
+        }
+        benchSet<StdUnorderedSet>("std::unordered_set", sizes[i], lookupCount);
+        benchSet<BenchFlatHashSet>("FlatHashSet", sizes[i], lookupCount);
+        std::printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+/**
+ * @file benchlifecycle.cpp
+ * @brief actor create/reference/destroy cycles with respect to live actor count
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <vector>
+
+#include "trz/engine/engine.h"
+
+#include "benchutil.h"
+
+using namespace tredzone;
+
+namespace
+{
+
+static const unsigned ROUND_ACTOR_COUNT = 1000; // actors created (and destroyed) per event-loop iteration
+
+struct BenchContext
+{
+    size_t liveActorCount;
+    uint64_t cycleCount;
+    BenchWaitCondition doneCondition;
+    inline BenchContext(size_t pliveActorCount, uint64_t pcycleCount)
+        : liveActorCount(pliveActorCount), cycleCount(pcycleCount)
+    {
+    }
+};
+
+struct BenchLiveActor : Actor
+{
+};
+
+struct BenchOrderActor : Actor
+{
+    uint64_t &destroyedCount;
+
+    BenchOrderActor(uint64_t *pdestroyedCount) : destroyedCount(*pdestroyedCount) {}
+    ~BenchOrderActor() noexcept { ++destroyedCount; }
+};
+
+/**
+ * Keeps liveActorCount referenced actors alive, then creates rounds of ROUND_ACTOR_COUNT referenced actors,
+ * releasing them all (destroyed by the engine at the next event-loop iteration).
+ */
+struct BenchPopulationActor : Actor, Actor::Callback
+{
+    BenchContext &context;
+    std::vector<ActorReference<BenchLiveActor>> liveActors;
+    ActorReference<BenchOrderActor> orderActors[ROUND_ACTOR_COUNT];
+    uint64_t createdCount;
+    uint64_t destroyedCount;
+    int64_t createNanoseconds;
+    int64_t releaseNanoseconds;
+    BenchTimer timer;
+
+    BenchPopulationActor(BenchContext *pcontext)
+        : context(*pcontext), createdCount(0), destroyedCount(0), createNanoseconds(0), releaseNanoseconds(0)
+    {
+        liveActors.reserve(context.liveActorCount);
+        for (size_t i = 0; i < context.liveActorCount; ++i)
+        {
+            liveActors.push_back(newReferencedActor<BenchLiveActor>());
+        }
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        if (destroyedCount == context.cycleCount)
+        {
+            report(timer.elapsedNanoseconds());
+            for (size_t i = 0; i < liveActors.size(); ++i)
+            {
+                liveActors[i]->requestDestroy();
+            }
+            liveActors.clear();
+            context.doneCondition.notify();
+            return;
+        }
+        if (createdCount == 0)
+        {
+            timer.reset();
+        }
+        if (destroyedCount == createdCount)
+        {
+            const unsigned n = (unsigned)std::min<uint64_t>(ROUND_ACTOR_COUNT, context.cycleCount - createdCount);
+            BenchTimer createTimer;
+            for (unsigned i = 0; i < n; ++i)
+            {
+                orderActors[i] = newReferencedActor<BenchOrderActor>(&destroyedCount);
+            }
+            createNanoseconds += createTimer.elapsedNanoseconds();
+            BenchTimer releaseTimer;
+            for (unsigned i = 0; i < n; ++i)
+            {
+                orderActors[i]->requestDestroy();
+                orderActors[i].reset();
+            }
+            releaseNanoseconds += releaseTimer.elapsedNanoseconds();
+            createdCount += n;
+        }
+        registerCallback(*this);
+    }
+    void report(int64_t elapsedNanoseconds)
+    {
+        char name[128];
+        std::snprintf(name, sizeof(name), "newReferencedActor (%zu live actors)", context.liveActorCount);
+        benchReport(name, createdCount, createNanoseconds);
+        std::snprintf(name, sizeof(name), "requestDestroy+unreference (%zu live actors)", context.liveActorCount);
+        benchReport(name, createdCount, releaseNanoseconds);
+        std::snprintf(name, sizeof(name), "create/reference/destroy cycle (%zu live actors)", context.liveActorCount);
+        benchReport(name, createdCount, elapsedNanoseconds);
+    }
+};
+
+void benchLifecycle(size_t liveActorCount, uint64_t cycleCount)
+{
+    BenchContext context(liveActorCount, cycleCount);
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<BenchPopulationActor>(0, &context);
+    Engine engine(startSequence);
+    context.doneCondition.wait();
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const bool quickFlag = benchIsQuick(argc, argv);
+    const uint64_t cycleCount = quickFlag ? 10 * ROUND_ACTOR_COUNT : 1000 * ROUND_ACTOR_COUNT;
+
+    benchLifecycle(1000, cycleCount);
+    benchLifecycle(100000, cycleCount);
+    if (!quickFlag)
+    {
+        benchLifecycle(1000000, cycleCount);
+    }
+    return 0;
+}
@@ -0,0 +1,298 @@
+/**
+ * @file benchprimitives.cpp
+ * @brief engine primitives: event-loop allocator, intrusive chains, mmap serial buffer, data streams
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "trz/engine/internal/datastream.h"
+#include "trz/engine/internal/mdoublechain.h"
+#include "trz/engine/internal/mforwardchain.h"
+#include "trz/engine/internal/mmapserialbuffer.h"
+#include "trz/engine/internal/node.h"
+
+#include "benchutil.h"
+
+using namespace tredzone;
+
+namespace
+{
+
+struct ForwardItem : MultiForwardChainLink<ForwardItem>
+{
+    uint64_t value;
+};
+typedef ForwardItem::ForwardChain<> BenchForwardChain;
+
+struct DoubleItem : MultiDoubleChainLink<DoubleItem>
+{
+    uint64_t value;
+};
+typedef DoubleItem::DoubleChain<> BenchDoubleChain;
+
+void benchAllocator(uint64_t operationCount)
+{
+    static const size_t BATCH_SIZE = 1024;
+    char name[128];
+    AsyncNodeAllocator allocator;
+    std::vector<void *> batch(BATCH_SIZE);
+    for (size_t sz = 8; sz <= 4096; sz *= 2)
+    {
+        // warm-up: carve the pages of this size class
+        for (size_t i = 0; i < BATCH_SIZE; ++i)
+        {
+            batch[i] = allocator.allocate(sz);
+        }
+        for (size_t i = 0; i < BATCH_SIZE; ++i)
+        {
+            allocator.deallocate(sz, batch[i]);
+        }
+
+        std::snprintf(name, sizeof(name), "AsyncNodeAllocator allocate+deallocate (%zu bytes)", sz);
+        benchRun(name, operationCount, [&](uint64_t) {
+            void *p = allocator.allocate(sz);
+            benchDoNotOptimize(p);
+            allocator.deallocate(sz, p);
+        });
+
+        std::snprintf(name, sizeof(name), "AsyncNodeAllocator batch of %zu (%zu bytes)", BATCH_SIZE, sz);
+        benchRun(name, operationCount, [&](uint64_t i) {
+            const size_t j = (size_t)(i % BATCH_SIZE);
+            if (i / BATCH_SIZE % 2 == 0)
+            {
+                batch[j] = allocator.allocate(sz);
+            }
+            else
+            {
+                allocator.deallocate(sz, batch[j]);
+            }
+        });
+        if (operationCount / BATCH_SIZE % 2 != 0)
+        {
+            for (size_t j = 0; j < BATCH_SIZE; ++j)
+            {
+                allocator.deallocate(sz, batch[j]);
+            }
+        }
+    }
+}
+
+void benchForwardChain(uint64_t operationCount, size_t itemCount)
+{
+    char name[128];
+    std::vector<ForwardItem> items(itemCount);
+    BenchForwardChain chain, otherChain;
+
+    std::snprintf(name, sizeof(name), "ForwardChain push_front+pop_front (%zu items)", itemCount);
+    benchRun(name, operationCount, [&](uint64_t i) {
+        const size_t j = (size_t)(i % itemCount);
+        chain.push_front(&items[j]);
+        if (j == itemCount - 1)
+        {
+            while (!chain.empty())
+            {
+                benchDoNotOptimize(chain.pop_front()->value);
+            }
+        }
+    });
+    while (!chain.empty())
+    {
+        chain.pop_front();
+    }
+
+    std::snprintf(name, sizeof(name), "ForwardChain push_back+pop_front (%zu items)", itemCount);
+    benchRun(name, operationCount, [&](uint64_t i) {
+        const size_t j = (size_t)(i % itemCount);
+        chain.push_back(&items[j]);
+        if (j == itemCount - 1)
+        {
+            while (!chain.empty())
+            {
+                benchDoNotOptimize(chain.pop_front()->value);
+            }
+        }
+    });
+    while (!chain.empty())
+    {
+        chain.pop_front();
+    }
+
+    for (size_t i = 0; i < itemCount; ++i)
+    {
+        (i % 2 == 0 ? chain : otherChain).push_back(&items[i]);
+    }
+    std::snprintf(name, sizeof(name), "ForwardChain splice (push_back(chain), %zu items)", itemCount);
+    benchRun(name, operationCount, [&](uint64_t) {
+        chain.push_back(otherChain);
+        otherChain.push_back(chain);
+    });
+}
+
+void benchDoubleChain(uint64_t operationCount, size_t itemCount)
+{
+    char name[128];
+    std::vector<DoubleItem> items(itemCount);
+    BenchDoubleChain chain, otherChain;
+
+    std::snprintf(name, sizeof(name), "DoubleChain push_back+pop_front (%zu items)", itemCount);
+    benchRun(name, operationCount, [&](uint64_t i) {
+        const size_t j = (size_t)(i % itemCount);
+        chain.push_back(&items[j]);
+        if (j == itemCount - 1)
+        {
+            while (!chain.empty())
+            {
+                benchDoNotOptimize(chain.pop_front()->value);
+            }
+        }
+    });
+    while (!chain.empty())
+    {
+        chain.pop_front();
+    }
+
+    for (size_t i = 0; i < itemCount; ++i)
+    {
+        chain.push_back(&items[i]);
+    }
+    std::snprintf(name, sizeof(name), "DoubleChain remove+push_back (%zu items)", itemCount);
+    benchRun(name, operationCount, [&](uint64_t i) {
+        DoubleItem *item = &items[(size_t)((i * 7919) % itemCount)];
+        chain.remove(item);
+        chain.push_back(item);
+    });
+    while (!chain.empty())
+    {
+        chain.pop_front();
+    }
+
+    for (size_t i = 0; i < itemCount; ++i)
+    {
+        (i % 2 == 0 ? chain : otherChain).push_back(&items[i]);
+    }
+    std::snprintf(name, sizeof(name), "DoubleChain splice (push_back(chain), %zu items)", itemCount);
+    benchRun(name, operationCount, [&](uint64_t) {
+        chain.push_back(otherChain);
+        otherChain.push_back(chain);
+    });
+    while (!otherChain.empty())
+    {
+        otherChain.pop_front();
+    }
+}
+
+void benchSerialBuffer(uint64_t recordCount)
+{
+    static const uint64_t ROUND_RECORD_COUNT = 1 << 16; // cleared every round (buffer is not circular)
+    const std::string text("ABCDEFGHIJKLMNOP");
+    mmapSerialBuffer buffer;
+    uint64_t sum = 0;
+
+    benchRun("mmapSerialBuffer write (uint64, uint32, 16-char string)", recordCount, [&](uint64_t i) {
+        if (i % ROUND_RECORD_COUNT == 0)
+        {
+            buffer.clear();
+        }
+        buffer << i << (uint32_t)i << text;
+    });
+
+    buffer.clear();
+    for (uint64_t i = 0; i < ROUND_RECORD_COUNT; ++i)
+    {
+        buffer << i << (uint32_t)i << text;
+    }
+    const mmapSerialBuffer::WriteMark mark = buffer.getCurrentWriteMark();
+    std::string s;
+    benchRun("mmapSerialBuffer read (uint64, uint32, 16-char string)", recordCount, [&](uint64_t i) {
+        if (i % ROUND_RECORD_COUNT == 0 && i != 0)
+        {
+            // rewind
+            buffer.clear();
+            buffer.increaseCurrentWriteBufferSize(mark);
+        }
+        uint64_t u64;
+        uint32_t u32;
+        buffer >> u64 >> u32 >> s;
+        sum += u64 + u32 + s.size();
+    });
+    benchDoNotOptimize(sum);
+}
+
+void benchDataStream(uint64_t recordCount)
+{
+    static const uint64_t ROUND_RECORD_COUNT = 1 << 16; // rewound every round
+    static const size_t ARRAY_SIZE = 16;
+    const std::string text("ABCDEFGHIJKLMNOP");
+    uint32_t array[ARRAY_SIZE] = {};
+    std::ostringstream oss;
+    DataOutputStream<> dos(oss);
+    for (uint64_t i = 0; i < ROUND_RECORD_COUNT; ++i)
+    {
+        dos << i << (uint32_t)i << (uint16_t)i << text;
+        for (size_t j = 0; j < ARRAY_SIZE; ++j)
+        {
+            dos << array[j];
+        }
+    }
+    const std::string serialized = oss.str();
+    std::istringstream iss(serialized);
+    DataInputStream<> dis(iss);
+    uint64_t sum = 0;
+
+    benchRun("DataInputStream read (3 ints, 16-char string, uint32[16])", recordCount,
+             [&](uint64_t i) {
+                 if (i % ROUND_RECORD_COUNT == 0)
+                 {
+                     iss.clear();
+                     iss.seekg(0);
+                 }
+                 uint64_t u64;
+                 uint32_t u32;
+                 uint16_t u16;
+                 std::string s;
+                 dis >> u64 >> u32 >> u16 >> s;
+                 for (size_t j = 0; j < ARRAY_SIZE; ++j)
+                 {
+                     dis >> array[j];
+                 }
+                 sum += u64 + u32 + u16 + s.size() + array[ARRAY_SIZE - 1];
+             });
+
+    DataBufferReader<> reader(serialized.data(), serialized.size());
+    benchRun("DataBufferReader read (3 ints, 16-char string, uint32[16])", recordCount,
+             [&](uint64_t i) {
+                 if (i % ROUND_RECORD_COUNT == 0)
+                 {
+                     reader = DataBufferReader<>(serialized.data(), serialized.size());
+                 }
+                 reader.Require(sizeof(uint64_t) + sizeof(uint32_t) + sizeof(uint16_t));
+                 const uint64_t u64 = reader.Fetch64();
+                 const uint32_t u32 = reader.Fetch32();
+                 const uint16_t u16 = reader.Fetch16();
+                 const std::string s = reader.ReadString();
+                 reader.Read32Array(array, ARRAY_SIZE);
+                 sum += u64 + u32 + u16 + s.size() + array[ARRAY_SIZE - 1];
+             });
+    benchDoNotOptimize(sum);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const bool quickFlag = benchIsQuick(argc, argv);
+    const uint64_t operationCount = quickFlag ? 10000 : 10000000;
+
+    benchAllocator(operationCount);
+    std::printf("\n");
+    benchForwardChain(operationCount, 1024);
+    benchDoubleChain(operationCount, 1024);
+    std::printf("\n");
+    benchSerialBuffer(operationCount);
+    benchDataStream(operationCount);
+    return 0;
+}
@@ -0,0 +1,274 @@
+/**
+ * @file benchtimer.cpp
+ * @brief TimerProxy/TimerActor scalability: firing jitter, per-tick cost and cross-core traffic
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <atomic>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "trz/engine/engine.h"
+#include "trz/util/timer.h"
+
+#include "benchutil.h"
+
+using namespace tredzone;
+
+namespace
+{
+
+static const size_t JITTER_HISTOGRAM_SIZE = 100001; // 1 microsecond buckets (last one: >= 100 ms)
+static const int DURATION_MILLISECOND_STEP = 10;    // proxy i duration: (1 + i % DURATION_STEP_COUNT) * 10 ms
+static const int DURATION_STEP_COUNT = 100;
+
+struct BenchCoreResult
+{
+    uint64_t timeoutCount;
+    uint64_t timerEventCount;     // events dispatched on the proxies core (TimeOutEvent)
+    uint64_t tickIterationCount;  // event-loop iterations dispatching at least one event
+    int64_t tickIterationNanoseconds;
+    uint64_t idleIterationCount;
+    int64_t idleIterationNanoseconds;
+    uint64_t writtenByteCount;    // to the timer service core (GetEvent)
+    int64_t maxJitterNanoseconds;
+    int64_t elapsedNanoseconds;
+    std::vector<uint32_t> jitterHistogram;
+};
+
+struct BenchContext
+{
+    size_t proxyCount;
+    int64_t runNanoseconds;
+    std::vector<BenchCoreResult> results;
+    std::atomic<unsigned> remainingCoreCount;
+    BenchWaitCondition doneCondition;
+    inline BenchContext(size_t pproxyCount, int64_t prunNanoseconds, unsigned coreCount)
+        : proxyCount(pproxyCount), runNanoseconds(prunNanoseconds), results(coreCount),
+          remainingCoreCount(coreCount)
+    {
+    }
+};
+
+struct BenchInit
+{
+    BenchContext *context;
+    unsigned resultIndex;
+};
+
+class BenchTimerActor;
+
+struct BenchTimerProxy : timer::TimerProxy
+{
+    BenchTimerActor &actor;
+    const int64_t durationNanoseconds;
+    const bool repeatFlag;
+    int64_t armNanoseconds;
+
+    BenchTimerProxy(BenchTimerActor &, size_t index);
+    void arm(int64_t nowNanoseconds) noexcept
+    {
+        armNanoseconds = nowNanoseconds;
+        if (repeatFlag)
+        {
+            setRepeat(Time::Nanosecond(durationNanoseconds));
+        }
+        else
+        {
+            set(Time::Nanosecond(durationNanoseconds));
+        }
+    }
+    virtual void onTimeout(const DateTime &) noexcept;
+};
+
+/**
+ * Holds context.proxyCount armed proxies (even: one-shot, re-armed on timeout; odd: repeat)
+ * and samples each event-loop iteration with a performance-neutral callback.
+ */
+class BenchTimerActor : public Actor, public Actor::Callback
+{
+  public:
+    BenchTimerActor(const BenchInit &init)
+        : context(*init.context), result(init.context->results[init.resultIndex]),
+          timerNodeId(timer::TimerProxy::getTimerServiceActorId(getEngine().getServiceIndex()).getNodeId()),
+          armedFlag(false), lastNanoseconds(0), lastEventCount(0), startWrittenByteCount(0)
+    {
+        result = BenchCoreResult();
+        result.jitterHistogram.resize(JITTER_HISTOGRAM_SIZE);
+        for (size_t i = 0; i < context.proxyCount; ++i)
+        {
+            proxies.emplace_back(*this, i);
+        }
+        registerPerformanceNeutralCallback(*this);
+    }
+    void onTimeout(BenchTimerProxy &proxy) noexcept
+    {
+        const int64_t nowNanoseconds = clock.elapsedNanoseconds();
+        const int64_t jitterNanoseconds = nowNanoseconds - proxy.armNanoseconds - proxy.durationNanoseconds;
+        const size_t bucket = jitterNanoseconds <= 0 ? 0 : (size_t)(jitterNanoseconds / 1000);
+        ++result.jitterHistogram[std::min(bucket, JITTER_HISTOGRAM_SIZE - 1)];
+        result.maxJitterNanoseconds = std::max(result.maxJitterNanoseconds, jitterNanoseconds);
+        ++result.timeoutCount;
+        if (proxy.repeatFlag)
+        {
+            proxy.armNanoseconds = nowNanoseconds;
+        }
+        else
+        {
+            proxy.arm(nowNanoseconds);
+        }
+    }
+    void onCallback() noexcept
+    {
+        const int64_t nowNanoseconds = clock.elapsedNanoseconds();
+        const CorePerformanceCounters &counters = getCorePerformanceCounters();
+        if (!armedFlag)
+        {
+            armedFlag = true;
+            clock.reset();
+            for (std::deque<BenchTimerProxy>::iterator i = proxies.begin(), endi = proxies.end(); i != endi; ++i)
+            {
+                i->arm(0);
+            }
+            lastEventCount = counters.getOnEventCount();
+            startWrittenByteCount = counters.getTotalWrittenEventByteSizeTo(timerNodeId);
+            lastNanoseconds = clock.elapsedNanoseconds();
+            registerPerformanceNeutralCallback(*this);
+            return;
+        }
+        const uint64_t eventCount = counters.getOnEventCount();
+        if (eventCount != lastEventCount)
+        {
+            result.timerEventCount += eventCount - lastEventCount;
+            ++result.tickIterationCount;
+            result.tickIterationNanoseconds += nowNanoseconds - lastNanoseconds;
+            lastEventCount = eventCount;
+        }
+        else
+        {
+            ++result.idleIterationCount;
+            result.idleIterationNanoseconds += nowNanoseconds - lastNanoseconds;
+        }
+        lastNanoseconds = nowNanoseconds;
+        if (nowNanoseconds < context.runNanoseconds)
+        {
+            registerPerformanceNeutralCallback(*this);
+            return;
+        }
+        result.elapsedNanoseconds = nowNanoseconds;
+        result.writtenByteCount = counters.getTotalWrittenEventByteSizeTo(timerNodeId) - startWrittenByteCount;
+        proxies.clear();
+        if (context.remainingCoreCount.fetch_sub(1) == 1)
+        {
+            context.doneCondition.notify();
+        }
+    }
+
+  private:
+    BenchContext &context;
+    BenchCoreResult &result;
+    const NodeId timerNodeId;
+    std::deque<BenchTimerProxy> proxies; // not moved once constructed
+    BenchTimer clock;
+    bool armedFlag;
+    int64_t lastNanoseconds;
+    uint64_t lastEventCount;
+    uint64_t startWrittenByteCount;
+};
+
+BenchTimerProxy::BenchTimerProxy(BenchTimerActor &pactor, size_t index)
+    : timer::TimerProxy(pactor),
+      actor(pactor),
+      durationNanoseconds((int64_t)(1 + index % DURATION_STEP_COUNT) * DURATION_MILLISECOND_STEP * 1000000),
+      repeatFlag(index % 2 != 0), armNanoseconds(0)
+{
+}
+
+void BenchTimerProxy::onTimeout(const DateTime &) noexcept { actor.onTimeout(*this); }
+
+int64_t jitterPercentile(const std::vector<uint32_t> &histogram, uint64_t count, double percentile)
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    const uint64_t rank = (uint64_t)((double)count * percentile);
+    uint64_t n = 0;
+    for (size_t i = 0; i < histogram.size(); ++i)
+    {
+        n += histogram[i];
+        if (n > rank)
+        {
+            return (int64_t)i;
+        }
+    }
+    return (int64_t)histogram.size() - 1;
+}
+
+void benchTimer(size_t proxyCount, int64_t runNanoseconds, unsigned coreCount)
+{
+    // timer service on core 0, proxies on the other cores (on core 0 as well if single cpu)
+    const unsigned proxyCoreCount = coreCount == 1 ? 1 : coreCount - 1;
+    BenchContext context(proxyCount, runNanoseconds, proxyCoreCount);
+    Engine::CoreSet coreSet;
+    for (unsigned i = 0; i < coreCount; ++i)
+    {
+        coreSet.set((Actor::CoreId)i);
+    }
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addServiceActor<service::Timer, timer::TimerActor>(0);
+    for (unsigned i = 0; i < proxyCoreCount; ++i)
+    {
+        BenchInit init = {&context, i};
+        startSequence.addActor<BenchTimerActor>((Actor::CoreId)(coreCount == 1 ? 0 : i + 1), init);
+    }
+    {
+        Engine engine(startSequence);
+        context.doneCondition.wait();
+    }
+
+    for (unsigned i = 0; i < proxyCoreCount; ++i)
+    {
+        const BenchCoreResult &result = context.results[i];
+        const double seconds = (double)result.elapsedNanoseconds / 1e9;
+        const double tickNanoseconds =
+            result.tickIterationCount == 0 ? 0. : (double)result.tickIterationNanoseconds / result.tickIterationCount;
+        const double idleNanoseconds =
+            result.idleIterationCount == 0 ? 0. : (double)result.idleIterationNanoseconds / result.idleIterationCount;
+        std::printf("%8zu proxies core %u: %10.0f timeouts/s %8.0f ticks/s %10.1f us/tick"
+                    " (%4.1f%% busy) jitter p50 %6lld us p99 %6lld us max %6lld us",
+                    proxyCount, coreCount == 1 ? 0 : i + 1, (double)result.timeoutCount / seconds,
+                    (double)result.timerEventCount / seconds, (tickNanoseconds - idleNanoseconds) / 1e3,
+                    100. * (double)result.tickIterationNanoseconds / (double)result.elapsedNanoseconds,
+                    (long long)jitterPercentile(result.jitterHistogram, result.timeoutCount, .5),
+                    (long long)jitterPercentile(result.jitterHistogram, result.timeoutCount, .99),
+                    (long long)(result.maxJitterNanoseconds / 1000));
+        if (coreCount == 1)
+        {
+            std::printf("\n");
+        }
+        else
+        {
+            std::printf(" %8.0f B/s to timer core\n", (double)result.writtenByteCount / seconds);
+        }
+    }
+    std::fflush(stdout);
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    const bool quickFlag = benchIsQuick(argc, argv);
+    const int64_t runNanoseconds = quickFlag ? 200000000 : 2000000000;
+    const size_t maxProxyCount = quickFlag ? 10000 : 1000000;
+    const unsigned coreCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency()));
+
+    for (size_t proxyCount = 1000; proxyCount <= maxProxyCount; proxyCount *= 10)
+    {
+        benchTimer(proxyCount, runNanoseconds, coreCount);
+    }
+    return 0;
+}
@@ -0,0 +1,110 @@
+/**
+ * @file benchutil.h
+ * @brief common micro benchmark utilities header
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "trz/engine/internal/thread.h"
+#include "trz/engine/platform.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Prevents the compiler from optimizing away a computed value.
+ */
+template <class T> inline void benchDoNotOptimize(const T &value) noexcept
+{
+    __asm__ volatile("" : : "g"(&value) : "memory");
+}
+
+/**
+ * @brief Wall-clock (monotonic) stopwatch.
+ */
+class BenchTimer
+{
+  public:
+    inline BenchTimer() : start(HighResolutionTime()()) {}
+    inline void reset() { start = HighResolutionTime()(); }
+    inline int64_t elapsedNanoseconds() { return (HighResolutionTime()() - start).toNanosecond(); }
+
+  private:
+    Time start;
+};
+
+/**
+ * @brief Prints one result line: name, operation count, total time and per-operation cost.
+ */
+inline void benchReport(const char *name, uint64_t operationCount, int64_t elapsedNanoseconds)
+{
+    std::printf("%-56s %12llu ops %10.3f ms %10.2f ns/op\n", name, (unsigned long long)operationCount,
+                (double)elapsedNanoseconds / 1e6,
+                operationCount == 0 ? 0. : (double)elapsedNanoseconds / (double)operationCount);
+    std::fflush(stdout);
+}
+
+/**
+ * @brief Runs fn(i) for i in [0, operationCount[ and reports it.
+ */
+template <class _Function> inline void benchRun(const char *name, uint64_t operationCount, _Function fn)
+{
+    BenchTimer timer;
+    for (uint64_t i = 0; i < operationCount; ++i)
+    {
+        fn(i);
+    }
+    benchReport(name, operationCount, timer.elapsedNanoseconds());
+}
+
+/**
+ * @brief One-shot notification from an event-loop thread to the benchmark (main) thread.
+ */
+class BenchWaitCondition
+{
+  public:
+    inline BenchWaitCondition() : signal(mutex), flag(false) {}
+    inline void wait()
+    {
+        Mutex::Lock lock(mutex);
+        while (!flag)
+        {
+            signal.wait();
+        }
+    }
+    inline void notify()
+    {
+        Mutex::Lock lock(mutex);
+        flag = true;
+        signal.notify();
+    }
+
+  private:
+    Mutex mutex;
+    Signal signal;
+    bool flag;
+};
+
+/**
+ * @brief Parses an optional "--quick" flag (reduced sizes, used for smoke-testing the benchmarks themselves).
+ */
+inline bool benchIsQuick(int argc, char *argv[]) noexcept
+{
+    for (int i = 1; i < argc; ++i)
+    {
+        if (std::strcmp(argv[i], "--quick") == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace tredzone
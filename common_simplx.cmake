@@ -6,6 +6,10 @@ project(root)
 set(SIMPLX_DIR ${CMAKE_CURRENT_LIST_DIR})
 
 option(TREDZONE_E2E "TREDZONE_E2E" OFF)
+option(TREDZONE_TRACE "TREDZONE_TRACE" OFF)     # record engine hook points (see trz/util/trace.h)
+option(TREDZONE_USDT "TREDZONE_USDT" ON)        # USDT static tracepoints (see trz/engine/internal/probes.h)
+option(TREDZONE_LATENCY_TRACKER "TREDZONE_LATENCY_TRACKER" OFF)    # causal trace id in events (see trz/engine/latencytracker.h)
+set(TREDZONE_LOG_MIN_SEVERITY "0" CACHE STRING "TREDZONE_LOG_MIN_SEVERITY")  # 0 (debug) to 3 (error), see trz/util/binarylogger.h
 
 INCLUDE(Dart)
 
@@ -81,6 +85,22 @@ macro(trz_add_topdir)
         add_definitions(-DTREDZONE_E2E=0)     # only valid in current directory
     endif()
     
+    if (${TREDZONE_TRACE})
+        add_definitions(-DTREDZONE_TRACE=1)   # only valid in current directory
+    endif()
+    
+    if (${TREDZONE_LATENCY_TRACKER})
+        add_definitions(-DTREDZONE_LATENCY_TRACKER=1)   # only valid in current directory
+    endif()
+    
+    if (NOT ${TREDZONE_USDT})
+        add_definitions(-DTREDZONE_USDT=0)    # only valid in current directory
+    endif()
+    
+    if (NOT "${TREDZONE_LOG_MIN_SEVERITY}" STREQUAL "0")
+        add_definitions(-DTREDZONE_LOG_MIN_SEVERITY=${TREDZONE_LOG_MIN_SEVERITY})   # only valid in current directory
+    endif()
+    
     set(reldir "${ARGV0}")
     
     set(dir1 "${SIMPLX_DIR}/${reldir}")
@@ -103,6 +123,15 @@ function(trz_add_test test_name source_file dependency)
 
 endfunction()
 
+#---- Add Benchmark ------------------------------------------------------------
+
+function(trz_add_bench bench_name source_file dependency)
+
+	add_executable(${bench_name} ${source_file})
+	target_link_libraries(${bench_name} ${dependency} ${ARGN} ${CMAKE_THREAD_LIBS_INIT})
+
+endfunction()
+
 #---- Set Link Dependencies ----------------------------------------------------
 
 function(trz_target_link_libraries test_name dependency)
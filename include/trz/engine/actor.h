@@ -16,11 +16,13 @@
 #include "trz/engine/internal/intrinsics.h"
 #include "trz/engine/internal/mdoublechain.h"
 #include "trz/engine/internal/mforwardchain.h"
+#include "trz/engine/internal/probes.h"
 #include "trz/engine/internal/property.h"
 #include "trz/engine/internal/serialbufferchain.h"
 #include "trz/engine/internal/stringstream.h"
 #include "trz/engine/internal/thread.h"
 #include "trz/engine/internal/RefMapper.h"
+#include "trz/engine/internal/scratcharena.h"
 #include "trz/util/enterprise.h"
 
 
@@ -43,6 +45,7 @@ class EngineToEngineConnector;
 class EngineToEngineSerialConnector;
 class EngineToEngineSharedMemoryConnector;
 class EngineToEngineConnectorEventFactory;
+class IngressChannelBase;
 
 struct FeatureNotImplementedException : std::exception
 {
@@ -125,6 +128,9 @@ class Actor : private MultiDoubleChainLink<Actor, 2u>, virtual private ActorBase
   private:
     struct EventBase;
     friend class EngineToEngineConnectorEventFactory;
+    friend class IngressChannelBase;
+    friend class LocalPipeBase;
+    friend class LatencyTracker;
 
 //---- ActorReferenceBase START ------------------------------------------------
 
@@ -526,7 +532,122 @@ public:
       private:
         inline Allocator(AsyncNode &pasyncNode) noexcept : AllocatorBase(pasyncNode) {}
     };
-    
+
+    /**
+     * @brief Non-template base-class of stl-compliant Actor::ScratchAllocator.
+     *
+     * Allocates from the event-loop (cpu-core) ScratchArena: an allocation costs a pointer increment,
+     * and all memory is reclaimed at the end of the current event-loop iteration.
+     * Therefore, memory obtained through this allocator must never outlive the callback
+     * (e.g. onEvent(), onCallback()) in which it was allocated.<br>
+     * In debug (NDEBUG macro not defined), any allocation/deallocation through an instance obtained in a previous
+     * event-loop iteration asserts, and reclaimed memory is poisoned.<br>
+     * A usable instance of this class can only be obtained from the Actor::getScratchAllocator() factory-method.
+     */
+    class ScratchAllocatorBase
+    {
+      public:
+        /**
+         * @brief Default constructor.
+         * @note Only there for stl-compliance, allocation will always throw std::bad_alloc.
+         */
+        inline ScratchAllocatorBase() noexcept : scratchArena(0)
+#ifndef NDEBUG
+            , debugGeneration(0)
+#endif
+        {
+        }
+        /**
+         * @brief Constructor with event-loop context.
+         * @param scratchArena event-loop scratch arena.
+         * @note Instead use, the Actor::getScratchAllocator() factory-method.
+         */
+        inline ScratchAllocatorBase(ScratchArena &pscratchArena) noexcept : scratchArena(&pscratchArena)
+#ifndef NDEBUG
+            , debugGeneration(pscratchArena.getGeneration())
+#endif
+        {
+        }
+        inline bool operator==(const ScratchAllocatorBase &other) const noexcept
+        {
+            return scratchArena == other.scratchArena;
+        }
+        inline bool operator!=(const ScratchAllocatorBase &other) const noexcept
+        {
+            return scratchArena != other.scratchArena;
+        }
+
+      protected:
+        /**
+         * @throw std::bad_alloc
+         */
+        inline void *allocate(size_t sz, size_t alignment)
+        {
+            if (scratchArena == 0)
+            {
+                throw std::bad_alloc();
+            }
+            assert(debugGeneration == scratchArena->getGeneration()); // allocator escaped its event-loop iteration
+            return scratchArena->allocate(sz, alignment);
+        }
+        inline void deallocate(size_t sz, void *p) noexcept
+        {
+            assert(scratchArena != 0);
+            assert(debugGeneration == scratchArena->getGeneration()); // memory escaped its event-loop iteration
+            scratchArena->deallocate(p, sz);
+        }
+
+      private:
+        ScratchArena *scratchArena;
+#ifndef NDEBUG
+        uint64_t debugGeneration;
+#endif
+    };
+    /**
+     * @brief STL-compliant allocator template based on Actor::ScratchAllocatorBase.
+     * \code
+     * std::vector<int, Actor::ScratchAllocator<int>> tmp(getScratchAllocator());
+     * \endcode
+     */
+    template <class T> class ScratchAllocator : public ScratchAllocatorBase
+    {
+      public:
+        typedef T value_type;              ///< STL-compliant
+        typedef size_t size_type;          ///< STL-compliant
+        typedef ptrdiff_t difference_type; ///< STL-compliant
+        typedef T *pointer;                ///< STL-compliant
+        typedef const T *const_pointer;    ///< STL-compliant
+        typedef T &reference;              ///< STL-compliant
+        typedef const T &const_reference;  ///< STL-compliant
+
+        /**
+         * @brief STL-compliant.
+         */
+        template <class U> struct rebind
+        {
+            typedef ScratchAllocator<U> other; ///< STL-compliant
+        };
+
+        inline ScratchAllocator() noexcept {}
+        inline ScratchAllocator(const ScratchAllocatorBase &other) noexcept : ScratchAllocatorBase(other) {}
+        inline pointer address(reference r) const { return &r; }
+        inline const_pointer address(const_reference r) const { return &r; }
+        /**
+         * @throw std::bad_alloc
+         */
+        inline pointer allocate(size_type n, const void * = 0)
+        {
+            return static_cast<pointer>(ScratchAllocatorBase::allocate(n * sizeof(T), alignof(T)));
+        }
+        inline void deallocate(pointer p, size_type n) noexcept { ScratchAllocatorBase::deallocate(n * sizeof(T), p); }
+        template <class U, class... Args> void construct(U *p, Args &&... args)
+        {
+            ::new ((void *)p) U(std::forward<Args>(args)...);
+        }
+        inline void destroy(pointer p) { p->~T(); }
+        inline size_type max_size() const noexcept { return std::numeric_limits<size_type>::max(); }
+    };
+
     /**
      * @brief Smart-pointer placeholder to an actor reference.
      *
@@ -750,6 +871,7 @@ public:
       private:
         friend class AsyncNode;
         friend class AsyncNodesHandle;
+        friend class LocalPipeBase;
         typedef std::vector<const uint64_t *, Allocator<const uint64_t *>> SizePointerVector;
         SizePointerVector writtenSizePointerVector;
         uint64_t loopTotalCount;
@@ -958,6 +1080,7 @@ public:
         friend class Actor;
         friend class AsyncNodesHandle;
         friend class EngineToEngineSerialConnector;
+        friend class LocalPipeBase;
         friend std::ostream &operator<<(std::ostream &, const Actor::ActorId &);
         template <class> friend class Accessor;
 
@@ -1317,6 +1440,13 @@ public:
     const ActorId& getServiceActorId(void) const noexcept;
     
     AllocatorBase getAllocator() const noexcept;
+    /**
+     * @brief Getter to local event-loop (cpu-core) scratch allocator.
+     * Memory allocated through it is reclaimed at the end of the current event-loop iteration.
+     * @return A copy of a local event-loop (cpu-core) scratch allocator.
+     * @see ScratchAllocatorBase
+     */
+    ScratchAllocatorBase getScratchAllocator() const noexcept;
     /**
      * @brief Create a new typed actor-reference to an existing actor.
      * For this operation to succeed the following conditions must be met:
@@ -1761,6 +1891,7 @@ public:
             // Actor::onAdded(asyncNode);
             int i = 0;
             (void)i;
+            probeNew();
         }
         
         // dtor
@@ -1769,6 +1900,10 @@ public:
             _Actor &actor = static_cast<_Actor&>(*this);
             (void)actor;
             ENTERPRISE_0X5018(static_cast<Actor*>(&actor));
+            if (TREDZONE_PROBE_ENABLED(actor_destroy))
+            {
+                TREDZONE_PROBE2(actor_destroy, actor.actorId.getNodeId(), actor.actorId.getNodeActorId());
+            }
 
             TraceREF(actor.getAsyncNode(), __func__, actor.actorId, cppDemangledTypeInfoName(typeid(actor)), "-1.-1", "null")
         }
@@ -1778,6 +1913,17 @@ public:
             : ActorBase(&asyncNode),
             _Actor(actorInit)
         {
+            probeNew();
+        }
+
+        inline void probeNew() const noexcept
+        {
+            if (TREDZONE_PROBE_ENABLED(actor_new))
+            {
+                const _Actor &actor = static_cast<const _Actor &>(*this);
+                TREDZONE_PROBE3(actor_new, actor.actorId.getNodeId(), actor.actorId.getNodeActorId(),
+                                typeid(_Actor).name());
+            }
         }
         
         inline
@@ -1935,6 +2081,9 @@ public:
   
     EventBase()
         : classId(0), sourceActorId(0), destinationActorId(0), routeOffset(0)
+#if defined(TREDZONE_LATENCY_TRACKER) && TREDZONE_LATENCY_TRACKER
+          , traceId(0), tracePushTsc(0)
+#endif
     {
         // should never instantiate EventBase or a derivative manually
         // Events are instatiated "in-place" by the engine inside pipe::push<>()
@@ -1946,17 +2095,33 @@ private:
     friend class Actor::Event;
     friend class AsyncExceptionHandler;
     friend class EngineToEngineConnectorEventFactory;
+    friend class IngressChannelBase;
+    friend class LocalPipeBase;
+    friend class LatencyTracker;
     using route_offset_type = uint16_t;
 
     Actor::EventId          classId;
     Actor::InProcessActorId sourceActorId;
     Actor::InProcessActorId destinationActorId;
     route_offset_type       routeOffset;
+#if defined(TREDZONE_LATENCY_TRACKER) && TREDZONE_LATENCY_TRACKER
+    uint32_t                traceId;        // causal trace inherited from the pushing thread (see LatencyTracker)
+    uint32_t                tracePushTsc;   // low 32 bits of the TSC at push time, if traceId != 0
+#endif
 
     EventBase(Actor::EventId _classId, Actor::InProcessActorId _sourceActorId, Actor::InProcessActorId _destinationActorId, route_offset_type _routeOffset)
         : classId(_classId), sourceActorId(_sourceActorId), destinationActorId(_destinationActorId), routeOffset(_routeOffset)
+#if defined(TREDZONE_LATENCY_TRACKER) && TREDZONE_LATENCY_TRACKER
+          , traceId(currentTraceId()), tracePushTsc(traceId == 0 ? 0 : (uint32_t)getTSC())
+#endif
     {
     }
+
+    inline static uint32_t &currentTraceId() noexcept
+    {
+        static thread_local uint32_t traceId = 0;
+        return traceId;
+    }
 };
 
 namespace e2econnector
@@ -2004,6 +2169,8 @@ public:
     class AllocatorBase;
     template <class T> class Allocator;
     typedef Property<Allocator<char>> property_type;
+    typedef InPlaceOutputStringStream<Allocator<char>>
+        ostringstream_type; ///< tredzone::InPlaceOutputStringStream formatting directly into event memory.
     class Batch;
     class Pipe;
     class BufferedPipe;
@@ -2066,6 +2233,16 @@ public:
      * @return The engine (process) unique run-time id for this Event sub-class.
      */
     inline EventId getClassId() const noexcept { return classId; }
+    /**
+     * @brief Getter.
+     * @return The causal latency trace this event belongs to, 0 if untraced.
+     * @see LatencyTracker
+     */
+#if defined(TREDZONE_LATENCY_TRACKER) && TREDZONE_LATENCY_TRACKER
+    inline uint32_t getTraceId() const noexcept { return traceId; }
+#else
+    inline uint32_t getTraceId() const noexcept { return 0; }
+#endif
     /**
      * @brief Getter.
      * @return The place holder to output this event's name.
@@ -2226,6 +2403,15 @@ public:
      * @throw std::bad_alloc
      */
     inline static const char *newCString(const AllocatorBase &allocator, const Actor::ostringstream_type &s);
+    /**
+     * @brief Returns the string formatted by s, without copy if s already formats into the allocator memory.
+     * @attention Like any allocation using Event::Allocator, no deallocation is required.
+     * @param allocator event-allocator (see Pipe::getAllocator()).
+     * @param s Source event-output-string-stream (constructed with an event-allocator).
+     * @return A pointer to a C-string (including null-char terminator), in the memory of allocator.
+     * @throw std::bad_alloc
+     */
+    inline static const char *newCString(const AllocatorBase &allocator, ostringstream_type &s);
 
 protected:
 
@@ -2248,6 +2434,7 @@ private:
     friend class AsyncExceptionHandler;
     friend class EngineToEngineConnector;
     friend class EngineToEngineConnectorEventFactory;
+    friend class LatencyTracker;
     friend e2econnector::DicoTimer;
     
     friend std::ostream &operator<<(std::ostream &, const Actor::Event::OStreamName &);
@@ -2707,6 +2894,7 @@ class Actor::Event::Pipe
         _Event *ret = newEvent<_Event>(destinationEventChain);
         destinationEventChain->push_back(ret);
         ENTERPRISE_0X5019(sourceActor.getAsyncNode(), ret, &sourceActor, this);
+        probePush(*ret, sizeof(_Event));
         return *ret;
     }
     /**
@@ -2731,6 +2919,7 @@ class Actor::Event::Pipe
 		_Event* ret = newEvent<_Event>(destinationEventChain, args...);
 		destinationEventChain->push_back(ret);
         ENTERPRISE_0X5020(sourceActor.getAsyncNode(), ret, &sourceActor, this);
+        probePush(*ret, sizeof(_Event));
 		return *ret;
 	}
 
@@ -2740,6 +2929,7 @@ class Actor::Event::Pipe
 		_Event* ret = newEvent<_Event>(destinationEventChain, eventInit);
 		destinationEventChain->push_back(ret);
         ENTERPRISE_0X5021(sourceActor.getAsyncNode(), ret, &sourceActor, this);
+        probePush(*ret, sizeof(_Event));
 
 		return *ret;
 	}
@@ -2822,6 +3012,15 @@ class Actor::Event::Pipe
 
     Pipe &operator=(const Pipe &);
     inline EventFactory getEventFactory() noexcept;
+    inline void probePush(const Event &event, size_t eventSize) const noexcept
+    {
+        if (TREDZONE_PROBE_ENABLED(event_push))
+        {
+            const ActorId &sourceActorId = sourceActor.getActorId();
+            TREDZONE_PROBE6(event_push, event.getClassId(), sourceActorId.getNodeId(), sourceActorId.getNodeActorId(),
+                            destinationActorId.getNodeId(), destinationActorId.getNodeActorId(), eventSize);
+        }
+    }
     inline void registerProcessOutPipe() noexcept;
     inline void unregisterProcessOutPipe() noexcept
     {
@@ -2970,6 +3169,7 @@ class Actor::Event::BufferedPipe : public Actor::Event::Pipe
         assert(oldDestinationEventChain == 0 || oldDestinationEventChain == destinationEventChain);
         eventChain.push_back(ret);
         ENTERPRISE_0X5022(sourceActor.getAsyncNode(), ret, &sourceActor, this);
+        probePush(*ret, sizeof(_Event));
         return *ret;
     }
     /**
@@ -3004,6 +3204,7 @@ class Actor::Event::BufferedPipe : public Actor::Event::Pipe
         assert(oldDestinationEventChain == 0 || oldDestinationEventChain == destinationEventChain);
         eventChain.push_back(ret);
         ENTERPRISE_0X5023(sourceActor.getAsyncNode(), ret, &sourceActor, this);
+        probePush(*ret, sizeof(_Event));
         return *ret;
     }
     /**
@@ -3307,6 +3508,18 @@ const char *Actor::Event::newCString(const AllocatorBase &a, const Actor::ostrin
     return ret;
 }
 
+const char *Actor::Event::newCString(const AllocatorBase &a, ostringstream_type &s)
+{
+    if (s.get_allocator() == a)
+    {
+        return s.c_str();
+    }
+    size_t sz = s.size() + 1;
+    char *ret = Allocator<char>(a).allocate(sz);
+    std::memcpy(ret, s.c_str(), sz);
+    return ret;
+}
+
 Actor::Event::AllocatorBase::AllocatorBase() noexcept : factory(0) {}
 
 Actor::Event::AllocatorBase::AllocatorBase(const Pipe &peventPipe) noexcept : factory(&peventPipe.eventFactory)
@@ -0,0 +1,153 @@
+/**
+ * @file allocationguard.h
+ * @brief steady-state zero-allocation verification of event-loop threads
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "trz/engine/actor.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Detects heap allocations made by event-loop (engine) threads once a steady state was declared.
+ *
+ * After enterSteadyState(), every global operator new, malloc() (calloc(), realloc(), posix_memalign(),
+ * aligned_alloc(), memalign()) and every new AsyncNodeAllocator page (Actor::getAllocator()) made from an
+ * event-loop thread is counted and recorded with a backtrace (COUNT mode),
+ * or reported on stderr followed by abort() (TRAP mode). Other threads are not checked.
+ * A new AsyncNodeAllocator page is also counted as a malloc() (posix_memalign()).
+ * \code
+ * Engine engine(startSequence);
+ * ... // warm-up
+ * AllocationGuard::enterSteadyState();
+ * ... // measured run
+ * AllocationGuard::leaveSteadyState();
+ * ASSERT_EQ(0u, AllocationGuard::getCount());
+ * AllocationGuard::report(std::cout);
+ * \endcode
+ * @note The engine only holds the inline hooks below. The global operator new and malloc() replacements
+ * (malloc() family on glibc only), with the other AllocationGuard functions, are in the opt-in allocationguard
+ * library (src/util/allocationguard), which programs using AllocationGuard link with. Outside of steady state,
+ * they cost a relaxed atomic load per allocation.
+ */
+class AllocationGuard
+{
+  public:
+    enum Source
+    {
+        OPERATOR_NEW = 0,
+        MALLOC,
+        NODE_ALLOCATOR_PAGE,
+        SOURCE_COUNT
+    };
+    enum Mode
+    {
+        COUNT = 0, ///< count and record (up to MAX_RECORD_COUNT) allocations
+        TRAP       ///< report first allocation on stderr and abort()
+    };
+    static const size_t MAX_RECORD_COUNT = 64;
+    static const int MAX_BACKTRACE_SIZE = 32;
+
+    /**
+     * @brief A recorded steady-state allocation.
+     */
+    struct Allocation
+    {
+        Source source;
+        size_t size;
+        Actor::NodeId nodeId;
+        Actor::CoreId coreId;
+        std::vector<std::string> backtrace; ///< resolved (hexadecimal addresses in release build)
+    };
+
+    /**
+     * @brief Starts checking the allocations of event-loop threads.
+     */
+    static void enterSteadyState(Mode = COUNT) noexcept;
+    /** @brief Stops checking. */
+    static void leaveSteadyState() noexcept;
+    /**
+     * @brief Getter.
+     * @return true between enterSteadyState() and leaveSteadyState().
+     */
+    inline static bool isSteadyState() noexcept { return getHandler().load(std::memory_order_relaxed) != 0; }
+    /**
+     * @brief Getter.
+     * @return number of steady-state allocations of given source (all recorded or not).
+     */
+    static uint64_t getCount(Source) noexcept;
+    /**
+     * @brief Getter.
+     * @return number of steady-state allocations (all sources).
+     */
+    static uint64_t getCount() noexcept;
+    /**
+     * @brief Getter.
+     * @return the first (up to MAX_RECORD_COUNT) steady-state allocations.
+     */
+    static std::vector<Allocation> getAllocations(); // throw (std::bad_alloc)
+    /** @brief Resets counts and recorded allocations (not to be called in steady state). */
+    static void clear() noexcept;
+    /**
+     * @brief Writes the counts and recorded allocations in text form.
+     */
+    static void report(std::ostream &); // throw (std::bad_alloc, std::ios_base::failure)
+    /** @brief Getter. */
+    static const char *getSourceName(Source) noexcept;
+
+    /** @brief Engine-internal: marks the calling thread as event-loop thread. */
+    inline static void onThreadStart(Actor::NodeId nodeId, Actor::CoreId coreId) noexcept
+    {
+        ThreadState &threadState = getThreadState();
+        threadState.nodeId = nodeId;
+        threadState.coreId = coreId;
+        threadState.engineThreadFlag = true;
+    }
+    /** @brief Engine-internal. */
+    inline static void onThreadStop() noexcept { getThreadState().engineThreadFlag = false; }
+    /**
+     * @brief Engine-internal: checks an allocation.
+     */
+    inline static void onAllocation(Source source, size_t size) noexcept
+    {
+        Handler handler = getHandler().load(std::memory_order_relaxed);
+        if (handler != 0 && getThreadState().engineThreadFlag)
+        {
+            (*handler)(source, size);
+        }
+    }
+
+  private:
+    typedef void (*Handler)(Source, size_t);
+    struct ThreadState
+    {
+        bool engineThreadFlag;
+        bool inHandlerFlag; // allocations of the handler itself (backtrace()) are not checked
+        Actor::NodeId nodeId;
+        Actor::CoreId coreId;
+    };
+
+    // handler is set by the allocationguard library (non-null in steady state only)
+    inline static std::atomic<Handler> &getHandler() noexcept
+    {
+        static std::atomic<Handler> handler(0);
+        return handler;
+    }
+    inline static ThreadState &getThreadState() noexcept
+    {
+        static thread_local ThreadState threadState = {false, false, 0, 0};
+        return threadState;
+    }
+    static void handle(Source, size_t) noexcept;
+};
+
+} // namespace tredzone
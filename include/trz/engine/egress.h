@@ -0,0 +1,280 @@
+/**
+ * @file egress.h
+ * @brief actor to external-thread channel
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <utility>
+
+#include "trz/engine/internal/cacheline.h"
+#include "trz/engine/platform.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Lock-free single-producer single-consumer channel handing values over from an actor
+ * (the producer, running on its event-loop) to a non-engine thread (the consumer, e.g. a logger or DB writer).
+ *
+ * Slots are pre-allocated at construction: the producer never allocates, never locks, and tryPush() fails
+ * (returns false) when the consumer lags by more than the channel capacity.
+ * The consumer reads in batches (popBatch(), consume()), releasing the consumed slots in one store,
+ * and may block in wait() (futex based, when constructed with blockingFlag) instead of polling.
+ * In blocking mode, each publication costs the producer an extra full memory fence.
+ * \code
+ * // actor side
+ * if (!channel.tryPush(record)) { ++droppedCount; }
+ * // consumer thread
+ * while (channel.wait() || !channel.isClosed()) { channel.consume(writeRecord); }
+ * \endcode
+ * @note Only one thread may push, and only one (other) thread may pop.
+ */
+template <class T> class EgressChannel
+{
+  public:
+    typedef T value_type;
+    static const size_t DEFAULT_CAPACITY = 1024;
+
+    /**
+     * @brief Constructor.
+     * @param capacity maximum number of unread values (rounded up to a power of 2).
+     * @param pblockingFlag if true, the consumer sleeps in wait() and the producer wakes it up.
+     * Otherwise wait() polls (yielding the cpu).
+     * @throw std::bad_alloc
+     */
+    inline explicit EgressChannel(size_t capacity = DEFAULT_CAPACITY, bool pblockingFlag = true)
+        : mask(roundCapacity(capacity) - 1), blockingFlag(pblockingFlag),
+          slots(static_cast<T *>(alignMalloc(CACHE_LINE_SIZE, (mask + 1) * sizeof(T)))), tail(0), cachedHead(0),
+          head(0), cachedTail(0), wakeSequence(0), waiterFlag(0), closedFlag(false)
+    {
+        if (slots == 0)
+        {
+            throw std::bad_alloc();
+        }
+    }
+    inline ~EgressChannel() noexcept
+    {
+        for (size_t i = head.load(std::memory_order_relaxed), endi = tail.load(std::memory_order_relaxed); i != endi;
+             ++i)
+        {
+            slots[i & mask].~T();
+        }
+        alignFree(CACHE_LINE_SIZE, slots);
+    }
+
+    inline size_t getCapacity() const noexcept { return mask + 1; }
+    inline bool isBlocking() const noexcept { return blockingFlag; }
+    /**
+     * @return approximate number of unread values.
+     */
+    inline size_t size() const noexcept
+    {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+    inline bool isClosed() const noexcept { return closedFlag.load(std::memory_order_acquire); }
+
+    // producer
+
+    /**
+     * @brief Constructs a new value from args and publishes it to the consumer.
+     * @return false if the channel is full (nothing was pushed).
+     * @throw ? Any exception thrown by T constructor (nothing was pushed).
+     */
+    template <class... _Args> inline bool tryPush(_Args &&... args)
+    {
+        const size_t position = tail.load(std::memory_order_relaxed);
+        if (position - cachedHead > mask && position - (cachedHead = head.load(std::memory_order_acquire)) > mask)
+        {
+            return false;
+        }
+        new (&slots[position & mask]) T(std::forward<_Args>(args)...);
+        tail.store(position + 1, std::memory_order_release);
+        notify();
+        return true;
+    }
+    /**
+     * @brief Copies as many values of [first, last[ as possible, and publishes them at once.
+     * @return number of pushed values (may be less than the range size if the channel is full).
+     * @throw ? Any exception thrown by T copy-constructor (values copied so far are published).
+     */
+    template <class _InputIterator> size_t tryPushBatch(_InputIterator first, _InputIterator last)
+    {
+        const size_t position = tail.load(std::memory_order_relaxed);
+        size_t i = position;
+        try
+        {
+            for (; first != last; ++first, ++i)
+            {
+                if (i - cachedHead > mask && i - (cachedHead = head.load(std::memory_order_acquire)) > mask)
+                {
+                    break;
+                }
+                new (&slots[i & mask]) T(*first);
+            }
+        }
+        catch (...)
+        {
+            publish(position, i);
+            throw;
+        }
+        publish(position, i);
+        return i - position;
+    }
+    /**
+     * @brief Tells the consumer no more values will be pushed (wakes it up if blocked).
+     */
+    inline void close() noexcept
+    {
+        closedFlag.store(true, std::memory_order_release);
+        notify();
+    }
+
+    // consumer
+
+    inline bool empty() noexcept
+    {
+        const size_t position = head.load(std::memory_order_relaxed);
+        return position == cachedTail && position == (cachedTail = tail.load(std::memory_order_acquire));
+    }
+    /**
+     * @brief Moves the next value into value.
+     * @return false if the channel is empty.
+     * @throw ? Any exception thrown by T move-assignment (the value is left in the channel).
+     */
+    inline bool tryPop(T &value)
+    {
+        return popBatch(&value, 1) == 1;
+    }
+    /**
+     * @brief Moves up to maxCount values to out, and releases their slots to the producer at once.
+     * @return number of popped values.
+     * @throw ? Any exception thrown by the assignment to out (values moved so far are released,
+     * the one that failed is left in the channel).
+     */
+    template <class _OutputIterator> size_t popBatch(_OutputIterator out, size_t maxCount)
+    {
+        const size_t position = head.load(std::memory_order_relaxed);
+        // one acquire per batch
+        const size_t n = std::min((cachedTail = tail.load(std::memory_order_acquire)) - position, maxCount);
+        size_t i = position;
+        try
+        {
+            for (; i != position + n; ++i, ++out)
+            {
+                T &value = slots[i & mask];
+                *out = std::move(value);
+                value.~T();
+            }
+        }
+        catch (...)
+        {
+            head.store(i, std::memory_order_release);
+            throw;
+        }
+        head.store(i, std::memory_order_release);
+        return n;
+    }
+    /**
+     * @brief Calls fn(T &) in place (no copy) for up to maxCount values, and releases their slots
+     * to the producer at once. fn must not throw.
+     * @return number of consumed values.
+     */
+    template <class _Function>
+    inline size_t consume(_Function fn, size_t maxCount = std::numeric_limits<size_t>::max()) noexcept
+    {
+        const size_t position = head.load(std::memory_order_relaxed);
+        // one acquire per batch
+        const size_t n = std::min((cachedTail = tail.load(std::memory_order_acquire)) - position, maxCount);
+        for (size_t i = position; i != position + n; ++i)
+        {
+            T &value = slots[i & mask];
+            fn(value);
+            value.~T();
+        }
+        head.store(position + n, std::memory_order_release);
+        return n;
+    }
+    /**
+     * @brief Waits until the channel is not empty or closed.
+     * @param timeOut maximum (relative) wait duration, null means no limit.
+     * @return true if the channel is not empty. May spuriously return false (e.g. on time-out or close).
+     */
+    inline bool wait(const Time &timeOut = Time()) noexcept
+    {
+        if (!empty() || isClosed())
+        {
+            return !empty();
+        }
+        if (!blockingFlag)
+        {
+            threadYield();
+            return !empty();
+        }
+        const uint32_t sequence = wakeSequence.load(std::memory_order_acquire);
+        waiterFlag.store(1, std::memory_order_seq_cst);
+        if (empty() && !isClosed())
+        {
+            futexWait(reinterpret_cast<uint32_t *>(&wakeSequence), sequence, timeOut);
+        }
+        waiterFlag.store(0, std::memory_order_relaxed);
+        return !empty();
+    }
+
+  private:
+    const size_t mask;
+    const bool blockingFlag;
+    T *const slots;
+    char cacheLinePadding1[CACHE_LINE_SIZE];
+    std::atomic<size_t> tail; // producer
+    size_t cachedHead;
+    char cacheLinePadding2[CACHE_LINE_SIZE];
+    std::atomic<size_t> head; // consumer
+    size_t cachedTail;
+    char cacheLinePadding3[CACHE_LINE_SIZE];
+    std::atomic<uint32_t> wakeSequence;
+    std::atomic<uint32_t> waiterFlag;
+    std::atomic<bool> closedFlag;
+
+    inline static size_t roundCapacity(size_t capacity) noexcept
+    {
+        size_t ret = 2;
+        for (; ret < capacity; ret *= 2)
+        {
+        }
+        return ret;
+    }
+    inline void publish(size_t position, size_t newPosition) noexcept
+    {
+        if (newPosition != position)
+        {
+            tail.store(newPosition, std::memory_order_release);
+            notify();
+        }
+    }
+    inline void notify() noexcept
+    {
+        if (blockingFlag)
+        {
+            // pairs with the consumer storing waiterFlag then re-checking emptiness (one of both sees the other)
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiterFlag.load(std::memory_order_relaxed) != 0)
+            {
+                wakeSequence.fetch_add(1, std::memory_order_release);
+                futexWake(reinterpret_cast<uint32_t *>(&wakeSequence));
+            }
+        }
+    }
+
+    EgressChannel(const EgressChannel &);
+    EgressChannel &operator=(const EgressChannel &);
+};
+
+} // namespace tredzone
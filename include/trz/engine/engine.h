@@ -916,6 +916,7 @@ public:
     friend class Actor;
     friend class EngineToEngineConnector;
     friend class EngineEventLoop;
+    friend class IngressChannelBase;
     struct NewCoreStarter
     {
         virtual ~NewCoreStarter() noexcept {}
@@ -0,0 +1,180 @@
+/**
+ * @file flightrecorder.h
+ * @brief per-core record of the last dispatched events
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <csignal>
+#include <iosfwd>
+#include <mutex>
+
+#include "trz/engine/actor.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Always-on record of the last CAPACITY events dispatched by an event-loop (cpu-core),
+ * for post-mortem analysis of a wedged or crashed core.
+ *
+ * Each AsyncNode owns one. Every event handler call is recorded (TSC, event class-id, source and destination
+ * actor-ids, handler duration in TSC cycles), at the cost of two TSC reads and a few stores.
+ * A handler that did not return (it threw, or is still running) is reported as "unfinished".
+ * Every event-loop iteration is also timed, into a log2 histogram of iteration durations (see Watchdog).
+ * The recorders of every running event-loop are dumped:
+ * - on demand, by dumpAll(), or on a signal, once installSignalHandler() was called,
+ * - automatically, to stderr, when an exception escapes an event-loop thread.
+ * \code
+ * FlightRecorder::installSignalHandler(SIGUSR2); // then: kill -USR2 <pid>
+ * \endcode
+ * @note The dump is read while the event-loops are running, the most recent records may be torn.
+ */
+class FlightRecorder
+{
+  public:
+    static const size_t CAPACITY = 256; ///< number of records per core (power of 2)
+    static const size_t MAX_RECORDER_COUNT = 256; ///< maximum simultaneously registered recorders (per process)
+    static const size_t LOOP_HISTOGRAM_SIZE = 64; ///< bucket i counts iterations of [2^i, 2^(i+1)[ TSC cycles
+    static const int MAX_BACKTRACE_SIZE = 32;
+
+    struct Record
+    {
+        static const uint32_t UNFINISHED = UINT32_MAX;
+        uint64_t tsc;
+        Actor::NodeActorId sourceNodeActorId;
+        Actor::NodeActorId destinationNodeActorId;
+        uint32_t durationTsc; ///< saturated to UNFINISHED - 1, or UNFINISHED
+        Actor::EventId eventClassId;
+        Actor::NodeId sourceNodeId;
+        Actor::NodeId destinationNodeId;
+    };
+
+    FlightRecorder(Actor::NodeId, Actor::CoreId) noexcept;
+    ~FlightRecorder() noexcept;
+
+    /**
+     * @brief Records the beginning of an event handler call.
+     * @return record to be passed to onDispatchEnd() once the handler returned.
+     */
+    inline Record &onDispatchBegin(const Actor::Event &event) noexcept
+    {
+        const uint64_t position = writePosition.load(std::memory_order_relaxed);
+        Record &record = records[position & (CAPACITY - 1)];
+        record.durationTsc = Record::UNFINISHED;
+        record.sourceNodeActorId = event.getSourceActorId().getNodeActorId();
+        record.destinationNodeActorId = event.getDestinationActorId().getNodeActorId();
+        record.eventClassId = event.getClassId();
+        record.sourceNodeId = event.getSourceActorId().getNodeId();
+        record.destinationNodeId = event.getDestinationActorId().getNodeId();
+        record.tsc = getTSC();
+        writePosition.store(position + 1, std::memory_order_release);
+        return record;
+    }
+    inline static void onDispatchEnd(Record &record) noexcept
+    {
+        const uint64_t duration = getTSC() - record.tsc;
+        record.durationTsc = duration < Record::UNFINISHED ? (uint32_t)duration : Record::UNFINISHED - 1;
+    }
+    /**
+     * @brief Records the end of an event-loop iteration (and the beginning of the next one).
+     */
+    inline void onLoop() noexcept
+    {
+        const uint64_t tsc = getTSC();
+        const uint64_t duration = tsc - loopTsc.load(std::memory_order_relaxed);
+        std::atomic<uint64_t> &bucket = loopHistogram[63 - __builtin_clzll(duration | 1)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        loopTsc.store(tsc, std::memory_order_relaxed);
+    }
+    /**
+     * @brief Called once, by the event-loop thread, before its first iteration.
+     */
+    void onThreadStart() noexcept;
+    /**
+     * @brief Called once, by the event-loop thread, after its last iteration.
+     */
+    void onThreadStop() noexcept;
+
+    /**
+     * @brief Getter.
+     * @return TSC at the beginning of the current event-loop iteration (0 if none yet).
+     */
+    inline uint64_t getLoopTsc() const noexcept { return loopTsc.load(std::memory_order_relaxed); }
+    /**
+     * @brief Copies the iteration duration histogram.
+     * @return total number of iterations.
+     */
+    uint64_t getLoopHistogram(uint64_t (&histogram)[LOOP_HISTOGRAM_SIZE]) const noexcept;
+    /**
+     * @brief Copies the most recent record.
+     * @return false if nothing was dispatched yet.
+     */
+    bool getLastRecord(Record &) const noexcept;
+    inline Actor::NodeId getNodeId() const noexcept { return nodeId; }
+    inline Actor::CoreId getCoreId() const noexcept { return coreId; }
+
+    /**
+     * @brief Writes this recorder's records (oldest first), one per line, to a file descriptor.
+     * @note async-signal-safe.
+     */
+    void dump(int fd) const noexcept;
+    /** @overload */
+    void dump(std::ostream &) const; // throw (std::ios_base::failure)
+    /**
+     * @brief Writes the records of every registered recorder.
+     * @note async-signal-safe.
+     */
+    static void dumpAll(int fd) noexcept;
+    /** @overload */
+    static void dumpAll(std::ostream &); // throw (std::ios_base::failure)
+    /**
+     * @brief Makes signalNumber dump the records of every registered recorder to fd.
+     * @return false if the signal handler could not be installed.
+     */
+    static bool installSignalHandler(int signalNumber = SIGUSR2, int fd = 2) noexcept;
+
+  private:
+    friend class Watchdog;
+
+    static std::atomic<FlightRecorder *> registry[MAX_RECORDER_COUNT];
+    static std::mutex registryMutex; // excludes unregistration while a Watchdog samples (not locked by dumpAll())
+    static std::atomic<unsigned> registryWalkCount; // lock-free registry walks in progress, awaited by unregistration
+
+    /** @brief Announces a registry walk without registryMutex (async-signal-safe, e.g. dumpAll()). */
+    struct RegistryWalkGuard
+    {
+        inline RegistryWalkGuard() noexcept
+        {
+            ++registryWalkCount;
+            std::atomic_thread_fence(std::memory_order_seq_cst); // before the (acquire) registry loads
+        }
+        inline ~RegistryWalkGuard() noexcept { --registryWalkCount; }
+    };
+
+    const Actor::NodeId nodeId;
+    const Actor::CoreId coreId;
+    std::atomic<uint64_t> writePosition;
+    Record records[CAPACITY];
+    std::atomic<uint64_t> loopTsc;
+    std::atomic<uint64_t> loopHistogram[LOOP_HISTOGRAM_SIZE];
+    std::atomic<bool> threadFlag;
+    thread_t thread;
+    std::atomic<int> backtraceSize; // -1 while requested (see Watchdog)
+    void *backtraceAddresses[MAX_BACKTRACE_SIZE];
+
+    /** @return length of the formatted line, written in buffer (see flightrecorder.cpp). */
+    size_t formatHeader(char *buffer) const noexcept;
+    size_t formatRecord(char *buffer, const Record &) const noexcept;
+    template <class _Writer> void write(_Writer &) const;
+    template <class _Writer> static void writeAll(_Writer &);
+    static void onSignal(int) noexcept;
+
+    FlightRecorder(const FlightRecorder &);
+    FlightRecorder &operator=(const FlightRecorder &);
+};
+
+} // namespace tredzone
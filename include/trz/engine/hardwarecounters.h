@@ -0,0 +1,206 @@
+/**
+ * @file hardwarecounters.h
+ * @brief per-core hardware performance counters attributed to actor types and event classes
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "trz/engine/actor.h"
+
+struct perf_event_mmap_page; // <linux/perf_event.h>, only included by hardwarecounters.cpp
+
+namespace tredzone
+{
+
+/**
+ * @brief Hardware performance counters (cycles, instructions, LLC misses, branch misses)
+ * of every event-loop (cpu-core), to find cache-hostile actors in production without running external perf.
+ *
+ * Once enable() was called, each event-loop thread opens its counters (perf_event_open()) when it starts.
+ * Core totals are read on snapshot(). Every event handler call is also measured, reading the counters
+ * in user-space (rdpmc) before and after the handler, and attributed to the (actor type, event class) pair.
+ * The TSC and dispatch count are always attributed, even if the hardware counters are not available
+ * (no PMU, perf_event_paranoid, rdpmc disabled, non-x86 cpu).
+ * \code
+ * HardwareCounters::enable(); // before the engine starts
+ * Engine engine(startSequence);
+ * ...
+ * HardwareCounters::report(std::cout); // or snapshot()
+ * \endcode
+ * @note An attributed handler call costs about 8 rdpmc instructions, a few hundred cycles.
+ * @note Counters of nested synchronous handler calls (e.g. LocalPipe) are also attributed to the outer handler.
+ */
+class HardwareCounters
+{
+  public:
+    enum Counter
+    {
+        CYCLES = 0,
+        INSTRUCTIONS,
+        LLC_MISSES,
+        BRANCH_MISSES,
+        COUNTER_COUNT
+    };
+    static const size_t MAX_ATTRIBUTION_COUNT = 256; ///< (actor type, event class) pairs per core (power of 2)
+    static const size_t MAX_COUNTERS_COUNT = 256;    ///< maximum simultaneously registered cores (per process)
+
+    /**
+     * @brief Counters accumulated by the handlers of an (actor type, event class) pair.
+     */
+    struct Attribution
+    {
+        const std::type_info *actorType; ///< 0 for handler calls beyond MAX_ATTRIBUTION_COUNT pairs
+        Actor::EventId eventClassId;
+        uint64_t dispatchCount;
+        uint64_t tsc;
+        uint64_t counters[COUNTER_COUNT];
+        /** @brief Getter (demangled actor type name). */
+        std::string getActorTypeName() const; // throw (std::bad_alloc)
+    };
+    /**
+     * @brief Counters of an event-loop (cpu-core).
+     */
+    struct CoreSnapshot
+    {
+        Actor::NodeId nodeId;
+        Actor::CoreId coreId;
+        bool availableFlag;              ///< false if the hardware counters could not be opened (counters are 0)
+        bool dispatchAvailableFlag;      ///< false if attributions only have dispatchCount and tsc (no rdpmc)
+        uint64_t counters[COUNTER_COUNT]; ///< since the event-loop thread started
+        std::vector<Attribution> attributions;
+    };
+    /**
+     * @brief Measure of an event handler call (see onDispatchBegin()).
+     */
+    struct Dispatch
+    {
+        size_t attributionIndex; ///< MAX_ATTRIBUTION_COUNT + 1 if not measured
+        uint64_t tsc;
+        uint64_t counters[COUNTER_COUNT];
+    };
+
+    /**
+     * @brief Opens the counters of the event-loop threads started from now on (disabled by default).
+     */
+    static void enable() noexcept;
+    /** @brief Stops the attribution in running event-loops, event-loop threads started from now on are not counted. */
+    static void disable() noexcept;
+    /**
+     * @brief Getter.
+     * @return true if enabled.
+     */
+    inline static bool isEnabled() noexcept { return getEnabledFlag().load(std::memory_order_relaxed); }
+    /**
+     * @brief Reads the counters of every registered event-loop.
+     * @note Read while the event-loops are running, an attribution may be torn (its counters from different calls).
+     */
+    static std::vector<CoreSnapshot> snapshot(); // throw (std::bad_alloc)
+    /**
+     * @brief Writes snapshot() in text form, with IPC and misses per handler call.
+     */
+    static void report(std::ostream &); // throw (std::bad_alloc, std::ios_base::failure)
+
+    HardwareCounters(Actor::NodeId, Actor::CoreId) noexcept;
+    ~HardwareCounters() noexcept;
+
+    /** @brief Engine-internal: opens the counters of the calling (event-loop) thread, if enabled. */
+    void onThreadStart() noexcept;
+    /** @brief Engine-internal: stops the attribution. */
+    void onThreadStop() noexcept;
+    /**
+     * @brief Engine-internal: measures the beginning of an event handler call.
+     */
+    inline void onDispatchBegin(Dispatch &dispatch, const Actor &actor, Actor::EventId eventClassId) noexcept
+    {
+        if (!activeFlag || !getEnabledFlag().load(std::memory_order_relaxed))
+        {
+            dispatch.attributionIndex = MAX_ATTRIBUTION_COUNT + 1;
+            return;
+        }
+        dispatch.attributionIndex = findAttribution(typeid(actor), eventClassId);
+        read(dispatch.counters);
+        dispatch.tsc = getTSC();
+    }
+    /**
+     * @brief Engine-internal: measures the end of an event handler call.
+     */
+    inline void onDispatchEnd(const Dispatch &dispatch) noexcept
+    {
+        if (dispatch.attributionIndex > MAX_ATTRIBUTION_COUNT)
+        {
+            return;
+        }
+        const uint64_t tsc = getTSC();
+        uint64_t counters[COUNTER_COUNT];
+        read(counters);
+        AttributionEntry &entry = attributions[dispatch.attributionIndex];
+        accumulate(entry.dispatchCount, 1);
+        accumulate(entry.tsc, tsc - dispatch.tsc);
+        for (int i = 0; i < COUNTER_COUNT; ++i)
+        {
+            accumulate(entry.counters[i], counters[i] - dispatch.counters[i]);
+        }
+    }
+
+  private:
+    struct PerfCounter
+    {
+        int fd;
+        const volatile perf_event_mmap_page *page;
+    };
+    struct AttributionEntry
+    {
+        std::atomic<const std::type_info *> actorType; // published last, by the event-loop thread
+        Actor::EventId eventClassId;
+        std::atomic<uint64_t> dispatchCount;
+        std::atomic<uint64_t> tsc;
+        std::atomic<uint64_t> counters[COUNTER_COUNT];
+    };
+    static const size_t MAX_PROBE_COUNT = 8;
+
+    static std::atomic<HardwareCounters *> registry[MAX_COUNTERS_COUNT];
+    static std::mutex registryMutex;
+
+    const Actor::NodeId nodeId;
+    const Actor::CoreId coreId;
+    bool activeFlag;              // written by the event-loop thread only
+    bool dispatchAvailableFlag;   // rdpmc usable
+    PerfCounter perfCounters[COUNTER_COUNT];
+    AttributionEntry attributions[MAX_ATTRIBUTION_COUNT + 1]; // last one for overflow
+
+    inline static std::atomic<bool> &getEnabledFlag() noexcept
+    {
+        static std::atomic<bool> enabledFlag(false);
+        return enabledFlag;
+    }
+    inline static void accumulate(std::atomic<uint64_t> &value, uint64_t delta) noexcept
+    {
+        // single writer (event-loop thread)
+        value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+    }
+    inline void read(uint64_t (&counters)[COUNTER_COUNT]) const noexcept
+    {
+        for (int i = 0; i < COUNTER_COUNT; ++i)
+        {
+            counters[i] = dispatchAvailableFlag ? readUserCounter(*perfCounters[i].page) : 0;
+        }
+    }
+    static uint64_t readUserCounter(const volatile perf_event_mmap_page &) noexcept;
+    size_t findAttribution(const std::type_info &, Actor::EventId) noexcept;
+    void closeCounters() noexcept;
+    uint64_t readCounter(int) const noexcept;
+
+    HardwareCounters(const HardwareCounters &);
+    HardwareCounters &operator=(const HardwareCounters &);
+};
+
+} // namespace tredzone
@@ -0,0 +1,250 @@
+/**
+ * @file ingress.h
+ * @brief external-thread to actor event channel
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "trz/engine/actor.h"
+
+namespace tredzone
+{
+
+class Engine;
+class AsyncNode;
+
+/**
+ * @brief Non-template part of IngressChannel.
+ */
+class IngressChannelBase
+{
+  public:
+    static const size_t DEFAULT_CAPACITY = 1024;
+    static const Actor::NodeActorId INGRESS_SOURCE_NODE_ACTOR_ID = std::numeric_limits<Actor::NodeActorId>::max();
+
+    /**
+     * @brief Thrown when the destination actor-id is not an in-process actor-id of the engine.
+     */
+    struct InvalidDestinationException : std::exception
+    {
+        virtual const char *what() const noexcept { return "tredzone::IngressChannelBase::InvalidDestinationException"; }
+    };
+
+    /**
+     * @brief Getter.
+     * @return actor-id of the destination actor.
+     */
+    inline const Actor::ActorId &getDestinationActorId() const noexcept { return shared->destinationActorId; }
+    /**
+     * @brief Getter.
+     * @return maximum number of entries pending delivery (power of 2).
+     */
+    inline size_t getCapacity() const noexcept { return shared->mask + 1; }
+    /**
+     * @brief Static getter.
+     * @param actorId source actor-id of a received event (see Actor::Event::getSourceActorId()).
+     * @return true if the event was injected through an IngressChannel.
+     * @note Ingress events have no source actor. They are silently dropped if undeliverable.
+     */
+    inline static bool isIngressSourceActorId(const Actor::ActorId &actorId) noexcept
+    {
+        return actorId.isInProcess() && actorId.getNodeActorId() == INGRESS_SOURCE_NODE_ACTOR_ID;
+    }
+
+    /**
+     * @brief State shared by the producer thread(s) and the destination AsyncNode.
+     * Bounded multiple-producers single-consumer ring of pre-allocated slots, where each slot
+     * carries a sequence number telling whether it is free or published.
+     */
+    struct Shared
+    {
+        typedef void (*DeliverFn)(const Shared &, void *payload, AsyncNode &); // throw (std::bad_alloc, ...)
+        typedef void (*DestroyFn)(void *payload);
+        typedef std::atomic<size_t> Sequence;
+
+        const Actor::ActorId destinationActorId;
+        const size_t mask;
+        const size_t slotSize;
+        const size_t payloadOffset;
+        const DeliverFn deliverFn;
+        const DestroyFn destroyFn;
+        char *const slots;
+        Shared *nextRegistered; // owned by destination AsyncNode thread
+        std::atomic<int> referenceCount;
+        std::atomic<bool> closedFlag;
+        char cacheLinePadding1[CACHE_LINE_SIZE];
+        std::atomic<size_t> enqueuePosition; // producers
+        char cacheLinePadding2[CACHE_LINE_SIZE];
+        size_t dequeuePosition; // consumer (destination AsyncNode thread)
+
+        Shared(const Actor::ActorId &, size_t capacity, size_t slotSize, size_t payloadOffset, DeliverFn,
+               DestroyFn); // throw (std::bad_alloc)
+        ~Shared() noexcept;
+        inline Sequence &sequenceAt(size_t position) const noexcept
+        {
+            return *reinterpret_cast<Sequence *>(slots + (position & mask) * slotSize);
+        }
+        inline void *payloadAt(size_t position) const noexcept
+        {
+            return slots + (position & mask) * slotSize + payloadOffset;
+        }
+        /**
+         * @brief Claims the next free slot.
+         * @return payload address, or 0 if the ring is full.
+         */
+        inline void *acquire(size_t &position) noexcept
+        {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+            for (;;)
+            {
+                const intptr_t diff =
+                    (intptr_t)sequenceAt(position).load(std::memory_order_acquire) - (intptr_t)position;
+                if (diff == 0)
+                {
+                    if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    {
+                        return payloadAt(position);
+                    }
+                }
+                else if (diff < 0)
+                {
+                    return 0;
+                }
+                else
+                {
+                    position = enqueuePosition.load(std::memory_order_relaxed);
+                }
+            }
+        }
+        inline void publish(size_t position) noexcept
+        {
+            sequenceAt(position).store(position + 1, std::memory_order_release);
+        }
+        inline bool empty() const noexcept
+        {
+            return sequenceAt(dequeuePosition).load(std::memory_order_acquire) != dequeuePosition + 1;
+        }
+        size_t drain(AsyncNode &) noexcept;
+        void release() noexcept;
+    };
+
+  protected:
+    template <class _Event> struct EventWrapper : virtual private Actor::EventBase, _Event
+    {
+        template <class _Payload>
+        inline EventWrapper(const Actor::ActorId &sourceActorId, const Actor::ActorId &destinationActorId,
+                            _Payload &&payload)
+            : Actor::EventBase(Actor::Event::getClassId<_Event>(), sourceActorId, destinationActorId, 0),
+              _Event(std::forward<_Payload>(payload))
+        {
+        }
+    };
+
+    Shared *const shared;
+
+    /**
+     * throw (std::bad_alloc, InvalidDestinationException)
+     */
+    IngressChannelBase(Engine &, const Actor::ActorId &, size_t capacity, size_t slotSize, size_t payloadOffset,
+                       Shared::DeliverFn, Shared::DestroyFn);
+    ~IngressChannelBase() noexcept;
+
+    /**
+     * @brief Allocates a new event in the current event-batch of the destination AsyncNode.
+     * throw (std::bad_alloc)
+     */
+    static void *allocateEvent(AsyncNode &, size_t);
+    static void pushEvent(AsyncNode &, Actor::Event &) noexcept;
+    static const Actor::ActorId &getSourceActorId(AsyncNode &) noexcept;
+
+  private:
+    static Shared *newShared(Engine &, const Actor::ActorId &, size_t capacity, size_t slotSize, size_t payloadOffset,
+                             Shared::DeliverFn, Shared::DestroyFn); // throw (std::bad_alloc, InvalidDestinationException)
+
+    IngressChannelBase(const IngressChannelBase &);
+    IngressChannelBase &operator=(const IngressChannelBase &);
+};
+
+/**
+ * @brief Lock-free channel injecting events into the engine from a non-engine thread.
+ *
+ * The destination actor's event-loop drains the channel at each synchronize(), and delivers
+ * every entry as a regular _Event (constructed from the pushed _Payload) to its handler
+ * (see Actor::registerEventHandler()).
+ * Any number of threads may push concurrently. Slots are pre-allocated at construction,
+ * so tryPush() never allocates and fails (returns false) when the destination lags
+ * by more than the channel capacity.
+ * \code
+ * IngressChannel<PacketEvent, Packet> channel(engine, parserActorId);
+ * while (channel.tryPush(packet) == false) { threadYield(); }
+ * \endcode
+ * @note _Event must be constructible from a _Payload rvalue. Since there is no source pipe,
+ * the event cannot embed Event::Allocator based containers.
+ * The delivered event's source actor-id is a synthetic one (see isIngressSourceActorId()).
+ * Destroying the channel closes it: entries already pushed are still delivered.
+ */
+template <class _Event, class _Payload> class IngressChannel : public IngressChannelBase
+{
+  public:
+    /**
+     * @brief Constructor.
+     * @param engine engine running the destination actor.
+     * @param destinationActorId in-process actor-id of the destination actor.
+     * @param capacity maximum number of undelivered entries (rounded up to a power of 2).
+     * @throw std::bad_alloc
+     * @throw InvalidDestinationException
+     */
+    inline IngressChannel(Engine &engine, const Actor::ActorId &destinationActorId,
+                          size_t capacity = DEFAULT_CAPACITY)
+        : IngressChannelBase(engine, destinationActorId, capacity, sizeof(Slot), offsetof(Slot, payload), &deliver,
+                             &destroy)
+    {
+    }
+    /**
+     * @brief Constructs a new _Payload from args and publishes it to the destination actor.
+     * @return false if the channel is full (nothing was pushed).
+     * @throw ? Any exception thrown by _Payload constructor (nothing was pushed).
+     */
+    template <class... _Args> inline bool tryPush(_Args &&... args)
+    {
+        _Payload payload(std::forward<_Args>(args)...);
+        size_t position;
+        void *p = shared->acquire(position);
+        if (p == 0)
+        {
+            return false;
+        }
+        new (p) _Payload(std::move(payload));
+        shared->publish(position);
+        return true;
+    }
+
+  private:
+    static_assert(std::is_nothrow_move_constructible<_Payload>::value,
+                  "IngressChannel _Payload must be nothrow move-constructible");
+
+    struct Slot
+    {
+        Shared::Sequence sequence;
+        typename std::aligned_storage<sizeof(_Payload), std::alignment_of<_Payload>::value>::type payload;
+    };
+
+    static void deliver(const Shared &shared, void *payload, AsyncNode &asyncNode)
+    {
+        _Event *event = new (allocateEvent(asyncNode, sizeof(EventWrapper<_Event>))) EventWrapper<_Event>(
+            getSourceActorId(asyncNode), shared.destinationActorId, std::move(*static_cast<_Payload *>(payload)));
+        pushEvent(asyncNode, *event);
+    }
+    static void destroy(void *payload) noexcept { static_cast<_Payload *>(payload)->~_Payload(); }
+};
+
+} // namespace tredzone
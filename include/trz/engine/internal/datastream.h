@@ -9,6 +9,7 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <exception>
 #include <string>
 #include <limits>
 #include <istream>
@@ -162,7 +163,7 @@ public:
     
 	DataOutputStream&	Write32(const uint32_t &v)
 	{
-        const uint32_t	tmp = netswap32(v);
+        const uint32_t	tmp = _SWAP_F ? netswap32(v) : v;
 	
         m_OS.write(reinterpret_cast<const char*>(&tmp), sizeof(tmp));
         return *this;
@@ -170,7 +171,7 @@ public:
     
     DataOutputStream&	Write64(const uint64_t &v)
 	{
-        const uint64_t	tmp = netswap64(v);
+        const uint64_t	tmp = _SWAP_F ? netswap64(v) : v;
 	
         m_OS.write(reinterpret_cast<const char*>(&tmp), sizeof(tmp));
         return *this;
@@ -245,6 +246,354 @@ private:
 	std::ostream     &m_OS;
 };
 
+//---- Data Buffer Out of Bounds Exception -------------------------------------
+
+/**
+ * @brief Thrown by DataBufferReader/DataBufferWriter when a read or write would overrun the buffer.
+ */
+struct DataBufferOutOfBoundsException : std::exception
+{
+    const char *what() const noexcept override { return "tredzone::DataBufferOutOfBoundsException"; }
+};
+
+//---- Data Buffer Reader ------------------------------------------------------
+
+/**
+ * @brief DataInputStream counterpart reading from a contiguous buffer (e.g. mmapped file, mmapSerialBuffer),
+ * with no per-field istream sentry or virtual streambuf call.
+ *
+ * Read*() methods check bounds on each call; for fixed-size records, call Require() once for the whole record
+ * then use the unchecked Fetch*() methods. Array reads check bounds once and byteswap in bulk.
+ * Reads the same format as DataInputStream<_SWAP_F>, e.g. from an mmapSerialBuffer:
+ * \code
+ * DataBufferReader<> reader(buffer.getCurrentReadBuffer(), buffer.size());
+ * \endcode
+ */
+template <bool _SWAP_F = false>
+class DataBufferReader
+{
+public:
+
+    DataBufferReader(const void *p, size_t sz) noexcept
+        : m_Cur(static_cast<const char*>(p)), m_End(static_cast<const char*>(p) + sz)
+    {
+    }
+
+    size_t  GetRemainingSize(void) const noexcept   {return (size_t)(m_End - m_Cur);}
+    const void  *GetCurrentBuffer(void) const noexcept  {return m_Cur;}
+
+//---- Require -----------------------------------------------------------------
+
+    // throw (DataBufferOutOfBoundsException)
+    void    Require(size_t sz) const
+    {
+        if (sz > GetRemainingSize())
+        {
+            throw DataBufferOutOfBoundsException();
+        }
+    }
+
+    // n elements of elementSize bytes (n * elementSize may overflow)
+    // throw (DataBufferOutOfBoundsException)
+    void    RequireArray(size_t n, size_t elementSize) const
+    {
+        if (n > GetRemainingSize() / elementSize)
+        {
+            throw DataBufferOutOfBoundsException();
+        }
+    }
+
+//---- Fetch (unchecked, see Require()) ----------------------------------------
+
+    char    Fetch8(void) noexcept
+    {
+        assert(GetRemainingSize() >= 1);
+        return *m_Cur++;
+    }
+
+    uint16_t    Fetch16(void) noexcept
+    {
+        const uint16_t  tmp = FetchRaw<uint16_t>();
+        return _SWAP_F ? netswap16(tmp) : tmp;
+    }
+
+    uint32_t    Fetch32(void) noexcept
+    {
+        const uint32_t  tmp = FetchRaw<uint32_t>();
+        return _SWAP_F ? netswap32(tmp) : tmp;
+    }
+
+    uint64_t    Fetch64(void) noexcept
+    {
+        const uint64_t  tmp = FetchRaw<uint64_t>();
+        return _SWAP_F ? netswap64(tmp) : tmp;
+    }
+
+//---- Read (checked) ----------------------------------------------------------
+
+    // throw (DataBufferOutOfBoundsException)
+    char    Read8(void)             {Require(1); return Fetch8();}
+    bool    ReadBool(void)          {return (bool) Read8();}
+    uint16_t    Read16(void)        {Require(sizeof(uint16_t)); return Fetch16();}
+    uint32_t    Read32(void)        {Require(sizeof(uint32_t)); return Fetch32();}
+    uint64_t    Read64(void)        {Require(sizeof(uint64_t)); return Fetch64();}
+
+//---- Read String -------------------------------------------------------------
+
+    // throw (DataBufferOutOfBoundsException, std::bad_alloc)
+    string  ReadString(void)
+    {
+        const size_t    sz = static_cast<size_t>(Read32());
+        assert(sz < MAX_DATA_STRING_LEN);
+        Require(sz);
+        const char  *p = m_Cur;
+        m_Cur += sz;
+        return string(p, sz);
+    }
+
+//---- Read RAW Buffer ---------------------------------------------------------
+
+    // throw (DataBufferOutOfBoundsException)
+    size_t  ReadRawBuffer(uint8_t *p, size_t sz)
+    {
+        Require(sz);
+        ::memcpy(p, m_Cur, sz);
+        m_Cur += sz;
+        return sz;
+    }
+
+//---- Read Arrays (one bounds check, bulk byteswap) ---------------------------
+
+    // throw (DataBufferOutOfBoundsException)
+    void    Read16Array(uint16_t *p, size_t n)
+    {
+        RequireArray(n, sizeof(uint16_t));
+        ReadRawBuffer(reinterpret_cast<uint8_t*>(p), n * sizeof(uint16_t));
+        for (size_t i = 0; _SWAP_F && i < n; ++i)
+        {
+            p[i] = netswap16(p[i]);
+        }
+    }
+
+    // throw (DataBufferOutOfBoundsException)
+    void    Read32Array(uint32_t *p, size_t n)
+    {
+        RequireArray(n, sizeof(uint32_t));
+        ReadRawBuffer(reinterpret_cast<uint8_t*>(p), n * sizeof(uint32_t));
+        for (size_t i = 0; _SWAP_F && i < n; ++i)
+        {
+            p[i] = netswap32(p[i]);
+        }
+    }
+
+    // throw (DataBufferOutOfBoundsException)
+    void    Read64Array(uint64_t *p, size_t n)
+    {
+        RequireArray(n, sizeof(uint64_t));
+        ReadRawBuffer(reinterpret_cast<uint8_t*>(p), n * sizeof(uint64_t));
+        for (size_t i = 0; _SWAP_F && i < n; ++i)
+        {
+            p[i] = netswap64(p[i]);
+        }
+    }
+
+//---- pipe operators ----------------------------------------------------------
+
+    DataBufferReader&   operator>>(bool &b)         {b = ReadBool(); return *this;}
+    DataBufferReader&   operator>>(uint8_t &ui)     {ui = (uint8_t)Read8(); return *this;}
+    DataBufferReader&   operator>>(uint16_t &ui)    {ui = Read16(); return *this;}
+    DataBufferReader&   operator>>(uint32_t &ui)    {ui = Read32(); return *this;}
+    DataBufferReader&   operator>>(int8_t &i)       {i = (int8_t)Read8(); return *this;}
+    DataBufferReader&   operator>>(int16_t &i)      {i = (int16_t)Read16(); return *this;}
+    DataBufferReader&   operator>>(int32_t &i)      {i = (int32_t)Read32(); return *this;}
+    DataBufferReader&   operator>>(uint64_t &ui)    {ui = Read64(); return *this;}
+    DataBufferReader&   operator>>(int64_t &i)      {i = (int64_t)Read64(); return *this;}
+    DataBufferReader&   operator>>(string &s)       {s = ReadString(); return *this;}
+
+private:
+
+    template <typename _T>
+    _T  FetchRaw(void) noexcept
+    {
+        assert(GetRemainingSize() >= sizeof(_T));
+        _T  tmp;
+        ::memcpy(&tmp, m_Cur, sizeof(tmp));     // unaligned-safe
+        m_Cur += sizeof(tmp);
+        return tmp;
+    }
+
+    const char  *m_Cur;
+    const char  *m_End;
+};
+
+//---- Data Buffer Writer ------------------------------------------------------
+
+/**
+ * @brief DataOutputStream counterpart writing into a contiguous buffer (e.g. mmapSerialBuffer write buffer),
+ * with the same Require()/Put*() batched bounds checks as DataBufferReader.
+ *
+ * Writes the same format as DataOutputStream<_SWAP_F>. GetSize() is the written byte count, e.g.:
+ * \code
+ * DataBufferWriter<> writer(buffer.getCurrentWriteBuffer(), buffer.getCurrentWriteBufferSize());
+ * writer << ...;
+ * buffer.increaseCurrentWriteBufferSize(writer.GetSize());
+ * \endcode
+ */
+template <bool _SWAP_F = false>
+class DataBufferWriter
+{
+public:
+
+    DataBufferWriter(void *p, size_t sz) noexcept
+        : m_Begin(static_cast<char*>(p)), m_Cur(static_cast<char*>(p)), m_End(static_cast<char*>(p) + sz)
+    {
+    }
+
+    size_t  GetSize(void) const noexcept            {return (size_t)(m_Cur - m_Begin);}
+    size_t  GetRemainingSize(void) const noexcept   {return (size_t)(m_End - m_Cur);}
+
+//---- Require -----------------------------------------------------------------
+
+    // throw (DataBufferOutOfBoundsException)
+    void    Require(size_t sz) const
+    {
+        if (sz > GetRemainingSize())
+        {
+            throw DataBufferOutOfBoundsException();
+        }
+    }
+
+    // n elements of elementSize bytes (n * elementSize may overflow)
+    // throw (DataBufferOutOfBoundsException)
+    void    RequireArray(size_t n, size_t elementSize) const
+    {
+        if (n > GetRemainingSize() / elementSize)
+        {
+            throw DataBufferOutOfBoundsException();
+        }
+    }
+
+//---- Put (unchecked, see Require()) ------------------------------------------
+
+    DataBufferWriter&   Put8(const uint8_t &v) noexcept
+    {
+        assert(GetRemainingSize() >= 1);
+        *m_Cur++ = (char)v;
+        return *this;
+    }
+
+    DataBufferWriter&   Put16(const uint16_t &v) noexcept   {return PutRaw<uint16_t>(_SWAP_F ? netswap16(v) : v);}
+    DataBufferWriter&   Put32(const uint32_t &v) noexcept   {return PutRaw<uint32_t>(_SWAP_F ? netswap32(v) : v);}
+    DataBufferWriter&   Put64(const uint64_t &v) noexcept   {return PutRaw<uint64_t>(_SWAP_F ? netswap64(v) : v);}
+
+//---- Write (checked) ---------------------------------------------------------
+
+    // throw (DataBufferOutOfBoundsException)
+    DataBufferWriter&   Write8(const uint8_t &v)    {Require(1); return Put8(v);}
+    DataBufferWriter&   Write16(const uint16_t &v)  {Require(sizeof(uint16_t)); return Put16(v);}
+    DataBufferWriter&   Write32(const uint32_t &v)  {Require(sizeof(uint32_t)); return Put32(v);}
+    DataBufferWriter&   Write64(const uint64_t &v)  {Require(sizeof(uint64_t)); return Put64(v);}
+
+//---- Write String ------------------------------------------------------------
+
+    // throw (DataBufferOutOfBoundsException)
+    DataBufferWriter&   WriteASCII(const char *ascii_s)
+    {
+        assert(ascii_s);
+        return WriteStringData(ascii_s, ::strlen(ascii_s));
+    }
+
+    // throw (DataBufferOutOfBoundsException)
+    DataBufferWriter&   WriteString(const string &s)    {return WriteStringData(s.data(), s.length());}
+
+//---- Write RAW Buffer --------------------------------------------------------
+
+    // throw (DataBufferOutOfBoundsException)
+    DataBufferWriter&   WriteRawBuffer(const uint8_t *data, const size_t sz)
+    {
+        Require(sz);
+        ::memcpy(m_Cur, data, sz);
+        m_Cur += sz;
+        return *this;
+    }
+
+//---- Write Arrays (one bounds check, bulk byteswap) --------------------------
+
+    // throw (DataBufferOutOfBoundsException)
+    DataBufferWriter&   Write16Array(const uint16_t *p, size_t n)
+    {
+        RequireArray(n, sizeof(uint16_t));
+        for (size_t i = 0; i < n; ++i)
+        {
+            Put16(p[i]);
+        }
+        return *this;
+    }
+
+    // throw (DataBufferOutOfBoundsException)
+    DataBufferWriter&   Write32Array(const uint32_t *p, size_t n)
+    {
+        RequireArray(n, sizeof(uint32_t));
+        for (size_t i = 0; i < n; ++i)
+        {
+            Put32(p[i]);
+        }
+        return *this;
+    }
+
+    // throw (DataBufferOutOfBoundsException)
+    DataBufferWriter&   Write64Array(const uint64_t *p, size_t n)
+    {
+        RequireArray(n, sizeof(uint64_t));
+        for (size_t i = 0; i < n; ++i)
+        {
+            Put64(p[i]);
+        }
+        return *this;
+    }
+
+//---- pipes -------------------------------------------------------------------
+
+    DataBufferWriter&   operator<<(const bool &b)       {return Write8(b);}
+    DataBufferWriter&   operator<<(const uint8_t &ui)   {return Write8(ui);}
+    DataBufferWriter&   operator<<(const int8_t &i)     {return Write8(i);}
+    DataBufferWriter&   operator<<(const uint16_t &ui)  {return Write16(ui);}
+    DataBufferWriter&   operator<<(const int16_t &i)    {return Write16(i);}
+    DataBufferWriter&   operator<<(const uint32_t &ui)  {return Write32(ui);}
+    DataBufferWriter&   operator<<(const int32_t &i)    {return Write32(i);}
+    DataBufferWriter&   operator<<(const uint64_t &ui)  {return Write64(ui);}
+    DataBufferWriter&   operator<<(const int64_t &i)    {return Write64(i);}
+    DataBufferWriter&   operator<<(const string &s)     {return WriteString(s);}
+    DataBufferWriter&   operator<<(const char *s)       {return WriteASCII(s);}
+
+private:
+
+    // throw (DataBufferOutOfBoundsException)
+    DataBufferWriter&   WriteStringData(const char *s, size_t sz)
+    {
+        assert(sz < MAX_DATA_STRING_LEN);
+        Require(sizeof(uint32_t) + sz);
+        Put32((uint32_t)sz);
+        ::memcpy(m_Cur, s, sz);
+        m_Cur += sz;
+        return *this;
+    }
+
+    template <typename _T>
+    DataBufferWriter&   PutRaw(const _T &v) noexcept
+    {
+        assert(GetRemainingSize() >= sizeof(_T));
+        ::memcpy(m_Cur, &v, sizeof(v));     // unaligned-safe
+        m_Cur += sizeof(v);
+        return *this;
+    }
+
+    char    *m_Begin;
+    char    *m_Cur;
+    char    *m_End;
+};
+
+
 } // namespace tredzone
 
 
@@ -12,13 +12,15 @@
 #include <cerrno>
 #include <cmath>
 #include <cstdlib>
+#include <linux/futex.h>
 #include <pthread.h>
 #include <stdint.h>
+#include <sys/syscall.h>
 #include <sys/time.h>
 #include <unistd.h>
+#include <vector>
 
 #ifndef NDEBUG
-    #include <vector>
     #include <execinfo.h>
 #endif
 
@@ -53,6 +55,7 @@ typedef pthread_t thread_t;
 typedef pthread_key_t tls_t;
 
 std::vector<std::string> debugBacktrace(const uint8_t stackTraceSize = 32) noexcept;
+std::vector<std::string> debugBacktrace(void *const *addresses, int size) noexcept;
 
 std::string demangleFromSymbolName(char *) noexcept;
 
@@ -108,6 +111,10 @@ inline void mutexSignalWait(signal_t &, mutex_t &lockedMutex);
 inline void mutexSignalWait(signal_t &, mutex_t &lockedMutex, const Time &timeOut, const Time & = timeGetEpoch());
 inline void mutexSignalNotify(signal_t &);
 
+// futex (process-private wait/wake on a 32-bit word)
+inline void futexWait(uint32_t *address, uint32_t expectedValue, const Time &timeOut = Time()) noexcept;
+inline void futexWake(uint32_t *address, int count = 1) noexcept;
+
 // CPUs
 typedef std::bitset<1024> cpuset_type;
 size_t cpuGetCount();
@@ -286,6 +293,28 @@ void mutexSignalNotify(signal_t &handle)
     }
 }
 
+/**
+ * @brief Blocks while *address == expectedValue, until woken by futexWake() or timeOut (if not null) elapses.
+ * @note May return spuriously: callers must re-check their condition.
+ */
+void futexWait(uint32_t *address, uint32_t expectedValue, const Time &timeOut) noexcept
+{
+    if (timeOut == Time())
+    {
+        syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expectedValue, 0, 0, 0);
+    }
+    else
+    {
+        const int64_t ns = timeOut.toNanosecond();
+        struct timespec t;
+        t.tv_sec = (time_t)(ns / 1000000000);
+        t.tv_nsec = (long)(ns % 1000000000);
+        syscall(SYS_futex, address, FUTEX_WAIT_PRIVATE, expectedValue, &t, 0, 0);
+    }
+}
+
+void futexWake(uint32_t *address, int count) noexcept { syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, 0, 0, 0); }
+
 /**
  * Linux implementation cannot fail
  * cf: http://man7.org/linux/man-pages/man2/sched_yield.2.html
@@ -319,6 +348,13 @@ string  GetHostnameIP(const string &name);
  * @param stackTraceSize by default is set to 32. This corresponds to the backtrace's maximum size.
  * @return string vector containing the backtrace.
  */
+/**
+ * @fn std::vector<std::string> debugBacktrace(void *const *addresses, int size) noexcept
+ * @brief Resolves a backtrace captured with backtrace() (e.g. on another thread, from a signal handler)
+ * @param addresses return addresses, as filled by backtrace()
+ * @param size number of addresses
+ * @return string vector containing the backtrace (hexadecimal addresses in release build).
+ */
 /**
  * @fn std::string demangleFromSymbolName(char*) noexcept
  * @brief Demangle symbol from its mangled name.
@@ -14,7 +14,12 @@
 #include <typeinfo>
 #include <vector>
 
+#include "trz/engine/allocationguard.h"
 #include "trz/engine/engine.h"
+#include "trz/engine/ingress.h"
+#include "trz/engine/flightrecorder.h"
+#include "trz/engine/hardwarecounters.h"
+#include "trz/engine/localpipe.h"
 #include "trz/engine/internal/intrinsics.h"
 #include "trz/engine/internal/parallel.h"
 #include "trz/engine/internal/RefMapper.h"
@@ -66,6 +71,23 @@ struct Actor::EventTable
     void onUndeliveredEvent(const Event &event) const;
     static size_t lfRegisteredEventArraySize(RegisteredEvent *) noexcept;
     static bool onUnregisteredEvent(void *, const Event &);
+    inline void probeDispatchEnter(const Event &event) const noexcept
+    {
+        if (TREDZONE_PROBE_ENABLED(dispatch_enter))
+        {
+            const InProcessActorId &sourceActorId = event.getSourceInProcessActorId();
+            TREDZONE_PROBE5(dispatch_enter, event.getDestinationInProcessActorId().getNodeId(), nodeActorId,
+                            event.getClassId(), sourceActorId.getNodeId(), sourceActorId.getNodeActorId());
+        }
+    }
+    inline void probeDispatchExit(const Event &event) const noexcept
+    {
+        if (TREDZONE_PROBE_ENABLED(dispatch_exit))
+        {
+            TREDZONE_PROBE3(dispatch_exit, event.getDestinationInProcessActorId().getNodeId(), nodeActorId,
+                            event.getClassId());
+        }
+    }
 #ifndef NDEBUG
     bool debugCheckUndeliveredEventCount() const noexcept;
 #endif
@@ -299,6 +321,7 @@ class AsyncNodesHandle
         bool shutdownFlag;
         bool interruptFlag;
         const CoreSet coreSet;
+        std::atomic<IngressChannelBase::Shared *> ingressRegistrationHead; // pushed by non-engine threads
 #ifndef NDEBUG
         bool debugNodePtrWasSet;
         bool debugSynchronizeWriteFailedOperatorCalled;
@@ -500,6 +523,7 @@ class AsyncNodeAllocator
             size_t pageSz = systemPageSize();
             assert(pageSz % tredzone::CACHE_LINE_SIZE == 0);
             pageSz *= ((blockSz + sizeof(Block) + pageSz - 1) / pageSz);
+            AllocationGuard::onAllocation(AllocationGuard::NODE_ALLOCATOR_PAGE, pageSz);
             Block *page = static_cast<Block *>(alignMalloc(tredzone::CACHE_LINE_SIZE, pageSz));
             if (page == 0)
             {
@@ -623,6 +647,8 @@ class AsyncNodeManager : private std::unique_ptr<AsyncExceptionHandler>, public
     friend class EngineEventLoop;
     friend class AsyncNode;
     friend class AsyncNodesHandle;
+    friend class IngressChannelBase;
+    friend class LocalPipeBase;
     AsyncExceptionHandler &exceptionHandler;
     const CoreSet coreSet;
 
@@ -761,6 +787,7 @@ public:
     static StaticShared                         s_StaticShared;
     
     AsyncNodeAllocator                                                                  nodeAllocator;
+    ScratchArena                                                                        scratchArena;
     std::vector<SingletonActorIndexEntry, Actor::Allocator<SingletonActorIndexEntry>>   singletonActorIndex;
     SingletonActorIndexEntry::Chain                                                     singletonActorIndexChain;
     
@@ -909,6 +936,10 @@ class AsyncNode : private AsyncNodeBase, public AsyncNodeManager::Node
 #endif
         synchronizeUsageCount();
         synchronizeAsyncActorCallbacks();
+        if (ingressChannelChain != 0 || nodeHandle.ingressRegistrationHead.load(std::memory_order_relaxed) != 0)
+        {
+            synchronizeIngressChannels();
+        }
         synchronizeLocalEvents();
         AsyncNodeManager::Node::synchronizePreBarrier();
     }
@@ -920,6 +951,7 @@ class AsyncNode : private AsyncNodeBase, public AsyncNodeManager::Node
 #endif
         AsyncNodeManager::Node::synchronizePostBarrier();
         synchronizeDestroyAsyncActors();
+        scratchArena.reset();
     }
     inline void stop() noexcept { nodeHandle.stopFlag = nodeHandle.interruptFlag = true; }
 #ifndef NDEBUG
@@ -932,10 +964,20 @@ class AsyncNode : private AsyncNodeBase, public AsyncNodeManager::Node
     friend class EngineToEngineConnector;
     friend class AsyncNodesHandle;
     friend class EngineEventLoop;
+    friend class IngressChannelBase;
+    friend class LocalPipeBase;
 
     EngineCustomEventLoopFactory::EventLoopAutoPointer eventLoop;
     AsyncNodesHandle::Shared::EventAllocatorPageChain usedlocalEventAllocatorPageChain;
     Actor::CorePerformanceCounters corePerformanceCounters;
+    IngressChannelBase::Shared *ingressChannelChain;
+    Actor::EventTable *ingressEventTable;
+    Actor::ActorId ingressSourceActorId;
+    unsigned localPipeDepth;
+    LocalPipeBase::QueuedEvent *localPipeQueueHead;
+    LocalPipeBase::QueuedEvent *localPipeQueueTail;
+    FlightRecorder flightRecorder;
+    HardwareCounters hardwareCounters;
 #ifndef NDEBUG
     bool debugSynchronizePostBarrierFlag;
 #endif
@@ -945,6 +987,7 @@ class AsyncNode : private AsyncNodeBase, public AsyncNodeManager::Node
         ++corePerformanceCounters.loopTotalCount;
         corePerformanceCounters.loopUsageCount += loopUsagePerformanceCounterIncrement;
         loopUsagePerformanceCounterIncrement = 0;
+        flightRecorder.onLoop();
         ENTERPRISE_0X500E(this);
     }
     inline static uint8_t synchronizeAsyncActorCallbacks(AsyncActorCallbackChain &callbackChain,
@@ -982,6 +1025,7 @@ class AsyncNode : private AsyncNodeBase, public AsyncNodeManager::Node
             synchronizeAsyncActorCallbacks(asyncActorCallbackChain, corePerformanceCounters.onCallbackCount);
     }
     
+    void synchronizeIngressChannels() noexcept;
     inline void synchronizeLocalEvents() noexcept
     {
         AsyncNodesHandle::WriterSharedHandle &writerSharedHandle = nodeHandle.getWriterSharedHandle(id);
@@ -1151,7 +1195,14 @@ bool Actor::EventTable::onEvent(const Event &event, uint64_t &performanceCounter
     ++performanceCounter;
     assert(hfEvent[i].staticEventHandler != 0);
     ENTERPRISE_0X5010(static_cast<Actor*>(static_cast<const Actor::EventTable*>(event.getDestinationActorId().eventTable)->asyncActor)->getAsyncNode(), &event, static_cast<void*>(hfEvent[i].eventHandler));
+    HardwareCounters::Dispatch hardwareDispatch;
+    asyncActor->asyncNode->hardwareCounters.onDispatchBegin(hardwareDispatch, *asyncActor, hfEvent[i].eventId);
+    FlightRecorder::Record &flightRecord = asyncActor->asyncNode->flightRecorder.onDispatchBegin(event);
+    probeDispatchEnter(event);
     bool ret =  (*hfEvent[i].staticEventHandler)(hfEvent[i].eventHandler, event);
+    probeDispatchExit(event);
+    FlightRecorder::onDispatchEnd(flightRecord);
+    asyncActor->asyncNode->hardwareCounters.onDispatchEnd(hardwareDispatch);
     ENTERPRISE_0X5011(static_cast<Actor*>(static_cast<const Actor::EventTable*>(event.getDestinationActorId().eventTable)->asyncActor)->getAsyncNode());
     return ret;
 }
@@ -0,0 +1,141 @@
+/**
+ * @file probes.h
+ * @brief USDT (systemtap SDT) static tracepoints of the engine hot paths
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+/**
+ * Each probe compiles to a single nop instruction, described in the .note.stapsdt ELF section
+ * (same layout as <sys/sdt.h>, not required to build), so that bpftrace, perf or systemtap
+ * can attach to a production binary without rebuilding it:
+ * \code
+ * bpftrace -e 'usdt:./myapp:tredzone:dispatch_enter { @[arg2] = count(); }'
+ * perf buildid-cache --add ./myapp && perf record -e sdt_tredzone:event_push -p <pid>
+ * \endcode
+ * Each probe also has a semaphore, incremented by the tracer while attached, so that the probe
+ * arguments are not evaluated when no tracer is attached (see TREDZONE_PROBE_ENABLED()).
+ *
+ * Probes (provider "tredzone"), and arguments:
+ * - event_push: event class-id, source node-id, source node-actor-id, destination node-id,
+ *   destination node-actor-id, event size (Event::Pipe::push(), Event::BufferedPipe::push())
+ * - batch_write: writer node-id, reader node-id, batch-id, cumulative written byte count
+ *   (AsyncNodesHandle::WriterSharedHandle::write(), when handing a batch over to the reader)
+ * - batch_read: reader node-id, writer node-id (AsyncNodesHandle::ReaderSharedHandle::read())
+ * - dispatch_enter: node-id, destination node-actor-id, event class-id, source node-id, source node-actor-id
+ * - dispatch_exit: node-id, destination node-actor-id, event class-id
+ * - actor_new: node-id, node-actor-id, actor type name (mangled, const char *)
+ * - actor_destroy: node-id, node-actor-id
+ * - event_page: page index, page byte size, 1 if newly allocated (0 if recycled)
+ *   (AsyncNodesHandle::Shared::WriteCache::newEventPage())
+ *
+ * Built with the TREDZONE_USDT cmake option OFF (-DTREDZONE_USDT=0), or on other than x86-64 and aarch64,
+ * the probes compile to nothing.
+ */
+
+#if (!defined(TREDZONE_USDT) || TREDZONE_USDT) && defined(__GNUC__) && (defined(__x86_64__) || defined(__aarch64__))
+#define TREDZONE_USDT_ENABLED 1
+#else
+#define TREDZONE_USDT_ENABLED 0
+#endif
+
+#if TREDZONE_USDT_ENABLED
+
+#include <type_traits>
+
+#define TREDZONE_PROBE_SEMAPHORE(name) tredzone_##name##_semaphore
+
+#define TREDZONE_PROBE_DECLARE(name) \
+    extern "C" volatile unsigned short TREDZONE_PROBE_SEMAPHORE(name) __attribute__((visibility("hidden")))
+
+// (C linkage of the TREDZONE_PROBE_DECLARE() declaration)
+#define TREDZONE_PROBE_DEFINE(name)                                                                                    \
+    volatile unsigned short TREDZONE_PROBE_SEMAPHORE(name)                                                             \
+        __attribute__((section(".probes"), used, visibility("hidden"))) = 0
+
+/** @brief true while a tracer is attached to probe name. */
+#define TREDZONE_PROBE_ENABLED(name) __builtin_expect(TREDZONE_PROBE_SEMAPHORE(name) != 0, 0)
+
+#define TREDZONE_PROBE_STR(x) #x
+#define TREDZONE_PROBE_ASM(x) TREDZONE_PROBE_STR(x) "\n"
+// stapsdt argument: <size, negative if signed>@<operand>
+#define TREDZONE_PROBE_ARG_SIZE(x)                                                                                     \
+    (std::is_signed<__typeof__((x) + 0)>::value ? -(int)sizeof((x) + 0) : (int)sizeof((x) + 0))
+#define TREDZONE_PROBE_OPERAND(n, x) [S##n] "n"(TREDZONE_PROBE_ARG_SIZE(x)), [A##n] "nor"((x) + 0)
+#define TREDZONE_PROBE_ARG(n) " %c[S" #n "]@%[A" #n "]"
+
+#define TREDZONE_PROBE_IMPL(name, args, ...)                                                                           \
+    __asm__ __volatile__(TREDZONE_PROBE_ASM(990: nop)                                                                  \
+                         ".pushsection .note.stapsdt, \"?\", \"note\"\n"                                               \
+                         TREDZONE_PROBE_ASM(.balign 4)                                                                 \
+                         TREDZONE_PROBE_ASM(.4byte 992f - 991f; .4byte 994f - 993f; .4byte 3)                          \
+                         TREDZONE_PROBE_ASM(991: .asciz "stapsdt")                                                     \
+                         TREDZONE_PROBE_ASM(992: .balign 4)                                                            \
+                         TREDZONE_PROBE_ASM(993: .8byte 990b; .8byte _.stapsdt.base)                                   \
+                         ".8byte tredzone_" #name "_semaphore\n"                                                       \
+                         TREDZONE_PROBE_ASM(.asciz "tredzone")                                                         \
+                         TREDZONE_PROBE_ASM(.asciz #name)                                                              \
+                         ".asciz \"" args "\"\n"                                                                       \
+                         TREDZONE_PROBE_ASM(994: .balign 4)                                                            \
+                         TREDZONE_PROBE_ASM(.popsection)                                                               \
+                         TREDZONE_PROBE_ASM(.ifndef _.stapsdt.base)                                                    \
+                         ".pushsection .stapsdt.base, \"aG\", \"progbits\", .stapsdt.base, comdat\n"                   \
+                         TREDZONE_PROBE_ASM(.weak _.stapsdt.base)                                                      \
+                         TREDZONE_PROBE_ASM(.hidden _.stapsdt.base)                                                    \
+                         TREDZONE_PROBE_ASM(_.stapsdt.base: .space 1)                                                  \
+                         ".size _.stapsdt.base, 1\n"                                                                   \
+                         TREDZONE_PROBE_ASM(.popsection)                                                               \
+                         TREDZONE_PROBE_ASM(.endif)                                                                    \
+                         :                                                                                             \
+                         : __VA_ARGS__)
+
+#define TREDZONE_PROBE0(name) TREDZONE_PROBE_IMPL(name, "", "i"(0))
+#define TREDZONE_PROBE1(name, a1) TREDZONE_PROBE_IMPL(name, TREDZONE_PROBE_ARG(1), TREDZONE_PROBE_OPERAND(1, a1))
+#define TREDZONE_PROBE2(name, a1, a2)                                                                                  \
+    TREDZONE_PROBE_IMPL(name, TREDZONE_PROBE_ARG(1) TREDZONE_PROBE_ARG(2), TREDZONE_PROBE_OPERAND(1, a1),              \
+                        TREDZONE_PROBE_OPERAND(2, a2))
+#define TREDZONE_PROBE3(name, a1, a2, a3)                                                                              \
+    TREDZONE_PROBE_IMPL(name, TREDZONE_PROBE_ARG(1) TREDZONE_PROBE_ARG(2) TREDZONE_PROBE_ARG(3),                       \
+                        TREDZONE_PROBE_OPERAND(1, a1), TREDZONE_PROBE_OPERAND(2, a2), TREDZONE_PROBE_OPERAND(3, a3))
+#define TREDZONE_PROBE4(name, a1, a2, a3, a4)                                                                          \
+    TREDZONE_PROBE_IMPL(name, TREDZONE_PROBE_ARG(1) TREDZONE_PROBE_ARG(2) TREDZONE_PROBE_ARG(3) TREDZONE_PROBE_ARG(4), \
+                        TREDZONE_PROBE_OPERAND(1, a1), TREDZONE_PROBE_OPERAND(2, a2), TREDZONE_PROBE_OPERAND(3, a3),   \
+                        TREDZONE_PROBE_OPERAND(4, a4))
+#define TREDZONE_PROBE5(name, a1, a2, a3, a4, a5)                                                                      \
+    TREDZONE_PROBE_IMPL(name,                                                                                          \
+                        TREDZONE_PROBE_ARG(1) TREDZONE_PROBE_ARG(2) TREDZONE_PROBE_ARG(3) TREDZONE_PROBE_ARG(4)        \
+                            TREDZONE_PROBE_ARG(5),                                                                     \
+                        TREDZONE_PROBE_OPERAND(1, a1), TREDZONE_PROBE_OPERAND(2, a2), TREDZONE_PROBE_OPERAND(3, a3),   \
+                        TREDZONE_PROBE_OPERAND(4, a4), TREDZONE_PROBE_OPERAND(5, a5))
+#define TREDZONE_PROBE6(name, a1, a2, a3, a4, a5, a6)                                                                  \
+    TREDZONE_PROBE_IMPL(name,                                                                                          \
+                        TREDZONE_PROBE_ARG(1) TREDZONE_PROBE_ARG(2) TREDZONE_PROBE_ARG(3) TREDZONE_PROBE_ARG(4)        \
+                            TREDZONE_PROBE_ARG(5) TREDZONE_PROBE_ARG(6),                                               \
+                        TREDZONE_PROBE_OPERAND(1, a1), TREDZONE_PROBE_OPERAND(2, a2), TREDZONE_PROBE_OPERAND(3, a3),   \
+                        TREDZONE_PROBE_OPERAND(4, a4), TREDZONE_PROBE_OPERAND(5, a5), TREDZONE_PROBE_OPERAND(6, a6))
+
+#else
+
+#define TREDZONE_PROBE_DECLARE(name) struct tredzone_probe_##name##_unused
+#define TREDZONE_PROBE_DEFINE(name) struct tredzone_probe_##name##_unused
+#define TREDZONE_PROBE_ENABLED(name) false
+#define TREDZONE_PROBE0(name)
+#define TREDZONE_PROBE1(name, a1)
+#define TREDZONE_PROBE2(name, a1, a2)
+#define TREDZONE_PROBE3(name, a1, a2, a3)
+#define TREDZONE_PROBE4(name, a1, a2, a3, a4)
+#define TREDZONE_PROBE5(name, a1, a2, a3, a4, a5)
+#define TREDZONE_PROBE6(name, a1, a2, a3, a4, a5, a6)
+
+#endif
+
+TREDZONE_PROBE_DECLARE(event_push);
+TREDZONE_PROBE_DECLARE(batch_write);
+TREDZONE_PROBE_DECLARE(batch_read);
+TREDZONE_PROBE_DECLARE(dispatch_enter);
+TREDZONE_PROBE_DECLARE(dispatch_exit);
+TREDZONE_PROBE_DECLARE(actor_new);
+TREDZONE_PROBE_DECLARE(actor_destroy);
+TREDZONE_PROBE_DECLARE(event_page);
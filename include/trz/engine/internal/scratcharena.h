@@ -0,0 +1,224 @@
+/**
+ * @file scratcharena.h
+ * @brief per-core bump-pointer arena for transient allocations
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+
+#include "trz/engine/platform.h"
+#include "trz/engine/internal/cacheline.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Event-loop (cpu-core) local bump-pointer arena.
+ *
+ * Memory is carved by incrementing a cursor within a chain of pages, and is reclaimed all at once
+ * by reset(), which the owning event-loop calls at the end of each iteration (see AsyncNode::synchronize()).
+ * Pages are retained across resets, so that once the high-water mark is reached no further system allocation occurs.
+ * Requests larger than a page get a dedicated block, released at the next reset().<br>
+ * It is not thread-safe.
+ */
+class ScratchArena
+{
+  public:
+    static const size_t DEFAULT_PAGE_SIZE = 16 * 1024;
+    static const size_t DEFAULT_ALIGNMENT = sizeof(void *) * 2;
+#ifndef NDEBUG
+    static const unsigned char DEBUG_POISON_BYTE = 0xdb;
+#endif
+
+    inline ScratchArena(size_t ppageSize = DEFAULT_PAGE_SIZE) noexcept
+        : pageSize(cacheLineAlignedSize(ppageSize)), firstPage(0), currentPage(0), largeChain(0), cursor(0), limit(0),
+          generation(0)
+    {
+    }
+    inline ~ScratchArena() noexcept
+    {
+        releaseLargeChain();
+        while (firstPage != 0)
+        {
+            Page *page = firstPage;
+            firstPage = page->next;
+            alignFree(CACHE_LINE_SIZE, page);
+        }
+    }
+    /**
+     * throw (std::bad_alloc)
+     */
+    inline void *allocate(size_t sz, size_t alignment = DEFAULT_ALIGNMENT)
+    {
+        assert(alignment != 0 && (alignment & (alignment - 1)) == 0);
+        char *p = alignUp(cursor, alignment);
+        if (p <= limit && sz <= (size_t)(limit - p))
+        {
+            cursor = p + sz;
+            return p;
+        }
+        return allocateSlow(sz, alignment);
+    }
+    /**
+     * @brief Only the most recent allocation is actually given back (LIFO roll-back),
+     * which covers the usual grow-and-copy pattern of stl containers. Anything else is reclaimed by reset().
+     */
+    inline void deallocate(void *p, size_t sz) noexcept
+    {
+        assert(debugOwns(p));
+        if (static_cast<char *>(p) + sz == cursor)
+        {
+            cursor = static_cast<char *>(p);
+        }
+    }
+    inline void reset() noexcept
+    {
+        ++generation;
+        if (currentPage != firstPage || largeChain != 0 || cursor != pageBegin(firstPage))
+        {
+            resetSlow();
+        }
+    }
+    /**
+     * @brief Incremented by every reset(). Used to detect memory escaping the event-loop iteration it was allocated in.
+     */
+    inline uint64_t getGeneration() const noexcept { return generation; }
+    inline size_t getPageSize() const noexcept { return pageSize; }
+
+#ifndef NDEBUG
+    inline bool debugOwns(const void *p) const noexcept
+    {
+        for (const Page *page = firstPage; page != 0; page = page->next)
+        {
+            if (p >= pageBegin(page) && p <= pageEnd(page))
+            {
+                return true;
+            }
+        }
+        for (const Page *page = largeChain; page != 0; page = page->next)
+        {
+            if (p >= pageBegin(page) && p <= pageEnd(page))
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+#endif
+
+  private:
+    struct Page
+    {
+        Page *next;
+        size_t size; // usable byte count following the header
+    };
+
+    const size_t pageSize;
+    Page *firstPage;
+    Page *currentPage;
+    Page *largeChain;
+    char *cursor;
+    char *limit;
+    uint64_t generation;
+
+    ScratchArena(const ScratchArena &);
+    void operator=(const ScratchArena &);
+
+    inline static size_t cacheLineAlignedSize(size_t sz) noexcept
+    {
+        return ((sz + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE;
+    }
+    inline static char *alignUp(char *p, size_t alignment) noexcept
+    {
+        return reinterpret_cast<char *>(((uintptr_t)p + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+    inline static char *pageBegin(const Page *page) noexcept
+    {
+        return page == 0 ? 0 : reinterpret_cast<char *>(const_cast<Page *>(page)) + cacheLineAlignedSize(sizeof(Page));
+    }
+    inline static char *pageEnd(const Page *page) noexcept { return pageBegin(page) + page->size; }
+    /**
+     * throw (std::bad_alloc)
+     */
+    inline static Page *newPage(size_t sz)
+    {
+        Page *page = static_cast<Page *>(alignMalloc(CACHE_LINE_SIZE, cacheLineAlignedSize(sizeof(Page)) + sz));
+        if (page == 0)
+        {
+            throw std::bad_alloc();
+        }
+        page->next = 0;
+        page->size = sz;
+        return page;
+    }
+    inline void setCurrentPage(Page *page) noexcept
+    {
+        currentPage = page;
+        cursor = pageBegin(page);
+        limit = page == 0 ? 0 : pageEnd(page);
+    }
+    inline void releaseLargeChain() noexcept
+    {
+        while (largeChain != 0)
+        {
+            Page *page = largeChain;
+            largeChain = page->next;
+            alignFree(CACHE_LINE_SIZE, page);
+        }
+    }
+    /**
+     * throw (std::bad_alloc)
+     */
+    void *allocateSlow(size_t sz, size_t alignment)
+    {
+        if (sz + alignment > pageSize)
+        {
+            Page *page = newPage(cacheLineAlignedSize(sz + alignment));
+            page->next = largeChain;
+            largeChain = page;
+            return alignUp(pageBegin(page), alignment);
+        }
+        // move on to the next retained page, or append a new one
+        if (currentPage == 0)
+        {
+            setCurrentPage(firstPage = newPage(pageSize));
+        }
+        else
+        {
+            if (currentPage->next == 0)
+            {
+                currentPage->next = newPage(pageSize);
+            }
+            setCurrentPage(currentPage->next);
+        }
+        char *p = alignUp(cursor, alignment);
+        assert(p + sz <= limit);
+        cursor = p + sz;
+        return p;
+    }
+    void resetSlow() noexcept
+    {
+        releaseLargeChain();
+#ifndef NDEBUG
+        // poison everything that was handed out since previous reset, so that escaped pointers fail loudly
+        for (Page *page = firstPage; page != 0; page = page->next)
+        {
+            std::memset(pageBegin(page), DEBUG_POISON_BYTE, page == currentPage ? (size_t)(cursor - pageBegin(page)) : page->size);
+            if (page == currentPage)
+            {
+                break;
+            }
+        }
+#endif
+        setCurrentPage(firstPage);
+    }
+};
+
+} // namespace tredzone
@@ -7,8 +7,10 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cstdio>
 #include <cstring>
+#include <limits>
 #include <ostream>
 
 #include "trz/engine/platform.h"
@@ -20,6 +22,9 @@ namespace tredzone
 
 /**
  * @brief Tredzone StreamBuffer class
+ *
+ * The buffer starts in-place (_BufferSizeIncrement characters) and then grows geometrically (doubling, rounded up to
+ * _BufferSizeIncrement), so that building a string of n characters copies O(n) characters.
  */
 template <typename _Char, class _Allocator, size_t _BufferSizeIncrement = TREDZONE_DEFAULT_STREAM_BUFFER_INCREMENT_SIZE>
 class StreamBuffer : public std::basic_streambuf<_Char>
@@ -37,7 +42,7 @@ class StreamBuffer : public std::basic_streambuf<_Char>
     {
         if (buffer != defaultBuffer)
         {
-            allocator.deallocate(buffer, bufferSize * sizeof(_Char));
+            allocator.deallocate(buffer, bufferSize);
         }
     }
     /** @brief Get allocator */
@@ -45,7 +50,7 @@ class StreamBuffer : public std::basic_streambuf<_Char>
 
   protected:
     _Allocator allocator;
-    char defaultBuffer[_BufferSizeIncrement];
+    _Char defaultBuffer[_BufferSizeIncrement];
     _Char *buffer;
     size_t bufferSize;
     size_t bufferOffset;
@@ -96,13 +101,14 @@ class StreamBuffer : public std::basic_streambuf<_Char>
         { // One more for c_str nul char
             size_t newBufferSize =
                 ((n + 1 + bufferOffset + _BufferSizeIncrement - 1) / _BufferSizeIncrement) * _BufferSizeIncrement;
+            newBufferSize = std::max(newBufferSize, 2 * bufferSize); // geometric growth: amortized O(1) copy
             assert(newBufferSize - bufferOffset >= n + 1);
             _Char *newBuffer = allocator.allocate(newBufferSize);
-            assert(bufferSize > 0 && bufferOffset > 0);
+            assert(bufferSize > 0);
             memcpy(newBuffer, buffer, bufferOffset * sizeof(_Char));
             if (buffer != defaultBuffer)
             {
-                allocator.deallocate(buffer, bufferSize * sizeof(_Char));
+                allocator.deallocate(buffer, bufferSize);
             }
             buffer = newBuffer;
             bufferSize = newBufferSize;
@@ -183,4 +189,155 @@ struct OutputStringStream<char, _Allocator, _BufferSizeIncrement>
     }
 };
 
+/**
+ * @brief Tredzone InPlaceStreamBuffer class
+ *
+ * Stream buffer formatting directly into memory obtained from _Allocator (e.g. Actor::Event::Allocator<char>),
+ * without any intermediate buffer: the formatted string is ready to be referenced from an event.
+ * The buffer grows geometrically; with an allocator whose deallocate() is a no-op (event allocator),
+ * the memory of the outgrown buffers (less than the final buffer size) is only reclaimed with the event page.
+ */
+template <class _Allocator, size_t _InitialBufferSize = TREDZONE_DEFAULT_STREAM_BUFFER_INCREMENT_SIZE>
+class InPlaceStreamBuffer : public std::basic_streambuf<char>
+{
+  public:
+    /** @brief Constructor */
+    inline InPlaceStreamBuffer(const _Allocator &pallocator) noexcept : allocator(pallocator), bufferSize(0) {}
+    /** @brief Destructor */
+    virtual ~InPlaceStreamBuffer() noexcept
+    {
+        if (bufferSize != 0)
+        {
+            allocator.deallocate(pbase(), bufferSize);
+        }
+    }
+    /** @brief Get allocator */
+    inline const _Allocator &get_allocator() const noexcept { return allocator; }
+
+  protected:
+    _Allocator allocator;
+    size_t bufferSize; // including nul char
+
+    /**
+     * @brief Called when the put area is full: grows the buffer and writes c.
+     * @param c character to write
+     * @return written character
+     * @throws std::bad_alloc
+     */
+    virtual int_type overflow(int_type c = traits_type::eof())
+    {
+        if (!traits_type::eq_int_type(c, traits_type::eof()))
+        {
+            reserve(1);
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    /**
+     * @brief Writes characters from the array pointed to by s into the put area, growing it once if needed.
+     * @param s array pointer
+     * @param n number of characters to write
+     * @return The number of characters written.
+     * @throws std::bad_alloc
+     */
+    virtual std::streamsize xsputn(const char *s, std::streamsize n)
+    {
+        if (n > 0)
+        {
+            reserve((size_t)n);
+            memcpy(pptr(), s, (size_t)n);
+            advance((size_t)n);
+        }
+        return n;
+    }
+
+    /**
+     * @brief Makes room for n more characters (plus the c_str() nul char).
+     * This method allocates and copies the buffer if needed
+     * @param n number of characters to reserve
+     * @throws std::bad_alloc
+     */
+    inline void reserve(size_t n)
+    {
+        if (bufferSize == 0 || (size_t)(epptr() - pptr()) < n)
+        {
+            const size_t offset = (size_t)(pptr() - pbase());
+            const size_t newBufferSize = std::max(std::max(offset + n + 1, 2 * bufferSize), _InitialBufferSize);
+            char *newBuffer = allocator.allocate(newBufferSize);
+            if (bufferSize != 0)
+            {
+                memcpy(newBuffer, pbase(), offset);
+                allocator.deallocate(pbase(), bufferSize);
+            }
+            bufferSize = newBufferSize;
+            setp(newBuffer, newBuffer + newBufferSize - 1);
+            advance(offset);
+        }
+    }
+
+    /**
+     * @brief Advances the put pointer by n characters, in int steps (pbump() takes an int).
+     * @param n number of characters, within the put area
+     */
+    inline void advance(size_t n) noexcept
+    {
+        for (; n > (size_t)std::numeric_limits<int>::max(); n -= (size_t)std::numeric_limits<int>::max())
+        {
+            pbump(std::numeric_limits<int>::max());
+        }
+        pbump((int)n);
+    }
+};
+
+/**
+ * @brief Tredzone InPlaceOutputStringStream class
+ *
+ * Output string stream formatting directly into allocator memory (see InPlaceStreamBuffer).
+ * Used as Actor::Event::ostringstream_type, to build string-carrying events in one formatting pass:
+ * \code
+ * Event::ostringstream_type s(pipe.getAllocator());
+ * s << "order " << orderId << " filled";
+ * pipe.push<MyEvent>(Event::newCString(pipe.getAllocator(), s)); // no copy
+ * \endcode
+ */
+template <class _Allocator, size_t _InitialBufferSize = TREDZONE_DEFAULT_STREAM_BUFFER_INCREMENT_SIZE>
+struct InPlaceOutputStringStream : private InPlaceStreamBuffer<_Allocator, _InitialBufferSize>, std::basic_ostream<char>
+{
+    /** @brief Constructor */
+    inline InPlaceOutputStringStream(const _Allocator &allocator) noexcept
+        : InPlaceStreamBuffer<_Allocator, _InitialBufferSize>(allocator),
+          std::basic_ostream<char>(static_cast<InPlaceStreamBuffer<_Allocator, _InitialBufferSize> *>(this))
+    {
+    }
+    /** @brief Destructor */
+    virtual ~InPlaceOutputStringStream() noexcept {}
+    /**
+     * @brief Returns the null-terminated string in allocator memory (valid as long as this memory is,
+     * and until the next output to this stream).
+     * @return A pointer to the c-string representation of the stream content.
+     * @throw std::bad_alloc
+     */
+    inline const char *c_str()
+    {
+        this->reserve(0);
+        *this->pptr() = '\0';
+        return this->pbase();
+    }
+    /**
+     * @brief Returns the length of the string
+     * @return String length
+     */
+    inline size_t size() const noexcept { return (size_t)(this->pptr() - this->pbase()); }
+    /**
+     * @brief Get allocator
+     * @return allocator
+     */
+    inline const _Allocator &get_allocator() const noexcept
+    {
+        return InPlaceStreamBuffer<_Allocator, _InitialBufferSize>::get_allocator();
+    }
+};
+
 } // namespace
\ No newline at end of file
@@ -0,0 +1,231 @@
+/**
+ * @file latencytracker.h
+ * @brief end-to-end causal latency tracking across actor hops
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+#include "trz/engine/actor.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Sampled end-to-end latency tracking of causal chains of events (traces), across actors and cores.
+ *
+ * A trace is started by a TraceScope (e.g. in the handler of an inbound market-data event, or in an ingress
+ * producer thread). Every event pushed within that scope carries the trace-id and its push TSC. When handled,
+ * such an event makes its handler the scope of the trace, so the events pushed by that handler inherit it too,
+ * and so on, hop after hop. For every traced event, the destination event-loop records a Hop
+ * (push, reader pickup, handler start and handler end TSCs) into a per-thread ring buffer.
+ * aggregate() groups the recorded hops per trace, then the traces per path (sequence of event class-ids
+ * and destination nodes), into per-hop queueing, waiting and handling latency breakdowns.
+ * \code
+ * LatencyTracker::enable(1000); // trace 1 out of 1000 origins
+ * ...
+ * void onEvent(const MarketDataEvent &event)
+ * {
+ *     LatencyTracker::TraceScope traceScope;
+ *     pricerPipe.push<PriceEvent>(event.price);
+ * }
+ * ...
+ * LatencyTracker::report(std::cout);
+ * \endcode
+ * @note Compiled in with the TREDZONE_LATENCY_TRACKER CMake option (see isAvailable()), which adds the trace-id and
+ * push TSC to every event. Untraced events then cost one thread-local read at push, and one branch at dispatch.
+ * Without it, the event layout and push path are unchanged and no trace is ever started.
+ * @note Events delivered synchronously (same-node or LocalPipe) are recorded with no queueing nor waiting latency.
+ * @note Only the low 32 bits of the push TSC travel with an event: a hop must be shorter than 2^32 TSC cycles.
+ * @note Hops are read while the event-loops are running, the most recent ones may be torn
+ * (aggregate after the engine is destroyed).
+ */
+class LatencyTracker
+{
+  public:
+    static const size_t DEFAULT_RING_CAPACITY = 1 << 16; ///< hops per thread
+
+    /**
+     * @brief Per-thread recorded hop of a traced event (or trace origin).
+     */
+    struct Hop
+    {
+        uint64_t pushTsc;    ///< origin TSC for a trace origin
+        uint64_t pickupTsc;  ///< TSC when the destination event-loop picked up the batch holding the event
+        uint64_t startTsc;   ///< handler start TSC
+        uint64_t endTsc;     ///< handler end TSC
+        uint32_t traceId;
+        Actor::NodeActorId sourceNodeActorId;
+        Actor::NodeActorId destinationNodeActorId;
+        Actor::EventId eventClassId;
+        Actor::NodeId sourceNodeId;
+        Actor::NodeId destinationNodeId;
+        bool originFlag; ///< true for the trace origin (TraceScope), not an event
+    };
+    /**
+     * @brief Mean latencies of the n-th hop of a path, in microseconds.
+     */
+    struct HopStats
+    {
+        Actor::EventId eventClassId;
+        Actor::NodeId destinationNodeId;
+        double queueMicroseconds;   ///< push to reader pickup
+        double waitMicroseconds;    ///< reader pickup to handler start
+        double handlerMicroseconds; ///< handler start to end
+    };
+    /**
+     * @brief Latencies of the traces that followed the same path.
+     */
+    struct PathStats
+    {
+        std::string path; ///< "event#<class-id>@<node-id> > ..."
+        uint64_t traceCount;
+        double meanEndToEndMicroseconds; ///< trace origin to last handler end
+        double maxEndToEndMicroseconds;
+        std::vector<HopStats> hops;
+    };
+    /**
+     * @brief Starts a (sampled) trace for the events pushed by the current thread while in scope.
+     * Nested in a traced scope (e.g. a traced event handler), it does not start a new trace.
+     */
+    class TraceScope
+    {
+      public:
+        TraceScope() noexcept;
+        ~TraceScope() noexcept;
+        /**
+         * @brief Getter.
+         * @return true if events pushed in this scope are traced.
+         */
+        inline bool isTraced() const noexcept { return Actor::EventBase::currentTraceId() != 0; }
+
+      private:
+        const uint32_t previousTraceId;
+
+        TraceScope(const TraceScope &);
+        TraceScope &operator=(const TraceScope &);
+    };
+    /**
+     * @brief Engine-internal: makes the handler of a traced event the scope of its trace, recording its hop.
+     */
+    class DispatchScope
+    {
+      public:
+        inline DispatchScope(const Actor::Event &pevent, uint64_t ppickupTsc) noexcept
+            : event(pevent), previousTraceId(Actor::EventBase::currentTraceId()), pickupTsc(ppickupTsc), startTsc(0)
+        {
+            if (event.getTraceId() != 0)
+            {
+                Actor::EventBase::currentTraceId() = event.getTraceId();
+                startTsc = getTSC();
+            }
+        }
+        inline ~DispatchScope() noexcept
+        {
+            if (event.getTraceId() != 0)
+            {
+                recordHop(event, pickupTsc, startTsc, getTSC());
+                Actor::EventBase::currentTraceId() = previousTraceId;
+            }
+        }
+
+      private:
+        const Actor::Event &event;
+        const uint32_t previousTraceId;
+        const uint64_t pickupTsc;
+        uint64_t startTsc;
+
+        DispatchScope(const DispatchScope &);
+        DispatchScope &operator=(const DispatchScope &);
+    };
+
+    /**
+     * @brief Enables tracing (disabled by default).
+     * @param samplingPeriod one TraceScope out of samplingPeriod starts a trace.
+     */
+    static void enable(uint32_t samplingPeriod = 1) noexcept;
+    /** @brief Disables tracing, traces already started still record their hops. */
+    static void disable() noexcept;
+    /**
+     * @brief Getter.
+     * @return true if compiled in (TREDZONE_LATENCY_TRACKER CMake option).
+     */
+    inline static constexpr bool isAvailable() noexcept
+    {
+#if defined(TREDZONE_LATENCY_TRACKER) && TREDZONE_LATENCY_TRACKER
+        return true;
+#else
+        return false;
+#endif
+    }
+    /**
+     * @brief Getter.
+     * @return true if available and enabled.
+     */
+    inline static bool isEnabled() noexcept
+    {
+        return isAvailable() && getEnabledFlag().load(std::memory_order_relaxed);
+    }
+    /**
+     * @brief Sets the capacity of the rings allocated from now on (rounded up to a power of 2).
+     * @note An event-loop thread gets its ring when it starts (not while dispatching), other threads on their
+     * first recorded hop. The ring of a stopped event-loop keeps its hops until another one of the same capacity
+     * reuses it. Rings are released at process exit.
+     */
+    static void setRingCapacity(size_t hopCount) noexcept;
+    /** @brief Discards the hops recorded so far. */
+    static void clear() noexcept;
+    /**
+     * @brief Aggregates the recorded hops per path, most frequent path first.
+     * @note Traces whose origin was overwritten in its ring (or cleared) are skipped.
+     */
+    static std::vector<PathStats> aggregate(); // throw (std::bad_alloc)
+    /**
+     * @brief Writes aggregate() in text form.
+     */
+    static void report(std::ostream &); // throw (std::bad_alloc, std::ios_base::failure)
+    /** @brief Engine-internal: gets the calling event-loop thread a ring, before it dispatches any event. */
+    static void onThreadStart() noexcept;
+    /** @brief Engine-internal: makes the calling event-loop thread's ring reusable (its hops stay readable). */
+    static void onThreadStop() noexcept;
+
+  private:
+    struct Ring
+    {
+        Ring *next;
+        Hop *hops;
+        uint64_t mask;
+        std::atomic<uint64_t> clearPosition;
+        std::atomic<uint64_t> writePosition;
+        std::atomic<bool> inUseFlag; // by a thread
+    };
+    struct RingReleaser
+    {
+        ~RingReleaser() noexcept;
+    };
+
+    static RingReleaser ringReleaser;
+
+    inline static std::atomic<bool> &getEnabledFlag() noexcept
+    {
+        static std::atomic<bool> enabledFlag(false);
+        return enabledFlag;
+    }
+    inline static Ring *&getThreadRing() noexcept
+    {
+        static thread_local Ring *ring = 0;
+        return ring;
+    }
+    static Ring *acquireThreadRing() noexcept;
+    static void recordHop(const Actor::Event &, uint64_t pickupTsc, uint64_t startTsc, uint64_t endTsc) noexcept;
+    static void recordOrigin(uint32_t traceId, uint64_t tsc) noexcept;
+    static Hop *nextHop() noexcept;
+};
+
+} // namespace tredzone
@@ -0,0 +1,200 @@
+/**
+ * @file localpipe.h
+ * @brief synchronous same-core event pipe
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <new>
+#include <utility>
+
+#include "trz/engine/actor.h"
+
+namespace tredzone
+{
+
+class AsyncNode;
+
+/**
+ * @brief Non-template part of LocalPipe.
+ */
+class LocalPipeBase
+{
+  public:
+    /** @brief Maximum nesting of synchronous deliveries, beyond which events go through the run queue. */
+    static const unsigned MAX_RECURSION_DEPTH = 8;
+
+    /**
+     * @brief Thrown when the destination actor-id is null, or does not belong to the source actor's event-loop.
+     */
+    struct InvalidDestinationException : std::exception
+    {
+        virtual const char *what() const noexcept { return "tredzone::LocalPipeBase::InvalidDestinationException"; }
+    };
+
+    /**
+     * @brief Getter.
+     * @return actor-id of the source actor.
+     */
+    inline const Actor::ActorId &getSourceActorId() const noexcept { return sourceActor.getActorId(); }
+    /**
+     * @brief Getter.
+     * @return actor-id of the destination actor.
+     */
+    inline const Actor::ActorId &getDestinationActorId() const noexcept { return destinationActorId; }
+
+  protected:
+    template <class _Event> struct EventWrapper : virtual private Actor::EventBase, _Event
+    {
+        template <class... _Args>
+        inline EventWrapper(const Actor::ActorId &sourceActorId, const Actor::ActorId &destinationActorId,
+                            _Args &&... args)
+            : Actor::EventBase(Actor::Event::getClassId<_Event>(), sourceActorId, destinationActorId, 0),
+              _Event(std::forward<_Args>(args)...)
+        {
+        }
+    };
+    /**
+     * @brief Run queue entry, allocated from the source actor's allocator.
+     */
+    struct QueuedEvent
+    {
+        typedef void (*DestroyFn)(QueuedEvent &);
+        QueuedEvent *next;
+        Actor::Event *event;
+        DestroyFn destroyFn;
+    };
+    template <class _Event> struct QueuedEventWrapper : QueuedEvent
+    {
+        Actor::AllocatorBase allocator;
+        EventWrapper<_Event> eventWrapper;
+        template <class... _Args>
+        inline QueuedEventWrapper(Actor &sourceActor, const Actor::ActorId &destinationActorId, _Args &&... args)
+            : allocator(sourceActor.getAllocator()),
+              eventWrapper(sourceActor.getActorId(), destinationActorId, std::forward<_Args>(args)...)
+        {
+            next = 0;
+            event = &eventWrapper;
+            destroyFn = &destroy;
+        }
+        static void destroy(QueuedEvent &queuedEvent) noexcept
+        {
+            QueuedEventWrapper &wrapper = static_cast<QueuedEventWrapper &>(queuedEvent);
+            Actor::Allocator<QueuedEventWrapper> allocator(wrapper.allocator);
+            wrapper.~QueuedEventWrapper();
+            allocator.deallocate(&wrapper, 1);
+        }
+    };
+    /**
+     * @brief Nesting scope of a synchronous delivery. The outermost scope drains the run queue on exit.
+     */
+    class DeliveryScope
+    {
+      public:
+        inline explicit DeliveryScope(AsyncNode &pasyncNode) noexcept : asyncNode(pasyncNode) { enter(asyncNode); }
+        inline ~DeliveryScope() noexcept { leave(asyncNode); }
+
+      private:
+        AsyncNode &asyncNode;
+    };
+
+    Actor &sourceActor;
+    AsyncNode &asyncNode;
+    const Actor::ActorId destinationActorId;
+
+    /**
+     * throw (InvalidDestinationException)
+     */
+    LocalPipeBase(Actor &, const Actor::ActorId &);
+
+    /** @return true if the next event can be delivered synchronously (not too deep, and run queue empty). */
+    static bool isSynchronous(const AsyncNode &) noexcept;
+    static void enter(AsyncNode &) noexcept;
+    static void leave(AsyncNode &) noexcept;
+    static void enqueue(AsyncNode &, QueuedEvent &) noexcept;
+    /**
+     * @brief Calls the destination actor's event-handler, or the source actor's undelivered-event-handler.
+     * Exceptions are reported to the engine's exception handler, as for regular events.
+     */
+    static void deliver(AsyncNode &, const Actor::Event &) noexcept;
+
+  private:
+    friend class AsyncNode;
+
+    LocalPipeBase(const LocalPipeBase &);
+    LocalPipeBase &operator=(const LocalPipeBase &);
+};
+
+/**
+ * @brief Opt-in pipe between two actors of the same event-loop (cpu-core), whose events are delivered
+ * synchronously, from within push(), instead of at the next event-loop iteration.
+ *
+ * A chain of local actors thus handles an event in a single iteration, with no event-page allocation
+ * (the event lives on the stack of push()).
+ * Synchronous deliveries nest up to MAX_RECURSION_DEPTH, beyond which events are appended to a per-core run queue,
+ * drained before the outermost push() returns. Once the run queue is not empty, every push() appends to it,
+ * so events of a given LocalPipe are always delivered in push order.
+ * \code
+ * struct Parser : Actor {
+ *     LocalPipe pipe;
+ *     Parser(const ActorId &bookActorId) : pipe(*this, bookActorId) {}
+ *     void onEvent(const PacketEvent &event) { pipe.push<QuoteEvent>(event.bid, event.ask); } // handled here
+ * };
+ * \endcode
+ * @note Unlike Event::Pipe, ordering with respect to events pushed through other pipes is not preserved,
+ * and the event cannot embed Event::Allocator based containers (there is no event-batch).
+ * The pushed event is destroyed once delivered.
+ * @attention A handler must not rely on its actor's state being unchanged across a LocalPipe::push()
+ * (the destination may synchronously call back into it).
+ */
+class LocalPipe : public LocalPipeBase
+{
+  public:
+    /**
+     * @brief Constructor.
+     * @param sourceActor source actor.
+     * @param destinationActorId actor-id of an actor of the source actor's event-loop.
+     * @throw InvalidDestinationException
+     */
+    inline LocalPipe(Actor &psourceActor, const Actor::ActorId &pdestinationActorId)
+        : LocalPipeBase(psourceActor, pdestinationActorId)
+    {
+    }
+    /**
+     * @brief Creates a new _Event(args...) and delivers it to the destination actor.
+     * If the destination actor does not exist (anymore), or did not register a handler for _Event,
+     * the source actor's undelivered-event-handler is called instead.
+     * @throw std::bad_alloc (queued delivery)
+     * @throw ? Any other exception thrown by _Event constructor (nothing was delivered).
+     */
+    template <class _Event, class... _Args> inline void push(_Args &&... args)
+    {
+        if (isSynchronous(asyncNode))
+        {
+            DeliveryScope deliveryScope(asyncNode);
+            const EventWrapper<_Event> event(sourceActor.getActorId(), destinationActorId,
+                                             std::forward<_Args>(args)...);
+            deliver(asyncNode, event);
+        }
+        else
+        {
+            Actor::Allocator<QueuedEventWrapper<_Event>> allocator(sourceActor.getAllocator());
+            QueuedEventWrapper<_Event> *queuedEvent = allocator.allocate(1);
+            try
+            {
+                new (queuedEvent) QueuedEventWrapper<_Event>(sourceActor, destinationActorId,
+                                                             std::forward<_Args>(args)...);
+            }
+            catch (...)
+            {
+                allocator.deallocate(queuedEvent, 1);
+                throw;
+            }
+            enqueue(asyncNode, *queuedEvent);
+        }
+    }
+};
+
+} // namespace tredzone
@@ -0,0 +1,120 @@
+/**
+ * @file watchdog.h
+ * @brief event-loop stall watchdog
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <signal.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trz/engine/flightrecorder.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Thread sampling the event-loop iterations of every running event-loop (cpu-core) of the process,
+ * reporting the ones that exceed a duration threshold (e.g. a handler spinning for 50ms on a red-zone core).
+ *
+ * The iteration start TSC and the iteration duration histogram are maintained by each event-loop
+ * (see FlightRecorder::onLoop()). When the current iteration of an event-loop exceeds the threshold,
+ * the watchdog reports it once to its StallHandler, with the event being handled (if any, from the flight recorder)
+ * and a backtrace of the event-loop thread, captured by a signal handler (see debugBacktrace()).
+ * \code
+ * Engine engine(startSequence);
+ * Watchdog watchdog(50000); // report iterations longer than 50ms to std::cerr
+ * \endcode
+ * @note A custom event-loop (see EngineCustomEventLoopFactory) blocking between two iterations is reported as stalled.
+ * @note Backtraces are resolved to function names in debug build only (link with -rdynamic), otherwise to addresses.
+ */
+class Watchdog
+{
+  public:
+    /**
+     * @brief Stall report.
+     */
+    struct Stall
+    {
+        Actor::NodeId nodeId;
+        Actor::CoreId coreId;
+        uint64_t iterationMicroseconds; ///< duration of the stalled iteration, when sampled
+        bool dispatchFlag;              ///< true if the event-loop is in an event handler (see dispatch)
+        FlightRecorder::Record dispatch;
+        std::vector<std::string> backtrace; ///< empty if the event-loop thread did not respond to the signal
+    };
+    /**
+     * @brief Stall report handler, called by the watchdog thread.
+     */
+    class StallHandler
+    {
+      public:
+        virtual ~StallHandler() noexcept {}
+        /** @brief Default implementation writes the report to std::cerr. */
+        virtual void onStall(const Stall &) noexcept;
+    };
+    /**
+     * @brief Thrown when a Watchdog is already running in this process.
+     */
+    struct AlreadyRunningException : std::exception
+    {
+        virtual const char *what() const noexcept { return "tredzone::Watchdog::AlreadyRunningException"; }
+    };
+
+    /**
+     * @brief Constructor. Starts the watchdog thread.
+     * @param stallThresholdMicroseconds iteration duration beyond which an event-loop is reported as stalled.
+     * @param stallHandler stall report handler (defaults to StallHandler), must outlive the watchdog.
+     * @param backtraceSignal signal used to capture the backtrace of a stalled event-loop thread.
+     * @throw AlreadyRunningException
+     * @throw std::system_error
+     */
+    explicit Watchdog(uint64_t stallThresholdMicroseconds, StallHandler *stallHandler = 0,
+                      int backtraceSignal = SIGURG);
+    /** @brief Destructor. Stops the watchdog thread and restores the previous backtraceSignal handler. */
+    ~Watchdog() noexcept;
+
+    /**
+     * @brief Getter.
+     * @return number of stalls reported so far.
+     */
+    inline uint64_t getStallCount() const noexcept { return stallCount.load(std::memory_order_relaxed); }
+    /**
+     * @brief Writes the iteration duration histogram of every running event-loop.
+     */
+    void dumpLoopHistograms(std::ostream &) const; // throw (std::ios_base::failure)
+
+  private:
+    static const unsigned BACKTRACE_TIMEOUT_MILLISECONDS = 100;
+
+    const uint64_t stallThresholdMicroseconds;
+    StallHandler defaultStallHandler;
+    StallHandler &stallHandler;
+    const int backtraceSignal;
+    struct sigaction previousSignalAction;
+    std::atomic<uint64_t> stallCount;
+    std::atomic<uint64_t> tscPerMillisecond; // 0 until calibrated
+    std::mutex stopMutex;
+    std::condition_variable stopCondition;
+    bool stopFlag;
+    std::thread thread;
+
+    void run() noexcept;
+    void sample(std::vector<std::pair<const FlightRecorder *, uint64_t>> &reportedLoopTscs) noexcept;
+    void captureBacktrace(FlightRecorder &, Stall &) const noexcept;
+    static void onBacktraceSignal(int) noexcept;
+
+    Watchdog(const Watchdog &);
+    Watchdog &operator=(const Watchdog &);
+};
+
+} // namespace tredzone
@@ -0,0 +1,401 @@
+/**
+ * @file ask.h
+ * @brief request/response with correlation and time-out
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "trz/engine/actor.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Per-actor request/response facility.
+ *
+ * ask<_Request, _Response>() pushes a _Request event to a destination actor and registers a callback,
+ * which is invoked exactly once: on reception of the matching _Response event, when the time-out elapses,
+ * or as soon as the request is returned undelivered (fail-fast).
+ * Pending requests live in a slab indexed by correlation-id (no lookup, no allocation in steady state),
+ * and time-outs in a hashed timing wheel (O(1) set and cancel), advanced by a performance-neutral callback
+ * while requests are pending.
+ * \code
+ * struct PriceRequest : AskProxy::RequestEvent { std::string symbol; ... };
+ * struct PriceResponse : AskProxy::ResponseEvent { double price; PriceResponse(const PriceRequest &r, double p)
+ *     : AskProxy::ResponseEvent(r), price(p) {} };
+ *
+ * // requester (AskProxy ask member)
+ * ask.ask<PriceRequest, PriceResponse>(pricerActorId, Time::Millisecond(5),
+ *     [this](AskProxy::Status status, const PriceResponse *response) { ... }, "EURUSD");
+ * // responder
+ * void onEvent(const PriceRequest &request) {
+ *     Event::Pipe(*this, request.getSourceActorId()).push<PriceResponse>(request, getPrice(request.symbol));
+ * }
+ * \endcode
+ * @note The AskProxy registers itself as the actor's event-handler for _Response and undelivered event-handler
+ * for _Request (unless the actor already registered its own), it must therefore live as long as its actor
+ * (typically as a member).
+ */
+class AskProxy
+{
+  public:
+    typedef uint64_t CorrelationId;
+    static const size_t CALLBACK_STORAGE_SIZE = 6 * sizeof(void *);
+    static const size_t WHEEL_SIZE = 256;
+
+    enum Status
+    {
+        OK,          ///< response received
+        TIMEOUT,     ///< no response within the requested time-out
+        UNDELIVERED, ///< request returned undelivered (destination actor does not exist)
+    };
+
+    /**
+     * @brief Base class of request events.
+     */
+    class RequestEvent : public Actor::Event
+    {
+      public:
+        inline RequestEvent() noexcept : correlationId(0) {}
+        inline CorrelationId getCorrelationId() const noexcept { return correlationId; }
+
+      private:
+        friend class AskProxy;
+        CorrelationId correlationId;
+    };
+    /**
+     * @brief Base class of response events. Constructing from the request carries its correlation-id over.
+     */
+    class ResponseEvent : public Actor::Event
+    {
+      public:
+        inline explicit ResponseEvent(const RequestEvent &request) noexcept : correlationId(request.getCorrelationId())
+        {
+        }
+        inline CorrelationId getCorrelationId() const noexcept { return correlationId; }
+
+      private:
+        CorrelationId correlationId;
+    };
+
+    /**
+     * @brief Constructor.
+     * @param actor requesting actor.
+     * @param ptimeOutResolution time-out granularity (time-outs are rounded up to it).
+     */
+    inline AskProxy(Actor &pactor, const Time &ptimeOutResolution = Time::Millisecond(1)) noexcept
+        : actor(pactor), timeOutCallback(*this),
+          timeOutResolution(std::max(ptimeOutResolution.toNanosecond(), (int64_t)1)), originTime(0), currentTick(0),
+          pendingCount(0), wheelEntryCount(0), freeIndex(INVALID_INDEX), chunkTable(pactor.getAllocator())
+    {
+    }
+    /**
+     * @brief Destructor. Pending callbacks are dropped (not invoked).
+     */
+    inline ~AskProxy() noexcept
+    {
+        Actor::Allocator<Chunk> allocator(actor.getAllocator());
+        for (size_t i = 0; i < chunkTable.size(); ++i)
+        {
+            for (size_t j = 0; j < CHUNK_SIZE; ++j)
+            {
+                if ((*chunkTable[i])[j].invokeFn != 0)
+                {
+                    (*chunkTable[i])[j].destroyFn((*chunkTable[i])[j]);
+                }
+            }
+            allocator.deallocate(chunkTable[i], 1);
+        }
+    }
+
+    inline size_t getPendingCount() const noexcept { return pendingCount; }
+    inline bool isPending(CorrelationId correlationId) const noexcept { return find(correlationId) != 0; }
+
+    /**
+     * @brief Pushes a new _Request(args...) event to destinationActorId.
+     * @param timeOut null means no time-out.
+     * @param callback callable as callback(Status, const _Response *), with a null response unless status is OK.
+     * It must be nothrow move-constructible, fit in CALLBACK_STORAGE_SIZE bytes and be at most pointer-aligned.
+     * It must not throw when invoked on time-out (the exception is dropped).
+     * @return correlation-id of the request (never 0).
+     * throw (std::bad_alloc, ?) any exception thrown by _Request constructor (nothing is pending then)
+     */
+    template <class _Request, class _Response, class _Callback, class... _Args>
+    CorrelationId ask(const Actor::ActorId &destinationActorId, const Time &timeOut, _Callback callback,
+                      _Args &&... args)
+    {
+        static_assert(std::is_base_of<RequestEvent, _Request>::value,
+                      "_Request must derive from AskProxy::RequestEvent");
+        static_assert(std::is_base_of<ResponseEvent, _Response>::value,
+                      "_Response must derive from AskProxy::ResponseEvent");
+        static_assert(sizeof(_Callback) <= CALLBACK_STORAGE_SIZE, "AskProxy callback too large (capture less)");
+        static_assert(alignof(_Callback) <= alignof(void *), "AskProxy callback over-aligned");
+        static_assert(std::is_nothrow_move_constructible<_Callback>::value,
+                      "AskProxy callback must be nothrow move-constructible");
+        if (!actor.isRegisteredEventHandler<_Response>())
+        {
+            actor.registerEventHandler<_Response>(*this);
+        }
+        if (!actor.isRegisteredUndeliveredEventHandler<_Request>())
+        {
+            actor.registerUndeliveredEventHandler<_Request>(*this);
+        }
+        const Actor::EventId responseEventId = Actor::Event::getClassId<_Response>(); // throw (std::bad_alloc)
+        Entry &entry = allocateEntry();                                               // throw (std::bad_alloc)
+        const CorrelationId correlationId = entry.getCorrelationId();
+        try
+        {
+            Actor::Event::Pipe(actor, destinationActorId).push<_Request>(std::forward<_Args>(args)...).correlationId =
+                correlationId;
+        }
+        catch (...)
+        {
+            freeEntry(entry);
+            throw;
+        }
+        new (&entry.callbackStorage) _Callback(std::move(callback));
+        entry.responseEventId = responseEventId;
+        entry.invokeFn = &invoke<_Response, _Callback>;
+        entry.destroyFn = &destroy<_Callback>;
+        ++pendingCount;
+        if (timeOut != Time())
+        {
+            if (wheelEntryCount == 0)
+            {
+                // time-out wheel restarts from now
+                originTime = HighResolutionTime()().toNanosecond();
+                currentTick = 0;
+            }
+            // rounded up, and never in an already visited tick
+            entry.expiryTick = std::max(currentTick + 1, (HighResolutionTime()().toNanosecond() - originTime +
+                                                          timeOut.toNanosecond() + timeOutResolution - 1) /
+                                                             timeOutResolution);
+            (entry.chain = &wheel[entry.expiryTick & (WHEEL_SIZE - 1)])->push_back(&entry);
+            ++wheelEntryCount;
+            if (!timeOutCallback.isRegistered())
+            {
+                actor.registerPerformanceNeutralCallback(timeOutCallback);
+            }
+        }
+        return correlationId;
+    }
+    /**
+     * @brief Forgets a pending request, without invoking its callback (a later response is dropped).
+     * @return false if the request was not pending.
+     */
+    inline bool cancel(CorrelationId correlationId) noexcept
+    {
+        Entry *entry = find(correlationId);
+        if (entry == 0)
+        {
+            return false;
+        }
+        detach(*entry);
+        entry->destroyFn(*entry);
+        freeEntry(*entry);
+        return true;
+    }
+
+    /** @brief (event-handler registered on the actor) */
+    template <class _Response> inline void onEvent(const _Response &response)
+    {
+        Entry *entry = find(response.getCorrelationId());
+        if (entry != 0 && entry->responseEventId == response.getClassId())
+        {
+            complete(*entry, OK, &response);
+        }
+        // else late (timed-out or cancelled) response: dropped
+    }
+    /** @brief (undelivered event-handler registered on the actor) */
+    template <class _Request> inline void onUndeliveredEvent(const _Request &request)
+    {
+        Entry *entry = find(request.getCorrelationId());
+        if (entry != 0)
+        {
+            complete(*entry, UNDELIVERED, 0);
+        }
+    }
+
+  private:
+    static const uint32_t CHUNK_SIZE = 64;
+    static const uint32_t INVALID_INDEX = ~(uint32_t)0;
+
+    struct Entry : MultiDoubleChainLink<Entry>
+    {
+        typedef DoubleChain<> Chain;
+        typedef void (*InvokeFn)(Entry &, Status, const Actor::Event *);
+        typedef void (*DestroyFn)(Entry &);
+        InvokeFn invokeFn; // null when free
+        DestroyFn destroyFn;
+        Chain *chain; // time-out wheel slot (null if no time-out)
+        int64_t expiryTick;
+        uint32_t index;
+        uint32_t generation;
+        uint32_t nextFreeIndex;
+        Actor::EventId responseEventId;
+        // pointer-aligned only: chunks come from Actor::Allocator, which does not guarantee more
+        typename std::aligned_storage<CALLBACK_STORAGE_SIZE, alignof(void *)>::type callbackStorage;
+        inline CorrelationId getCorrelationId() const noexcept
+        {
+            return ((CorrelationId)generation << 32) | (CorrelationId)(index + 1);
+        }
+    };
+    typedef Entry Chunk[CHUNK_SIZE];
+    struct TimeOutCallback : Actor::Callback
+    {
+        AskProxy &askProxy;
+        inline TimeOutCallback(AskProxy &paskProxy) noexcept : askProxy(paskProxy) {}
+        inline void onCallback() noexcept { askProxy.onTimeOutCallback(); }
+    };
+
+    Actor &actor;
+    TimeOutCallback timeOutCallback;
+    const int64_t timeOutResolution;
+    int64_t originTime;
+    int64_t currentTick;
+    size_t pendingCount;
+    size_t wheelEntryCount;
+    uint32_t freeIndex;
+    std::vector<Chunk *, Actor::Allocator<Chunk *>> chunkTable;
+    Entry::Chain wheel[WHEEL_SIZE];
+
+    inline Entry &entryAt(uint32_t index) const noexcept
+    {
+        return (*chunkTable[index / CHUNK_SIZE])[index % CHUNK_SIZE];
+    }
+    inline Entry *find(CorrelationId correlationId) const noexcept
+    {
+        const uint32_t index = (uint32_t)correlationId - 1;
+        if (index >= chunkTable.size() * CHUNK_SIZE)
+        {
+            return 0;
+        }
+        Entry &entry = entryAt(index);
+        return entry.invokeFn != 0 && entry.generation == (uint32_t)(correlationId >> 32) ? &entry : 0;
+    }
+    /**
+     * throw (std::bad_alloc)
+     */
+    inline Entry &allocateEntry()
+    {
+        if (freeIndex == INVALID_INDEX)
+        {
+            Actor::Allocator<Chunk> allocator(actor.getAllocator());
+            chunkTable.reserve(chunkTable.size() + 1);
+            Chunk *chunk = allocator.allocate(1);
+            const uint32_t firstIndex = (uint32_t)chunkTable.size() * CHUNK_SIZE;
+            chunkTable.push_back(chunk);
+            for (uint32_t i = CHUNK_SIZE; i-- != 0;)
+            {
+                Entry &entry = *new (&(*chunk)[i]) Entry;
+                entry.invokeFn = 0;
+                entry.chain = 0;
+                entry.index = firstIndex + i;
+                entry.generation = 0;
+                entry.nextFreeIndex = freeIndex;
+                freeIndex = entry.index;
+            }
+        }
+        Entry &entry = entryAt(freeIndex);
+        freeIndex = entry.nextFreeIndex;
+        return entry;
+    }
+    inline void freeEntry(Entry &entry) noexcept
+    {
+        entry.invokeFn = 0;
+        ++entry.generation; // stale correlation-ids no longer match
+        entry.nextFreeIndex = freeIndex;
+        freeIndex = entry.index;
+    }
+    inline void detach(Entry &entry) noexcept
+    {
+        assert(pendingCount != 0);
+        --pendingCount;
+        if (entry.chain != 0)
+        {
+            entry.chain->remove(&entry);
+            entry.chain = 0;
+            --wheelEntryCount;
+        }
+    }
+    /**
+     * @brief The entry is detached (not pending) before the callback runs, which may then issue new requests.
+     */
+    inline void complete(Entry &entry, Status status, const Actor::Event *response)
+    {
+        detach(entry);
+        const Entry::InvokeFn invokeFn = entry.invokeFn;
+        entry.invokeFn = 0;
+        struct Guard
+        {
+            AskProxy &askProxy;
+            Entry &entry;
+            inline ~Guard() noexcept
+            {
+                entry.destroyFn(entry);
+                askProxy.freeEntry(entry);
+            }
+        } guard = {*this, entry};
+        invokeFn(entry, status, response);
+    }
+    inline void onTimeOutCallback() noexcept
+    {
+        const int64_t nowTick = (HighResolutionTime()().toNanosecond() - originTime) / timeOutResolution;
+        // each wheel slot is visited at most once per call, however long the event-loop stalled
+        for (int64_t tick = currentTick + 1, endTick = std::min(nowTick, currentTick + (int64_t)WHEEL_SIZE);
+             tick <= endTick; ++tick)
+        {
+            Entry::Chain &slot = wheel[tick & (WHEEL_SIZE - 1)];
+            Entry::Chain expiredChain;
+            for (Entry::Chain::iterator i = slot.begin(); i != slot.end();)
+            {
+                Entry &entry = *i++;
+                if (entry.expiryTick <= nowTick)
+                {
+                    slot.remove(&entry);
+                    (entry.chain = &expiredChain)->push_back(&entry);
+                }
+            }
+            // callbacks may cancel other expired entries or ask again
+            while (!expiredChain.empty())
+            {
+                try
+                {
+                    complete(*expiredChain.front(), TIMEOUT, 0);
+                }
+                catch (...)
+                {
+                    // dropped
+                }
+            }
+        }
+        currentTick = std::max(currentTick, nowTick);
+        if (wheelEntryCount != 0)
+        {
+            actor.registerPerformanceNeutralCallback(timeOutCallback);
+        }
+    }
+    template <class _Response, class _Callback>
+    static void invoke(Entry &entry, Status status, const Actor::Event *response)
+    {
+        (*reinterpret_cast<_Callback *>(&entry.callbackStorage))(status, static_cast<const _Response *>(response));
+    }
+    template <class _Callback> static void destroy(Entry &entry) noexcept
+    {
+        reinterpret_cast<_Callback *>(&entry.callbackStorage)->~_Callback();
+    }
+
+    AskProxy(const AskProxy &);
+    AskProxy &operator=(const AskProxy &);
+};
+
+} // namespace tredzone
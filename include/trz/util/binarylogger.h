@@ -0,0 +1,373 @@
+/**
+ * @file binarylogger.h
+ * @brief asynchronous per-core binary logger
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+#include "trz/engine/internal/cacheline.h"
+#include "trz/engine/platform.h"
+
+#ifndef TREDZONE_LOG_MIN_SEVERITY
+#define TREDZONE_LOG_MIN_SEVERITY 0 // see BinaryLogger::Severity
+#endif
+
+namespace tredzone
+{
+
+/**
+ * @brief Asynchronous logger: the logging thread only captures a format-string id (the address of a static
+ * Format descriptor), a TSC timestamp and the raw arguments into its own lock-free ring;
+ * a background thread formats and writes the entries with batched I/O.
+ *
+ * Each thread (i.e. each event-loop cpu-core) writes to its own ring, allocated at its first log entry
+ * (with the capacity set by setRingCapacity()) and reused by another thread once the owner thread exited.
+ * Logging never blocks nor allocates: when a ring is full, the entry is dropped and counted,
+ * and the background thread reports the number of dropped entries. Entries may be logged before a
+ * BinaryLogger is running, they are then written once it starts.
+ * The format string is written as is, each "{}" being replaced by the next argument (bool, char, integer,
+ * floating point, enum, C string, std::string or pointer). Strings are copied (up to MAX_STRING_SIZE bytes).
+ * Severity filtering is done at compile time (TREDZONE_LOG_MIN_SEVERITY cmake option or macro): the arguments
+ * of a filtered-out TREDZONE_LOG_xxx() are not evaluated.
+ * \code
+ * BinaryLogger logger;    // writes to stdout (file descriptor 1)
+ * Engine engine(startSequence);
+ * ...
+ * // in an actor
+ * TREDZONE_LOG_INFO("order {} filled at {} ({} lots)", orderId, price, quantity);
+ * \endcode
+ * Written lines are: UTC date-time (nanoseconds), severity, cpu of the ring, formatted text.
+ * Lines of one thread are in logging order, lines of different threads are not merged by time.
+ */
+class BinaryLogger
+{
+  public:
+    enum Severity
+    {
+        SEVERITY_DEBUG = 0,
+        SEVERITY_INFO,
+        SEVERITY_WARNING,
+        SEVERITY_ERROR
+    };
+    /**
+     * @brief Static descriptor of a logging call site (its address is the format-string id).
+     */
+    struct Format
+    {
+        Severity severity;
+        const char *text;
+    };
+    /**
+     * @brief Thrown when a BinaryLogger is already running in this process.
+     */
+    struct AlreadyRunningException : std::exception
+    {
+        virtual const char *what() const noexcept { return "tredzone::BinaryLogger::AlreadyRunningException"; }
+    };
+
+    static const size_t DEFAULT_RING_CAPACITY = 1 << 20; ///< bytes per thread
+    static const size_t MAX_STRING_SIZE = 4096;           ///< longer string arguments are truncated
+    static const size_t WRITE_BUFFER_SIZE = 1 << 16;      ///< formatted bytes per write() call (at most)
+
+    /**
+     * @brief Constructor. Starts the background thread.
+     * @param fd file descriptor the formatted entries are written to (not closed by the logger).
+     * @param pollMicroseconds sleep duration of the background thread when no entry is pending.
+     * @throw AlreadyRunningException
+     * @throw std::system_error
+     */
+    explicit BinaryLogger(int fd = 1, unsigned pollMicroseconds = 1000);
+    /** @brief Destructor. Writes the pending entries and stops the background thread. */
+    ~BinaryLogger() noexcept;
+
+    /**
+     * @brief Sets the capacity (bytes, rounded up to a power of 2) of the rings created from now on.
+     */
+    static void setRingCapacity(size_t byteCount) noexcept;
+    /**
+     * @brief Getter.
+     * @return number of entries dropped so far (rings full), in all the rings.
+     */
+    static uint64_t getDroppedCount() noexcept;
+    /**
+     * @brief Getter.
+     * @return number of entries written by this logger so far.
+     */
+    inline uint64_t getWrittenCount() const noexcept { return writtenCount.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Captures an entry (use the TREDZONE_LOG_xxx() macros instead).
+     * @return false if the entry was dropped.
+     */
+    template <class... _Args>
+    inline static bool log(const Format &format, const char *, const _Args &... args) noexcept
+    {
+        const size_t size = alignEntrySize(sizeof(EntryHeader) + argsSize(args...));
+        char *p = reserve(size);
+        if (p == 0)
+        {
+            return false;
+        }
+        EntryHeader header;
+        header.size = (uint32_t)size;
+        header.argCount = (uint32_t)sizeof...(args);
+        header.format = &format;
+        header.tsc = getTSC();
+        std::memcpy(p, &header, sizeof(header));
+        writeArgs(p + sizeof(header), args...);
+        commit(size);
+        return true;
+    }
+
+  private:
+    enum ArgTag
+    {
+        TAG_BOOL = 0,
+        TAG_CHAR,
+        TAG_INT64,
+        TAG_UINT64,
+        TAG_DOUBLE,
+        TAG_STRING,
+        TAG_POINTER
+    };
+    static const uint32_t PADDING_ARG_COUNT = UINT32_MAX; // end-of-ring filler entry
+    struct EntryHeader
+    {
+        uint32_t size; ///< multiple of 8, header included
+        uint32_t argCount;
+        const Format *format;
+        uint64_t tsc;
+    };
+    struct Ring
+    {
+        Ring *next;
+        std::atomic<uint32_t> cpuId; // updated when reused by another thread
+        uint64_t mask;
+        char *buffer;
+        std::atomic<bool> ownedFlag;
+        char cacheLinePadding1[CACHE_LINE_SIZE];
+        std::atomic<uint64_t> writePosition; // producer
+        uint64_t cachedReadPosition;
+        std::atomic<uint64_t> droppedCount;
+        char cacheLinePadding2[CACHE_LINE_SIZE];
+        std::atomic<uint64_t> readPosition; // consumer
+        uint64_t reportedDroppedCount;
+    };
+    struct ThreadRing
+    {
+        Ring *ring;
+        inline ~ThreadRing() noexcept
+        {
+            if (ring != 0)
+            {
+                ring->ownedFlag.store(false, std::memory_order_release);
+            }
+        }
+    };
+
+    const int fd;
+    const unsigned pollMicroseconds;
+    std::atomic<uint64_t> writtenCount;
+    std::string writeBuffer;
+    uint64_t startTsc;
+    int64_t startNanoseconds; // UTC
+    double tscPerNanosecond;
+    time_t dateTimeSecond;    // of the cached date-time prefix
+    char dateTimePrefix[24];  // "YYYY-MM-DD HH:MM:SS."
+    std::mutex stopMutex;
+    std::condition_variable stopCondition;
+    bool stopFlag;
+    std::thread thread;
+
+    inline static size_t alignEntrySize(size_t size) noexcept { return (size + 7) & ~(size_t)7; }
+    inline static Ring *&getThreadRing() noexcept
+    {
+        static thread_local ThreadRing threadRing = {0};
+        return threadRing.ring;
+    }
+    static Ring *newThreadRing() noexcept;
+    inline static char *reserve(size_t size) noexcept
+    {
+        Ring *ring = getThreadRing();
+        if (ring == 0 && (ring = newThreadRing()) == 0)
+        {
+            return 0;
+        }
+        const uint64_t capacity = ring->mask + 1;
+        const uint64_t position = ring->writePosition.load(std::memory_order_relaxed);
+        const uint64_t offset = position & ring->mask;
+        const uint64_t paddingSize = capacity - offset < size ? capacity - offset : 0;
+        if (size > capacity / 2 || (position + paddingSize + size - ring->cachedReadPosition > capacity &&
+                                    position + paddingSize + size -
+                                            (ring->cachedReadPosition =
+                                                 ring->readPosition.load(std::memory_order_acquire)) >
+                                        capacity))
+        {
+            ring->droppedCount.store(ring->droppedCount.load(std::memory_order_relaxed) + 1,
+                                     std::memory_order_relaxed);
+            return 0;
+        }
+        if (paddingSize != 0)
+        {
+            const uint32_t padding[2] = {(uint32_t)paddingSize, PADDING_ARG_COUNT};
+            std::memcpy(ring->buffer + offset, padding, sizeof(padding));
+            // published on its own (the consumer may read it before the entry is committed)
+            ring->writePosition.store(position + paddingSize, std::memory_order_release);
+            return ring->buffer;
+        }
+        return ring->buffer + offset;
+    }
+    inline static void commit(size_t size) noexcept
+    {
+        Ring *ring = getThreadRing();
+        ring->writePosition.store(ring->writePosition.load(std::memory_order_relaxed) + size,
+                                  std::memory_order_release);
+    }
+
+    // argument encoding: tag byte followed by the value (unaligned)
+
+    inline static size_t argsSize() noexcept { return 0; }
+    template <class T, class... _Args> inline static size_t argsSize(const T &arg, const _Args &... args) noexcept
+    {
+        return 1 + argSize(arg) + argsSize(args...);
+    }
+    inline static void writeArgs(char *) noexcept {}
+    template <class T, class... _Args> inline static void writeArgs(char *p, const T &arg, const _Args &... args) noexcept
+    {
+        writeArgs(writeArg(p, arg), args...);
+    }
+    template <class T> inline static char *writeValue(char *p, ArgTag tag, const T &value) noexcept
+    {
+        *p = (char)tag;
+        std::memcpy(p + 1, &value, sizeof(value));
+        return p + 1 + sizeof(value);
+    }
+    inline static size_t stringSize(const char *s) noexcept { return s == 0 ? 0 : strnlen(s, MAX_STRING_SIZE); }
+    inline static char *writeString(char *p, const char *s, size_t size) noexcept
+    {
+        const uint32_t size32 = (uint32_t)size;
+        *p = (char)TAG_STRING;
+        std::memcpy(p + 1, &size32, sizeof(size32));
+        std::memcpy(p + 1 + sizeof(size32), s, size);
+        return p + 1 + sizeof(size32) + size;
+    }
+
+    inline static size_t argSize(bool) noexcept { return 1; }
+    inline static char *writeArg(char *p, bool value) noexcept { return writeValue(p, TAG_BOOL, (char)value); }
+    inline static size_t argSize(char) noexcept { return 1; }
+    inline static char *writeArg(char *p, char value) noexcept { return writeValue(p, TAG_CHAR, value); }
+    template <class T>
+    inline static typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, size_t>::type
+    argSize(T) noexcept
+    {
+        return sizeof(uint64_t);
+    }
+    template <class T>
+    inline static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, char *>::type
+    writeArg(char *p, T value) noexcept
+    {
+        return writeValue(p, TAG_INT64, (int64_t)value);
+    }
+    template <class T>
+    inline static typename std::enable_if<std::is_integral<T>::value && std::is_unsigned<T>::value, char *>::type
+    writeArg(char *p, T value) noexcept
+    {
+        return writeValue(p, TAG_UINT64, (uint64_t)value);
+    }
+    template <class T>
+    inline static typename std::enable_if<std::is_enum<T>::value, char *>::type writeArg(char *p, T value) noexcept
+    {
+        return writeValue(p, TAG_INT64, (int64_t)value);
+    }
+    inline static size_t argSize(double) noexcept { return sizeof(double); }
+    inline static char *writeArg(char *p, double value) noexcept { return writeValue(p, TAG_DOUBLE, value); }
+    inline static size_t argSize(const char *s) noexcept { return sizeof(uint32_t) + stringSize(s); }
+    inline static char *writeArg(char *p, const char *s) noexcept
+    {
+        return s == 0 ? writeString(p, "", 0) : writeString(p, s, stringSize(s));
+    }
+    inline static size_t argSize(const std::string &s) noexcept
+    {
+        return sizeof(uint32_t) + std::min(s.size(), MAX_STRING_SIZE);
+    }
+    inline static char *writeArg(char *p, const std::string &s) noexcept
+    {
+        return writeString(p, s.data(), std::min(s.size(), MAX_STRING_SIZE));
+    }
+    inline static size_t argSize(const void *) noexcept { return sizeof(uint64_t); }
+    inline static char *writeArg(char *p, const void *value) noexcept
+    {
+        return writeValue(p, TAG_POINTER, (uint64_t)(uintptr_t)value);
+    }
+
+    void run() noexcept;
+    bool drain() noexcept;
+    void format(const Ring &, const EntryHeader &, const char *args) noexcept;
+    void formatPrefix(uint64_t tsc, Severity, uint32_t cpuId) noexcept;
+    void flush() noexcept;
+    // writeBuffer is reserved upfront and flushed instead of growing: no allocation after construction
+    void append(const char *, size_t) noexcept;
+    inline void append(const char *s) noexcept { append(s, std::strlen(s)); }
+    inline void append(char c) noexcept { append(&c, 1); }
+
+    BinaryLogger(const BinaryLogger &);
+    BinaryLogger &operator=(const BinaryLogger &);
+};
+
+} // namespace tredzone
+
+#define TREDZONE_LOG_FORMAT_(format, ...) format
+#define TREDZONE_LOG_(severity, ...)                                                                                   \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        static const ::tredzone::BinaryLogger::Format tredzoneLogFormat = {severity,                                   \
+                                                                            TREDZONE_LOG_FORMAT_(__VA_ARGS__, 0)};     \
+        ::tredzone::BinaryLogger::log(tredzoneLogFormat, __VA_ARGS__);                                                 \
+    } while (false)
+
+#if TREDZONE_LOG_MIN_SEVERITY <= 0
+#define TREDZONE_LOG_DEBUG(...) TREDZONE_LOG_(::tredzone::BinaryLogger::SEVERITY_DEBUG, __VA_ARGS__)
+#else
+#define TREDZONE_LOG_DEBUG(...)                                                                                        \
+    do                                                                                                                 \
+    {                                                                                                                  \
+    } while (false)
+#endif
+#if TREDZONE_LOG_MIN_SEVERITY <= 1
+#define TREDZONE_LOG_INFO(...) TREDZONE_LOG_(::tredzone::BinaryLogger::SEVERITY_INFO, __VA_ARGS__)
+#else
+#define TREDZONE_LOG_INFO(...)                                                                                         \
+    do                                                                                                                 \
+    {                                                                                                                  \
+    } while (false)
+#endif
+#if TREDZONE_LOG_MIN_SEVERITY <= 2
+#define TREDZONE_LOG_WARNING(...) TREDZONE_LOG_(::tredzone::BinaryLogger::SEVERITY_WARNING, __VA_ARGS__)
+#else
+#define TREDZONE_LOG_WARNING(...)                                                                                      \
+    do                                                                                                                 \
+    {                                                                                                                  \
+    } while (false)
+#endif
+#if TREDZONE_LOG_MIN_SEVERITY <= 3
+#define TREDZONE_LOG_ERROR(...) TREDZONE_LOG_(::tredzone::BinaryLogger::SEVERITY_ERROR, __VA_ARGS__)
+#else
+#define TREDZONE_LOG_ERROR(...)                                                                                        \
+    do                                                                                                                 \
+    {                                                                                                                  \
+    } while (false)
+#endif
@@ -0,0 +1,421 @@
+/**
+ * @file coroutine.h
+ * @brief C++20 coroutines for actor handlers
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <cassert>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+#include "trz/engine/actor.h"
+#include "trz/util/ask.h"
+
+namespace tredzone
+{
+namespace coroutine
+{
+
+template <class T = void> class Task;
+
+namespace detail
+{
+
+/**
+ * @brief Frames are allocated from the actor's event-loop allocator (AsyncNodeAllocator),
+ * which is found from the coroutine's first parameter (the actor itself for an actor member function).
+ */
+class PromiseAllocation
+{
+  public:
+    static void *allocate(const Actor &actor, size_t sz) // throw (std::bad_alloc)
+    {
+        Actor::Allocator<char> allocator(actor.getAllocator());
+        char *p = allocator.allocate(getAllocationSize(sz));
+        // the event-loop allocator only guarantees pointer alignment (NDEBUG), frames need the operator new one
+        char *frame = reinterpret_cast<char *>(((uintptr_t)p + sizeof(Header) + FRAME_ALIGNMENT - 1) &
+                                               ~(uintptr_t)(FRAME_ALIGNMENT - 1));
+        new (frame - sizeof(Header)) Header(allocator, p, sz);
+        return frame;
+    }
+    static void deallocate(void *frame) noexcept
+    {
+        const Header &header = getHeader(frame);
+        Actor::Allocator<char> allocator(header.allocator);
+        allocator.deallocate(header.allocation, getAllocationSize(header.size));
+    }
+    inline static size_t getSize(void *frame) noexcept { return getHeader(frame).size; }
+
+  private:
+    struct Header
+    {
+        Actor::AllocatorBase allocator;
+        char *allocation;
+        size_t size; // of the frame (the placement operator delete has no size parameter)
+        inline Header(const Actor::AllocatorBase &pallocator, char *pallocation, size_t psize) noexcept
+            : allocator(pallocator), allocation(pallocation), size(psize)
+        {
+        }
+    };
+    static constexpr size_t FRAME_ALIGNMENT = alignof(std::max_align_t);
+
+    inline static size_t getAllocationSize(size_t sz) noexcept { return sizeof(Header) + FRAME_ALIGNMENT - 1 + sz; }
+    inline static const Header &getHeader(void *frame) noexcept
+    {
+        return *reinterpret_cast<const Header *>(static_cast<char *>(frame) - sizeof(Header));
+    }
+};
+
+class PromiseBase
+{
+  public:
+    struct FinalAwaiter
+    {
+        inline bool await_ready() const noexcept { return false; }
+        template <class _Promise>
+        inline std::coroutine_handle<> await_suspend(std::coroutine_handle<_Promise> handle) noexcept
+        {
+            // symmetric transfer to the awaiting coroutine (no stack growth along a chain of tasks)
+            std::coroutine_handle<> continuation = handle.promise().continuation;
+            return continuation ? continuation : std::noop_coroutine();
+        }
+        inline void await_resume() const noexcept {}
+    };
+
+    std::coroutine_handle<> continuation;
+    std::exception_ptr exception;
+
+    inline std::suspend_always initial_suspend() const noexcept { return std::suspend_always(); }
+    inline FinalAwaiter final_suspend() const noexcept { return FinalAwaiter(); }
+    inline void unhandled_exception() noexcept { exception = std::current_exception(); }
+};
+
+template <class T> class Promise : public PromiseBase
+{
+  public:
+    std::optional<T> result;
+
+    template <class U> inline void return_value(U &&value) { result.emplace(std::forward<U>(value)); }
+    inline T getResult()
+    {
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*result);
+    }
+};
+
+template <> class Promise<void> : public PromiseBase
+{
+  public:
+    inline void return_void() const noexcept {}
+    inline void getResult()
+    {
+        if (exception)
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+/**
+ * @brief Promise of a Task coroutine taking (_Actor &, _Args...) (see std::coroutine_traits<Task<T>, ...> below).
+ * The frame operator new/delete are not templates, so that they match each other
+ * (no -Wmismatched-new-delete), including the placement operator delete called if the promise construction throws.
+ */
+template <class T, class... _Args> class FramePromise
+{
+    static_assert(sizeof...(_Args) != 0,
+                  "coroutine::Task must be an actor member function, or take an Actor & first parameter");
+};
+
+template <class T, class _Actor, class... _Args> class FramePromise<T, _Actor, _Args...> : public Promise<T>
+{
+    static_assert(std::is_base_of<Actor, typename std::decay<_Actor>::type>::value,
+                  "coroutine::Task must be an actor member function, or take an Actor & first parameter");
+
+  public:
+    static void *operator new(size_t sz, _Actor &actor, _Args &...) // throw (std::bad_alloc)
+    {
+        return PromiseAllocation::allocate(actor, sz);
+    }
+    static void operator delete(void *frame, _Actor &, _Args &...) noexcept { PromiseAllocation::deallocate(frame); }
+    static void operator delete(void *frame, size_t sz) noexcept
+    {
+        (void)sz;
+        assert(PromiseAllocation::getSize(frame) == sz);
+        PromiseAllocation::deallocate(frame);
+    }
+
+    inline Task<T> get_return_object() noexcept;
+};
+
+} // namespace detail
+
+/**
+ * @brief Lazily started coroutine returning T, owned by the Task object (destroying the Task destroys the frame,
+ * cancelling whatever it was awaiting).
+ *
+ * Frames are allocated from the actor's event-loop allocator (no heap traffic).
+ * Every awaitable in this file resumes the coroutine from its actor's event-loop (callbacks or event-handlers),
+ * so a coroutine never migrates across cores.
+ * \code
+ * struct Loader : Actor {
+ *     AskProxy askProxy;
+ *     coroutine::Task<> task;
+ *     Loader() : askProxy(*this) { (task = run()).start(); }
+ *     coroutine::Task<> run() {
+ *         auto reply = co_await coroutine::ask<GetRequest, GetResponse>(askProxy, storeActorId,
+ *                                                                       Time::Millisecond(5), key);
+ *         if (reply.status != AskProxy::OK) { co_return; }
+ *         co_await coroutine::sleep(*this, Time::Millisecond(10));
+ *         int n = co_await parse(*reply.response); // parse() is itself a Task<int> member function
+ *         ...
+ *     }
+ * };
+ * \endcode
+ * @note A Task coroutine must be an Actor member function, or a function taking an Actor & as first parameter
+ * (this is how its frame allocator is found).
+ * @note Declare Task members after the AskProxy they await on (destroying the frame cancels pending requests).
+ */
+template <class T> class Task
+{
+  public:
+    inline Task() noexcept : promise(0) {}
+    inline Task(Task &&other) noexcept
+        : handle(std::exchange(other.handle, nullptr)), promise(std::exchange(other.promise, nullptr))
+    {
+    }
+    inline ~Task() noexcept
+    {
+        if (handle)
+        {
+            handle.destroy();
+        }
+    }
+    inline Task &operator=(Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+            {
+                handle.destroy();
+            }
+            handle = std::exchange(other.handle, nullptr);
+            promise = std::exchange(other.promise, nullptr);
+        }
+        return *this;
+    }
+
+    inline bool isValid() const noexcept { return (bool)handle; }
+    inline bool isDone() const noexcept { return handle && handle.done(); }
+    /**
+     * @brief Runs a top-level (not awaited) task until its first suspension.
+     */
+    inline void start() noexcept
+    {
+        assert(handle && !handle.done());
+        handle.resume();
+    }
+    /**
+     * @brief Getter of a completed task's result.
+     * @throw ? The exception which escaped the coroutine, if any.
+     */
+    inline T getResult()
+    {
+        assert(isDone());
+        return promise->getResult();
+    }
+
+    /** @brief (co_await a Task from another Task) */
+    struct Awaiter
+    {
+        std::coroutine_handle<> handle;
+        detail::Promise<T> *promise;
+        inline bool await_ready() const noexcept { return handle.done(); }
+        inline std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaitingHandle) noexcept
+        {
+            promise->continuation = awaitingHandle;
+            return handle;
+        }
+        inline T await_resume() { return promise->getResult(); }
+    };
+    inline Awaiter operator co_await() const &noexcept
+    {
+        assert(handle);
+        return Awaiter{handle, promise};
+    }
+
+  private:
+    template <class, class...> friend class detail::FramePromise;
+    std::coroutine_handle<> handle;
+    detail::Promise<T> *promise; // of handle (whose promise type is a FramePromise<T, ...>)
+
+    inline Task(std::coroutine_handle<> phandle, detail::Promise<T> &ppromise) noexcept
+        : handle(phandle), promise(&ppromise)
+    {
+    }
+
+    Task(const Task &) = delete;
+    Task &operator=(const Task &) = delete;
+};
+
+template <class T, class _Actor, class... _Args>
+Task<T> detail::FramePromise<T, _Actor, _Args...>::get_return_object() noexcept
+{
+    return Task<T>(std::coroutine_handle<FramePromise>::from_promise(*this), *this);
+}
+
+/**
+ * @brief Awaitable resuming at the actor's next event-loop iteration (see nextIteration()).
+ */
+class NextIterationAwaiter : public Actor::Callback
+{
+  public:
+    inline explicit NextIterationAwaiter(Actor &pactor) noexcept : actor(pactor) {}
+    inline bool await_ready() const noexcept { return false; }
+    inline void await_suspend(std::coroutine_handle<> phandle) noexcept
+    {
+        handle = phandle;
+        actor.registerCallback(*this);
+    }
+    inline void await_resume() const noexcept {}
+    inline void onCallback() noexcept { handle.resume(); }
+
+  private:
+    Actor &actor;
+    std::coroutine_handle<> handle;
+};
+
+/**
+ * @brief Awaitable resuming once a duration elapsed (see sleep()).
+ * The deadline is polled once per event-loop iteration, by a performance-neutral callback.
+ */
+class SleepAwaiter : public Actor::Callback
+{
+  public:
+    inline SleepAwaiter(Actor &pactor, const Time &duration) // throw (RunTimeException)
+        : actor(pactor), deadline(HighResolutionTime()() + duration)
+    {
+    }
+    inline bool await_ready() const noexcept { return false; }
+    inline void await_suspend(std::coroutine_handle<> phandle) noexcept
+    {
+        handle = phandle;
+        actor.registerPerformanceNeutralCallback(*this);
+    }
+    inline void await_resume() const noexcept {}
+    inline void onCallback() noexcept
+    {
+        if (HighResolutionTime()() < deadline)
+        {
+            actor.registerPerformanceNeutralCallback(*this);
+        }
+        else
+        {
+            handle.resume();
+        }
+    }
+
+  private:
+    Actor &actor;
+    const Time deadline;
+    std::coroutine_handle<> handle;
+};
+
+/**
+ * @brief Outcome of an awaited AskProxy request.
+ * The response is only valid until the coroutine next suspends (it is resumed from within the response's
+ * event-handler).
+ */
+template <class _Response> struct AskResult
+{
+    AskProxy::Status status;
+    const _Response *response; ///< null unless status is OK
+};
+
+/**
+ * @brief Awaitable AskProxy request (see ask()). The request is pushed when the awaiter is created,
+ * and cancelled if the awaiting coroutine is destroyed first.
+ */
+template <class _Request, class _Response> class AskAwaiter
+{
+  public:
+    template <class... _Args>
+    inline AskAwaiter(AskProxy &paskProxy, const Actor::ActorId &destinationActorId, const Time &timeOut,
+                      _Args &&... args) // throw (std::bad_alloc, ?)
+        : askProxy(paskProxy), result{AskProxy::TIMEOUT, 0}, doneFlag(false)
+    {
+        correlationId = askProxy.ask<_Request, _Response>(
+            destinationActorId, timeOut,
+            [this](AskProxy::Status status, const _Response *response) { onAnswer(status, response); },
+            std::forward<_Args>(args)...);
+    }
+    inline ~AskAwaiter() noexcept { askProxy.cancel(correlationId); }
+    inline bool await_ready() const noexcept { return doneFlag; }
+    inline void await_suspend(std::coroutine_handle<> phandle) noexcept { handle = phandle; }
+    inline AskResult<_Response> await_resume() const noexcept { return result; }
+
+  private:
+    AskProxy &askProxy;
+    AskProxy::CorrelationId correlationId;
+    AskResult<_Response> result;
+    bool doneFlag;
+    std::coroutine_handle<> handle;
+
+    inline void onAnswer(AskProxy::Status status, const _Response *response) noexcept
+    {
+        result.status = status;
+        result.response = response;
+        doneFlag = true;
+        if (handle)
+        {
+            handle.resume();
+        }
+    }
+
+    AskAwaiter(const AskAwaiter &) = delete;
+    AskAwaiter &operator=(const AskAwaiter &) = delete;
+};
+
+/**
+ * @return awaitable resuming at the actor's next event-loop iteration (lets other actors run).
+ */
+inline NextIterationAwaiter nextIteration(Actor &actor) noexcept { return NextIterationAwaiter(actor); }
+/**
+ * @return awaitable resuming once duration elapsed.
+ */
+inline SleepAwaiter sleep(Actor &actor, const Time &duration) { return SleepAwaiter(actor, duration); }
+/**
+ * @brief Pushes a new _Request(args...) through askProxy (see AskProxy::ask()).
+ * @return awaitable resuming with the AskResult<_Response>.
+ */
+template <class _Request, class _Response, class... _Args>
+inline AskAwaiter<_Request, _Response> ask(AskProxy &askProxy, const Actor::ActorId &destinationActorId,
+                                           const Time &timeOut, _Args &&... args)
+{
+    return AskAwaiter<_Request, _Response>(askProxy, destinationActorId, timeOut, std::forward<_Args>(args)...);
+}
+
+} // namespace coroutine
+} // namespace tredzone
+
+/** @brief Selects the promise type of a Task coroutine from its parameters (the first one gives the allocator). */
+template <class T, class... _Args> struct std::coroutine_traits<tredzone::coroutine::Task<T>, _Args...>
+{
+    typedef tredzone::coroutine::detail::FramePromise<T, _Args...> promise_type;
+};
+
+#endif // __cpp_impl_coroutine
@@ -5,6 +5,52 @@
 
 #ifdef ENTERPRISE
 #include "../../../enterprise/include/trz/util/enterprise.h"
+#elif defined(TREDZONE_TRACE) && TREDZONE_TRACE
+#include "trz/util/trace.h"
+#define ENTERPRISE_0X5030
+#define ENTERPRISE_0X5031
+#define ENTERPRISE_0X5032
+#define ENTERPRISE_0X5000(a,b)
+#define ENTERPRISE_0X5001(a,b,c)
+#define ENTERPRISE_0X5002(a,b)
+#define ENTERPRISE_0X5003(a,b,c)
+#define ENTERPRISE_0X5004(a,b)
+#define ENTERPRISE_0X5005(a,b,c)
+#define ENTERPRISE_0X5006(a,b)
+#define ENTERPRISE_0X5007(a,b,c)
+#define ENTERPRISE_0X5008(a,b)
+#define ENTERPRISE_0X5009(a,b,c)
+#define ENTERPRISE_0X500A(a,b)
+#define ENTERPRISE_0X500B(a,b,c) tredzone::Trace::onActorNew(b, c);
+#define ENTERPRISE_0X500C(a,b)
+#define ENTERPRISE_0X500D(a,b,c) tredzone::Trace::onActorNew(b, c);
+#define ENTERPRISE_0X500E(a) tredzone::Trace::onLoop();
+#define ENTERPRISE_0X500F(a,b) tredzone::Trace::onCallback(a);
+#define ENTERPRISE_0X5010(a,b,c) tredzone::Trace::onDispatchBegin(tredzone::Trace::HOOK_DISPATCH_BEGIN, b);
+#define ENTERPRISE_0X5011(a) tredzone::Trace::onDispatchEnd(tredzone::Trace::HOOK_DISPATCH_END);
+#define ENTERPRISE_0X5012(a,b)
+#define ENTERPRISE_0X5013(a)
+#define ENTERPRISE_0X5014(a,b)
+#define ENTERPRISE_0X5015(a,b,c)
+#define ENTERPRISE_0X5016(a,b,c)
+#define ENTERPRISE_0X5017(a,b,c)
+#define ENTERPRISE_0X5018(a) tredzone::Trace::onActorDestroy(a);
+#define ENTERPRISE_0X5019(a,b,c,d) tredzone::Trace::onPush(b, c);
+#define ENTERPRISE_0X5020(a,b,c,d) tredzone::Trace::onPush(b, c);
+#define ENTERPRISE_0X5021(a,b,c,d) tredzone::Trace::onPush(b, c);
+#define ENTERPRISE_0X5022(a,b,c,d) tredzone::Trace::onPush(b, c);
+#define ENTERPRISE_0X5023(a,b,c,d) tredzone::Trace::onPush(b, c);
+#define ENTERPRISE_0X5024(a,b,c,d,e)
+#define ENTERPRISE_0X5025(a,b)
+#define ENTERPRISE_0X5026(a,b,c) tredzone::Trace::onActorNew(b, c);
+#define ENTERPRISE_0X5027(a,b)
+#define ENTERPRISE_0X5028(a,b,c) tredzone::Trace::onActorNew(b, c);
+#define ENTERPRISE_0X5029(a,b)
+#define ENTERPRISE_0X502A(a,b,c) tredzone::Trace::onActorNew(b, c);
+#define ENTERPRISE_0X501A(a,b)
+#define ENTERPRISE_0X501B(a,b,c) tredzone::Trace::onActorNew(b, c);
+#define ENTERPRISE_0X501C(a,b,c) tredzone::Trace::onDispatchBegin(tredzone::Trace::HOOK_UNDELIVERED_BEGIN, b);
+#define ENTERPRISE_0X501D(a) tredzone::Trace::onDispatchEnd(tredzone::Trace::HOOK_UNDELIVERED_END);
 #else
 #define ENTERPRISE_0X5030
 #define ENTERPRISE_0X5031
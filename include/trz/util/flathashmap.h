@@ -0,0 +1,675 @@
+/**
+ * @file flathashmap.h
+ * @brief open-addressing flat hash map & set
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "trz/engine/actor.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief 16-entry metadata group of an open-addressing flat hash table.
+ *
+ * Each slot has one control byte which is either EMPTY, DELETED, or the 7 low bits (H2) of the hash of the key
+ * stored in that slot. A whole group is probed at once (SSE2 when available, else portable byte loop).
+ */
+class FlatHashGroup
+{
+  public:
+    typedef int8_t ctrl_t;
+    static const size_t SIZE = 16;
+    static const ctrl_t EMPTY = -128;
+    static const ctrl_t DELETED = -2;
+
+    inline explicit FlatHashGroup(const ctrl_t *pctrl) noexcept
+#if defined(__SSE2__)
+        : ctrl(_mm_loadu_si128(reinterpret_cast<const __m128i *>(pctrl)))
+#else
+        : ctrl(pctrl)
+#endif
+    {
+    }
+    /**
+     * @return bit-mask of slots whose control byte equals h2
+     */
+    inline uint32_t match(ctrl_t h2) const noexcept
+    {
+#if defined(__SSE2__)
+        return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), ctrl));
+#else
+        uint32_t ret = 0;
+        for (size_t i = 0; i < SIZE; ++i)
+        {
+            ret |= (uint32_t)(ctrl[i] == h2) << i;
+        }
+        return ret;
+#endif
+    }
+    inline uint32_t matchEmpty() const noexcept { return match(EMPTY); }
+    /**
+     * @return bit-mask of slots available for insertion (EMPTY and DELETED both have their sign bit set)
+     */
+    inline uint32_t matchEmptyOrDeleted() const noexcept
+    {
+#if defined(__SSE2__)
+        return (uint32_t)_mm_movemask_epi8(ctrl);
+#else
+        uint32_t ret = 0;
+        for (size_t i = 0; i < SIZE; ++i)
+        {
+            ret |= (uint32_t)(ctrl[i] < 0) << i;
+        }
+        return ret;
+#endif
+    }
+    /**
+     * @brief Pops lowest set bit of mask.
+     * @return index of popped bit
+     */
+    inline static unsigned nextBit(uint32_t &mask) noexcept
+    {
+        assert(mask != 0);
+        unsigned ret = (unsigned)__builtin_ctz(mask);
+        mask &= mask - 1;
+        return ret;
+    }
+
+  private:
+#if defined(__SSE2__)
+    __m128i ctrl;
+#else
+    const ctrl_t *ctrl;
+#endif
+};
+
+/**
+ * @brief Open-addressing hash table storage shared by FlatHashMap and FlatHashSet.
+ *
+ * Values are stored inline in a single slot array (no per-element allocation), next to a parallel array
+ * of control bytes probed 16 at a time. Capacity is a power of two (multiple of FlatHashGroup::SIZE) and the table
+ * grows by rehashing once 7/8 of it is in use. No memory is allocated until the first insertion,
+ * so a default-constructed Actor::Allocator may be used for empty tables.
+ * Iterators and references are invalidated by rehashing (any insertion that grows the table).
+ */
+template <class _Value, class _Key, class _KeyOf, class _Hash, class _KeyEqual, class _Allocator> class FlatHashTable
+{
+  protected:
+    typedef FlatHashGroup::ctrl_t ctrl_t;
+    typedef std::allocator_traits<_Allocator> SlotAllocatorTraits;
+    typedef typename SlotAllocatorTraits::template rebind_alloc<ctrl_t> CtrlAllocator;
+    typedef std::allocator_traits<CtrlAllocator> CtrlAllocatorTraits;
+
+    template <bool _Const> class Iterator
+    {
+      public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef _Value value_type;
+        typedef ptrdiff_t difference_type;
+        typedef typename std::conditional<_Const, const _Value *, _Value *>::type pointer;
+        typedef typename std::conditional<_Const, const _Value &, _Value &>::type reference;
+
+        inline Iterator() noexcept : ctrl(0), ctrlEnd(0), slot(0) {}
+        /** @brief iterator to const_iterator conversion (not a copy constructor). */
+        template <bool _OtherConst, class = typename std::enable_if<_Const && !_OtherConst>::type>
+        inline Iterator(const Iterator<_OtherConst> &other) noexcept
+            : ctrl(other.ctrl), ctrlEnd(other.ctrlEnd), slot(other.slot)
+        {
+        }
+        inline reference operator*() const noexcept { return *slot; }
+        inline pointer operator->() const noexcept { return slot; }
+        inline Iterator &operator++() noexcept
+        {
+            ++ctrl;
+            ++slot;
+            skipFree();
+            return *this;
+        }
+        inline Iterator operator++(int) noexcept
+        {
+            Iterator ret = *this;
+            ++*this;
+            return ret;
+        }
+        inline bool operator==(const Iterator &other) const noexcept { return ctrl == other.ctrl; }
+        inline bool operator!=(const Iterator &other) const noexcept { return ctrl != other.ctrl; }
+
+      private:
+        friend class FlatHashTable;
+        friend class Iterator<!_Const>;
+        const ctrl_t *ctrl;
+        const ctrl_t *ctrlEnd;
+        _Value *slot;
+
+        inline Iterator(const ctrl_t *pctrl, const ctrl_t *pctrlEnd, _Value *pslot) noexcept
+            : ctrl(pctrl), ctrlEnd(pctrlEnd), slot(pslot)
+        {
+        }
+        inline void skipFree() noexcept
+        {
+            for (; ctrl != ctrlEnd && *ctrl < 0; ++ctrl, ++slot)
+            {
+            }
+        }
+    };
+
+  public:
+    typedef _Key key_type;
+    typedef _Value value_type;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+    typedef _Hash hasher;
+    typedef _KeyEqual key_equal;
+    typedef _Allocator allocator_type;
+    typedef value_type &reference;
+    typedef const value_type &const_reference;
+    typedef Iterator<false> iterator;
+    typedef Iterator<true> const_iterator;
+
+    inline explicit FlatHashTable(const allocator_type &pallocator = allocator_type(), const hasher &phash = hasher(),
+                                  const key_equal &pkeyEqual = key_equal()) noexcept
+        : ctrl(0), slots(0), capacity(0), valueCount(0), growthLeft(0), hash(phash), keyEqual(pkeyEqual),
+          allocator(pallocator)
+    {
+    }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    FlatHashTable(const FlatHashTable &other)
+        : ctrl(0), slots(0), capacity(0), valueCount(0), growthLeft(0), hash(other.hash), keyEqual(other.keyEqual),
+          allocator(other.allocator)
+    {
+        reserve(other.valueCount);
+        for (const_iterator i = other.begin(), endi = other.end(); i != endi; ++i)
+        {
+            emplaceKey(_KeyOf()(*i), *i);
+        }
+    }
+    inline FlatHashTable(FlatHashTable &&other) noexcept
+        : ctrl(other.ctrl), slots(other.slots), capacity(other.capacity), valueCount(other.valueCount),
+          growthLeft(other.growthLeft), hash(other.hash), keyEqual(other.keyEqual), allocator(other.allocator)
+    {
+        other.ctrl = 0;
+        other.slots = 0;
+        other.capacity = other.valueCount = other.growthLeft = 0;
+    }
+    inline ~FlatHashTable() noexcept { destroy(); }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    FlatHashTable &operator=(const FlatHashTable &other)
+    {
+        if (this != &other)
+        {
+            FlatHashTable tmp(other);
+            swap(tmp);
+        }
+        return *this;
+    }
+    inline FlatHashTable &operator=(FlatHashTable &&other) noexcept
+    {
+        swap(other);
+        return *this;
+    }
+    inline void swap(FlatHashTable &other) noexcept
+    {
+        std::swap(ctrl, other.ctrl);
+        std::swap(slots, other.slots);
+        std::swap(capacity, other.capacity);
+        std::swap(valueCount, other.valueCount);
+        std::swap(growthLeft, other.growthLeft);
+        std::swap(hash, other.hash);
+        std::swap(keyEqual, other.keyEqual);
+        std::swap(allocator, other.allocator);
+    }
+
+    inline allocator_type get_allocator() const noexcept { return allocator; }
+    inline hasher hash_function() const { return hash; }
+    inline key_equal key_eq() const { return keyEqual; }
+    inline bool empty() const noexcept { return valueCount == 0; }
+    inline size_type size() const noexcept { return valueCount; }
+    inline size_type bucket_count() const noexcept { return capacity; }
+    inline float load_factor() const noexcept { return capacity == 0 ? 0.f : (float)valueCount / (float)capacity; }
+
+    inline iterator begin() noexcept
+    {
+        iterator ret(ctrl, ctrl + capacity, slots);
+        ret.skipFree();
+        return ret;
+    }
+    inline const_iterator begin() const noexcept
+    {
+        const_iterator ret(ctrl, ctrl + capacity, slots);
+        ret.skipFree();
+        return ret;
+    }
+    inline const_iterator cbegin() const noexcept { return begin(); }
+    inline iterator end() noexcept { return iterator(ctrl + capacity, ctrl + capacity, slots + capacity); }
+    inline const_iterator end() const noexcept
+    {
+        return const_iterator(ctrl + capacity, ctrl + capacity, slots + capacity);
+    }
+    inline const_iterator cend() const noexcept { return end(); }
+
+    inline iterator find(const key_type &key) noexcept
+    {
+        size_t i = findIndex(key);
+        return i == capacity ? end() : iterator(ctrl + i, ctrl + capacity, slots + i);
+    }
+    inline const_iterator find(const key_type &key) const noexcept
+    {
+        size_t i = findIndex(key);
+        return i == capacity ? end() : const_iterator(ctrl + i, ctrl + capacity, slots + i);
+    }
+    inline size_type count(const key_type &key) const noexcept { return findIndex(key) == capacity ? 0 : 1; }
+
+    inline iterator erase(const_iterator pos) noexcept
+    {
+        assert(pos.ctrl >= ctrl && pos.ctrl < ctrl + capacity && *pos.ctrl >= 0);
+        size_t i = (size_t)(pos.ctrl - ctrl);
+        eraseIndex(i);
+        iterator ret(ctrl + i, ctrl + capacity, slots + i);
+        ret.skipFree();
+        return ret;
+    }
+    inline size_type erase(const key_type &key) noexcept
+    {
+        size_t i = findIndex(key);
+        if (i == capacity)
+        {
+            return 0;
+        }
+        eraseIndex(i);
+        return 1;
+    }
+    /**
+     * @brief Destroys all values, but keeps allocated capacity.
+     */
+    inline void clear() noexcept
+    {
+        if (valueCount != 0)
+        {
+            destroyValues();
+        }
+        if (capacity != 0)
+        {
+            std::memset(ctrl, FlatHashGroup::EMPTY, capacity);
+            growthLeft = maxLoad(capacity);
+        }
+        valueCount = 0;
+    }
+    /**
+     * @brief Ensures that n values can be stored without rehashing.
+     * throw (std::bad_alloc, ...)
+     */
+    inline void reserve(size_type n)
+    {
+        if (n > valueCount + growthLeft)
+        {
+            rehash(capacityFor(n));
+        }
+    }
+
+  protected:
+    ctrl_t *ctrl;
+    value_type *slots;
+    size_t capacity;
+    size_t valueCount;
+    size_t growthLeft;
+    hasher hash;
+    key_equal keyEqual;
+    allocator_type allocator;
+
+    inline static size_t maxLoad(size_t pcapacity) noexcept { return pcapacity - pcapacity / 8; }
+    inline static size_t capacityFor(size_t n) noexcept
+    {
+        size_t ret = FlatHashGroup::SIZE;
+        for (; maxLoad(ret) < n; ret *= 2)
+        {
+        }
+        return ret;
+    }
+    /**
+     * @brief Mixes the user hash (std::hash of integers is the identity) so that both H1 and H2 are well distributed.
+     */
+    inline size_t mixedHash(const key_type &key) const noexcept
+    {
+        uint64_t h = (uint64_t)hash(key) * UINT64_C(0x9E3779B97F4A7C15);
+        return (size_t)(h ^ (h >> 32));
+    }
+    inline static ctrl_t h2(size_t h) noexcept { return (ctrl_t)(h & 0x7f); }
+    inline static size_t h1(size_t h) noexcept { return h >> 7; }
+
+    inline size_t findIndex(const key_type &key) const noexcept
+    {
+        if (valueCount == 0)
+        {
+            return capacity;
+        }
+        const size_t h = mixedHash(key);
+        const size_t groupMask = capacity / FlatHashGroup::SIZE - 1;
+        for (size_t g = h1(h) & groupMask, step = 0;; g = (g + ++step) & groupMask)
+        {
+            const size_t base = g * FlatHashGroup::SIZE;
+            FlatHashGroup group(ctrl + base);
+            for (uint32_t mask = group.match(h2(h)); mask != 0;)
+            {
+                size_t i = base + FlatHashGroup::nextBit(mask);
+                if (keyEqual(_KeyOf()(slots[i]), key))
+                {
+                    return i;
+                }
+            }
+            if (group.matchEmpty() != 0)
+            {
+                return capacity;
+            }
+            assert(step <= groupMask);
+        }
+    }
+    /**
+     * @brief First EMPTY or DELETED slot in the probe sequence of h (the table must not be full).
+     */
+    inline size_t findFreeIndex(size_t h) const noexcept
+    {
+        const size_t groupMask = capacity / FlatHashGroup::SIZE - 1;
+        for (size_t g = h1(h) & groupMask, step = 0;; g = (g + ++step) & groupMask)
+        {
+            uint32_t mask = FlatHashGroup(ctrl + g * FlatHashGroup::SIZE).matchEmptyOrDeleted();
+            if (mask != 0)
+            {
+                return g * FlatHashGroup::SIZE + FlatHashGroup::nextBit(mask);
+            }
+            assert(step <= groupMask);
+        }
+    }
+    /**
+     * @brief Inserts a value constructed from args if key is not found.
+     * throw (std::bad_alloc, ...)
+     */
+    template <class... _Args> std::pair<iterator, bool> emplaceKey(const key_type &key, _Args &&... args)
+    {
+        size_t i = findIndex(key);
+        if (i != capacity)
+        {
+            return std::make_pair(iterator(ctrl + i, ctrl + capacity, slots + i), false);
+        }
+        const size_t h = mixedHash(key);
+        if (growthLeft == 0)
+        {
+            // reclaim tombstones in place when they account for most of the load, else double
+            rehash(capacity != 0 && valueCount < maxLoad(capacity) / 2 ? capacity : capacityFor(valueCount + 1));
+        }
+        i = findFreeIndex(h);
+        SlotAllocatorTraits::construct(allocator, slots + i, std::forward<_Args>(args)...);
+        if (ctrl[i] == FlatHashGroup::EMPTY)
+        {
+            --growthLeft;
+        }
+        ctrl[i] = h2(h);
+        ++valueCount;
+        return std::make_pair(iterator(ctrl + i, ctrl + capacity, slots + i), true);
+    }
+    inline void eraseIndex(size_t i) noexcept
+    {
+        assert(ctrl[i] >= 0);
+        SlotAllocatorTraits::destroy(allocator, slots + i);
+        --valueCount;
+        // a group that still has an EMPTY slot never made a probe sequence move on, so the slot can be made EMPTY again
+        size_t base = i & ~(FlatHashGroup::SIZE - 1);
+        if (FlatHashGroup(ctrl + base).matchEmpty() != 0)
+        {
+            ctrl[i] = FlatHashGroup::EMPTY;
+            ++growthLeft;
+        }
+        else
+        {
+            ctrl[i] = FlatHashGroup::DELETED;
+        }
+    }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    void rehash(size_t newCapacity)
+    {
+        assert(newCapacity >= FlatHashGroup::SIZE && (newCapacity & (newCapacity - 1)) == 0);
+        assert(maxLoad(newCapacity) >= valueCount);
+        CtrlAllocator ctrlAllocator(allocator);
+        ctrl_t *newCtrl = CtrlAllocatorTraits::allocate(ctrlAllocator, newCapacity);
+        value_type *newSlots;
+        try
+        {
+            newSlots = SlotAllocatorTraits::allocate(allocator, newCapacity);
+        }
+        catch (...)
+        {
+            CtrlAllocatorTraits::deallocate(ctrlAllocator, newCtrl, newCapacity);
+            throw;
+        }
+        std::memset(newCtrl, FlatHashGroup::EMPTY, newCapacity);
+
+        ctrl_t *oldCtrl = ctrl;
+        value_type *oldSlots = slots;
+        const size_t oldCapacity = capacity;
+        ctrl = newCtrl;
+        slots = newSlots;
+        capacity = newCapacity;
+        for (size_t i = 0; i < oldCapacity; ++i)
+        {
+            if (oldCtrl[i] >= 0)
+            {
+                const size_t h = mixedHash(_KeyOf()(oldSlots[i]));
+                size_t j = findFreeIndex(h);
+                SlotAllocatorTraits::construct(allocator, slots + j, std::move_if_noexcept(oldSlots[i]));
+                SlotAllocatorTraits::destroy(allocator, oldSlots + i);
+                ctrl[j] = h2(h);
+            }
+        }
+        growthLeft = maxLoad(capacity) - valueCount;
+        if (oldCapacity != 0)
+        {
+            CtrlAllocatorTraits::deallocate(ctrlAllocator, oldCtrl, oldCapacity);
+            SlotAllocatorTraits::deallocate(allocator, oldSlots, oldCapacity);
+        }
+    }
+    inline void destroyValues() noexcept
+    {
+        for (size_t i = 0; i < capacity; ++i)
+        {
+            if (ctrl[i] >= 0)
+            {
+                SlotAllocatorTraits::destroy(allocator, slots + i);
+            }
+        }
+    }
+    inline void destroy() noexcept
+    {
+        if (capacity != 0)
+        {
+            destroyValues();
+            CtrlAllocator ctrlAllocator(allocator);
+            CtrlAllocatorTraits::deallocate(ctrlAllocator, ctrl, capacity);
+            SlotAllocatorTraits::deallocate(allocator, slots, capacity);
+        }
+        ctrl = 0;
+        slots = 0;
+        capacity = valueCount = growthLeft = 0;
+    }
+
+  private:
+    static_assert(sizeof(FlatHashGroup::ctrl_t) == 1, "control bytes must be bytes");
+};
+
+template <class _Key, class _Mapped> struct FlatHashMapKeyOf
+{
+    inline const _Key &operator()(const std::pair<const _Key, _Mapped> &value) const noexcept { return value.first; }
+};
+
+template <class _Key> struct FlatHashSetKeyOf
+{
+    inline const _Key &operator()(const _Key &value) const noexcept { return value; }
+};
+
+/**
+ * @brief Open-addressing flat hash map, with an std::unordered_map-like interface.
+ *
+ * Defaults to the event-loop (cpu-core) local Actor::Allocator:
+ * \code
+ * FlatHashMap<uint64_t, Order> orders(getAllocator());
+ * \endcode
+ * @see FlatHashTable
+ */
+template <class _Key, class _Mapped, class _Hash = std::hash<_Key>, class _KeyEqual = std::equal_to<_Key>,
+          class _Allocator = Actor::Allocator<std::pair<const _Key, _Mapped>>>
+class FlatHashMap : public FlatHashTable<std::pair<const _Key, _Mapped>, _Key, FlatHashMapKeyOf<_Key, _Mapped>, _Hash,
+                                         _KeyEqual, _Allocator>
+{
+    typedef FlatHashTable<std::pair<const _Key, _Mapped>, _Key, FlatHashMapKeyOf<_Key, _Mapped>, _Hash, _KeyEqual,
+                          _Allocator>
+        Base;
+
+  public:
+    typedef _Mapped mapped_type;
+    typedef typename Base::key_type key_type;
+    typedef typename Base::value_type value_type;
+    typedef typename Base::allocator_type allocator_type;
+    typedef typename Base::hasher hasher;
+    typedef typename Base::key_equal key_equal;
+    typedef typename Base::iterator iterator;
+    typedef typename Base::const_iterator const_iterator;
+
+    inline explicit FlatHashMap(const allocator_type &allocator = allocator_type(), const hasher &hash = hasher(),
+                                const key_equal &keyEqual = key_equal()) noexcept
+        : Base(allocator, hash, keyEqual)
+    {
+    }
+
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    inline std::pair<iterator, bool> insert(const value_type &value) { return Base::emplaceKey(value.first, value); }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    inline std::pair<iterator, bool> insert(value_type &&value)
+    {
+        const key_type &key = value.first;
+        return Base::emplaceKey(key, std::move(value));
+    }
+    /**
+     * @brief Constructs mapped value from args only if key is not found.
+     * throw (std::bad_alloc, ...)
+     */
+    template <class... _Args> inline std::pair<iterator, bool> try_emplace(const key_type &key, _Args &&... args)
+    {
+        return Base::emplaceKey(key, std::piecewise_construct, std::forward_as_tuple(key),
+                                std::forward_as_tuple(std::forward<_Args>(args)...));
+    }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    template <class... _Args> inline std::pair<iterator, bool> emplace(const key_type &key, _Args &&... args)
+    {
+        return try_emplace(key, std::forward<_Args>(args)...);
+    }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    inline mapped_type &operator[](const key_type &key) { return try_emplace(key).first->second; }
+    /**
+     * throw (std::out_of_range)
+     */
+    inline mapped_type &at(const key_type &key)
+    {
+        iterator i = Base::find(key);
+        if (i == Base::end())
+        {
+            throw std::out_of_range("tredzone::FlatHashMap::at()");
+        }
+        return i->second;
+    }
+    /**
+     * throw (std::out_of_range)
+     */
+    inline const mapped_type &at(const key_type &key) const
+    {
+        const_iterator i = Base::find(key);
+        if (i == Base::end())
+        {
+            throw std::out_of_range("tredzone::FlatHashMap::at()");
+        }
+        return i->second;
+    }
+};
+
+/**
+ * @brief Open-addressing flat hash set, with an std::unordered_set-like interface.
+ * As with std::unordered_set, iterator is a const iterator: keys cannot be modified in place.
+ * @see FlatHashTable
+ */
+template <class _Key, class _Hash = std::hash<_Key>, class _KeyEqual = std::equal_to<_Key>,
+          class _Allocator = Actor::Allocator<_Key>>
+class FlatHashSet : public FlatHashTable<_Key, _Key, FlatHashSetKeyOf<_Key>, _Hash, _KeyEqual, _Allocator>
+{
+    typedef FlatHashTable<_Key, _Key, FlatHashSetKeyOf<_Key>, _Hash, _KeyEqual, _Allocator> Base;
+
+  public:
+    typedef typename Base::key_type key_type;
+    typedef typename Base::value_type value_type;
+    typedef typename Base::allocator_type allocator_type;
+    typedef typename Base::hasher hasher;
+    typedef typename Base::key_equal key_equal;
+    typedef typename Base::const_iterator iterator;
+    typedef typename Base::const_iterator const_iterator;
+
+    inline explicit FlatHashSet(const allocator_type &allocator = allocator_type(), const hasher &hash = hasher(),
+                                const key_equal &keyEqual = key_equal()) noexcept
+        : Base(allocator, hash, keyEqual)
+    {
+    }
+
+    inline const_iterator begin() const noexcept { return Base::begin(); }
+    inline const_iterator end() const noexcept { return Base::end(); }
+    inline const_iterator find(const key_type &key) const noexcept { return Base::find(key); }
+    using Base::erase;
+    inline iterator erase(const_iterator pos) noexcept { return Base::erase(pos); }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    inline std::pair<iterator, bool> insert(const value_type &value)
+    {
+        const std::pair<typename Base::iterator, bool> ret = Base::emplaceKey(value, value);
+        return std::pair<iterator, bool>(ret.first, ret.second);
+    }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    inline std::pair<iterator, bool> insert(value_type &&value)
+    {
+        const key_type &key = value;
+        const std::pair<typename Base::iterator, bool> ret = Base::emplaceKey(key, std::move(value));
+        return std::pair<iterator, bool>(ret.first, ret.second);
+    }
+};
+
+} // namespace tredzone
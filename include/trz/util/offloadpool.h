@@ -0,0 +1,280 @@
+/**
+ * @file offloadpool.h
+ * @brief blocking-call offload thread pool
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trz/engine/engine.h"
+#include "trz/engine/ingress.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Pool of non-engine worker threads running blocking calls (file i/o, name resolution, compression...)
+ * on behalf of actors, which must never block.
+ *
+ * Worker threads are pinned to the cpu-cores that are not part of the engine's CoreSet (if any).
+ * Actors submit callables through an OffloadPool::Proxy. The callable's return value is delivered back
+ * to the reply actor, on the submitting actor's event-loop, as an OffloadPool::ResultEvent<_Result>.
+ * Completions are handed back to each event-loop through a single IngressChannel per cpu-core,
+ * so they are delivered in batches, once per event-loop iteration.
+ * \code
+ * OffloadPool pool(engineCoreSet, 2); // must outlive the engine
+ *
+ * struct FileLoader : Actor {
+ *     OffloadPool::Proxy offload;
+ *     FileLoader(OffloadPool *pool) : offload(*this, *pool, 16) {
+ *         registerEventHandler<OffloadPool::ResultEvent<std::string>>(*this);
+ *         offload.submit<std::string>(*this, []() { return readFile("ref.csv"); });
+ *     }
+ *     void onEvent(const OffloadPool::ResultEvent<std::string> &event) { ... event.getResult() ... }
+ * };
+ * \endcode
+ */
+class OffloadPool
+{
+  public:
+    static const size_t DEFAULT_QUEUE_CAPACITY = 1024;
+
+    class Proxy;
+    template <class _Result> class ResultEvent;
+
+    /**
+     * @brief Constructor. Starts the worker threads.
+     * @param engineCoreSet cpu-cores used by the engine, which the workers must not run on.
+     * @param workerCount number of worker threads.
+     * @param queueCapacity maximum number of submitted calls not yet picked up by a worker (rounded up to a power of 2).
+     * throw (std::bad_alloc, std::system_error)
+     */
+    OffloadPool(const Engine::CoreSet &engineCoreSet, size_t workerCount = 1,
+                size_t queueCapacity = DEFAULT_QUEUE_CAPACITY);
+    /**
+     * @brief Destructor. Runs the already submitted calls, then joins the worker threads.
+     */
+    ~OffloadPool() noexcept;
+
+    inline size_t getWorkerCount() const noexcept { return workers.size(); }
+
+  private:
+    class CompletionActor;
+    struct CompletionEvent;
+    struct TaskBase;
+    typedef IngressChannel<CompletionEvent, TaskBase *> CompletionChannel;
+
+    struct TaskBase : MultiDoubleChainLink<TaskBase>
+    {
+        typedef DoubleChain<> Chain;
+        CompletionChannel *completionChannel;
+        Proxy *proxy; // null once the proxy is destroyed
+        Actor::ActorId replyActorId;
+        uint64_t requestId;
+        std::string exceptionWhat;
+        bool exceptionFlag;
+        inline TaskBase() noexcept : completionChannel(0), proxy(0), requestId(0), exceptionFlag(false) {}
+        virtual ~TaskBase() noexcept {}
+        virtual void run() noexcept = 0;                          // on worker thread
+        virtual void reply(Actor::Event::Pipe &) = 0;             // on event-loop, throw (std::bad_alloc)
+        virtual void destroy(const Actor::AllocatorBase &) noexcept = 0;
+    };
+    template <class _Result> struct TaskResult : TaskBase
+    {
+        _Result result;
+        inline TaskResult() : result() {}
+        virtual void reply(Actor::Event::Pipe &pipe) { pipe.push<ResultEvent<_Result>>(*this); }
+    };
+    template <class _Result, class _Function> struct Task : TaskResult<_Result>
+    {
+        _Function function;
+        inline Task(const _Function &pfunction) : function(pfunction) {}
+        virtual void run() noexcept
+        {
+            try
+            {
+                this->result = function();
+            }
+            catch (std::exception &e)
+            {
+                this->exceptionFlag = true;
+                this->exceptionWhat = e.what();
+            }
+            catch (...)
+            {
+                this->exceptionFlag = true;
+                this->exceptionWhat = "unknown exception";
+            }
+        }
+        virtual void destroy(const Actor::AllocatorBase &allocatorBase) noexcept
+        {
+            Actor::Allocator<Task> allocator(allocatorBase);
+            this->~Task();
+            allocator.deallocate(this, 1);
+        }
+    };
+    struct CompletionEvent : Actor::Event
+    {
+        TaskBase *task;
+        inline CompletionEvent(TaskBase *ptask) noexcept : task(ptask) {}
+    };
+    class CompletionActor : public Actor, public Actor::Callback
+    {
+      public:
+        CompletionActor(); // throw (std::bad_alloc)
+        void onEvent(const CompletionEvent &);
+        void onUndeliveredEvent(const Actor::Event &) {}
+        void onCallback() noexcept;
+        inline CompletionChannel &getCompletionChannel() noexcept { return completionChannel; }
+        inline void onSubmit() noexcept { ++inFlightCount; }
+
+      protected:
+        virtual void onDestroyRequest() noexcept;
+
+      private:
+        CompletionChannel completionChannel;
+        size_t inFlightCount;
+        TaskBase::Chain retiredTaskChain[2]; // replied, released 2 event-loop iterations later
+    };
+
+    const size_t queueMask;
+    std::vector<std::atomic<size_t>> queueSequences;
+    std::vector<TaskBase *> queueTasks;
+    char cacheLinePadding1[CACHE_LINE_SIZE];
+    std::atomic<size_t> enqueuePosition;
+    char cacheLinePadding2[CACHE_LINE_SIZE];
+    std::atomic<size_t> dequeuePosition;
+    char cacheLinePadding3[CACHE_LINE_SIZE];
+    std::atomic<uint32_t> wakeSequence;
+    std::atomic<uint32_t> idleWorkerCount;
+    std::atomic<bool> stopFlag;
+    std::vector<std::thread> workers;
+
+    static size_t roundCapacity(size_t) noexcept;
+    void stop() noexcept;
+    bool tryEnqueue(TaskBase &) noexcept;
+    TaskBase *tryDequeue() noexcept;
+    void runWorker(const cpuset_type &) noexcept;
+
+    OffloadPool(const OffloadPool &);
+    OffloadPool &operator=(const OffloadPool &);
+};
+
+/**
+ * @brief Result of an offloaded call, delivered to the reply actor.
+ * The result remains valid (and may be moved from) until the end of the event handler.
+ */
+template <class _Result> class OffloadPool::ResultEvent : public Actor::Event
+{
+  public:
+    inline explicit ResultEvent(TaskResult<_Result> &ptask) noexcept : task(ptask) {}
+    /** @return the id returned by Proxy::submit(). */
+    inline uint64_t getRequestId() const noexcept { return task.requestId; }
+    /** @return true if the offloaded call threw an exception (then getResult() is value-initialized). */
+    inline bool hasException() const noexcept { return task.exceptionFlag; }
+    inline const std::string &getExceptionWhat() const noexcept { return task.exceptionWhat; }
+    inline _Result &getResult() const noexcept { return task.result; }
+
+  private:
+    TaskResult<_Result> &task;
+};
+
+/**
+ * @brief Per-actor access to an OffloadPool, bounding the number of in-flight calls of its actor.
+ */
+class OffloadPool::Proxy
+{
+  public:
+    /**
+     * @brief Constructor.
+     * @param actor submitting actor (results are delivered on its event-loop).
+     * @param pool offload pool.
+     * @param maxInFlightCount maximum number of submitted calls whose result was not yet delivered.
+     * throw (std::bad_alloc, Actor::ShutdownException)
+     */
+    inline Proxy(Actor &pactor, OffloadPool &ppool, size_t pmaxInFlightCount = 64)
+        : actor(pactor), pool(ppool), completionActor(pactor.newReferencedSingletonActor<CompletionActor>()),
+          maxInFlightCount(pmaxInFlightCount), inFlightCount(0), lastRequestId(0)
+    {
+    }
+    /**
+     * @brief Destructor. In-flight calls still run, but their results are dropped.
+     */
+    inline ~Proxy() noexcept
+    {
+        while (!inFlightTaskChain.empty())
+        {
+            inFlightTaskChain.pop_front()->proxy = 0;
+        }
+    }
+    inline size_t getInFlightCount() const noexcept { return inFlightCount; }
+    inline size_t getMaxInFlightCount() const noexcept { return maxInFlightCount; }
+    /**
+     * @brief Submits fn (a callable returning _Result) to the pool.
+     * @param replyActorId actor receiving the ResultEvent<_Result>. It must run on the submitting actor's
+     * event-loop (the result is released by this event-loop shortly after delivery).
+     * @return request id (see ResultEvent::getRequestId()), or 0 if the in-flight limit is reached
+     * or the pool queue is full.
+     * throw (std::bad_alloc)
+     */
+    template <class _Result, class _Function> uint64_t submit(const Actor::ActorId &replyActorId, const _Function &fn)
+    {
+        assert(replyActorId.getNodeId() == actor.getActorId().getNodeId());
+        if (inFlightCount >= maxInFlightCount)
+        {
+            return 0;
+        }
+        Actor::Allocator<Task<_Result, _Function>> allocator(actor.getAllocator());
+        Task<_Result, _Function> *task = allocator.allocate(1);
+        try
+        {
+            new (task) Task<_Result, _Function>(fn);
+        }
+        catch (...)
+        {
+            allocator.deallocate(task, 1);
+            throw;
+        }
+        task->completionChannel = &completionActor->getCompletionChannel();
+        task->proxy = this;
+        task->replyActorId = replyActorId;
+        task->requestId = ++lastRequestId;
+        if (!pool.tryEnqueue(*task))
+        {
+            task->destroy(actor.getAllocator());
+            return 0;
+        }
+        inFlightTaskChain.push_back(task);
+        ++inFlightCount;
+        completionActor->onSubmit();
+        return lastRequestId;
+    }
+    /** @overload (reply to the submitting actor) */
+    template <class _Result, class _Function> inline uint64_t submit(const _Function &fn)
+    {
+        return submit<_Result>(actor.getActorId(), fn);
+    }
+
+  private:
+    friend class CompletionActor;
+    Actor &actor;
+    OffloadPool &pool;
+    Actor::ActorReference<CompletionActor> completionActor;
+    const size_t maxInFlightCount;
+    size_t inFlightCount;
+    uint64_t lastRequestId;
+    TaskBase::Chain inFlightTaskChain;
+
+    Proxy(const Proxy &);
+    Proxy &operator=(const Proxy &);
+};
+
+} // namespace tredzone
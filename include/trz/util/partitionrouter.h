@@ -0,0 +1,396 @@
+/**
+ * @file partitionrouter.h
+ * @brief key-partitioned routing of events to per-core partition actors
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <utility>
+
+#include "trz/engine/engine.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Routes keyed events to partition actors (one per core of the engine CoreSet), using jump consistent
+ * hashing over the active partitions, so that senders push by key without knowing actor-ids.
+ *
+ * Partitions derive from PartitionRouter::Partition and are declared before the engine starts,
+ * in a Directory shared by all senders:
+ * \code
+ * struct InstrumentPartition : PartitionRouter::Partition {
+ *     InstrumentPartition(PartitionRouter::Directory *directory) : Partition(*directory) {
+ *         registerEventHandler<QuoteEvent>(*this);
+ *     }
+ *     void onEvent(const QuoteEvent &event) {
+ *         if (forwardIfMoved(event.instrumentId, event)) { return; } // sent with a stale shard table
+ *         ...
+ *     }
+ *     virtual void onHandoff(uint32_t oldPartitionCount, uint32_t newPartitionCount) {
+ *         // push the state of the keys for which getOwner(key) != getPartitionIndex() to their new owner
+ *     }
+ * };
+ * PartitionRouter::Directory directory;
+ * directory.addPartitions<InstrumentPartition>(startSequence); // red-zone cores skipped
+ * // sender (PartitionRouter::Proxy router(*this, *directory) member)
+ * router.push<QuoteEvent>(instrumentId, instrumentId, bid, ask);
+ * \endcode
+ *
+ * Rebalancing (Proxy::rebalance()) changes the number of active partitions (a prefix of the directory),
+ * which with jump hashing only moves the keys of the added or removed partitions:
+ * - every partition adopts the new count, and the old owners hand moved keys off (Partition::onHandoff()),
+ *   then send an end-of-handoff marker to every new partition through the same event-pipe;
+ * - each new partition acknowledges once it received the markers of all old partitions;
+ * - the new count is then published to the senders' per-core shard tables.
+ * Since the state precedes the marker on each pipe, and events sent with a stale table are forwarded
+ * by their old owner after its marker, a new owner never sees an event before the state of its key.
+ */
+class PartitionRouter
+{
+  public:
+    class Directory;
+    class Partition;
+    class Proxy;
+
+    /**
+     * @brief Jump consistent hash (Lamping & Veach).
+     * @return bucket of key in [0, bucketCount[ (only 1/bucketCount of the keys move when adding a bucket).
+     */
+    inline static uint32_t jumpHash(uint64_t key, uint32_t bucketCount) noexcept
+    {
+        int64_t b = -1;
+        for (int64_t j = 0; j < (int64_t)bucketCount;)
+        {
+            b = j;
+            key = key * 2862933555777941757ULL + 1;
+            j = (int64_t)((double)(b + 1) * ((double)(1LL << 31) / (double)((key >> 33) + 1)));
+        }
+        return (uint32_t)b;
+    }
+
+  private:
+    class ShardTableActor;
+
+    struct HandoffEvent : Actor::Event
+    {
+        uint32_t version;
+        uint32_t partitionCount;
+        Actor::ActorId coordinatorActorId;
+        bool markerFlag; // from an old partition, after its handed-off state
+        inline HandoffEvent(uint32_t pversion, uint32_t ppartitionCount, const Actor::ActorId &pcoordinatorActorId,
+                            bool pmarkerFlag) noexcept
+            : version(pversion), partitionCount(ppartitionCount), coordinatorActorId(pcoordinatorActorId),
+              markerFlag(pmarkerFlag)
+        {
+        }
+    };
+    struct HandoffAckEvent : Actor::Event
+    {
+        uint32_t version;
+        inline explicit HandoffAckEvent(uint32_t pversion) noexcept : version(pversion) {}
+    };
+
+    inline static uint64_t packShardState(uint32_t version, uint32_t partitionCount) noexcept
+    {
+        return ((uint64_t)version << 32) | partitionCount;
+    }
+};
+
+/**
+ * @brief Process-wide list of partition actor-ids (filled at engine start), and published shard state.
+ */
+class PartitionRouter::Directory
+{
+  public:
+    inline Directory() noexcept : partitionCount(0), shardState(0), rebalanceFlag(false) {}
+
+    /**
+     * @brief Adds a _Partition actor, constructed with this directory's address, to every core
+     * of the start-sequence's core-set.
+     * @param redZoneFlag if false (default), red-zone cores (see Engine::StartSequence::setRedZoneCore())
+     * are skipped.
+     * @note The directory must outlive the engine.
+     * throw (std::bad_alloc)
+     */
+    template <class _Partition> void addPartitions(Engine::StartSequence &startSequence, bool redZoneFlag = false)
+    {
+        const Engine::CoreSet coreSet = startSequence.getCoreSet();
+        for (size_t i = 0; i < coreSet.size(); ++i)
+        {
+            const Actor::CoreId coreId = coreSet.at((Actor::NodeId)i);
+            if (redZoneFlag || !startSequence.isRedZoneCore(coreId))
+            {
+                addPartition<_Partition>(startSequence, coreId);
+            }
+        }
+    }
+    /**
+     * @brief Adds one _Partition actor on coreId (partitions are indexed in the order they are added).
+     * throw (std::bad_alloc)
+     */
+    template <class _Partition> void addPartition(Engine::StartSequence &startSequence, Actor::CoreId coreId)
+    {
+        startSequence.addActor<_Partition>(coreId, this);
+        shardState.store(shardState.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+    /** @return number of partition actors. */
+    inline uint32_t getPartitionCount() const noexcept { return partitionCount; }
+    /** @return number of active partitions, as published to the senders. */
+    inline uint32_t getActivePartitionCount() const noexcept
+    {
+        return (uint32_t)shardState.load(std::memory_order_acquire);
+    }
+    inline const Actor::ActorId &getPartitionActorId(uint32_t index) const noexcept
+    {
+        assert(index < partitionCount);
+        return partitionActorIds[index];
+    }
+
+  private:
+    friend class Partition;
+    friend class ShardTableActor;
+    // start-sequence actors are all constructed before any event-loop runs: no synchronization needed
+    uint32_t partitionCount;
+    Actor::ActorId partitionActorIds[Actor::MAX_NODE_COUNT];
+    std::atomic<uint64_t> shardState; // version << 32 | active partition count
+    std::atomic<bool> rebalanceFlag;
+};
+
+/**
+ * @brief Base class of partition actors.
+ */
+class PartitionRouter::Partition : public Actor
+{
+  public:
+    inline uint32_t getPartitionIndex() const noexcept { return partitionIndex; }
+    /** @return number of active partitions, as currently known by this partition (possibly ahead of senders). */
+    inline uint32_t getActivePartitionCount() const noexcept { return activePartitionCount; }
+    /** @return index of the partition owning key. */
+    inline uint32_t getOwner(uint64_t key) const noexcept { return jumpHash(key, activePartitionCount); }
+    inline bool isOwner(uint64_t key) const noexcept { return getOwner(key) == partitionIndex; }
+    /** @brief (handoff protocol, see PartitionRouter) */
+    inline void onEvent(const HandoffEvent &event)
+    {
+        if (event.version != version)
+        {
+            // first message of a new rebalancing (from the coordinator, or an early marker)
+            assert(event.version == version + 1 && ackFlag);
+            const uint32_t oldPartitionCount = activePartitionCount;
+            version = event.version;
+            activePartitionCount = event.partitionCount;
+            coordinatorActorId = event.coordinatorActorId;
+            receivedMarkerCount = 0;
+            expectedMarkerCount = partitionIndex < activePartitionCount
+                                      ? oldPartitionCount - (partitionIndex < oldPartitionCount ? 1 : 0)
+                                      : 0;
+            ackFlag = partitionIndex >= activePartitionCount;
+            if (partitionIndex < oldPartitionCount)
+            {
+                onHandoff(oldPartitionCount, activePartitionCount);
+                for (uint32_t i = 0; i < activePartitionCount; ++i)
+                {
+                    if (i != partitionIndex)
+                    {
+                        Event::Pipe(*this, getPartitionActorId(i))
+                            .push<HandoffEvent>(version, activePartitionCount, coordinatorActorId, true);
+                    }
+                }
+            }
+        }
+        if (event.markerFlag)
+        {
+            ++receivedMarkerCount;
+        }
+        if (!ackFlag && receivedMarkerCount == expectedMarkerCount)
+        {
+            ackFlag = true;
+            Event::Pipe(*this, coordinatorActorId).push<HandoffAckEvent>(version);
+        }
+    }
+
+  protected:
+    /**
+     * throw (std::bad_alloc)
+     */
+    inline Partition(Directory &pdirectory)
+        : directory(pdirectory), partitionIndex(pdirectory.partitionCount),
+          activePartitionCount((uint32_t)pdirectory.shardState.load(std::memory_order_relaxed)), version(0),
+          expectedMarkerCount(0), receivedMarkerCount(0), ackFlag(true)
+    {
+        assert(directory.partitionCount < Actor::MAX_NODE_COUNT);
+        directory.partitionActorIds[directory.partitionCount++] = getActorId();
+        registerEventHandler<HandoffEvent>(*this);
+    }
+
+    /**
+     * @brief Called when the number of active partitions changes, on the partitions which were active,
+     * before they forward anything to the new owners.
+     * Implementations push the state of the keys no longer owned (see isOwner()) to their new owner
+     * (see getPartitionActorId()), using an Event::Pipe from this actor.
+     */
+    virtual void onHandoff(uint32_t oldPartitionCount, uint32_t newPartitionCount) = 0;
+
+    inline const Actor::ActorId &getPartitionActorId(uint32_t index) const noexcept
+    {
+        return directory.getPartitionActorId(index);
+    }
+    /**
+     * @brief Forwards a copy of event to key's owner, if not this partition (event sent with a stale shard table).
+     * @return true if forwarded (the event's source actor-id is then this partition's).
+     * throw (std::bad_alloc)
+     */
+    template <class _Event> inline bool forwardIfMoved(uint64_t key, const _Event &event)
+    {
+        const uint32_t owner = getOwner(key);
+        if (owner == partitionIndex)
+        {
+            return false;
+        }
+        Event::Pipe(*this, getPartitionActorId(owner)).push<_Event>(event);
+        return true;
+    }
+
+  private:
+    Directory &directory;
+    const uint32_t partitionIndex;
+    uint32_t activePartitionCount;
+    uint32_t version;
+    uint32_t expectedMarkerCount;
+    uint32_t receivedMarkerCount;
+    bool ackFlag;
+    ActorId coordinatorActorId;
+
+};
+
+/**
+ * @brief Per-core cache of the shard table, and coordinator of the rebalancings started from its core.
+ */
+class PartitionRouter::ShardTableActor : public Actor
+{
+  public:
+    inline ShardTableActor(const Directory *pdirectory)
+        : directory(*const_cast<Directory *>(pdirectory)), cachedShardState(~(uint64_t)0), partitionCount(0),
+          activePartitionCount(0), ackCount(0), rebalanceVersion(0), rebalancePartitionCount(0)
+    {
+        registerEventHandler<HandoffAckEvent>(*this);
+    }
+    inline const Directory &getDirectory() const noexcept { return directory; }
+    /**
+     * @return actor-id of the partition owning key, according to this core's cached shard table.
+     */
+    inline const ActorId &getOwnerActorId(uint64_t key) noexcept
+    {
+        refresh();
+        assert(activePartitionCount != 0);
+        return partitionActorIds[jumpHash(key, activePartitionCount)];
+    }
+    inline uint32_t getActivePartitionCount() noexcept
+    {
+        refresh();
+        return activePartitionCount;
+    }
+    /**
+     * throw (std::bad_alloc)
+     */
+    inline bool rebalance(uint32_t newPartitionCount)
+    {
+        refresh();
+        assert(newPartitionCount != 0 && newPartitionCount <= partitionCount);
+        bool expectedFlag = false;
+        if (newPartitionCount == activePartitionCount ||
+            !directory.rebalanceFlag.compare_exchange_strong(expectedFlag, true, std::memory_order_acquire))
+        {
+            return false;
+        }
+        rebalanceVersion = (uint32_t)(cachedShardState >> 32) + 1;
+        rebalancePartitionCount = newPartitionCount;
+        ackCount = 0;
+        for (uint32_t i = 0, endi = std::max(activePartitionCount, newPartitionCount); i < endi; ++i)
+        {
+            Event::Pipe(*this, partitionActorIds[i])
+                .push<HandoffEvent>(rebalanceVersion, newPartitionCount, getActorId(), false);
+        }
+        return true;
+    }
+    inline void onEvent(const HandoffAckEvent &event)
+    {
+        assert(event.version == rebalanceVersion);
+        (void)event;
+        if (++ackCount == rebalancePartitionCount)
+        {
+            directory.shardState.store(packShardState(rebalanceVersion, rebalancePartitionCount),
+                                       std::memory_order_release);
+            directory.rebalanceFlag.store(false, std::memory_order_release);
+        }
+    }
+
+  private:
+    Directory &directory;
+    uint64_t cachedShardState;
+    uint32_t partitionCount;
+    uint32_t activePartitionCount;
+    uint32_t ackCount;
+    uint32_t rebalanceVersion;
+    uint32_t rebalancePartitionCount;
+    ActorId partitionActorIds[MAX_NODE_COUNT];
+
+    inline void refresh() noexcept
+    {
+        const uint64_t shardState = directory.shardState.load(std::memory_order_acquire);
+        if (shardState != cachedShardState)
+        {
+            cachedShardState = shardState;
+            activePartitionCount = (uint32_t)shardState;
+            for (; partitionCount < directory.partitionCount; ++partitionCount)
+            {
+                partitionActorIds[partitionCount] = directory.partitionActorIds[partitionCount];
+            }
+        }
+    }
+};
+
+/**
+ * @brief Sender side: pushes keyed events to their owner partition.
+ */
+class PartitionRouter::Proxy
+{
+  public:
+    /**
+     * throw (std::bad_alloc, Actor::ShutdownException)
+     */
+    inline Proxy(Actor &pactor, const Directory &directory)
+        : actor(pactor), shardTable(pactor.newReferencedSingletonActor<ShardTableActor>(&directory))
+    {
+        assert(&shardTable->getDirectory() == &directory); // one directory per process
+    }
+
+    /**
+     * @brief Pushes a new _Event(args...) to the partition owning key.
+     * throw (std::bad_alloc, ?)
+     */
+    template <class _Event, class... _Args> inline _Event &push(uint64_t key, _Args &&... args)
+    {
+        return Actor::Event::Pipe(actor, shardTable->getOwnerActorId(key)).push<_Event>(std::forward<_Args>(args)...);
+    }
+    inline const Actor::ActorId &getOwnerActorId(uint64_t key) noexcept { return shardTable->getOwnerActorId(key); }
+    inline uint32_t getActivePartitionCount() noexcept { return shardTable->getActivePartitionCount(); }
+    /**
+     * @brief Starts changing the number of active partitions (see PartitionRouter handoff protocol).
+     * Senders keep using the previous count until all new partitions acknowledged the handoff.
+     * @return false if newPartitionCount is the current count, or a rebalancing is already in progress.
+     * throw (std::bad_alloc)
+     */
+    inline bool rebalance(uint32_t newPartitionCount) { return shardTable->rebalance(newPartitionCount); }
+
+  private:
+    Actor &actor;
+    Actor::ActorReference<ShardTableActor> shardTable;
+};
+
+} // namespace tredzone
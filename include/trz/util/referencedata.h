@@ -0,0 +1,250 @@
+/**
+ * @file referencedata.h
+ * @brief memory-mapped reference-data loader with parallel per-core parsing
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "trz/engine/engine.h"
+#include "trz/engine/internal/datastream.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Read-only memory mapping of a reference-data file (mapped once, populated, huge pages where available),
+ * split at record boundaries.
+ */
+class ReferenceDataFile
+{
+  public:
+    /**
+     * @brief Returns the byte size of the record at record (at most maxByteCount bytes are readable),
+     * or 0 if the record is truncated or malformed.
+     */
+    typedef size_t (*RecordSizeFunction)(const void *record, size_t maxByteCount);
+
+    /** @brief Thrown when a record size is 0 (truncated or malformed record). */
+    struct CorruptFileException : std::exception
+    {
+        const char *what() const noexcept override { return "tredzone::ReferenceDataFile::CorruptFileException"; }
+    };
+
+    /** @brief Consecutive whole records. */
+    struct Chunk
+    {
+        const char *data;
+        size_t byteCount;
+        size_t recordCount;
+    };
+
+    /**
+     * @brief Constructor. Maps the file read-only.
+     * @throw std::system_error
+     */
+    explicit ReferenceDataFile(const char *path);
+    ~ReferenceDataFile() noexcept;
+
+    inline const void *getData() const noexcept { return data; }
+    inline size_t getSize() const noexcept { return size; }
+
+    /**
+     * @brief Splits the file into chunkCount chunks of whole records, of about the same byte size.
+     * Only the record sizes are read (no parsing).
+     * @throw CorruptFileException, std::bad_alloc
+     */
+    std::vector<Chunk> split(size_t chunkCount, RecordSizeFunction) const;
+
+    /**
+     * @brief Allocates anonymous memory, backed by (transparent) huge pages where available.
+     * Pages are physically allocated on first touch, i.e. on the touching cpu-core's NUMA node.
+     * @throw std::bad_alloc
+     */
+    static void *allocatePages(size_t byteCount);
+    /** @brief Makes memory from allocatePages() read-only. */
+    static void protectPages(void *, size_t byteCount) noexcept;
+    /** @brief Releases memory from allocatePages(). */
+    static void deallocatePages(void *, size_t byteCount) noexcept;
+
+  private:
+    const char *data;
+    size_t size;
+
+    ReferenceDataFile(const ReferenceDataFile &);
+    ReferenceDataFile &operator=(const ReferenceDataFile &);
+};
+
+/**
+ * @brief Loads a reference-data file (e.g. instrument definitions) of length-delimited records into
+ * one read-only array of _Record per cpu-core, each core getting a slice of the file.
+ *
+ * The file is mapped once and split at record boundaries (one chunk per core of the CoreSet).
+ * The chunks are parsed in parallel, by one thread pinned to each target core, into memory first-touched
+ * by that core (huge pages where available), which is then made read-only.
+ * Loading runs once, at the first getView() call, typically from the constructor of an actor during engine start:
+ * \code
+ * ReferenceDataLoader<Instrument> loader("instruments.bin", startSequence.getCoreSet(), &instrumentSize,
+ *                                        &parseInstrument); // must outlive the engine
+ *
+ * struct InstrumentActor : Actor {
+ *     const ReferenceDataLoader<Instrument>::View &instruments;
+ *     InstrumentActor(ReferenceDataLoader<Instrument> *loader) : instruments(loader->getView(getCore())) {}
+ * };
+ * \endcode
+ * _Record must be default-constructible and trivially destructible (it lives in read-only memory);
+ * parse functions read one record (exactly its record size bytes) from a bounds-checked DataBufferReader.
+ */
+template <class _Record> class ReferenceDataLoader : private ReferenceDataFile
+{
+    static_assert(std::is_trivially_destructible<_Record>::value, "_Record must be trivially destructible");
+
+  public:
+    typedef ReferenceDataFile::RecordSizeFunction RecordSizeFunction;
+    /** @brief Parses one record. throw (DataBufferOutOfBoundsException, ...) */
+    typedef void (*ParseFunction)(DataBufferReader<> &, _Record &);
+
+    /** @brief Core-local read-only array of records. */
+    class View
+    {
+      public:
+        inline View() noexcept : records(0), recordCount(0), byteCount(0) {}
+        inline const _Record *begin() const noexcept { return records; }
+        inline const _Record *end() const noexcept { return records + recordCount; }
+        inline size_t size() const noexcept { return recordCount; }
+        inline bool empty() const noexcept { return recordCount == 0; }
+        inline const _Record &operator[](size_t i) const noexcept
+        {
+            assert(i < recordCount);
+            return records[i];
+        }
+
+      private:
+        friend class ReferenceDataLoader;
+        _Record *records;
+        size_t recordCount;
+        size_t byteCount;
+    };
+
+    /**
+     * @brief Constructor. Maps the file, parsing is deferred to the first getView() (or load()) call.
+     * @param path reference-data file path.
+     * @param coreSet cpu-cores, each getting a slice of the file (usually the engine's CoreSet).
+     * @throw std::system_error
+     */
+    ReferenceDataLoader(const char *path, const Engine::CoreSet &pcoreSet, RecordSizeFunction precordSize,
+                        ParseFunction pparse)
+        : ReferenceDataFile(path), coreSet(pcoreSet), recordSize(precordSize), parse(pparse),
+          views(pcoreSet.size())
+    {
+    }
+    ~ReferenceDataLoader() noexcept { releaseAll(); }
+
+    /**
+     * @brief Returns the read-only view of the records of coreId, loading all cores' views if not done yet.
+     * @throw CoreSet::UndefinedCoreException, CorruptFileException, DataBufferOutOfBoundsException,
+     * std::bad_alloc, std::system_error, and the exceptions of the parse function
+     */
+    const View &getView(Actor::CoreId coreId)
+    {
+        load();
+        return views[coreSet.index(coreId)];
+    }
+
+    /**
+     * @brief Splits the file and parses the chunks in parallel, one thread pinned per cpu-core (once).
+     * @throw see getView()
+     */
+    void load() { std::call_once(loadedFlag, &ReferenceDataLoader::loadOnce, this); }
+
+  private:
+    const Engine::CoreSet coreSet;
+    const RecordSizeFunction recordSize;
+    const ParseFunction parse;
+    std::vector<View> views;
+    std::once_flag loadedFlag;
+
+    void loadOnce()
+    {
+        const std::vector<Chunk> chunks = split(coreSet.size(), recordSize);
+        std::vector<std::exception_ptr> exceptions(chunks.size());
+        std::vector<std::thread> threads;
+        threads.reserve(chunks.size());
+        try
+        {
+            for (size_t i = 0; i < chunks.size(); ++i)
+            {
+                threads.push_back(std::thread(&ReferenceDataLoader::loadChunk, this, coreSet.at((Actor::NodeId)i),
+                                              chunks[i], &views[i], &exceptions[i]));
+            }
+        }
+        catch (...)
+        {
+            join(threads);
+            releaseAll();
+            throw;
+        }
+        join(threads);
+        for (size_t i = 0; i < exceptions.size(); ++i)
+        {
+            if (exceptions[i])
+            {
+                releaseAll(); // load() may be retried
+                std::rethrow_exception(exceptions[i]);
+            }
+        }
+    }
+    static void join(std::vector<std::thread> &threads) noexcept
+    {
+        for (size_t i = 0; i < threads.size(); ++i)
+        {
+            threads[i].join();
+        }
+    }
+    void loadChunk(Actor::CoreId coreId, Chunk chunk, View *view, std::exception_ptr *exception) noexcept
+    {
+        try
+        {
+            threadSetAffinity(coreId);
+            const size_t byteCount = std::max(chunk.recordCount, (size_t)1) * sizeof(_Record);
+            view->records = static_cast<_Record *>(allocatePages(byteCount));
+            view->byteCount = byteCount;
+            const char *p = chunk.data;
+            for (; view->recordCount < chunk.recordCount; ++view->recordCount)
+            {
+                const size_t n = recordSize(p, chunk.byteCount - (size_t)(p - chunk.data));
+                DataBufferReader<> reader(p, n);
+                parse(reader, *new (view->records + view->recordCount) _Record());
+                p += n;
+            }
+            protectPages(view->records, byteCount);
+        }
+        catch (...)
+        {
+            *exception = std::current_exception();
+        }
+    }
+    void releaseAll() noexcept
+    {
+        for (size_t i = 0; i < views.size(); ++i)
+        {
+            if (views[i].records != 0)
+            {
+                deallocatePages(views[i].records, views[i].byteCount);
+            }
+            views[i] = View();
+        }
+    }
+};
+
+} // namespace tredzone
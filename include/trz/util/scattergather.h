@@ -0,0 +1,434 @@
+/**
+ * @file scattergather.h
+ * @brief scatter-gather of a range across cores
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <new>
+#include <utility>
+
+#include "trz/engine/engine.h"
+#include "trz/engine/internal/cacheline.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Splits an index range into per-core chunks, maps them on per-core worker singletons,
+ * and reduces the partial results on the coordinator's core as they come back.
+ *
+ * A _Job is a copyable class providing:
+ * \code
+ * struct RiskJob {
+ *     typedef double result_type;                                 // default-constructible, movable
+ *     const Position *positions;                                  // shared input, read-only while the job runs
+ *     result_type map(size_t begin, size_t end) const;            // on worker cores, may throw
+ *     void reduce(result_type &accumulator, result_type &partial) const; // on the coordinator's core
+ * };
+ * \endcode
+ * Partial results are reduced in arrival order: reduce() must be commutative and associative.
+ * Each chunk's partial result is written by its worker in place (in its own cache-line), and only
+ * an id goes back through the event-pipe.
+ *
+ * Workers are declared before the engine starts, with a WorkerDirectory shared by all coordinators:
+ * \code
+ * ScatterGather::WorkerDirectory directory;
+ * Engine::StartSequence startSequence(coreSet);
+ * directory.addWorkers(startSequence); // one worker per core-set core, red-zone cores skipped
+ * startSequence.addActor<Coordinator>(0, &directory);
+ * // Coordinator (ScatterGather scatterGather(*this, *directory) member)
+ * scatterGather.scatter(RiskJob{positions}, 0, positionCount,
+ *                       [this](double risk, size_t failedChunkCount) { ... });
+ * \endcode
+ */
+class ScatterGather
+{
+  public:
+    typedef uint64_t JobId;
+
+    struct NoWorkerException : std::exception
+    {
+        virtual const char *what() const noexcept { return "tredzone::ScatterGather::NoWorkerException"; }
+    };
+
+    class WorkerDirectory;
+
+    /**
+     * @brief Constructor.
+     * @param actor coordinator actor (completion callbacks are invoked on its event-loop).
+     * @param directory workers the jobs are scattered to.
+     * throw (std::bad_alloc, Actor::ShutdownException)
+     */
+    inline ScatterGather(Actor &pactor, const WorkerDirectory &pdirectory)
+        : actor(pactor), directory(pdirectory), gatherActor(pactor.newReferencedSingletonActor<GatherActor>()),
+          lastJobId(0), jobCount(0)
+    {
+    }
+    /**
+     * @brief Destructor. Jobs in progress still run on the workers, but their completion callback is dropped.
+     */
+    inline ~ScatterGather() noexcept
+    {
+        while (!jobChain.empty())
+        {
+            jobChain.pop_front()->scatterGather = 0;
+        }
+    }
+
+    inline size_t getJobCount() const noexcept { return jobCount; }
+
+    /**
+     * @brief Splits [first, last[ into chunksPerWorker chunks per worker, and sends them.
+     * @param completion callable as completion(_Job::result_type &&result, size_t failedChunkCount),
+     * invoked once all chunks came back (a chunk fails if its map() threw or its worker is gone).
+     * @param chunksPerWorker more than one chunk per worker evens out unequal chunk costs.
+     * @return job id.
+     * throw (std::bad_alloc, NoWorkerException)
+     */
+    template <class _Job, class _Completion>
+    JobId scatter(const _Job &job, size_t first, size_t last, const _Completion &completion,
+                  size_t chunksPerWorker = 1);
+
+  private:
+    class WorkerActor;
+    class GatherActor;
+    struct JobBase;
+    template <class _Job, class _Completion> struct Job;
+
+    struct ChunkEvent : Actor::Event
+    {
+        JobBase *job;
+        size_t chunkIndex;
+        size_t begin;
+        size_t end;
+        inline ChunkEvent(JobBase *pjob, size_t pchunkIndex, size_t pbegin, size_t pend) noexcept
+            : job(pjob), chunkIndex(pchunkIndex), begin(pbegin), end(pend)
+        {
+        }
+    };
+    struct PartialEvent : Actor::Event
+    {
+        JobBase *job;
+        size_t chunkIndex;
+        inline PartialEvent(JobBase *pjob, size_t pchunkIndex) noexcept : job(pjob), chunkIndex(pchunkIndex) {}
+    };
+    struct JobBase : MultiDoubleChainLink<JobBase>
+    {
+        typedef DoubleChain<> Chain;
+        ScatterGather *scatterGather; // null once the coordinator's ScatterGather is destroyed
+        JobId id;
+        size_t remainingChunkCount;
+        size_t failedChunkCount;
+        inline JobBase() noexcept : scatterGather(0), id(0), remainingChunkCount(0), failedChunkCount(0) {}
+        virtual ~JobBase() noexcept {}
+        virtual void map(size_t chunkIndex, size_t begin, size_t end) noexcept = 0; // on worker core
+        virtual void reduce(size_t chunkIndex) noexcept = 0;                        // on coordinator core
+        virtual void complete() = 0;                                                // on coordinator core
+        virtual void destroy(const Actor::AllocatorBase &) noexcept = 0;
+    };
+
+    Actor &actor;
+    const WorkerDirectory &directory;
+    Actor::ActorReference<GatherActor> gatherActor;
+    JobId lastJobId;
+    size_t jobCount;
+    JobBase::Chain jobChain;
+
+    ScatterGather(const ScatterGather &);
+    ScatterGather &operator=(const ScatterGather &);
+};
+
+/**
+ * @brief Per-core worker singleton, mapping chunks.
+ */
+class ScatterGather::WorkerActor : public Actor
+{
+  public:
+    inline WorkerActor() { registerEventHandler<ChunkEvent>(*this); }
+    inline void onEvent(const ChunkEvent &event)
+    {
+        event.job->map(event.chunkIndex, event.begin, event.end);
+        Event::Pipe(*this, event.getSourceActorId()).push<PartialEvent>(event.job, event.chunkIndex);
+    }
+};
+
+/**
+ * @brief Coordinator-core singleton, reducing partial results. Owns the jobs, so that late partial results
+ * never refer to freed memory, and defers its destruction until all jobs completed.
+ */
+class ScatterGather::GatherActor : public Actor
+{
+  public:
+    inline GatherActor() noexcept : jobCount(0)
+    {
+        registerEventHandler<PartialEvent>(*this);
+        registerUndeliveredEventHandler<ChunkEvent>(*this);
+    }
+    inline void onEvent(const PartialEvent &event) { onChunk(*event.job, event.chunkIndex, false); }
+    inline void onUndeliveredEvent(const ChunkEvent &event) { onChunk(*event.job, event.chunkIndex, true); }
+    inline void onScatter() noexcept { ++jobCount; }
+
+  protected:
+    virtual void onDestroyRequest() noexcept
+    {
+        if (jobCount == 0)
+        {
+            acceptDestroy();
+        }
+        else
+        {
+            requestDestroy();
+        }
+    }
+
+  private:
+    size_t jobCount;
+
+    inline void onChunk(JobBase &job, size_t chunkIndex, bool failedFlag)
+    {
+        if (failedFlag)
+        {
+            ++job.failedChunkCount;
+        }
+        else
+        {
+            job.reduce(chunkIndex);
+        }
+        assert(job.remainingChunkCount != 0);
+        if (--job.remainingChunkCount == 0)
+        {
+            struct Guard
+            {
+                GatherActor &gatherActor;
+                JobBase &job;
+                inline ~Guard() noexcept
+                {
+                    assert(gatherActor.jobCount != 0);
+                    --gatherActor.jobCount;
+                    job.destroy(gatherActor.getAllocator());
+                }
+            } guard = {*this, job};
+            if (job.scatterGather != 0)
+            {
+                job.scatterGather->jobChain.remove(&job);
+                --job.scatterGather->jobCount;
+                job.complete();
+            }
+        }
+    }
+};
+
+/**
+ * @brief Process-wide list of worker actor-ids, one per engine core (filled at engine start).
+ */
+class ScatterGather::WorkerDirectory
+{
+  public:
+    inline WorkerDirectory() noexcept : workerCount(0) {}
+
+    /**
+     * @brief Adds a worker to every core of the start-sequence's core-set.
+     * @param redZoneFlag if false (default), red-zone cores (see Engine::StartSequence::setRedZoneCore()) are skipped.
+     * @note Must be called after the core-set and red-zone cores were set, and before adding the coordinators.
+     * The directory must outlive the engine.
+     * throw (std::bad_alloc)
+     */
+    inline void addWorkers(Engine::StartSequence &startSequence, bool redZoneFlag = false)
+    {
+        const Engine::CoreSet coreSet = startSequence.getCoreSet();
+        for (size_t i = 0; i < coreSet.size(); ++i)
+        {
+            const Actor::CoreId coreId = coreSet.at((Actor::NodeId)i);
+            if (redZoneFlag || !startSequence.isRedZoneCore(coreId))
+            {
+                startSequence.addActor<WorkerStarterActor>(coreId, this);
+            }
+        }
+    }
+    inline size_t size() const noexcept { return workerCount; }
+    inline const Actor::ActorId &at(size_t i) const noexcept
+    {
+        assert(i < workerCount);
+        return workerActorIds[i];
+    }
+
+  private:
+    // start-sequence actors are all constructed before any event-loop runs: no synchronization needed
+    class WorkerStarterActor : public Actor
+    {
+      public:
+        inline WorkerStarterActor(WorkerDirectory *directory) : worker(newReferencedSingletonActor<WorkerActor>())
+        {
+            assert(directory->workerCount < Actor::MAX_NODE_COUNT);
+            directory->workerActorIds[directory->workerCount++] = worker->getActorId();
+        }
+
+      private:
+        ActorReference<WorkerActor> worker;
+    };
+
+    size_t workerCount;
+    Actor::ActorId workerActorIds[Actor::MAX_NODE_COUNT];
+};
+
+template <class _Job, class _Completion> struct ScatterGather::Job : ScatterGather::JobBase
+{
+    typedef typename _Job::result_type result_type;
+    struct Partial
+    {
+        result_type result;
+        bool failedFlag;
+        inline Partial() : result(), failedFlag(false) {}
+    };
+    static const size_t PARTIAL_SIZE = sizeof(Partial) + TREDZONE_CACHE_LINE_PADDING(sizeof(Partial));
+
+    const _Job job;
+    _Completion completion;
+    result_type accumulator;
+    char *const partialBuffer; // one cache-line aligned Partial per chunk (no false sharing between workers)
+    char *const partialBufferAllocation;
+    const size_t chunkCount;
+
+    inline Job(const _Job &pjob, const _Completion &pcompletion, char *ppartialBufferAllocation, size_t pchunkCount)
+        : job(pjob), completion(pcompletion), accumulator(),
+          partialBuffer(static_cast<char *>(CacheLineAlignedBuffer::cacheLineAlignedPointer(ppartialBufferAllocation))),
+          partialBufferAllocation(ppartialBufferAllocation), chunkCount(pchunkCount)
+    {
+        size_t i = 0;
+        try
+        {
+            for (; i < chunkCount; ++i)
+            {
+                new (partialAt(i)) Partial();
+            }
+        }
+        catch (...)
+        {
+            destroyPartials(i);
+            throw;
+        }
+    }
+    virtual ~Job() noexcept { destroyPartials(chunkCount); }
+    inline Partial *partialAt(size_t i) const noexcept
+    {
+        return reinterpret_cast<Partial *>(partialBuffer + i * PARTIAL_SIZE);
+    }
+    inline void destroyPartials(size_t n) noexcept
+    {
+        for (size_t i = 0; i < n; ++i)
+        {
+            partialAt(i)->~Partial();
+        }
+    }
+    inline static size_t partialBufferAllocationSize(size_t chunkCount) noexcept
+    {
+        return chunkCount * PARTIAL_SIZE + CACHE_LINE_SIZE - 1;
+    }
+    virtual void map(size_t chunkIndex, size_t begin, size_t end) noexcept
+    {
+        Partial &partial = *partialAt(chunkIndex);
+        try
+        {
+            partial.result = job.map(begin, end);
+        }
+        catch (...)
+        {
+            partial.failedFlag = true;
+        }
+    }
+    virtual void reduce(size_t chunkIndex) noexcept
+    {
+        Partial &partial = *partialAt(chunkIndex);
+        if (partial.failedFlag)
+        {
+            ++failedChunkCount;
+        }
+        else
+        {
+            job.reduce(accumulator, partial.result);
+        }
+    }
+    virtual void complete() { completion(std::move(accumulator), failedChunkCount); }
+    virtual void destroy(const Actor::AllocatorBase &allocatorBase) noexcept
+    {
+        Actor::Allocator<char> partialBufferAllocator(allocatorBase);
+        char *allocation = partialBufferAllocation;
+        const size_t allocationSize = partialBufferAllocationSize(chunkCount);
+        Actor::Allocator<Job> allocator(allocatorBase);
+        this->~Job();
+        allocator.deallocate(this, 1);
+        partialBufferAllocator.deallocate(allocation, allocationSize);
+    }
+};
+
+template <class _Job, class _Completion>
+ScatterGather::JobId ScatterGather::scatter(const _Job &job, size_t first, size_t last, const _Completion &completion,
+                                            size_t chunksPerWorker)
+{
+    typedef Job<_Job, _Completion> JobType;
+    const size_t workerCount = directory.size();
+    if (workerCount == 0)
+    {
+        throw NoWorkerException();
+    }
+    assert(first <= last);
+    const size_t chunkCount = std::max(std::min(workerCount * std::max(chunksPerWorker, (size_t)1), last - first),
+                                       (size_t)1);
+    Actor::Allocator<char> partialBufferAllocator(actor.getAllocator());
+    char *partialBufferAllocation = partialBufferAllocator.allocate(JobType::partialBufferAllocationSize(chunkCount));
+    Actor::Allocator<JobType> allocator(actor.getAllocator());
+    JobType *newJob;
+    try
+    {
+        newJob = allocator.allocate(1);
+        try
+        {
+            new (newJob) JobType(job, completion, partialBufferAllocation, chunkCount);
+        }
+        catch (...)
+        {
+            allocator.deallocate(newJob, 1);
+            throw;
+        }
+    }
+    catch (...)
+    {
+        partialBufferAllocator.deallocate(partialBufferAllocation, JobType::partialBufferAllocationSize(chunkCount));
+        throw;
+    }
+    // partial results come back to the gather actor, and chunks are returned to it if undelivered
+    const size_t n = last - first;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        try
+        {
+            Actor::Event::Pipe(*gatherActor, directory.at(i % workerCount))
+                .push<ChunkEvent>(newJob, i, first + n * i / chunkCount, first + n * (i + 1) / chunkCount);
+        }
+        catch (std::bad_alloc &)
+        {
+            if (i == 0)
+            {
+                newJob->destroy(actor.getAllocator());
+                throw;
+            }
+            // the job completes with the chunks already sent, the others count as failed
+            newJob->failedChunkCount = chunkCount - i;
+            break;
+        }
+        ++newJob->remainingChunkCount;
+    }
+    newJob->scatterGather = this;
+    newJob->id = ++lastJobId;
+    jobChain.push_back(newJob);
+    ++jobCount;
+    gatherActor->onScatter();
+    return newJob->id;
+}
+
+} // namespace tredzone
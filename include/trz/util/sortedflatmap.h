@@ -0,0 +1,215 @@
+/**
+ * @file sortedflatmap.h
+ * @brief sorted contiguous map
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "trz/engine/actor.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Ordered map stored as a sorted contiguous vector of key/value pairs, with an std::map-like interface.
+ *
+ * Lookup is a binary search over contiguous memory, and in-order iteration is a linear scan.
+ * Insertion/erasure in the middle is linear (values are shifted), but appending beyond the current greatest key
+ * (the usual case for sequence numbers and time-ordered keys) is amortized constant.
+ * Unlike std::map, the key is not const in value_type (pairs must be movable), and any insertion or erasure
+ * invalidates iterators and references.<br>
+ * Defaults to the event-loop (cpu-core) local Actor::Allocator:
+ * \code
+ * SortedFlatMap<uint64_t, Level> bids(getAllocator());
+ * \endcode
+ */
+template <class _Key, class _Mapped, class _Compare = std::less<_Key>,
+          class _Allocator = Actor::Allocator<std::pair<_Key, _Mapped>>>
+class SortedFlatMap
+{
+    typedef std::vector<std::pair<_Key, _Mapped>, _Allocator> Vector;
+
+  public:
+    typedef _Key key_type;
+    typedef _Mapped mapped_type;
+    typedef std::pair<_Key, _Mapped> value_type;
+    typedef _Compare key_compare;
+    typedef _Allocator allocator_type;
+    typedef typename Vector::size_type size_type;
+    typedef typename Vector::difference_type difference_type;
+    typedef typename Vector::iterator iterator;
+    typedef typename Vector::const_iterator const_iterator;
+    typedef typename Vector::reverse_iterator reverse_iterator;
+    typedef typename Vector::const_reverse_iterator const_reverse_iterator;
+
+    inline explicit SortedFlatMap(const allocator_type &allocator = allocator_type(),
+                                  const key_compare &pcompare = key_compare())
+        : values(allocator), compare(pcompare)
+    {
+    }
+
+    inline allocator_type get_allocator() const noexcept { return values.get_allocator(); }
+    inline key_compare key_comp() const { return compare; }
+    inline bool empty() const noexcept { return values.empty(); }
+    inline size_type size() const noexcept { return values.size(); }
+    inline size_type capacity() const noexcept { return values.capacity(); }
+    /**
+     * throw (std::bad_alloc)
+     */
+    inline void reserve(size_type n) { values.reserve(n); }
+    inline void clear() noexcept { values.clear(); }
+
+    inline iterator begin() noexcept { return values.begin(); }
+    inline const_iterator begin() const noexcept { return values.begin(); }
+    inline const_iterator cbegin() const noexcept { return values.cbegin(); }
+    inline iterator end() noexcept { return values.end(); }
+    inline const_iterator end() const noexcept { return values.end(); }
+    inline const_iterator cend() const noexcept { return values.cend(); }
+    inline reverse_iterator rbegin() noexcept { return values.rbegin(); }
+    inline const_reverse_iterator rbegin() const noexcept { return values.rbegin(); }
+    inline reverse_iterator rend() noexcept { return values.rend(); }
+    inline const_reverse_iterator rend() const noexcept { return values.rend(); }
+
+    inline iterator lower_bound(const key_type &key) { return values.begin() + lowerBoundIndex(key); }
+    inline const_iterator lower_bound(const key_type &key) const { return values.begin() + lowerBoundIndex(key); }
+    inline iterator upper_bound(const key_type &key)
+    {
+        return std::upper_bound(values.begin(), values.end(), key, KeyCompare(compare));
+    }
+    inline const_iterator upper_bound(const key_type &key) const
+    {
+        return std::upper_bound(values.begin(), values.end(), key, KeyCompare(compare));
+    }
+    inline iterator find(const key_type &key)
+    {
+        iterator ret = lower_bound(key);
+        return ret != values.end() && !compare(key, ret->first) ? ret : values.end();
+    }
+    inline const_iterator find(const key_type &key) const
+    {
+        const_iterator ret = lower_bound(key);
+        return ret != values.end() && !compare(key, ret->first) ? ret : values.end();
+    }
+    inline size_type count(const key_type &key) const { return find(key) == values.end() ? 0 : 1; }
+
+    /**
+     * @brief Constructs mapped value from args only if key is not found.
+     * throw (std::bad_alloc, ...)
+     */
+    template <class... _Args> std::pair<iterator, bool> try_emplace(const key_type &key, _Args &&... args)
+    {
+        if (values.empty() || compare(values.back().first, key))
+        { // append fast path
+            values.emplace_back(std::piecewise_construct, std::forward_as_tuple(key),
+                                std::forward_as_tuple(std::forward<_Args>(args)...));
+            return std::make_pair(values.end() - 1, true);
+        }
+        iterator i = lower_bound(key);
+        if (i != values.end() && !compare(key, i->first))
+        {
+            return std::make_pair(i, false);
+        }
+        return std::make_pair(values.emplace(i, std::piecewise_construct, std::forward_as_tuple(key),
+                                             std::forward_as_tuple(std::forward<_Args>(args)...)),
+                              true);
+    }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    inline std::pair<iterator, bool> insert(const value_type &value) { return try_emplace(value.first, value.second); }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    inline std::pair<iterator, bool> insert(value_type &&value)
+    {
+        return try_emplace(value.first, std::move(value.second));
+    }
+    /**
+     * throw (std::bad_alloc, ...)
+     */
+    inline mapped_type &operator[](const key_type &key) { return try_emplace(key).first->second; }
+    /**
+     * throw (std::out_of_range)
+     */
+    inline mapped_type &at(const key_type &key)
+    {
+        iterator i = find(key);
+        if (i == values.end())
+        {
+            throw std::out_of_range("tredzone::SortedFlatMap::at()");
+        }
+        return i->second;
+    }
+    /**
+     * throw (std::out_of_range)
+     */
+    inline const mapped_type &at(const key_type &key) const
+    {
+        const_iterator i = find(key);
+        if (i == values.end())
+        {
+            throw std::out_of_range("tredzone::SortedFlatMap::at()");
+        }
+        return i->second;
+    }
+    inline iterator erase(const_iterator pos) { return values.erase(pos); }
+    inline iterator erase(const_iterator first, const_iterator last) { return values.erase(first, last); }
+    inline size_type erase(const key_type &key)
+    {
+        iterator i = find(key);
+        if (i == values.end())
+        {
+            return 0;
+        }
+        values.erase(i);
+        return 1;
+    }
+    inline void swap(SortedFlatMap &other) noexcept
+    {
+        values.swap(other.values);
+        std::swap(compare, other.compare);
+    }
+
+  private:
+    /**
+     * @brief Branch-free binary search (the compiler emits conditional moves), which avoids the mispredictions
+     * std::lower_bound suffers from on random lookups.
+     */
+    inline size_type lowerBoundIndex(const key_type &key) const
+    {
+        size_type len = values.size();
+        if (len == 0)
+        {
+            return 0;
+        }
+        const value_type *first = values.data();
+        while (len > 1)
+        {
+            const size_type half = len / 2;
+            first = compare(first[half].first, key) ? first + half : first;
+            len -= half;
+        }
+        return (size_type)(first - values.data()) + (compare(first->first, key) ? 1 : 0);
+    }
+
+    struct KeyCompare
+    {
+        const key_compare &compare;
+        inline KeyCompare(const key_compare &pcompare) noexcept : compare(pcompare) {}
+        inline bool operator()(const value_type &value, const key_type &key) const { return compare(value.first, key); }
+        inline bool operator()(const key_type &key, const value_type &value) const { return compare(key, value.first); }
+    };
+
+    Vector values;
+    key_compare compare;
+};
+
+} // namespace tredzone
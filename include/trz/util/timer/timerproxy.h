@@ -17,6 +17,14 @@ namespace timer
 
 //---- Timer Proxy -------------------------------------------------------------
 
+/**
+ * @brief Timer client: onTimeout() is called once the set() duration is elapsed (or periodically with setRepeat()).
+ *
+ * All the proxies of a core share one singleton, which keeps one request at a time with the TimerActor service.
+ * @note Scaling: every TimeOutEvent received by a core walks all the set proxies of that core,
+ * and every TimerActor tick walks the cores having a pending request. The per-tick cost is therefore
+ * linear in the number of set proxies per core (see bench/benchtimer.cpp for measured limits).
+ */
 class TimerProxy: private MultiDoubleChainLink<TimerProxy>
 {
 public:
@@ -0,0 +1,378 @@
+/**
+ * @file trace.h
+ * @brief per-core binary tracing of engine hook points
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <iosfwd>
+#include <type_traits>
+
+#include "trz/engine/internal/cacheline.h"
+#include "trz/engine/platform.h"
+
+namespace tredzone
+{
+
+/**
+ * @brief Lock-free recorder of the engine instrumentation hook points (see trz/util/enterprise.h).
+ *
+ * When built with the TREDZONE_TRACE cmake option (-DTREDZONE_TRACE=1), actor creation/destruction,
+ * event pushes, event dispatch (enter/exit), callbacks and busy event-loop iterations are recorded,
+ * with a TSC timestamp, into a binary ring buffer owned by the recording thread (one per event-loop cpu-core).
+ * Recording never blocks nor allocates (except once per thread, for its ring), and the oldest records are
+ * overwritten when a ring is full.
+ * \code
+ * Trace::setRingCapacity(1 << 20); // records per core, before the engine starts
+ * { Engine engine(startSequence); ... }
+ * Trace::dump("simplx.trace");     // then, offline: tracetojson simplx.trace > simplx.json
+ * \endcode
+ * The JSON output (Chrome trace-event format) loads in chrome://tracing or ui.perfetto.dev,
+ * with one timeline per core.
+ *
+ * The content of dispatched events is captured too, for event classes registered with a binary layout
+ * (generated from a field list). The event bytes are copied raw into the ring (no formatting, unlike
+ * Event::contentToOStream()) and the fields are only decoded offline, by tracetojson, into the event "args":
+ * \code
+ * struct OrderEvent : Actor::Event { uint64_t orderId; double price; int32_t quantity; char symbol[8]; };
+ * Trace::registerEvent<OrderEvent>("OrderEvent", {TREDZONE_TRACE_FIELD(OrderEvent, orderId),
+ *                                                 TREDZONE_TRACE_FIELD(OrderEvent, price),
+ *                                                 TREDZONE_TRACE_FIELD(OrderEvent, quantity),
+ *                                                 TREDZONE_TRACE_FIELD(OrderEvent, symbol)});
+ * \endcode
+ */
+class Trace
+{
+  public:
+    /** @brief Recorded hook points (values are those of the matching ENTERPRISE_0X50xx hooks). */
+    enum Hook
+    {
+        HOOK_ACTOR_NEW = 0x500B,
+        HOOK_LOOP = 0x500E,
+        HOOK_CALLBACK = 0x500F,
+        HOOK_DISPATCH_BEGIN = 0x5010,
+        HOOK_DISPATCH_END = 0x5011,
+        HOOK_ACTOR_DESTROY = 0x5018,
+        HOOK_PUSH = 0x5019,
+        HOOK_UNDELIVERED_BEGIN = 0x501C,
+        HOOK_UNDELIVERED_END = 0x501D,
+        HOOK_EVENT_CONTENT = 0x5F00, ///< (trace only) raw event content of the preceding dispatch, see registerEvent()
+        HOOK_EVENT_DATA = 0x5F01     ///< (trace only) CONTENT_SLOT_SIZE raw event bytes following a HOOK_EVENT_CONTENT
+    };
+    /** @brief Registered event field types (the byte size is that of the field). */
+    enum FieldType
+    {
+        FIELD_BYTES = 0, ///< decoded as an hexadecimal string
+        FIELD_BOOL,
+        FIELD_CHAR,
+        FIELD_INT,   ///< signed integer (or enum) of 1, 2, 4 or 8 bytes
+        FIELD_UINT,  ///< unsigned integer (or enum) of 1, 2, 4 or 8 bytes
+        FIELD_FLOAT, ///< float or double
+        FIELD_STRING ///< char array, decoded up to the first '\0'
+    };
+    /** @brief Registered event field (see TREDZONE_TRACE_FIELD). */
+    struct Field
+    {
+        const char *name;
+        uint32_t offset; ///< from the start of the event (most derived class)
+        uint16_t size;
+        uint8_t type; ///< FieldType
+    };
+
+#pragma pack(push)
+#pragma pack(1)
+    /**
+     * @brief Binary trace record (32 bytes).
+     */
+    struct Record
+    {
+        uint64_t tsc;
+        uint64_t actorId;     ///< node-actor-id of the recording core's actor (destination of a dispatch)
+        uint64_t peerActorId; ///< node-actor-id of the other actor (push destination, dispatch source), if any
+        uint16_t hook;
+        uint16_t eventClassId;
+        uint8_t peerNodeId;
+        uint8_t padding[3];
+    };
+    /**
+     * @brief Binary trace file header, followed by ringCount times (RingHeader, recordCount Records),
+     * then (since version 2) by a uint32_t layout count and as many
+     * (LayoutHeader, name, fieldCount times (FieldHeader, name)).
+     */
+    struct FileHeader
+    {
+        char magic[8]; ///< "TRZTRACE"
+        uint32_t version;
+        uint32_t ringCount;
+        double tscPerMicrosecond;
+    };
+    struct RingHeader
+    {
+        uint32_t cpuId;
+        uint32_t ringIndex;
+        uint64_t recordCount;
+    };
+    struct LayoutHeader
+    {
+        uint16_t eventClassId;
+        uint16_t fieldCount;
+        uint32_t eventSize;
+        uint32_t nameSize;
+    };
+    struct FieldHeader
+    {
+        uint32_t offset;
+        uint16_t size;
+        uint8_t type;
+        uint8_t padding;
+        uint32_t nameSize;
+    };
+#pragma pack(pop)
+
+    static const uint32_t FILE_VERSION = 2;
+    static const size_t DEFAULT_RING_CAPACITY = 65536;
+    static const size_t CONTENT_SLOT_SIZE = offsetof(Record, hook); ///< event bytes per HOOK_EVENT_DATA record
+    static const size_t MAX_EVENT_CLASS_COUNT = 4096;                ///< Actor::MAX_EVENT_ID_COUNT
+
+    /**
+     * @brief Thrown by convertToJson() when the input is not a trace file.
+     */
+    struct InvalidFileException : std::exception
+    {
+        virtual const char *what() const noexcept { return "tredzone::Trace::InvalidFileException"; }
+    };
+
+    /** @return true if the engine hook points were compiled with the TREDZONE_TRACE option. */
+    inline static constexpr bool isEnabled() noexcept
+    {
+#if defined(TREDZONE_TRACE) && TREDZONE_TRACE
+        return true;
+#else
+        return false;
+#endif
+    }
+    /**
+     * @brief Sets the capacity (rounded up to a power of 2) of the rings created from now on.
+     */
+    static void setRingCapacity(size_t recordCount) noexcept;
+    /**
+     * @brief Writes every ring to a binary trace file.
+     * @note Rings still being written to may yield a few torn records (dump after the engine is destroyed).
+     * @return false if the file could not be written.
+     */
+    static bool dump(const char *path) noexcept;
+    /** @overload */
+    static void dump(std::ostream &); // throw (std::ios_base::failure)
+    /**
+     * @brief Converts a binary trace to Chrome trace-event JSON.
+     * throw (InvalidFileException, std::ios_base::failure)
+     */
+    static void convertToJson(std::istream &, std::ostream &);
+
+    /**
+     * @brief Registers the binary layout of _Event (a class derived from Actor::Event), whose content is
+     * from now on captured at each dispatch (of events pushed after registration). Fields are generated with
+     * TREDZONE_TRACE_FIELD; they must be members of _Event or of its non-virtual base classes.
+     * Registering again replaces the layout.
+     * @note Captures cost one ring record per CONTENT_SLOT_SIZE bytes of sizeof(_Event);
+     * events larger than the ring are not captured.
+     * throw (std::bad_alloc)
+     */
+    template <class _Event> static void registerEvent(const char *name, std::initializer_list<Field> fields)
+    {
+        typedef typename _Event::Event EventType;
+        // the offset of the Actor::Event base is measured on the first pushed _Event (see locateEvent())
+        registerEventLayout(EventType::template getClassId<_Event>(), name, sizeof(_Event), fields.begin(),
+                            fields.size());
+    }
+    /** @brief Returns the description of the field of _Event at member (see TREDZONE_TRACE_FIELD). */
+    template <class _Event, class _Class, class _T> static Field field(const char *name, _T _Class::*member) noexcept
+    {
+        // no _Event object is needed: the offset is the Itanium C++ ABI representation of the pointer to data member
+        // (that of a member of a virtual base does not convert)
+        _T _Event::*eventMember = member;
+        static_assert(sizeof(eventMember) == sizeof(ptrdiff_t), "unexpected pointer to data member representation");
+        ptrdiff_t offset;
+        std::memcpy(&offset, &eventMember, sizeof(offset));
+        Field ret;
+        ret.name = name;
+        ret.offset = (uint32_t)offset;
+        ret.size = (uint16_t)sizeof(_T);
+        ret.type = (uint8_t)FieldTypeOf<_T>::value;
+        return ret;
+    }
+
+    inline static void record(Hook hook, uint16_t eventClassId, uint64_t actorId, uint64_t peerActorId = 0,
+                              uint8_t peerNodeId = 0) noexcept
+    {
+        Ring *ring = getThreadRing();
+        if (ring == 0 && (ring = newThreadRing()) == 0)
+        {
+            return;
+        }
+        const uint64_t position = ring->writePosition.load(std::memory_order_relaxed);
+        Record &r = ring->records[position & ring->mask];
+        r.tsc = getTSC();
+        r.actorId = actorId;
+        r.peerActorId = peerActorId;
+        r.hook = (uint16_t)hook;
+        r.eventClassId = eventClassId;
+        r.peerNodeId = peerNodeId;
+        ring->writePosition.store(position + 1, std::memory_order_release);
+    }
+
+    /** @brief (hook point, see trz/util/enterprise.h) */
+    template <class _Creator, class _Actor>
+    inline static void onActorNew(const _Creator *creator, const _Actor *actor) noexcept
+    {
+        record(HOOK_ACTOR_NEW, 0, actor->getActorId().getNodeActorId(),
+               creator == 0 ? 0 : creator->getActorId().getNodeActorId());
+    }
+    template <class _Actor> inline static void onActorDestroy(const _Actor *actor) noexcept
+    {
+        record(HOOK_ACTOR_DESTROY, 0, actor->getActorId().getNodeActorId());
+    }
+    inline static void onLoop() noexcept
+    {
+        // idle iterations are not recorded
+        Ring *ring = getThreadRing();
+        if (ring != 0 && ring->writePosition.load(std::memory_order_relaxed) != ring->loopPosition)
+        {
+            record(HOOK_LOOP, 0, 0);
+            ring->loopPosition = ring->writePosition.load(std::memory_order_relaxed);
+        }
+    }
+    template <class _Actor> inline static void onCallback(const _Actor *actor) noexcept
+    {
+        record(HOOK_CALLBACK, 0, actor->getActorId().getNodeActorId());
+    }
+    /** @note event points to the Actor::Event (base class) of the dispatched event. */
+    template <class _Event> inline static void onDispatchBegin(Hook hook, const _Event *event) noexcept
+    {
+        record(hook, event->getClassId(), event->getDestinationActorId().getNodeActorId(),
+               event->getSourceActorId().getNodeActorId(), event->getSourceActorId().getNodeId());
+        if (hook == HOOK_DISPATCH_BEGIN)
+        {
+            recordContent(event->getClassId(), event);
+        }
+    }
+    inline static void onDispatchEnd(Hook hook) noexcept { record(hook, 0, 0); }
+    template <class _Event, class _Actor> inline static void onPush(const _Event *event, const _Actor *source) noexcept
+    {
+        record(HOOK_PUSH, event->getClassId(), source->getActorId().getNodeActorId(),
+               event->getDestinationActorId().getNodeActorId(), event->getDestinationActorId().getNodeId());
+        locateEvent(event);
+    }
+
+  private:
+    template <class _T, bool = std::is_enum<_T>::value> struct FieldTypeOf
+    {
+        static const FieldType value =
+            std::is_floating_point<_T>::value && sizeof(_T) <= sizeof(double)
+                ? FIELD_FLOAT
+                : std::is_integral<_T>::value ? (std::is_signed<_T>::value ? FIELD_INT : FIELD_UINT) : FIELD_BYTES;
+    };
+    template <class _T> struct FieldTypeOf<_T, true> : FieldTypeOf<typename std::underlying_type<_T>::type>
+    {
+    };
+    template <bool _Enum> struct FieldTypeOf<bool, _Enum>
+    {
+        static const FieldType value = FIELD_BOOL;
+    };
+    template <bool _Enum> struct FieldTypeOf<char, _Enum>
+    {
+        static const FieldType value = FIELD_CHAR;
+    };
+    template <size_t _N> struct FieldTypeOf<char[_N], false>
+    {
+        static const FieldType value = FIELD_STRING;
+    };
+    struct Ring
+    {
+        Ring *next;
+        uint32_t cpuId;
+        uint32_t ringIndex;
+        uint64_t mask;
+        uint64_t loopPosition; // writePosition at the last HOOK_LOOP record
+        char cacheLinePadding[CACHE_LINE_SIZE];
+        std::atomic<uint64_t> writePosition;
+        Record *records;
+    };
+
+    inline static Ring *&getThreadRing() noexcept
+    {
+        static thread_local Ring *ring = 0;
+        return ring;
+    }
+    static Ring *newThreadRing() noexcept;
+
+    static const uint32_t UNKNOWN_EVENT_OFFSET = ~(uint32_t)0;
+
+    // per event class-id: (event size | offset of its Actor::Event base << 32), 0 if not registered
+    // (UNKNOWN_EVENT_OFFSET until an event of the class is pushed: not captured)
+    static std::atomic<uint64_t> eventCaptures[MAX_EVENT_CLASS_COUNT];
+
+    static void registerEventLayout(uint16_t eventClassId, const char *name, size_t eventSize, const Field *fields,
+                                    size_t fieldCount); // throw (std::bad_alloc)
+    template <class _Event> inline static void locateEvent(const _Event *event) noexcept
+    {
+        typedef typename _Event::Event EventType;
+        const uint16_t eventClassId = event->getClassId();
+        uint64_t capture =
+            eventClassId < MAX_EVENT_CLASS_COUNT ? eventCaptures[eventClassId].load(std::memory_order_relaxed) : 0;
+        if ((capture >> 32) == UNKNOWN_EVENT_OFFSET)
+        {
+            // measured on a live event (published to the destination event-loop with it)
+            const uint64_t eventOffset =
+                (uint64_t)(reinterpret_cast<const char *>(static_cast<const EventType *>(event)) -
+                           reinterpret_cast<const char *>(event));
+            eventCaptures[eventClassId].compare_exchange_strong(capture, (uint32_t)capture | eventOffset << 32,
+                                                                std::memory_order_relaxed);
+        }
+    }
+    inline static void recordContent(uint16_t eventClassId, const void *event) noexcept
+    {
+        const uint64_t capture =
+            eventClassId < MAX_EVENT_CLASS_COUNT ? eventCaptures[eventClassId].load(std::memory_order_relaxed) : 0;
+        Ring *ring = getThreadRing();
+        if (capture == 0 || (capture >> 32) == UNKNOWN_EVENT_OFFSET || ring == 0)
+        {
+            return;
+        }
+        const uint32_t size = (uint32_t)capture;
+        const char *content = static_cast<const char *>(event) - (uint32_t)(capture >> 32);
+        const uint64_t slotCount = (size + CONTENT_SLOT_SIZE - 1) / CONTENT_SLOT_SIZE;
+        if (slotCount > ring->mask)
+        {
+            return;
+        }
+        uint64_t position = ring->writePosition.load(std::memory_order_relaxed);
+        Record &r = ring->records[position & ring->mask];
+        r.tsc = ring->records[(position - 1) & ring->mask].tsc; // that of the dispatch record
+        r.actorId = size;
+        r.peerActorId = 0;
+        r.hook = (uint16_t)HOOK_EVENT_CONTENT;
+        r.eventClassId = eventClassId;
+        r.peerNodeId = 0;
+        for (uint32_t offset = 0; offset < size; offset += (uint32_t)CONTENT_SLOT_SIZE)
+        {
+            Record &data = ring->records[++position & ring->mask];
+            std::memcpy(&data, content + offset, std::min((size_t)(size - offset), CONTENT_SLOT_SIZE));
+            data.hook = (uint16_t)HOOK_EVENT_DATA;
+        }
+        ring->writePosition.store(position + 1, std::memory_order_release);
+    }
+};
+
+} // namespace tredzone
+
+/** @brief Trace::Field of _Event's member (see Trace::registerEvent()). */
+#define TREDZONE_TRACE_FIELD(_Event, member) ::tredzone::Trace::field<_Event>(#member, &_Event::member)
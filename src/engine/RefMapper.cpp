@@ -8,8 +8,6 @@
 #include <iostream>
 #include <unordered_map>
 #include <unordered_set>
-#include <set>
-#include <queue>
 
 #include "trz/engine/actor.h"
 #include "trz/engine/internal/node.h"
@@ -29,42 +27,50 @@ public:
     
     // ctor
     RefMapper(const AsyncNode &nod)
-        : m_Node(nod), m_Id(s_Id++)
+        : m_Node(nod), m_Id(s_Id++), m_NumActors(0)
     {
-        m_LiveActorSet.clear();
-        
         (void)m_Node;
+        (void)m_Id;
     }
     
+    // O(1), no allocation: on the hot path of every actor creation/destruction (live actor set is debug-only)
     void    onActorAdded(const Actor *actor) override
     {
         assert(actor);
+        (void)actor;    // NDEBUG
         
-        // dispatch existing
-        DispatchQueue();
+        #ifdef DTOR_DEBUG
+            cout << "adding (node " << m_Id << ") ";
+            DumpActor(actor);
+        #endif
         
-        // enqueue new
-        m_ActorQueue.push_back(actor);
+        #ifndef NDEBUG
+            const bool  inserted_f = m_LiveActorSet.insert(actor).second;
+            assert(inserted_f);
+            (void)inserted_f;
+        #endif
+        
+        ++m_NumActors;
     }
     
     void    onActorRemoved(const Actor *actor) override
     {
         assert(actor);
+        (void)actor;    // NDEBUG
+        assert(m_NumActors > 0);
         
-        // dispatch existing
-        DispatchQueue();
-        
-        assert(m_LiveActorSet.count(actor));
-        
-        const size_t    n_erased = m_LiveActorSet.erase(actor);
-        assert(n_erased == 1);
+        #ifndef NDEBUG
+            const size_t    n_erased = m_LiveActorSet.erase(actor);
+            assert(n_erased == 1);
+            (void)n_erased;
+        #endif
         
-        (void)n_erased;
+        --m_NumActors;
     }
     
     size_t  getNumActors(void) const override
     {
-        return m_LiveActorSet.size() + m_ActorQueue.size();
+        return m_NumActors;
     }
     
     //----------------------------------------------------------------------
@@ -137,31 +143,14 @@ private:
         */
     }
     
-    void    DispatchQueue(void)
-    {
-        while (!m_ActorQueue.empty())
-        {
-            const Actor *actor = m_ActorQueue.front();
-            
-            #ifdef DTOR_DEBUG
-                cout << "dispatching (node " << m_Id << ") ";
-                DumpActor(actor);
-            #endif
-            
-            m_ActorQueue.pop_front();
-            
-            assert(!m_LiveActorSet.count(actor));
-            
-            m_LiveActorSet.insert(actor);
-        }
-    }
-    
     static int          s_Id;
     const AsyncNode     &m_Node;
     const int           m_Id;
+    size_t              m_NumActors;
     
-    set<const Actor*>   m_LiveActorSet;
-    list<const Actor*>  m_ActorQueue;
+    #ifndef NDEBUG
+        unordered_set<const Actor*> m_LiveActorSet;
+    #endif
 };
 
 // static
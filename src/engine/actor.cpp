@@ -310,6 +310,11 @@ const Actor::ActorId& Actor::getServiceActorId() const noexcept { return Engine:
 
 Actor::AllocatorBase Actor::getAllocator() const noexcept { return AllocatorBase(asyncNode->nodeAllocator); }
 
+Actor::ScratchAllocatorBase Actor::getScratchAllocator() const noexcept
+{
+    return ScratchAllocatorBase(asyncNode->scratchArena);
+}
+
 Actor::SingletonActorIndex Actor::retainSingletonActorIndex()
 { // throw (std::bad_alloc)
     assert(std::numeric_limits<SingletonActorIndex>::max() >= AsyncNodeBase::StaticShared::SINGLETON_ACTOR_INDEX_SIZE);
@@ -0,0 +1,339 @@
+/**
+ * @file binarylogger.cpp
+ * @brief asynchronous per-core binary logger
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <sched.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <new>
+
+#include "trz/util/binarylogger.h"
+
+namespace tredzone
+{
+
+const size_t BinaryLogger::DEFAULT_RING_CAPACITY;
+const size_t BinaryLogger::MAX_STRING_SIZE;
+const size_t BinaryLogger::WRITE_BUFFER_SIZE;
+const uint32_t BinaryLogger::PADDING_ARG_COUNT;
+
+static_assert(BinaryLogger::MAX_STRING_SIZE < BinaryLogger::WRITE_BUFFER_SIZE, "appended pieces must fit writeBuffer");
+
+namespace
+{
+
+std::atomic<size_t> loggerRingCapacity(BinaryLogger::DEFAULT_RING_CAPACITY);
+std::atomic<void *> loggerRingHead(0); // BinaryLogger::Ring chain, never released
+std::atomic<bool> loggerRunningFlag(false);
+
+const unsigned CALIBRATION_MILLISECONDS = 10;
+const char *const SEVERITY_NAMES[] = {"DEBUG  ", "INFO   ", "WARNING", "ERROR  "};
+
+int64_t utcNanoseconds() noexcept
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+template <class T> inline const char *readValue(const char *p, T &value) noexcept
+{
+    std::memcpy(&value, p, sizeof(value));
+    return p + sizeof(value);
+}
+
+} // namespace
+
+/**
+ * throw (AlreadyRunningException, std::system_error)
+ */
+BinaryLogger::BinaryLogger(int pfd, unsigned ppollMicroseconds)
+    : fd(pfd), pollMicroseconds(ppollMicroseconds), writtenCount(0), startTsc(0), startNanoseconds(0),
+      tscPerNanosecond(1.), dateTimeSecond(-1), stopFlag(false)
+{
+    if (loggerRunningFlag.exchange(true))
+    {
+        throw AlreadyRunningException();
+    }
+    dateTimePrefix[0] = '\0';
+    try
+    {
+        writeBuffer.reserve(2 * WRITE_BUFFER_SIZE);
+        thread = std::thread(&BinaryLogger::run, this);
+    }
+    catch (...)
+    {
+        loggerRunningFlag.store(false);
+        throw;
+    }
+}
+
+BinaryLogger::~BinaryLogger() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopFlag = true;
+    }
+    stopCondition.notify_one();
+    thread.join();
+    loggerRunningFlag.store(false);
+}
+
+void BinaryLogger::setRingCapacity(size_t byteCount) noexcept
+{
+    size_t capacity = 64; // power of 2, larger than any padding
+    for (; capacity < byteCount; capacity *= 2)
+    {
+    }
+    loggerRingCapacity.store(capacity, std::memory_order_relaxed);
+}
+
+uint64_t BinaryLogger::getDroppedCount() noexcept
+{
+    uint64_t ret = 0;
+    for (const Ring *ring = static_cast<const Ring *>(loggerRingHead.load(std::memory_order_acquire)); ring != 0;
+         ring = ring->next)
+    {
+        ret += ring->droppedCount.load(std::memory_order_relaxed);
+    }
+    return ret;
+}
+
+BinaryLogger::Ring *BinaryLogger::newThreadRing() noexcept
+{
+    const size_t capacity = loggerRingCapacity.load(std::memory_order_relaxed);
+    const int cpu = sched_getcpu();
+    // reuse the (empty) ring of an exited thread
+    for (Ring *ring = static_cast<Ring *>(loggerRingHead.load(std::memory_order_acquire)); ring != 0;
+         ring = ring->next)
+    {
+        bool ownedFlag = false;
+        if (ring->mask + 1 == capacity && !ring->ownedFlag.load(std::memory_order_relaxed) &&
+            ring->readPosition.load(std::memory_order_acquire) == ring->writePosition.load(std::memory_order_relaxed) &&
+            ring->ownedFlag.compare_exchange_strong(ownedFlag, true, std::memory_order_acquire))
+        {
+            ring->cpuId.store(cpu < 0 ? 0 : (uint32_t)cpu, std::memory_order_relaxed);
+            return getThreadRing() = ring;
+        }
+    }
+    Ring *ring = new (std::nothrow) Ring;
+    if (ring == 0)
+    {
+        return 0;
+    }
+    if ((ring->buffer = new (std::nothrow) char[capacity]) == 0)
+    {
+        delete ring;
+        return 0;
+    }
+    ring->cpuId.store(cpu < 0 ? 0 : (uint32_t)cpu, std::memory_order_relaxed);
+    ring->mask = capacity - 1;
+    ring->ownedFlag.store(true, std::memory_order_relaxed);
+    ring->writePosition.store(0, std::memory_order_relaxed);
+    ring->cachedReadPosition = 0;
+    ring->droppedCount.store(0, std::memory_order_relaxed);
+    ring->readPosition.store(0, std::memory_order_relaxed);
+    ring->reportedDroppedCount = 0;
+    void *head = loggerRingHead.load(std::memory_order_relaxed);
+    do
+    {
+        ring->next = static_cast<Ring *>(head);
+    } while (!loggerRingHead.compare_exchange_weak(head, ring, std::memory_order_release, std::memory_order_relaxed));
+    return getThreadRing() = ring;
+}
+
+void BinaryLogger::run() noexcept
+{
+    // TSC to UTC: the TSC rate is measured against the steady clock, from the logger start
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    startTsc = getTSC();
+    startNanoseconds = utcNanoseconds();
+    std::this_thread::sleep_for(std::chrono::milliseconds(CALIBRATION_MILLISECONDS));
+    std::unique_lock<std::mutex> lock(stopMutex);
+    for (;;)
+    {
+        const bool stop = stopFlag;
+        lock.unlock();
+        const int64_t elapsedNanoseconds = (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                               std::chrono::steady_clock::now() - startTime).count();
+        tscPerNanosecond = (double)(getTSC() - startTsc) / (double)elapsedNanoseconds;
+        while (drain())
+        {
+        }
+        flush();
+        lock.lock();
+        if (stop)
+        {
+            break;
+        }
+        stopCondition.wait_for(lock, std::chrono::microseconds(pollMicroseconds), [this] { return stopFlag; });
+    }
+}
+
+bool BinaryLogger::drain() noexcept
+{
+    bool ret = false;
+    for (Ring *ring = static_cast<Ring *>(loggerRingHead.load(std::memory_order_acquire)); ring != 0;
+         ring = ring->next)
+    {
+        const uint64_t droppedCount = ring->droppedCount.load(std::memory_order_relaxed);
+        if (droppedCount != ring->reportedDroppedCount)
+        {
+            formatPrefix(getTSC(), SEVERITY_WARNING, ring->cpuId.load(std::memory_order_relaxed));
+            char text[64];
+            std::snprintf(text, sizeof(text), "%llu log entries dropped (ring full)\n",
+                          (unsigned long long)(droppedCount - ring->reportedDroppedCount));
+            append(text);
+            ring->reportedDroppedCount = droppedCount;
+            ret = true;
+        }
+        uint64_t position = ring->readPosition.load(std::memory_order_relaxed);
+        const uint64_t endPosition = ring->writePosition.load(std::memory_order_acquire);
+        for (; position != endPosition && writeBuffer.size() < WRITE_BUFFER_SIZE; ret = true)
+        {
+            const char *p = ring->buffer + (position & ring->mask);
+            uint32_t sizeAndArgCount[2];
+            std::memcpy(sizeAndArgCount, p, sizeof(sizeAndArgCount));
+            if (sizeAndArgCount[1] != PADDING_ARG_COUNT)
+            {
+                EntryHeader header;
+                std::memcpy(&header, p, sizeof(header));
+                format(*ring, header, p + sizeof(header));
+                writtenCount.store(writtenCount.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            }
+            position += sizeAndArgCount[0];
+        }
+        ring->readPosition.store(position, std::memory_order_release);
+        if (writeBuffer.size() >= WRITE_BUFFER_SIZE)
+        {
+            flush();
+        }
+    }
+    return ret;
+}
+
+void BinaryLogger::formatPrefix(uint64_t tsc, Severity severity, uint32_t cpuId) noexcept
+{
+    const int64_t nanoseconds =
+        startNanoseconds + (int64_t)((double)(int64_t)(tsc - startTsc) / tscPerNanosecond);
+    const time_t second = (time_t)(nanoseconds / 1000000000);
+    if (second != dateTimeSecond)
+    {
+        struct tm t;
+        gmtime_r(&second, &t);
+        strftime(dateTimePrefix, sizeof(dateTimePrefix), "%Y-%m-%d %H:%M:%S.", &t);
+        dateTimeSecond = second;
+    }
+    char text[64];
+    std::snprintf(text, sizeof(text), "%s%09lld %s cpu%u ", dateTimePrefix,
+                  (long long)(nanoseconds % 1000000000), SEVERITY_NAMES[severity], (unsigned)cpuId);
+    append(text);
+}
+
+void BinaryLogger::format(const Ring &ring, const EntryHeader &header, const char *args) noexcept
+{
+    formatPrefix(header.tsc, header.format->severity, ring.cpuId.load(std::memory_order_relaxed));
+    uint32_t argCount = header.argCount;
+    for (const char *text = header.format->text; *text != '\0'; ++text)
+    {
+        if (text[0] != '{' || text[1] != '}' || argCount == 0)
+        {
+            append(*text);
+            continue;
+        }
+        ++text;
+        --argCount;
+        char value[32];
+        const char tag = *args++;
+        switch (tag)
+        {
+        case TAG_BOOL:
+            append(*args++ != 0 ? "true" : "false");
+            break;
+        case TAG_CHAR:
+            append(*args++);
+            break;
+        case TAG_INT64:
+        {
+            int64_t i;
+            args = readValue(args, i);
+            std::snprintf(value, sizeof(value), "%lld", (long long)i);
+            append(value);
+            break;
+        }
+        case TAG_UINT64:
+        {
+            uint64_t u;
+            args = readValue(args, u);
+            std::snprintf(value, sizeof(value), "%llu", (unsigned long long)u);
+            append(value);
+            break;
+        }
+        case TAG_DOUBLE:
+        {
+            double d;
+            args = readValue(args, d);
+            std::snprintf(value, sizeof(value), "%.15g", d);
+            append(value);
+            break;
+        }
+        case TAG_STRING:
+        {
+            uint32_t size;
+            args = readValue(args, size);
+            append(args, size);
+            args += size;
+            break;
+        }
+        case TAG_POINTER:
+        {
+            uint64_t u;
+            args = readValue(args, u);
+            std::snprintf(value, sizeof(value), "0x%llx", (unsigned long long)u);
+            append(value);
+            break;
+        }
+        default:
+            assert(false);
+            break;
+        }
+    }
+    append('\n');
+}
+
+void BinaryLogger::append(const char *s, size_t size) noexcept
+{
+    // at most MAX_STRING_SIZE bytes, appended without reallocation (the reserved capacity is kept by clear())
+    if (writeBuffer.size() + size > writeBuffer.capacity())
+    {
+        flush();
+    }
+    assert(writeBuffer.size() + size <= writeBuffer.capacity());
+    writeBuffer.append(s, size);
+}
+
+void BinaryLogger::flush() noexcept
+{
+    for (size_t offset = 0; offset < writeBuffer.size();)
+    {
+        const ssize_t n = ::write(fd, writeBuffer.data() + offset, writeBuffer.size() - offset);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            break; // output error: entries are lost
+        }
+        offset += (size_t)n;
+    }
+    writeBuffer.clear();
+}
+
+} // namespace tredzone
@@ -361,9 +361,10 @@ private:
     }
     void onNodeActorsDestroyed() noexcept
     {
-        if (onlyCoreAndServiceReferencedActorsLeft() &&
-            (serviceSingletonActor->getServiceActorList().empty() ||
-             (m_ShutdownFlag && !serviceSingletonActor->isServiceDestroyTimeFlag)))
+        // cheap service test first: reference tree walk is O(core and service referenced actors)
+        if ((serviceSingletonActor->getServiceActorList().empty() ||
+             (m_ShutdownFlag && !serviceSingletonActor->isServiceDestroyTimeFlag)) &&
+            onlyCoreAndServiceReferencedActorsLeft())
         {
             requestDestroy();
         }
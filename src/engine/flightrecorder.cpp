@@ -0,0 +1,272 @@
+/**
+ * @file flightrecorder.cpp
+ * @brief per-core record of the last dispatched events
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+
+#include "trz/engine/flightrecorder.h"
+
+namespace tredzone
+{
+
+const size_t FlightRecorder::CAPACITY;
+const size_t FlightRecorder::MAX_RECORDER_COUNT;
+const size_t FlightRecorder::LOOP_HISTOGRAM_SIZE;
+const int FlightRecorder::MAX_BACKTRACE_SIZE;
+const uint32_t FlightRecorder::Record::UNFINISHED;
+
+std::atomic<FlightRecorder *> FlightRecorder::registry[FlightRecorder::MAX_RECORDER_COUNT];
+std::mutex FlightRecorder::registryMutex;
+std::atomic<unsigned> FlightRecorder::registryWalkCount(0);
+
+namespace
+{
+
+const size_t LINE_BUFFER_SIZE = 256;
+
+std::atomic<int> flightRecorderSignalFd(2);
+
+// formatting without locale nor allocation (async-signal-safe)
+inline void appendString(char *&p, const char *s) noexcept
+{
+    for (; *s != '\0'; ++s, ++p)
+    {
+        *p = *s;
+    }
+}
+
+inline void appendUnsigned(char *&p, uint64_t value) noexcept
+{
+    char digits[20];
+    int n = 0;
+    do
+    {
+        digits[n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (n != 0)
+    {
+        *(p++) = digits[--n];
+    }
+}
+
+struct FdWriter
+{
+    const int fd;
+    inline FdWriter(int pfd) noexcept : fd(pfd) {}
+    inline void write(const char *buffer, size_t size) noexcept
+    {
+        while (size != 0)
+        {
+            const ssize_t n = ::write(fd, buffer, size);
+            if (n <= 0)
+            {
+                return;
+            }
+            buffer += n;
+            size -= (size_t)n;
+        }
+    }
+};
+
+struct StreamWriter
+{
+    std::ostream &os;
+    inline StreamWriter(std::ostream &pos) noexcept : os(pos) {}
+    inline void write(const char *buffer, size_t size) { os.write(buffer, (std::streamsize)size); }
+};
+
+} // namespace
+
+FlightRecorder::FlightRecorder(Actor::NodeId pnodeId, Actor::CoreId pcoreId) noexcept : nodeId(pnodeId),
+                                                                                           coreId(pcoreId),
+                                                                                           writePosition(0),
+                                                                                           loopTsc(0),
+                                                                                           threadFlag(false),
+                                                                                           thread(),
+                                                                                           backtraceSize(0)
+{
+    std::memset(records, 0, sizeof(records));
+    for (size_t i = 0; i < LOOP_HISTOGRAM_SIZE; ++i)
+    {
+        loopHistogram[i].store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < MAX_RECORDER_COUNT; ++i)
+    {
+        FlightRecorder *expected = 0;
+        if (registry[i].compare_exchange_strong(expected, this))
+        {
+            return;
+        }
+    }
+    // registry full: still recording, not dumped by dumpAll()
+}
+
+FlightRecorder::~FlightRecorder() noexcept
+{
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (size_t i = 0; i < MAX_RECORDER_COUNT; ++i)
+    {
+        FlightRecorder *expected = this;
+        if (registry[i].compare_exchange_strong(expected, 0))
+        {
+            // a signal handler walking the registry (it cannot lock registryMutex) may have loaded this recorder
+            // before it was cleared (both sequentially consistent): wait for the walks in progress to end
+            while (registryWalkCount.load() != 0)
+            {
+                threadYield();
+            }
+            return;
+        }
+    }
+}
+
+void FlightRecorder::onThreadStart() noexcept
+{
+    thread = threadCurrent();
+    loopTsc.store(getTSC(), std::memory_order_relaxed);
+    threadFlag.store(true, std::memory_order_release);
+}
+
+void FlightRecorder::onThreadStop() noexcept { threadFlag.store(false, std::memory_order_release); }
+
+uint64_t FlightRecorder::getLoopHistogram(uint64_t (&histogram)[LOOP_HISTOGRAM_SIZE]) const noexcept
+{
+    uint64_t ret = 0;
+    for (size_t i = 0; i < LOOP_HISTOGRAM_SIZE; ++i)
+    {
+        ret += (histogram[i] = loopHistogram[i].load(std::memory_order_relaxed));
+    }
+    return ret;
+}
+
+bool FlightRecorder::getLastRecord(Record &record) const noexcept
+{
+    const uint64_t position = writePosition.load(std::memory_order_acquire);
+    if (position == 0)
+    {
+        return false;
+    }
+    record = records[(position - 1) & (CAPACITY - 1)];
+    return true;
+}
+
+size_t FlightRecorder::formatHeader(char *buffer) const noexcept
+{
+    char *p = buffer;
+    appendString(p, "flight recorder of node ");
+    appendUnsigned(p, nodeId);
+    appendString(p, " (core ");
+    appendUnsigned(p, coreId);
+    appendString(p, "), ");
+    appendUnsigned(p, writePosition.load(std::memory_order_acquire));
+    appendString(p, " events dispatched, now tsc=");
+    appendUnsigned(p, getTSC());
+    appendString(p, "\n");
+    assert((size_t)(p - buffer) <= LINE_BUFFER_SIZE);
+    return (size_t)(p - buffer);
+}
+
+size_t FlightRecorder::formatRecord(char *buffer, const Record &record) const noexcept
+{
+    char *p = buffer;
+    appendString(p, "  tsc=");
+    appendUnsigned(p, record.tsc);
+    appendString(p, " event#");
+    appendUnsigned(p, record.eventClassId);
+    appendString(p, " ");
+    appendUnsigned(p, record.sourceNodeId);
+    appendString(p, ".");
+    appendUnsigned(p, record.sourceNodeActorId);
+    appendString(p, " -> ");
+    appendUnsigned(p, record.destinationNodeId);
+    appendString(p, ".");
+    appendUnsigned(p, record.destinationNodeActorId);
+    if (record.durationTsc == Record::UNFINISHED)
+    {
+        appendString(p, " unfinished\n");
+    }
+    else
+    {
+        appendString(p, " cycles=");
+        appendUnsigned(p, record.durationTsc);
+        appendString(p, "\n");
+    }
+    assert((size_t)(p - buffer) <= LINE_BUFFER_SIZE);
+    return (size_t)(p - buffer);
+}
+
+template <class _Writer> void FlightRecorder::write(_Writer &writer) const
+{
+    char buffer[LINE_BUFFER_SIZE];
+    writer.write(buffer, formatHeader(buffer));
+    const uint64_t end = writePosition.load(std::memory_order_acquire);
+    for (uint64_t position = end > CAPACITY ? end - CAPACITY : 0; position < end; ++position)
+    {
+        writer.write(buffer, formatRecord(buffer, records[position & (CAPACITY - 1)]));
+    }
+}
+
+template <class _Writer> void FlightRecorder::writeAll(_Writer &writer)
+{
+    RegistryWalkGuard registryWalkGuard;
+    for (size_t i = 0; i < MAX_RECORDER_COUNT; ++i)
+    {
+        const FlightRecorder *flightRecorder = registry[i].load(std::memory_order_acquire);
+        if (flightRecorder != 0)
+        {
+            flightRecorder->write(writer);
+        }
+    }
+}
+
+void FlightRecorder::dump(int fd) const noexcept
+{
+    FdWriter writer(fd);
+    write(writer);
+}
+
+/**
+ * throw (std::ios_base::failure)
+ */
+void FlightRecorder::dump(std::ostream &os) const
+{
+    StreamWriter writer(os);
+    write(writer);
+}
+
+void FlightRecorder::dumpAll(int fd) noexcept
+{
+    FdWriter writer(fd);
+    writeAll(writer);
+}
+
+/**
+ * throw (std::ios_base::failure)
+ */
+void FlightRecorder::dumpAll(std::ostream &os)
+{
+    StreamWriter writer(os);
+    writeAll(writer);
+}
+
+void FlightRecorder::onSignal(int) noexcept { dumpAll(flightRecorderSignalFd.load(std::memory_order_relaxed)); }
+
+bool FlightRecorder::installSignalHandler(int signalNumber, int fd) noexcept
+{
+    flightRecorderSignalFd.store(fd, std::memory_order_relaxed);
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = &onSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    return sigaction(signalNumber, &action, 0) == 0;
+}
+
+} // namespace tredzone
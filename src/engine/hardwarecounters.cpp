@@ -0,0 +1,313 @@
+/**
+ * @file hardwarecounters.cpp
+ * @brief per-core hardware performance counters attributed to actor types and event classes
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#include "trz/engine/hardwarecounters.h"
+
+namespace tredzone
+{
+
+const size_t HardwareCounters::MAX_ATTRIBUTION_COUNT;
+const size_t HardwareCounters::MAX_COUNTERS_COUNT;
+const size_t HardwareCounters::MAX_PROBE_COUNT;
+
+std::atomic<HardwareCounters *> HardwareCounters::registry[HardwareCounters::MAX_COUNTERS_COUNT];
+std::mutex HardwareCounters::registryMutex;
+
+namespace
+{
+
+const uint64_t PERF_COUNTER_CONFIGS[HardwareCounters::COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+const char *const COUNTER_NAMES[HardwareCounters::COUNTER_COUNT] = {"cycles", "instructions", "llc-misses",
+                                                                     "branch-misses"};
+
+// counts the calling thread, user-space only (allowed with perf_event_paranoid <= 2)
+int openPerfCounter(uint64_t config, int groupFd) noexcept
+{
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = groupFd == -1 ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+
+} // namespace
+
+/**
+ * throw (std::bad_alloc)
+ */
+std::string HardwareCounters::Attribution::getActorTypeName() const
+{
+    return actorType == 0 ? std::string("<other>") : cppDemangledTypeInfoName(*actorType);
+}
+
+void HardwareCounters::enable() noexcept { getEnabledFlag().store(true, std::memory_order_relaxed); }
+
+void HardwareCounters::disable() noexcept { getEnabledFlag().store(false, std::memory_order_relaxed); }
+
+HardwareCounters::HardwareCounters(Actor::NodeId pnodeId, Actor::CoreId pcoreId) noexcept
+    : nodeId(pnodeId), coreId(pcoreId), activeFlag(false), dispatchAvailableFlag(false)
+{
+    for (int i = 0; i < COUNTER_COUNT; ++i)
+    {
+        perfCounters[i].fd = -1;
+        perfCounters[i].page = 0;
+    }
+    for (size_t i = 0; i <= MAX_ATTRIBUTION_COUNT; ++i)
+    {
+        AttributionEntry &entry = attributions[i];
+        entry.actorType.store(0, std::memory_order_relaxed);
+        entry.eventClassId = 0;
+        entry.dispatchCount.store(0, std::memory_order_relaxed);
+        entry.tsc.store(0, std::memory_order_relaxed);
+        for (int j = 0; j < COUNTER_COUNT; ++j)
+        {
+            entry.counters[j].store(0, std::memory_order_relaxed);
+        }
+    }
+    for (size_t i = 0; i < MAX_COUNTERS_COUNT; ++i)
+    {
+        HardwareCounters *expected = 0;
+        if (registry[i].compare_exchange_strong(expected, this))
+        {
+            return;
+        }
+    }
+    // registry full: still counting, not in snapshot()
+}
+
+HardwareCounters::~HardwareCounters() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (size_t i = 0; i < MAX_COUNTERS_COUNT; ++i)
+        {
+            HardwareCounters *expected = this;
+            if (registry[i].compare_exchange_strong(expected, 0))
+            {
+                break;
+            }
+        }
+    }
+    closeCounters();
+}
+
+void HardwareCounters::onThreadStart() noexcept
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    bool openedFlag = true;
+    for (int i = 0; i < COUNTER_COUNT && openedFlag; ++i)
+    {
+        PerfCounter &perfCounter = perfCounters[i];
+        openedFlag = (perfCounter.fd = openPerfCounter(PERF_COUNTER_CONFIGS[i], perfCounters[0].fd)) != -1;
+        void *page = openedFlag ? mmap(0, (size_t)pageSize, PROT_READ, MAP_SHARED, perfCounter.fd, 0) : MAP_FAILED;
+        perfCounter.page = page == MAP_FAILED ? 0 : static_cast<const volatile perf_event_mmap_page *>(page);
+    }
+    if (!openedFlag)
+    {
+        closeCounters(); // counting dispatches and tsc only
+    }
+    else
+    {
+        ioctl(perfCounters[0].fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(perfCounters[0].fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#if defined(__x86_64__) || defined(__i386__)
+        dispatchAvailableFlag = true;
+        for (int i = 0; i < COUNTER_COUNT; ++i)
+        {
+            dispatchAvailableFlag = dispatchAvailableFlag && perfCounters[i].page != 0 &&
+                                    perfCounters[i].page->cap_user_rdpmc != 0;
+        }
+#endif
+    }
+    activeFlag = true;
+}
+
+void HardwareCounters::onThreadStop() noexcept
+{
+    activeFlag = false;
+    if (perfCounters[0].fd != -1)
+    {
+        ioctl(perfCounters[0].fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+void HardwareCounters::closeCounters() noexcept
+{
+    const long pageSize = sysconf(_SC_PAGESIZE);
+    dispatchAvailableFlag = false;
+    for (int i = COUNTER_COUNT - 1; i >= 0; --i)
+    {
+        PerfCounter &perfCounter = perfCounters[i];
+        if (perfCounter.page != 0)
+        {
+            munmap(const_cast<perf_event_mmap_page *>(perfCounter.page), (size_t)pageSize);
+            perfCounter.page = 0;
+        }
+        if (perfCounter.fd != -1)
+        {
+            close(perfCounter.fd);
+            perfCounter.fd = -1;
+        }
+    }
+}
+
+uint64_t HardwareCounters::readUserCounter(const volatile perf_event_mmap_page &page) noexcept
+{
+    // see perf_event_mmap_page in linux/perf_event.h
+    uint32_t sequence;
+    uint64_t count;
+    do
+    {
+        sequence = page.lock;
+        std::atomic_signal_fence(std::memory_order_acq_rel);
+        const uint32_t index = page.index;
+        count = (uint64_t)page.offset;
+#if defined(__x86_64__) || defined(__i386__)
+        if (page.cap_user_rdpmc != 0 && index != 0)
+        {
+            const int shift = 64 - page.pmc_width;
+            count += (uint64_t)((int64_t)(__builtin_ia32_rdpmc((int)index - 1) << shift) >> shift);
+        }
+#endif
+        std::atomic_signal_fence(std::memory_order_acq_rel);
+    } while (page.lock != sequence);
+    return count;
+}
+
+uint64_t HardwareCounters::readCounter(int counter) const noexcept
+{
+    uint64_t value = 0;
+    const int fd = perfCounters[counter].fd;
+    return fd != -1 && ::read(fd, &value, sizeof(value)) == (ssize_t)sizeof(value) ? value : 0;
+}
+
+size_t HardwareCounters::findAttribution(const std::type_info &actorType, Actor::EventId eventClassId) noexcept
+{
+    const size_t hash = (size_t)(reinterpret_cast<uintptr_t>(&actorType) >> 4) * 31 + eventClassId;
+    for (size_t i = 0; i < MAX_PROBE_COUNT; ++i)
+    {
+        const size_t index = (hash + i) & (MAX_ATTRIBUTION_COUNT - 1);
+        AttributionEntry &entry = attributions[index];
+        const std::type_info *entryActorType = entry.actorType.load(std::memory_order_relaxed);
+        if (entryActorType == &actorType && entry.eventClassId == eventClassId)
+        {
+            return index;
+        }
+        if (entryActorType == 0)
+        {
+            entry.eventClassId = eventClassId;
+            entry.actorType.store(&actorType, std::memory_order_release);
+            return index;
+        }
+    }
+    return MAX_ATTRIBUTION_COUNT;
+}
+
+/**
+ * throw (std::bad_alloc)
+ */
+std::vector<HardwareCounters::CoreSnapshot> HardwareCounters::snapshot()
+{
+    std::vector<CoreSnapshot> ret;
+    std::lock_guard<std::mutex> lock(registryMutex);
+    for (size_t i = 0; i < MAX_COUNTERS_COUNT; ++i)
+    {
+        const HardwareCounters *hardwareCounters = registry[i].load(std::memory_order_acquire);
+        if (hardwareCounters == 0)
+        {
+            continue;
+        }
+        ret.push_back(CoreSnapshot());
+        CoreSnapshot &coreSnapshot = ret.back();
+        coreSnapshot.nodeId = hardwareCounters->nodeId;
+        coreSnapshot.coreId = hardwareCounters->coreId;
+        coreSnapshot.availableFlag = hardwareCounters->perfCounters[0].fd != -1;
+        coreSnapshot.dispatchAvailableFlag = hardwareCounters->dispatchAvailableFlag;
+        for (int j = 0; j < COUNTER_COUNT; ++j)
+        {
+            coreSnapshot.counters[j] = hardwareCounters->readCounter(j);
+        }
+        for (size_t j = 0; j <= MAX_ATTRIBUTION_COUNT; ++j)
+        {
+            const AttributionEntry &entry = hardwareCounters->attributions[j];
+            Attribution attribution;
+            attribution.actorType = entry.actorType.load(std::memory_order_acquire);
+            attribution.dispatchCount = entry.dispatchCount.load(std::memory_order_relaxed);
+            if ((attribution.actorType == 0) != (j == MAX_ATTRIBUTION_COUNT) || attribution.dispatchCount == 0)
+            {
+                continue;
+            }
+            attribution.eventClassId = entry.eventClassId;
+            attribution.tsc = entry.tsc.load(std::memory_order_relaxed);
+            for (int k = 0; k < COUNTER_COUNT; ++k)
+            {
+                attribution.counters[k] = entry.counters[k].load(std::memory_order_relaxed);
+            }
+            coreSnapshot.attributions.push_back(attribution);
+        }
+    }
+    return ret;
+}
+
+/**
+ * throw (std::bad_alloc, std::ios_base::failure)
+ */
+void HardwareCounters::report(std::ostream &os)
+{
+    const std::vector<CoreSnapshot> coreSnapshots = snapshot();
+    for (std::vector<CoreSnapshot>::const_iterator i = coreSnapshots.begin(), endi = coreSnapshots.end(); i != endi;
+         ++i)
+    {
+        os << "node " << (unsigned)i->nodeId << " (core " << (unsigned)i->coreId << "):";
+        if (!i->availableFlag)
+        {
+            os << " hardware counters not available";
+        }
+        for (int j = 0; i->availableFlag && j < COUNTER_COUNT; ++j)
+        {
+            os << ' ' << COUNTER_NAMES[j] << '=' << i->counters[j];
+        }
+        os << '\n';
+        for (std::vector<Attribution>::const_iterator j = i->attributions.begin(), endj = i->attributions.end();
+             j != endj; ++j)
+        {
+            const double dispatchCount = (double)j->dispatchCount;
+            os << "  " << j->getActorTypeName() << " event#" << j->eventClassId << ": " << j->dispatchCount
+               << " calls, tsc/call=" << (double)j->tsc / dispatchCount;
+            if (i->dispatchAvailableFlag)
+            {
+                os << " ipc=" << (j->counters[CYCLES] == 0 ? 0. : (double)j->counters[INSTRUCTIONS] /
+                                                                      (double)j->counters[CYCLES])
+                   << " llc-misses/call=" << (double)j->counters[LLC_MISSES] / dispatchCount
+                   << " branch-misses/call=" << (double)j->counters[BRANCH_MISSES] / dispatchCount;
+            }
+            os << '\n';
+        }
+    }
+}
+
+} // namespace tredzone
@@ -0,0 +1,186 @@
+/**
+ * @file ingress.cpp
+ * @brief external-thread to actor event channel
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include "trz/engine/ingress.h"
+#include "trz/engine/internal/node.h"
+
+namespace tredzone
+{
+
+/**
+ * throw (std::bad_alloc)
+ */
+IngressChannelBase::Shared::Shared(const Actor::ActorId &pdestinationActorId, size_t capacity, size_t pslotSize,
+                                   size_t ppayloadOffset, DeliverFn pdeliverFn, DestroyFn pdestroyFn)
+    : destinationActorId(pdestinationActorId), mask(capacity - 1), slotSize(pslotSize), payloadOffset(ppayloadOffset),
+      deliverFn(pdeliverFn), destroyFn(pdestroyFn),
+      slots(static_cast<char *>(alignMalloc(CACHE_LINE_SIZE, capacity * pslotSize))), nextRegistered(0),
+      referenceCount(2), closedFlag(false), enqueuePosition(0), dequeuePosition(0)
+{
+    assert(capacity >= 2 && (capacity & mask) == 0);
+    if (slots == 0)
+    {
+        throw std::bad_alloc();
+    }
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        new (&sequenceAt(i)) Sequence(i);
+    }
+}
+
+IngressChannelBase::Shared::~Shared() noexcept
+{
+    for (; !empty(); ++dequeuePosition)
+    {
+        (*destroyFn)(payloadAt(dequeuePosition));
+    }
+    for (size_t i = 0; i <= mask; ++i)
+    {
+        sequenceAt(i).~Sequence();
+    }
+    alignFree(CACHE_LINE_SIZE, slots);
+}
+
+/**
+ * @brief Delivers at most one ring-length of published entries (a busy producer cannot starve the event-loop).
+ * @return number of drained entries.
+ */
+size_t IngressChannelBase::Shared::drain(AsyncNode &asyncNode) noexcept
+{
+    size_t n = 0;
+    for (; n <= mask && !empty(); ++n, ++dequeuePosition)
+    {
+        void *payload = payloadAt(dequeuePosition);
+        try
+        {
+            (*deliverFn)(*this, payload, asyncNode);
+        }
+        catch (...)
+        {
+            // no source actor to notify: the entry is dropped
+        }
+        (*destroyFn)(payload);
+        sequenceAt(dequeuePosition).store(dequeuePosition + mask + 1, std::memory_order_release);
+    }
+    return n;
+}
+
+void IngressChannelBase::Shared::release() noexcept
+{
+    if (referenceCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    {
+        delete this;
+    }
+}
+
+/**
+ * throw (std::bad_alloc, InvalidDestinationException)
+ */
+IngressChannelBase::IngressChannelBase(Engine &engine, const Actor::ActorId &destinationActorId, size_t capacity,
+                                       size_t slotSize, size_t payloadOffset, Shared::DeliverFn deliverFn,
+                                       Shared::DestroyFn destroyFn)
+    : shared(newShared(engine, destinationActorId, capacity, slotSize, payloadOffset, deliverFn, destroyFn))
+{
+    std::atomic<Shared *> &registrationHead =
+        engine.nodeManager->nodesHandle.getNodeHandle(destinationActorId.getNodeId()).ingressRegistrationHead;
+    Shared *head = registrationHead.load(std::memory_order_relaxed);
+    do
+    {
+        shared->nextRegistered = head;
+    } while (!registrationHead.compare_exchange_weak(head, shared, std::memory_order_release,
+                                                     std::memory_order_relaxed));
+}
+
+IngressChannelBase::~IngressChannelBase() noexcept
+{
+    shared->closedFlag.store(true, std::memory_order_release);
+    shared->release();
+}
+
+/**
+ * throw (std::bad_alloc, InvalidDestinationException)
+ */
+IngressChannelBase::Shared *IngressChannelBase::newShared(Engine &engine, const Actor::ActorId &destinationActorId,
+                                                          size_t capacity, size_t slotSize, size_t payloadOffset,
+                                                          Shared::DeliverFn deliverFn, Shared::DestroyFn destroyFn)
+{
+    if (!destinationActorId.isInProcess() || destinationActorId.getNodeActorId() == 0 ||
+        destinationActorId.getNodeId() >= engine.nodeManager->size())
+    {
+        throw InvalidDestinationException();
+    }
+    size_t roundedCapacity = 2;
+    for (; roundedCapacity < capacity; roundedCapacity *= 2)
+    {
+    }
+    return new Shared(destinationActorId, roundedCapacity, slotSize, payloadOffset, deliverFn, destroyFn);
+}
+
+/**
+ * throw (std::bad_alloc)
+ */
+void *IngressChannelBase::allocateEvent(AsyncNode &asyncNode, size_t sz)
+{
+    return asyncNode.getReferenceToWriterShared(asyncNode.id).writeCache.allocateEvent(sz);
+}
+
+void IngressChannelBase::pushEvent(AsyncNode &asyncNode, Actor::Event &event) noexcept
+{
+    asyncNode.getReferenceToWriterShared(asyncNode.id).writeCache.toBeDeliveredEventChain.push_back(&event);
+    asyncNode.setWriteSignal(asyncNode.id);
+}
+
+const Actor::ActorId &IngressChannelBase::getSourceActorId(AsyncNode &asyncNode) noexcept
+{
+    return asyncNode.ingressSourceActorId;
+}
+
+/**
+ * @brief Adopts newly registered ingress channels, drains them, and releases the closed ones.
+ */
+void AsyncNode::synchronizeIngressChannels() noexcept
+{
+    for (IngressChannelBase::Shared *registered =
+             nodeHandle.ingressRegistrationHead.exchange(0, std::memory_order_acquire);
+         registered != 0;)
+    {
+        IngressChannelBase::Shared *next = registered->nextRegistered;
+        registered->nextRegistered = ingressChannelChain;
+        ingressChannelChain = registered;
+        registered = next;
+    }
+    if (ingressEventTable == 0 && ingressChannelChain != 0)
+    {
+        // synthetic source actor: its event-table never matches the actor-id, so undelivered events are dropped
+        char *deallocatePointer =
+            static_cast<char *>(nodeAllocator.allocate(sizeof(Actor::EventTable) + CACHE_LINE_SIZE - 1));
+        ingressEventTable = new (CacheLineAlignedBuffer::cacheLineAlignedPointer(deallocatePointer))
+            Actor::EventTable(deallocatePointer);
+        ingressSourceActorId = Actor::ActorId(id, IngressChannelBase::INGRESS_SOURCE_NODE_ACTOR_ID, ingressEventTable);
+    }
+    for (IngressChannelBase::Shared **i = &ingressChannelChain; *i != 0;)
+    {
+        IngressChannelBase::Shared &shared = **i;
+        // read before draining: entries pushed before closing are delivered
+        const bool closedFlag = shared.closedFlag.load(std::memory_order_acquire);
+        if (shared.drain(*this) != 0)
+        {
+            loopUsagePerformanceCounterIncrement = 1;
+        }
+        if (closedFlag && shared.empty())
+        {
+            *i = shared.nextRegistered;
+            shared.release();
+        }
+        else
+        {
+            i = &shared.nextRegistered;
+        }
+    }
+}
+
+} // namespace tredzone
@@ -0,0 +1,376 @@
+/**
+ * @file latencytracker.cpp
+ * @brief end-to-end causal latency tracking across actor hops
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <thread>
+
+#include "trz/engine/latencytracker.h"
+
+namespace tredzone
+{
+
+const size_t LatencyTracker::DEFAULT_RING_CAPACITY;
+
+namespace
+{
+
+std::atomic<uint32_t> latencySamplingPeriod(1);
+std::atomic<uint32_t> latencyNextTraceId(1);
+std::atomic<size_t> latencyRingCapacity(LatencyTracker::DEFAULT_RING_CAPACITY);
+std::atomic<void *> latencyRingHead(0); // LatencyTracker::Ring chain, released at exit (see LatencyRingReleaser)
+std::atomic<uint64_t> latencyEnableTsc(0);
+std::atomic<int64_t> latencyEnableNanoseconds(0);
+
+thread_local uint32_t threadOriginCount = 0;
+
+const int64_t CALIBRATION_NANOSECONDS = 10000000;
+
+int64_t steadyNanoseconds() noexcept
+{
+    return (int64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// measured since enable(), waiting if not long enough ago
+double calibrateTscPerMicrosecond() noexcept
+{
+    const int64_t elapsedNanoseconds = steadyNanoseconds() - latencyEnableNanoseconds.load(std::memory_order_relaxed);
+    if (elapsedNanoseconds < CALIBRATION_NANOSECONDS)
+    {
+        std::this_thread::sleep_for(std::chrono::nanoseconds(CALIBRATION_NANOSECONDS - elapsedNanoseconds));
+    }
+    const uint64_t tsc = getTSC();
+    const int64_t nanoseconds = steadyNanoseconds();
+    const uint64_t enableTsc = latencyEnableTsc.load(std::memory_order_relaxed);
+    const int64_t enableNanoseconds = latencyEnableNanoseconds.load(std::memory_order_relaxed);
+    return nanoseconds > enableNanoseconds && tsc > enableTsc
+               ? (double)(tsc - enableTsc) * 1000. / (double)(nanoseconds - enableNanoseconds)
+               : 1.;
+}
+
+struct HopPushTscLess
+{
+    inline bool operator()(const LatencyTracker::Hop &hop, const LatencyTracker::Hop &other) const noexcept
+    {
+        return hop.originFlag != other.originFlag ? hop.originFlag : hop.pushTsc < other.pushTsc;
+    }
+};
+
+struct PathAccumulator
+{
+    uint64_t traceCount;
+    uint64_t endToEndTscSum;
+    uint64_t endToEndTscMax;
+    std::vector<const LatencyTracker::Hop *> firstHops;
+    std::vector<uint64_t> queueTscSums;
+    std::vector<uint64_t> waitTscSums;
+    std::vector<uint64_t> handlerTscSums;
+    inline PathAccumulator() noexcept : traceCount(0), endToEndTscSum(0), endToEndTscMax(0) {}
+};
+
+struct PathStatsTraceCountGreater
+{
+    inline bool operator()(const LatencyTracker::PathStats &pathStats,
+                           const LatencyTracker::PathStats &other) const noexcept
+    {
+        return pathStats.traceCount > other.traceCount;
+    }
+};
+
+} // namespace
+
+LatencyTracker::RingReleaser LatencyTracker::ringReleaser; // destroyed before latencyRingHead (defined above)
+
+LatencyTracker::RingReleaser::~RingReleaser() noexcept
+{
+    // at exit: the rings of threads still running are left alone
+    Ring *ring = static_cast<Ring *>(latencyRingHead.exchange(0, std::memory_order_acquire));
+    Ring *inUseHead = 0;
+    while (ring != 0)
+    {
+        Ring *next = ring->next;
+        if (ring->inUseFlag.load(std::memory_order_acquire))
+        {
+            ring->next = inUseHead;
+            inUseHead = ring;
+        }
+        else
+        {
+            delete[] ring->hops;
+            delete ring;
+        }
+        ring = next;
+    }
+    latencyRingHead.store(inUseHead, std::memory_order_release);
+}
+
+LatencyTracker::TraceScope::TraceScope() noexcept : previousTraceId(Actor::EventBase::currentTraceId())
+{
+    if (previousTraceId == 0 && isEnabled() &&
+        ++threadOriginCount % latencySamplingPeriod.load(std::memory_order_relaxed) == 0)
+    {
+        uint32_t traceId = latencyNextTraceId.fetch_add(1, std::memory_order_relaxed);
+        if (traceId == 0)
+        {
+            traceId = latencyNextTraceId.fetch_add(1, std::memory_order_relaxed);
+        }
+        Actor::EventBase::currentTraceId() = traceId;
+        recordOrigin(traceId, getTSC());
+    }
+}
+
+LatencyTracker::TraceScope::~TraceScope() noexcept { Actor::EventBase::currentTraceId() = previousTraceId; }
+
+void LatencyTracker::enable(uint32_t samplingPeriod) noexcept
+{
+    latencySamplingPeriod.store(samplingPeriod == 0 ? 1 : samplingPeriod, std::memory_order_relaxed);
+    latencyEnableTsc.store(getTSC(), std::memory_order_relaxed);
+    latencyEnableNanoseconds.store(steadyNanoseconds(), std::memory_order_relaxed);
+    getEnabledFlag().store(true, std::memory_order_relaxed);
+}
+
+void LatencyTracker::disable() noexcept { getEnabledFlag().store(false, std::memory_order_relaxed); }
+
+void LatencyTracker::setRingCapacity(size_t hopCount) noexcept
+{
+    size_t capacity = 2;
+    for (; capacity < hopCount; capacity *= 2)
+    {
+    }
+    latencyRingCapacity.store(capacity, std::memory_order_relaxed);
+}
+
+void LatencyTracker::clear() noexcept
+{
+    for (Ring *ring = static_cast<Ring *>(latencyRingHead.load(std::memory_order_acquire)); ring != 0;
+         ring = ring->next)
+    {
+        ring->clearPosition.store(ring->writePosition.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+}
+
+void LatencyTracker::onThreadStart() noexcept
+{
+    if (isAvailable() && getThreadRing() == 0)
+    {
+        acquireThreadRing();
+    }
+}
+
+void LatencyTracker::onThreadStop() noexcept
+{
+    Ring *ring = getThreadRing();
+    if (ring != 0)
+    {
+        ring->inUseFlag.store(false, std::memory_order_release);
+        getThreadRing() = 0;
+    }
+}
+
+LatencyTracker::Ring *LatencyTracker::acquireThreadRing() noexcept
+{
+    const size_t capacity = latencyRingCapacity.load(std::memory_order_relaxed);
+    for (Ring *ring = static_cast<Ring *>(latencyRingHead.load(std::memory_order_acquire)); ring != 0;
+         ring = ring->next)
+    {
+        bool inUseFlag = false;
+        if (ring->mask + 1 == capacity &&
+            ring->inUseFlag.compare_exchange_strong(inUseFlag, true, std::memory_order_acquire))
+        {
+            return getThreadRing() = ring;
+        }
+    }
+    Ring *ring = new (std::nothrow) Ring;
+    if (ring == 0)
+    {
+        return 0;
+    }
+    if ((ring->hops = new (std::nothrow) Hop[capacity]) == 0)
+    {
+        delete ring;
+        return 0;
+    }
+    ring->mask = capacity - 1;
+    ring->clearPosition.store(0, std::memory_order_relaxed);
+    ring->writePosition.store(0, std::memory_order_relaxed);
+    ring->inUseFlag.store(true, std::memory_order_relaxed);
+    void *head = latencyRingHead.load(std::memory_order_relaxed);
+    do
+    {
+        ring->next = static_cast<Ring *>(head);
+    } while (!latencyRingHead.compare_exchange_weak(head, ring, std::memory_order_release, std::memory_order_relaxed));
+    return getThreadRing() = ring;
+}
+
+LatencyTracker::Hop *LatencyTracker::nextHop() noexcept
+{
+    Ring *ring = getThreadRing();
+    if (ring == 0 && (ring = acquireThreadRing()) == 0)
+    {
+        return 0;
+    }
+    return &ring->hops[ring->writePosition.load(std::memory_order_relaxed) & ring->mask];
+}
+
+void LatencyTracker::recordHop(const Actor::Event &event, uint64_t pickupTsc, uint64_t startTsc,
+                               uint64_t endTsc) noexcept
+{
+    Hop *hop = nextHop();
+    if (hop == 0)
+    {
+        return;
+    }
+#if defined(TREDZONE_LATENCY_TRACKER) && TREDZONE_LATENCY_TRACKER
+    // only the low 32 bits of the push TSC travel with the event (hop shorter than 2^32 cycles)
+    hop->pushTsc = startTsc - (uint32_t)((uint32_t)startTsc - event.tracePushTsc);
+#else
+    hop->pushTsc = startTsc; // not reached: events carry no trace
+#endif
+    hop->pickupTsc = pickupTsc == 0 || pickupTsc > startTsc ? startTsc : std::max(pickupTsc, hop->pushTsc);
+    hop->startTsc = startTsc;
+    hop->endTsc = endTsc;
+    hop->traceId = event.getTraceId();
+    hop->sourceNodeActorId = event.getSourceInProcessActorId().getNodeActorId();
+    hop->destinationNodeActorId = event.getDestinationInProcessActorId().getNodeActorId();
+    hop->eventClassId = event.getClassId();
+    hop->sourceNodeId = event.getSourceInProcessActorId().getNodeId();
+    hop->destinationNodeId = event.getDestinationInProcessActorId().getNodeId();
+    hop->originFlag = false;
+    Ring &ring = *getThreadRing();
+    ring.writePosition.store(ring.writePosition.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void LatencyTracker::recordOrigin(uint32_t traceId, uint64_t tsc) noexcept
+{
+    Hop *hop = nextHop();
+    if (hop == 0)
+    {
+        return;
+    }
+    hop->pushTsc = hop->pickupTsc = hop->startTsc = hop->endTsc = tsc;
+    hop->traceId = traceId;
+    hop->sourceNodeActorId = hop->destinationNodeActorId = 0;
+    hop->eventClassId = 0;
+    hop->sourceNodeId = hop->destinationNodeId = 0;
+    hop->originFlag = true;
+    Ring &ring = *getThreadRing();
+    ring.writePosition.store(ring.writePosition.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+/**
+ * throw (std::bad_alloc)
+ */
+std::vector<LatencyTracker::PathStats> LatencyTracker::aggregate()
+{
+    const double tscPerMicrosecond = calibrateTscPerMicrosecond();
+    typedef std::map<uint32_t, std::vector<Hop>> TraceMap;
+    TraceMap traces;
+    for (const Ring *ring = static_cast<const Ring *>(latencyRingHead.load(std::memory_order_acquire)); ring != 0;
+         ring = ring->next)
+    {
+        const uint64_t end = ring->writePosition.load(std::memory_order_acquire);
+        const uint64_t begin = std::max(end > ring->mask + 1 ? end - (ring->mask + 1) : 0,
+                                        ring->clearPosition.load(std::memory_order_relaxed));
+        for (uint64_t position = begin; position < end; ++position)
+        {
+            const Hop &hop = ring->hops[position & ring->mask];
+            traces[hop.traceId].push_back(hop);
+        }
+    }
+
+    typedef std::map<std::string, PathAccumulator> PathMap;
+    PathMap paths;
+    for (TraceMap::iterator i = traces.begin(), endi = traces.end(); i != endi; ++i)
+    {
+        std::vector<Hop> &hops = i->second;
+        std::sort(hops.begin(), hops.end(), HopPushTscLess());
+        if (hops.size() < 2 || !hops.front().originFlag || hops[1].originFlag)
+        {
+            continue; // origin overwritten (or cleared), or no hop yet
+        }
+        std::ostringstream path;
+        uint64_t endTsc = hops.front().endTsc;
+        for (size_t j = 1; j < hops.size(); ++j)
+        {
+            path << (j == 1 ? "" : " > ") << "event#" << hops[j].eventClassId << '@'
+                 << (unsigned)hops[j].destinationNodeId;
+            endTsc = std::max(endTsc, hops[j].endTsc);
+        }
+        PathAccumulator &accumulator = paths[path.str()];
+        if (accumulator.traceCount++ == 0)
+        {
+            accumulator.queueTscSums.resize(hops.size() - 1, 0);
+            accumulator.waitTscSums.resize(hops.size() - 1, 0);
+            accumulator.handlerTscSums.resize(hops.size() - 1, 0);
+            for (size_t j = 1; j < hops.size(); ++j)
+            {
+                accumulator.firstHops.push_back(&hops[j]);
+            }
+        }
+        const uint64_t endToEndTsc = endTsc - hops.front().pushTsc;
+        accumulator.endToEndTscSum += endToEndTsc;
+        accumulator.endToEndTscMax = std::max(accumulator.endToEndTscMax, endToEndTsc);
+        for (size_t j = 1; j < hops.size(); ++j)
+        {
+            accumulator.queueTscSums[j - 1] += hops[j].pickupTsc - hops[j].pushTsc;
+            accumulator.waitTscSums[j - 1] += hops[j].startTsc - hops[j].pickupTsc;
+            accumulator.handlerTscSums[j - 1] += hops[j].endTsc - hops[j].startTsc;
+        }
+    }
+
+    std::vector<PathStats> ret;
+    ret.reserve(paths.size());
+    for (PathMap::const_iterator i = paths.begin(), endi = paths.end(); i != endi; ++i)
+    {
+        const PathAccumulator &accumulator = i->second;
+        const double divisor = tscPerMicrosecond * (double)accumulator.traceCount;
+        ret.push_back(PathStats());
+        PathStats &pathStats = ret.back();
+        pathStats.path = i->first;
+        pathStats.traceCount = accumulator.traceCount;
+        pathStats.meanEndToEndMicroseconds = (double)accumulator.endToEndTscSum / divisor;
+        pathStats.maxEndToEndMicroseconds = (double)accumulator.endToEndTscMax / tscPerMicrosecond;
+        for (size_t j = 0; j < accumulator.firstHops.size(); ++j)
+        {
+            HopStats hopStats;
+            hopStats.eventClassId = accumulator.firstHops[j]->eventClassId;
+            hopStats.destinationNodeId = accumulator.firstHops[j]->destinationNodeId;
+            hopStats.queueMicroseconds = (double)accumulator.queueTscSums[j] / divisor;
+            hopStats.waitMicroseconds = (double)accumulator.waitTscSums[j] / divisor;
+            hopStats.handlerMicroseconds = (double)accumulator.handlerTscSums[j] / divisor;
+            pathStats.hops.push_back(hopStats);
+        }
+    }
+    std::stable_sort(ret.begin(), ret.end(), PathStatsTraceCountGreater());
+    return ret;
+}
+
+/**
+ * throw (std::bad_alloc, std::ios_base::failure)
+ */
+void LatencyTracker::report(std::ostream &os)
+{
+    const std::vector<PathStats> pathStats = aggregate();
+    for (std::vector<PathStats>::const_iterator i = pathStats.begin(), endi = pathStats.end(); i != endi; ++i)
+    {
+        os << i->path << ": " << i->traceCount << " traces, end-to-end mean " << i->meanEndToEndMicroseconds
+           << " us, max " << i->maxEndToEndMicroseconds << " us\n";
+        for (std::vector<HopStats>::const_iterator j = i->hops.begin(), endj = i->hops.end(); j != endj; ++j)
+        {
+            os << "  event#" << j->eventClassId << '@' << (unsigned)j->destinationNodeId << ": queue "
+               << j->queueMicroseconds << " us, wait " << j->waitMicroseconds << " us, handler "
+               << j->handlerMicroseconds << " us\n";
+        }
+    }
+}
+
+} // namespace tredzone
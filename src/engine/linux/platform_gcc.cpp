@@ -6,6 +6,7 @@
  */
 
 #include <cassert>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <vector>
@@ -36,19 +37,28 @@ vector<string> tredzone::debugBacktrace(const uint8_t stackTraceSize) noexcept
 {
     // void *buffer[stackTraceSize];						// variable length array is VERBOTEN!
     vector<void *> buffer(stackTraceSize, nullptr);
+
+    int32_t returnedStackTraceSize = backtrace(&buffer[0], stackTraceSize);
+    assert(returnedStackTraceSize != 0);
+    
+    return debugBacktrace(&buffer[0], returnedStackTraceSize);
+}
+
+vector<string> tredzone::debugBacktrace(void *const *addresses, int size) noexcept
+{
     char **trace;
     vector<string> ret;
 
     try
     {
-        int32_t returnedStackTraceSize = backtrace(&buffer[0], stackTraceSize);
-        assert(returnedStackTraceSize != 0);
-        
-        trace = backtrace_symbols(&buffer[0], returnedStackTraceSize);
-        assert(trace != 0);
+        trace = backtrace_symbols(addresses, size);
+        if (trace == 0)
+        {
+            return ret;
+        }
 
-        ret.reserve(stackTraceSize);
-        for (int32_t j = 0; j < returnedStackTraceSize; ++j)
+        ret.reserve(size);
+        for (int32_t j = 0; j < size; ++j)
         {
             ret.push_back(demangleFromSymbolName(trace[j]));
         }
@@ -139,6 +149,24 @@ vector<string> tredzone::debugBacktrace(const uint8_t) noexcept
     return {""};
 }
 
+vector<string> tredzone::debugBacktrace(void *const *addresses, int size) noexcept
+{
+    vector<string> ret;
+    try
+    {
+        for (int j = 0; j < size; ++j)
+        {
+            char address[2 + 2 * sizeof(void *) + 1];
+            snprintf(address, sizeof(address), "%p", addresses[j]);
+            ret.push_back(address);
+        }
+    }
+    catch (...)
+    {
+    }
+    return ret;
+}
+
 #endif
 
 
@@ -0,0 +1,135 @@
+/**
+ * @file localpipe.cpp
+ * @brief synchronous same-core event pipe
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include "trz/engine/latencytracker.h"
+#include "trz/engine/localpipe.h"
+#include "trz/engine/internal/node.h"
+
+namespace tredzone
+{
+
+const unsigned LocalPipeBase::MAX_RECURSION_DEPTH;
+
+/**
+ * throw (InvalidDestinationException)
+ */
+LocalPipeBase::LocalPipeBase(Actor &psourceActor, const Actor::ActorId &pdestinationActorId)
+    : sourceActor(psourceActor), asyncNode(*psourceActor.getAsyncNode()), destinationActorId(pdestinationActorId)
+{
+    if (!destinationActorId.isInProcess() || destinationActorId.getNodeActorId() == 0 ||
+        destinationActorId.getNodeId() != asyncNode.id)
+    {
+        throw InvalidDestinationException();
+    }
+}
+
+bool LocalPipeBase::isSynchronous(const AsyncNode &asyncNode) noexcept
+{
+    return asyncNode.localPipeDepth < MAX_RECURSION_DEPTH && asyncNode.localPipeQueueHead == 0;
+}
+
+void LocalPipeBase::enter(AsyncNode &asyncNode) noexcept
+{
+    assert(asyncNode.localPipeDepth < MAX_RECURSION_DEPTH);
+    ++asyncNode.localPipeDepth;
+}
+
+void LocalPipeBase::leave(AsyncNode &asyncNode) noexcept
+{
+    assert(asyncNode.localPipeDepth > 0);
+    if (asyncNode.localPipeDepth == 1)
+    {
+        // outermost delivery: drain the run queue (entries pushed while draining are appended)
+        while (asyncNode.localPipeQueueHead != 0)
+        {
+            QueuedEvent &queuedEvent = *asyncNode.localPipeQueueHead;
+            if ((asyncNode.localPipeQueueHead = queuedEvent.next) == 0)
+            {
+                asyncNode.localPipeQueueTail = 0;
+            }
+            deliver(asyncNode, *queuedEvent.event);
+            (*queuedEvent.destroyFn)(queuedEvent);
+        }
+    }
+    --asyncNode.localPipeDepth;
+}
+
+void LocalPipeBase::enqueue(AsyncNode &asyncNode, QueuedEvent &queuedEvent) noexcept
+{
+    assert(asyncNode.localPipeDepth > 0);
+    assert(queuedEvent.next == 0);
+    if (asyncNode.localPipeQueueTail == 0)
+    {
+        asyncNode.localPipeQueueHead = &queuedEvent;
+    }
+    else
+    {
+        asyncNode.localPipeQueueTail->next = &queuedEvent;
+    }
+    asyncNode.localPipeQueueTail = &queuedEvent;
+}
+
+void LocalPipeBase::deliver(AsyncNode &asyncNode, const Actor::Event &event) noexcept
+{
+    const Actor::InProcessActorId &destinationActorId = event.getDestinationInProcessActorId();
+    const Actor::EventTable &destinationEventTable = *destinationActorId.eventTable;
+    if (destinationActorId.getNodeActorId() == destinationEventTable.nodeActorId)
+    {
+        LatencyTracker::DispatchScope latencyScope(event, 0);
+        try
+        {
+            if (destinationEventTable.onEvent(event, asyncNode.corePerformanceCounters.onEventCount))
+            {
+                return;
+            }
+        }
+        catch (Actor::ReturnToSenderException &)
+        {
+        }
+        catch (std::exception &e)
+        {
+            assert(destinationEventTable.asyncActor != 0);
+            asyncNode.nodeManager.exceptionHandler.onEventExceptionSynchronous(
+                destinationEventTable.asyncActor, typeid(*destinationEventTable.asyncActor), "onEvent", event,
+                e.what());
+            return;
+        }
+        catch (...)
+        {
+            assert(destinationEventTable.asyncActor != 0);
+            asyncNode.nodeManager.exceptionHandler.onEventExceptionSynchronous(
+                destinationEventTable.asyncActor, typeid(*destinationEventTable.asyncActor), "onEvent", event,
+                "unknown exception");
+            return;
+        }
+    }
+    const Actor::InProcessActorId &sourceActorId = event.getSourceInProcessActorId();
+    const Actor::EventTable &sourceEventTable = *sourceActorId.eventTable;
+    if (sourceActorId.getNodeActorId() == sourceEventTable.nodeActorId)
+    {
+        try
+        {
+            sourceEventTable.onUndeliveredEvent(event);
+        }
+        catch (std::exception &e)
+        {
+            assert(sourceEventTable.asyncActor != 0);
+            asyncNode.nodeManager.exceptionHandler.onEventExceptionSynchronous(
+                sourceEventTable.asyncActor, typeid(*sourceEventTable.asyncActor), "onUndeliveredEvent", event,
+                e.what());
+        }
+        catch (...)
+        {
+            assert(sourceEventTable.asyncActor != 0);
+            asyncNode.nodeManager.exceptionHandler.onEventExceptionSynchronous(
+                sourceEventTable.asyncActor, typeid(*sourceEventTable.asyncActor), "onUndeliveredEvent", event,
+                "unknown exception");
+        }
+    }
+}
+
+} // namespace tredzone
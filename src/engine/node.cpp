@@ -9,6 +9,7 @@
 #include <fstream>
 
 #include "trz/engine/internal/node.h"
+#include "trz/engine/latencytracker.h"
 
 using namespace std;
 
@@ -79,7 +80,15 @@ bool Actor::EventTable::onLowFrequencyEvent(const Event &event, uint64_t &perfor
     }
     ++performanceCounter;
     assert(lfEvent[i].staticEventHandler != 0);
-    return (*lfEvent[i].staticEventHandler)(lfEvent[i].eventHandler, event);
+    HardwareCounters::Dispatch hardwareDispatch;
+    asyncActor->asyncNode->hardwareCounters.onDispatchBegin(hardwareDispatch, *asyncActor, lfEvent[i].eventId);
+    FlightRecorder::Record &flightRecord = asyncActor->asyncNode->flightRecorder.onDispatchBegin(event);
+    probeDispatchEnter(event);
+    bool ret = (*lfEvent[i].staticEventHandler)(lfEvent[i].eventHandler, event);
+    probeDispatchExit(event);
+    FlightRecorder::onDispatchEnd(flightRecord);
+    asyncActor->asyncNode->hardwareCounters.onDispatchEnd(hardwareDispatch);
+    return ret;
 }
 
 size_t Actor::EventTable::lfRegisteredEventArraySize(RegisteredEvent *registeredEvent) noexcept
@@ -296,7 +305,8 @@ AsyncNodesHandle::Shared::Shared(size_t eventAllocatorPageSize) : writeCache(eve
  */
 AsyncNodesHandle::NodeHandle::NodeHandle(const std::pair<AsyncNodesHandle *, const CoreSet *> &init)
     : readerSharedHandles(init.first->size), writerSharedHandles(init.first->size, init.first->eventAllocatorPageSize),
-      node(0), nextHanlerId(1), stopFlag(false), shutdownFlag(false), interruptFlag(true), coreSet(*init.second)
+      node(0), nextHanlerId(1), stopFlag(false), shutdownFlag(false), interruptFlag(true), coreSet(*init.second),
+      ingressRegistrationHead(0)
 #ifndef NDEBUG
       ,
       debugNodePtrWasSet(false)
@@ -309,6 +319,12 @@ AsyncNodesHandle::NodeHandle::~NodeHandle() noexcept
 {
     // assert(node == 0); // Silenced as to much defensive - typically over-stepping a failure in the thread preventing
     // call to delete node (required to comply with this assert) in AsyncNode::Thread::inThread()
+    for (IngressChannelBase::Shared *i = ingressRegistrationHead.exchange(0); i != 0;)
+    {
+        IngressChannelBase::Shared *tmp = i;
+        i = i->nextRegistered;
+        tmp->release();
+    }
 }
 
 void AsyncNodesHandle::WriterSharedHandle::writeFailed() noexcept
@@ -567,6 +583,8 @@ void AsyncNodeBase::StaticShared::AbsoluteEventIds::debugCheckMaps() const
           AsyncNodeManager::Node(init.nodeManager, init.nodeManager.getCoreSet().index(init.coreId)),
         eventLoop(init.customEventLoopFactory.newEventLoop()),
         corePerformanceCounters(Actor::AllocatorBase(*this), getCoreSet().size()),
+        ingressChannelChain(0), ingressEventTable(0), localPipeDepth(0), localPipeQueueHead(0),
+        localPipeQueueTail(0), flightRecorder(id, init.coreId), hardwareCounters(id, init.coreId),
         
 #ifndef NDEBUG
         debugSynchronizePostBarrierFlag(false),
@@ -600,6 +618,18 @@ catch (AsyncNodeManager::NodeInUseException &)
     assert(!debugSynchronizePostBarrierFlag);
     nodeHandle.getWriterSharedHandle(id).cl2.shared.writeCache.freeEventAllocatorPageChain.push_back(
         usedlocalEventAllocatorPageChain);
+    while (ingressChannelChain != 0)
+    {
+        IngressChannelBase::Shared *tmp = ingressChannelChain;
+        ingressChannelChain = tmp->nextRegistered;
+        tmp->release();
+    }
+    if (ingressEventTable != 0)
+    {
+        void *deallocatePointer = ingressEventTable->deallocatePointer;
+        ingressEventTable->~EventTable();
+        nodeAllocator.deallocate(sizeof(Actor::EventTable) + CACHE_LINE_SIZE - 1, deallocatePointer);
+    }
         
     #ifdef TRACE_REF
         std::ofstream refLogFile;
@@ -733,6 +763,7 @@ void AsyncNode::Thread::run(CacheLineAlignedObject<AsyncNode> &node) noexcept
 
 void AsyncNode::Thread::inThread(void *pthread)
 {
+    const FlightRecorder *flightRecorder = 0;
     try
     {
         std::pair<StartHook, void *> startHook(0, 0);
@@ -740,6 +771,7 @@ void AsyncNode::Thread::inThread(void *pthread)
         CacheLineAlignedObject<AsyncNode> *node = 0;
         const bool redZoneFlag = static_cast<Thread *>(pthread)->redZoneFlag;
         const ThreadRealTimeParam redZoneParam = static_cast<Thread *>(pthread)->redZoneParam;
+        const Actor::CoreId coreId = static_cast<Thread *>(pthread)->coreId;
         {
             Thread &thread = *static_cast<Thread *>(pthread);
             startHook = thread.getStartHook();
@@ -813,6 +845,11 @@ void AsyncNode::Thread::inThread(void *pthread)
         }
 
         AsyncNode &asyncNode = **node;
+        asyncNode.flightRecorder.onThreadStart();
+        asyncNode.hardwareCounters.onThreadStart();
+        LatencyTracker::onThreadStart();
+        AllocationGuard::onThreadStart(asyncNode.id, coreId);
+        flightRecorder = &asyncNode.flightRecorder;
 #ifndef NDEBUG
         asyncNode.nodeAllocator.debugThreadId = ThreadId::current();
 #endif
@@ -824,6 +861,11 @@ void AsyncNode::Thread::inThread(void *pthread)
         asyncNode.eventLoop->preRun();
         asyncNode.eventLoop->run();
         asyncNode.eventLoop->postRun();
+        AllocationGuard::onThreadStop();
+        LatencyTracker::onThreadStop();
+        asyncNode.hardwareCounters.onThreadStop();
+        asyncNode.flightRecorder.onThreadStop();
+        flightRecorder = 0;
         delete node;
 
         if (stopHook != 0)
@@ -840,6 +882,10 @@ void AsyncNode::Thread::inThread(void *pthread)
         catch (...)
         {
         }
+        if (flightRecorder != 0)
+        {
+            flightRecorder->dump(2);
+        }
         exit(-2);
     }
     catch (...)
@@ -851,6 +897,10 @@ void AsyncNode::Thread::inThread(void *pthread)
         catch (...)
         {
         }
+        if (flightRecorder != 0)
+        {
+            flightRecorder->dump(2);
+        }
         exit(-2);
     }
 }
@@ -984,7 +1034,12 @@ void AsyncNodesHandle::ReaderSharedHandle::read(void) noexcept
     {   // flag will be falsed by next peer write
         node.setWriteSignal(sharedReadWriteLocked.writerNodeId);
     }
+    if (TREDZONE_PROBE_ENABLED(batch_read))
+    {
+        TREDZONE_PROBE2(batch_read, node.id, sharedReadWriteLocked.writerNodeId);
+    }
     
+    const uint64_t latencyPickupTsc = LatencyTracker::isEnabled() ? getTSC() : 0;
     for (EventChain::iterator i = sharedReadWriteLocked.toBeDeliveredEventChain.begin(), endi = sharedReadWriteLocked.toBeDeliveredEventChain.end(); i != endi; node.loopUsagePerformanceCounterIncrement = 1)
     {
         assert(i->getSourceActorId() != i->getDestinationActorId());
@@ -997,6 +1052,7 @@ void AsyncNodesHandle::ReaderSharedHandle::read(void) noexcept
         // is event destination in this node?
         if (eventDestinationInProcessActorId.getNodeActorId() == eventTable.nodeActorId)
         {
+            LatencyTracker::DispatchScope latencyScope(event, latencyPickupTsc);
             try
             {
                 if (eventTable.onEvent(event, node.corePerformanceCounters.onEventCount))
@@ -1210,6 +1266,13 @@ bool AsyncNodesHandle::WriterSharedHandle::write() noexcept
                 cl2.shared.writeCache.freeEventAllocatorPageChain.pop_front());
         }
         cl2.shared.writeCache.frontUsedEventAllocatorPageChainOffset = 0;
+        if (TREDZONE_PROBE_ENABLED(batch_write) && cl2.shared.readWriteLocked.readerNodeHandle != 0 &&
+            cl2.shared.readWriteLocked.readerNodeHandle->node != 0)
+        {
+            TREDZONE_PROBE4(batch_write, cl2.shared.readWriteLocked.writerNodeId,
+                            cl2.shared.readWriteLocked.readerNodeHandle->node->id, cl2.shared.writeCache.batchId,
+                            cl2.shared.writeCache.totalWrittenByteSize);
+        }
     }
     return isWriteWorthy;
 }
@@ -1229,6 +1292,7 @@ bool AsyncNodesHandle::WriterSharedHandle::localOnEvent(const Actor::Event &even
     {
         return false;
     }
+    LatencyTracker::DispatchScope latencyScope(event, 0);
     try
     {
         return eventTable->onEvent(event, performanceCounter);
@@ -1264,10 +1328,18 @@ void AsyncNodesHandle::Shared::WriteCache::newEventPage()
             new (eventAllocatorPageAllocator.insert(CACHE_LINE_SIZE + eventAllocatorPageSize))
                 AsyncNodesHandle::Shared::EventAllocatorPage(nextEventAllocatorPageIndex));
         ++nextEventAllocatorPageIndex;
+        if (TREDZONE_PROBE_ENABLED(event_page))
+        {
+            TREDZONE_PROBE3(event_page, usedEventAllocatorPageChain.front()->index, eventAllocatorPageSize, 1);
+        }
     }
     else
     {
         usedEventAllocatorPageChain.push_front(freeEventAllocatorPageChain.pop_front());
+        if (TREDZONE_PROBE_ENABLED(event_page))
+        {
+            TREDZONE_PROBE3(event_page, usedEventAllocatorPageChain.front()->index, eventAllocatorPageSize, 0);
+        }
     }
     frontUsedEventAllocatorPageChainOffset = 0;
 }
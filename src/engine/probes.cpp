@@ -0,0 +1,18 @@
+/**
+ * @file probes.cpp
+ * @brief USDT (systemtap SDT) static tracepoint semaphores
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include "trz/engine/internal/probes.h"
+
+// incremented by the tracer (bpftrace, perf, systemtap) while attached to the probe
+TREDZONE_PROBE_DEFINE(event_push);
+TREDZONE_PROBE_DEFINE(batch_write);
+TREDZONE_PROBE_DEFINE(batch_read);
+TREDZONE_PROBE_DEFINE(dispatch_enter);
+TREDZONE_PROBE_DEFINE(dispatch_exit);
+TREDZONE_PROBE_DEFINE(actor_new);
+TREDZONE_PROBE_DEFINE(actor_destroy);
+TREDZONE_PROBE_DEFINE(event_page);
@@ -0,0 +1,153 @@
+/**
+ * @file referencedata.cpp
+ * @brief memory-mapped reference-data loader with parallel per-core parsing
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <system_error>
+
+#include "trz/util/referencedata.h"
+
+namespace tredzone
+{
+
+namespace
+{
+
+// faults the (mapped) pages in upfront: no page fault while splitting and parsing
+void populatePages(const char *p, size_t size) noexcept
+{
+#ifdef MADV_POPULATE_READ
+    if (::madvise(const_cast<char *>(p), size, MADV_POPULATE_READ) == 0)
+    {
+        return;
+    }
+#endif
+    // kernels before 5.14: touch every page
+    const volatile char *page = p;
+    const size_t pageSize = (size_t)::sysconf(_SC_PAGESIZE);
+    char sum = 0;
+    for (size_t i = 0; i < size; i += pageSize)
+    {
+        sum = (char)(sum + page[i]);
+    }
+    (void)sum;
+}
+
+} // namespace
+
+/**
+ * throw (std::system_error)
+ */
+ReferenceDataFile::ReferenceDataFile(const char *path) : data(0), size(0)
+{
+    const int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+    {
+        throw std::system_error(errno, std::system_category());
+    }
+    struct stat st;
+    if (::fstat(fd, &st) == -1)
+    {
+        const int err = errno;
+        ::close(fd);
+        throw std::system_error(err, std::system_category());
+    }
+    size = (size_t)st.st_size;
+    if (size != 0)
+    {
+        // not MAP_POPULATE: the pages would already be faulted in (as small pages) when advised
+        void *p = ::mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED)
+        {
+            const int err = errno;
+            ::close(fd);
+            throw std::system_error(err, std::system_category());
+        }
+#ifdef MADV_HUGEPAGE
+        ::madvise(p, size, MADV_HUGEPAGE); // file-backed huge pages are not supported by all kernels/file-systems
+#endif
+        data = static_cast<const char *>(p);
+        populatePages(data, size);
+    }
+    ::close(fd);
+}
+
+ReferenceDataFile::~ReferenceDataFile() noexcept
+{
+    if (data != 0)
+    {
+        ::munmap(const_cast<char *>(data), size);
+    }
+}
+
+/**
+ * throw (CorruptFileException, std::bad_alloc)
+ */
+std::vector<ReferenceDataFile::Chunk> ReferenceDataFile::split(size_t chunkCount, RecordSizeFunction recordSize) const
+{
+    assert(chunkCount != 0);
+    std::vector<Chunk> ret(chunkCount);
+    const char *p = data;
+    const char *const end = data + size;
+    for (size_t i = 0; i < chunkCount; ++i)
+    {
+        Chunk &chunk = ret[i];
+        chunk.data = p;
+        chunk.recordCount = 0;
+        // whole records, up to the (i + 1)/chunkCount of the file
+        const char *const chunkEnd = data + (size * (i + 1)) / chunkCount;
+        while (p < chunkEnd)
+        {
+            const size_t n = recordSize(p, (size_t)(end - p));
+            if (n == 0 || n > (size_t)(end - p))
+            {
+                throw CorruptFileException();
+            }
+            p += n;
+            ++chunk.recordCount;
+        }
+        chunk.byteCount = (size_t)(p - chunk.data);
+    }
+    assert(p == end);
+    return ret;
+}
+
+/**
+ * throw (std::bad_alloc)
+ */
+void *ReferenceDataFile::allocatePages(size_t byteCount)
+{
+    void *ret = ::mmap(0, byteCount, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ret == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+#ifdef MADV_HUGEPAGE
+    ::madvise(ret, byteCount, MADV_HUGEPAGE); // transparent huge pages, if enabled
+#endif
+    return ret;
+}
+
+void ReferenceDataFile::protectPages(void *p, size_t byteCount) noexcept
+{
+    const int err = ::mprotect(p, byteCount, PROT_READ);
+    (void)err;
+    assert(err == 0);
+}
+
+void ReferenceDataFile::deallocatePages(void *p, size_t byteCount) noexcept
+{
+    const int err = ::munmap(p, byteCount);
+    (void)err;
+    assert(err == 0);
+}
+
+} // namespace tredzone
@@ -0,0 +1,544 @@
+/**
+ * @file trace.cpp
+ * @brief per-core binary tracing of engine hook points
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <sched.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trz/engine/actor.h"
+#include "trz/util/trace.h"
+
+namespace tredzone
+{
+
+const uint32_t Trace::FILE_VERSION;
+const size_t Trace::DEFAULT_RING_CAPACITY;
+const size_t Trace::CONTENT_SLOT_SIZE;
+const size_t Trace::MAX_EVENT_CLASS_COUNT;
+const uint32_t Trace::UNKNOWN_EVENT_OFFSET;
+std::atomic<uint64_t> Trace::eventCaptures[Trace::MAX_EVENT_CLASS_COUNT];
+
+static_assert(Trace::MAX_EVENT_CLASS_COUNT == (size_t)Actor::MAX_EVENT_ID_COUNT, "event class-id range mismatch");
+static_assert(sizeof(Trace::Record) == 32, "Trace::Record size changed (file format)");
+
+namespace
+{
+
+std::atomic<size_t> traceRingCapacity(Trace::DEFAULT_RING_CAPACITY);
+std::atomic<uint32_t> traceRingCount(0);
+std::atomic<void *> traceRingHead(0); // Trace::Ring chain, never released
+
+const char TRACE_FILE_MAGIC[8] = {'T', 'R', 'Z', 'T', 'R', 'A', 'C', 'E'};
+
+double calibrateTscPerMicrosecond() noexcept
+{
+    const std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+    const uint64_t tsc0 = getTSC();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    const uint64_t tsc1 = getTSC();
+    const double us = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - t0).count() / 1000.;
+    return us > 0 && tsc1 > tsc0 ? (double)(tsc1 - tsc0) / us : 1.;
+}
+
+struct TraceField
+{
+    std::string name;
+    uint32_t offset;
+    uint16_t size;
+    uint8_t type;
+};
+
+struct TraceLayout
+{
+    std::string name;
+    uint32_t eventSize;
+    std::vector<TraceField> fields;
+};
+
+typedef std::map<uint16_t, TraceLayout> TraceLayoutMap;
+
+std::mutex &getTraceLayoutMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+TraceLayoutMap &getTraceLayouts()
+{
+    static TraceLayoutMap layouts; // registered from static initializers too
+    return layouts;
+}
+
+template <class T> void writeValue(std::ostream &os, const T &value)
+{
+    os.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <class T> void readValue(std::istream &is, T &value) // throw (Trace::InvalidFileException)
+{
+    if (!is.read(reinterpret_cast<char *>(&value), sizeof(value)))
+    {
+        throw Trace::InvalidFileException();
+    }
+}
+
+void readString(std::istream &is, uint32_t size, std::string &s) // throw (Trace::InvalidFileException)
+{
+    s.resize(size);
+    if (size != 0 && !is.read(&s[0], size))
+    {
+        throw Trace::InvalidFileException();
+    }
+}
+
+void writeJsonString(std::ostream &os, const char *s, size_t size)
+{
+    os << '"';
+    for (size_t i = 0; i < size; ++i)
+    {
+        const unsigned char c = (unsigned char)s[i];
+        if (c == '"' || c == '\\')
+        {
+            os << '\\' << (char)c;
+        }
+        else if (c < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+            os << escaped;
+        }
+        else
+        {
+            os << (char)c;
+        }
+    }
+    os << '"';
+}
+
+void writeJsonName(std::ostream &os, const Trace::Record &record, const TraceLayoutMap &layouts)
+{
+    const TraceLayoutMap::const_iterator i = layouts.find(record.eventClassId);
+    if (i == layouts.end())
+    {
+        os << "\"name\":\"event#" << record.eventClassId << '"';
+    }
+    else
+    {
+        os << "\"name\":";
+        writeJsonString(os, i->second.name.data(), i->second.name.size());
+    }
+}
+
+template <class T> T fieldValue(const char *p) noexcept
+{
+    T ret;
+    std::memcpy(&ret, p, sizeof(ret));
+    return ret;
+}
+
+void writeJsonField(std::ostream &os, const TraceField &field, const char *p)
+{
+    char value[32];
+    switch (field.type)
+    {
+    case Trace::FIELD_BOOL:
+        os << (*p != 0 ? "true" : "false");
+        return;
+    case Trace::FIELD_CHAR:
+        writeJsonString(os, p, 1);
+        return;
+    case Trace::FIELD_INT:
+        if (field.size == 1 || field.size == 2 || field.size == 4 || field.size == 8)
+        {
+            os << (field.size == 1 ? (long long)fieldValue<int8_t>(p)
+                                   : field.size == 2 ? (long long)fieldValue<int16_t>(p)
+                                                     : field.size == 4 ? (long long)fieldValue<int32_t>(p)
+                                                                       : (long long)fieldValue<int64_t>(p));
+            return;
+        }
+        break;
+    case Trace::FIELD_UINT:
+        if (field.size == 1 || field.size == 2 || field.size == 4 || field.size == 8)
+        {
+            os << (field.size == 1 ? (unsigned long long)fieldValue<uint8_t>(p)
+                                   : field.size == 2 ? (unsigned long long)fieldValue<uint16_t>(p)
+                                                     : field.size == 4 ? (unsigned long long)fieldValue<uint32_t>(p)
+                                                                       : (unsigned long long)fieldValue<uint64_t>(p));
+            return;
+        }
+        break;
+    case Trace::FIELD_FLOAT:
+        if (field.size == sizeof(float) || field.size == sizeof(double))
+        {
+            const double d = field.size == sizeof(float) ? (double)fieldValue<float>(p) : fieldValue<double>(p);
+            if (std::isfinite(d))
+            {
+                std::snprintf(value, sizeof(value), "%.17g", d);
+                os << value;
+            }
+            else
+            {
+                os << "null"; // not representable in JSON
+            }
+            return;
+        }
+        break;
+    case Trace::FIELD_STRING:
+        writeJsonString(os, p, std::find(p, p + field.size, '\0') - p);
+        return;
+    default:
+        break;
+    }
+    os << "\"0x";
+    for (uint16_t i = 0; i < field.size; ++i)
+    {
+        std::snprintf(value, sizeof(value), "%02x", (unsigned)(unsigned char)p[i]);
+        os << value;
+    }
+    os << '"';
+}
+
+/**
+ * @return the record count of the event content (HOOK_EVENT_CONTENT and HOOK_EVENT_DATA records) at records[i],
+ * 0 if there is none (or it is truncated).
+ */
+size_t readContent(const std::vector<Trace::Record> &records, size_t i, uint16_t eventClassId, std::string &content)
+{
+    if (i >= records.size() || records[i].hook != Trace::HOOK_EVENT_CONTENT ||
+        records[i].eventClassId != eventClassId)
+    {
+        return 0;
+    }
+    const uint64_t size = records[i].actorId;
+    const uint64_t slotCount = (size + Trace::CONTENT_SLOT_SIZE - 1) / Trace::CONTENT_SLOT_SIZE;
+    if (slotCount >= records.size() - i)
+    {
+        return 0;
+    }
+    content.clear();
+    for (size_t j = i + 1; j <= i + slotCount; ++j)
+    {
+        if (records[j].hook != Trace::HOOK_EVENT_DATA)
+        {
+            return 0;
+        }
+        content.append(reinterpret_cast<const char *>(&records[j]),
+                       std::min((size_t)(size - content.size()), Trace::CONTENT_SLOT_SIZE));
+    }
+    return (size_t)slotCount + 1;
+}
+
+} // namespace
+
+void Trace::setRingCapacity(size_t recordCount) noexcept
+{
+    size_t capacity = 2;
+    for (; capacity < recordCount; capacity *= 2)
+    {
+    }
+    traceRingCapacity.store(capacity, std::memory_order_relaxed);
+}
+
+/**
+ * throw (std::bad_alloc)
+ */
+void Trace::registerEventLayout(uint16_t eventClassId, const char *name, size_t eventSize, const Field *fields,
+                                size_t fieldCount)
+{
+    assert(eventClassId < MAX_EVENT_CLASS_COUNT);
+    assert(eventSize <= std::numeric_limits<uint32_t>::max());
+    TraceLayout layout;
+    layout.name = name;
+    layout.eventSize = (uint32_t)eventSize;
+    layout.fields.resize(fieldCount);
+    for (size_t i = 0; i < fieldCount; ++i)
+    {
+        assert(fields[i].offset + fields[i].size <= eventSize);
+        layout.fields[i].name = fields[i].name;
+        layout.fields[i].offset = fields[i].offset;
+        layout.fields[i].size = fields[i].size;
+        layout.fields[i].type = fields[i].type;
+    }
+    std::lock_guard<std::mutex> lock(getTraceLayoutMutex());
+    std::swap(getTraceLayouts()[eventClassId], layout);
+    eventCaptures[eventClassId].store((uint64_t)eventSize | (uint64_t)UNKNOWN_EVENT_OFFSET << 32,
+                                      std::memory_order_relaxed);
+}
+
+Trace::Ring *Trace::newThreadRing() noexcept
+{
+    const size_t capacity = traceRingCapacity.load(std::memory_order_relaxed);
+    Ring *ring = new (std::nothrow) Ring;
+    if (ring == 0)
+    {
+        return 0;
+    }
+    if ((ring->records = new (std::nothrow) Record[capacity]) == 0)
+    {
+        delete ring;
+        return 0;
+    }
+    const int cpu = sched_getcpu();
+    ring->cpuId = cpu < 0 ? 0 : (uint32_t)cpu;
+    ring->ringIndex = traceRingCount.fetch_add(1, std::memory_order_relaxed);
+    ring->mask = capacity - 1;
+    ring->loopPosition = 0;
+    ring->writePosition.store(0, std::memory_order_relaxed);
+    void *head = traceRingHead.load(std::memory_order_relaxed);
+    do
+    {
+        ring->next = static_cast<Ring *>(head);
+    } while (!traceRingHead.compare_exchange_weak(head, ring, std::memory_order_release, std::memory_order_relaxed));
+    return getThreadRing() = ring;
+}
+
+/**
+ * throw (std::ios_base::failure)
+ */
+void Trace::dump(std::ostream &os)
+{
+    std::vector<const Ring *> rings;
+    for (const Ring *ring = static_cast<const Ring *>(traceRingHead.load(std::memory_order_acquire)); ring != 0;
+         ring = ring->next)
+    {
+        rings.insert(rings.begin(), ring); // creation order
+    }
+    FileHeader fileHeader;
+    std::memcpy(fileHeader.magic, TRACE_FILE_MAGIC, sizeof(fileHeader.magic));
+    fileHeader.version = FILE_VERSION;
+    fileHeader.ringCount = (uint32_t)rings.size();
+    fileHeader.tscPerMicrosecond = calibrateTscPerMicrosecond();
+    os.write(reinterpret_cast<const char *>(&fileHeader), sizeof(fileHeader));
+    for (size_t i = 0; i < rings.size(); ++i)
+    {
+        const Ring &ring = *rings[i];
+        const uint64_t end = ring.writePosition.load(std::memory_order_acquire);
+        const uint64_t begin = end > ring.mask + 1 ? end - (ring.mask + 1) : 0;
+        RingHeader ringHeader;
+        ringHeader.cpuId = ring.cpuId;
+        ringHeader.ringIndex = ring.ringIndex;
+        ringHeader.recordCount = end - begin;
+        os.write(reinterpret_cast<const char *>(&ringHeader), sizeof(ringHeader));
+        for (uint64_t position = begin; position < end; ++position)
+        {
+            os.write(reinterpret_cast<const char *>(&ring.records[position & ring.mask]), sizeof(Record));
+        }
+    }
+    std::lock_guard<std::mutex> lock(getTraceLayoutMutex());
+    const TraceLayoutMap &layouts = getTraceLayouts();
+    writeValue(os, (uint32_t)layouts.size());
+    for (TraceLayoutMap::const_iterator i = layouts.begin(), endi = layouts.end(); i != endi; ++i)
+    {
+        LayoutHeader layoutHeader;
+        layoutHeader.eventClassId = i->first;
+        layoutHeader.fieldCount = (uint16_t)i->second.fields.size();
+        layoutHeader.eventSize = i->second.eventSize;
+        layoutHeader.nameSize = (uint32_t)i->second.name.size();
+        writeValue(os, layoutHeader);
+        os.write(i->second.name.data(), layoutHeader.nameSize);
+        for (std::vector<TraceField>::const_iterator j = i->second.fields.begin(), endj = i->second.fields.end();
+             j != endj; ++j)
+        {
+            FieldHeader fieldHeader;
+            fieldHeader.offset = j->offset;
+            fieldHeader.size = j->size;
+            fieldHeader.type = j->type;
+            fieldHeader.padding = 0;
+            fieldHeader.nameSize = (uint32_t)j->name.size();
+            writeValue(os, fieldHeader);
+            os.write(j->name.data(), fieldHeader.nameSize);
+        }
+    }
+    os.flush();
+}
+
+bool Trace::dump(const char *path) noexcept
+{
+    try
+    {
+        std::ofstream os(path, std::ios::binary | std::ios::trunc);
+        if (!os)
+        {
+            return false;
+        }
+        dump(os);
+        return (bool)os;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+/**
+ * throw (InvalidFileException, std::ios_base::failure)
+ */
+void Trace::convertToJson(std::istream &is, std::ostream &os)
+{
+    FileHeader fileHeader;
+    if (!is.read(reinterpret_cast<char *>(&fileHeader), sizeof(fileHeader)) ||
+        std::memcmp(fileHeader.magic, TRACE_FILE_MAGIC, sizeof(fileHeader.magic)) != 0 ||
+        fileHeader.version == 0 || fileHeader.version > FILE_VERSION || !(fileHeader.tscPerMicrosecond > 0))
+    {
+        throw InvalidFileException();
+    }
+    std::vector<RingHeader> ringHeaders(fileHeader.ringCount);
+    std::vector<std::vector<Record>> ringRecords(fileHeader.ringCount);
+    uint64_t baseTsc = std::numeric_limits<uint64_t>::max();
+    for (uint32_t i = 0; i < fileHeader.ringCount; ++i)
+    {
+        if (!is.read(reinterpret_cast<char *>(&ringHeaders[i]), sizeof(RingHeader)))
+        {
+            throw InvalidFileException();
+        }
+        ringRecords[i].resize(ringHeaders[i].recordCount);
+        if (!ringRecords[i].empty())
+        {
+            if (!is.read(reinterpret_cast<char *>(&ringRecords[i][0]), ringRecords[i].size() * sizeof(Record)))
+            {
+                throw InvalidFileException();
+            }
+            // the oldest records may be the raw event bytes of an overwritten content
+            for (std::vector<Record>::const_iterator j = ringRecords[i].begin(), endj = ringRecords[i].end();
+                 j != endj; ++j)
+            {
+                if (j->hook != HOOK_EVENT_DATA)
+                {
+                    baseTsc = std::min(baseTsc, j->tsc);
+                    break;
+                }
+            }
+        }
+    }
+    TraceLayoutMap layouts;
+    if (fileHeader.version >= 2)
+    {
+        uint32_t layoutCount;
+        readValue(is, layoutCount);
+        for (uint32_t i = 0; i < layoutCount; ++i)
+        {
+            LayoutHeader layoutHeader;
+            readValue(is, layoutHeader);
+            TraceLayout &layout = layouts[layoutHeader.eventClassId];
+            readString(is, layoutHeader.nameSize, layout.name);
+            layout.eventSize = layoutHeader.eventSize;
+            layout.fields.resize(layoutHeader.fieldCount);
+            for (uint16_t j = 0; j < layoutHeader.fieldCount; ++j)
+            {
+                FieldHeader fieldHeader;
+                readValue(is, fieldHeader);
+                if ((uint64_t)fieldHeader.offset + fieldHeader.size > layout.eventSize)
+                {
+                    throw InvalidFileException();
+                }
+                TraceField &field = layout.fields[j];
+                readString(is, fieldHeader.nameSize, field.name);
+                field.offset = fieldHeader.offset;
+                field.size = fieldHeader.size;
+                field.type = fieldHeader.type;
+            }
+        }
+    }
+    std::string content;
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    const char *separator = "\n";
+    for (uint32_t i = 0; i < fileHeader.ringCount; ++i)
+    {
+        os << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << ringHeaders[i].ringIndex
+           << ",\"args\":{\"name\":\"cpu " << ringHeaders[i].cpuId << "\"}}";
+        separator = ",\n";
+        const std::vector<Record> &records = ringRecords[i];
+        for (size_t j = 0; j < records.size(); ++j)
+        {
+            const Record &record = records[j];
+            if (record.hook == HOOK_EVENT_CONTENT || record.hook == HOOK_EVENT_DATA)
+            {
+                continue; // not following its dispatch record (overwritten)
+            }
+            os << separator << '{';
+            switch (record.hook)
+            {
+            case HOOK_ACTOR_NEW:
+                os << "\"name\":\"new actor\",\"cat\":\"actor\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"actor\":"
+                   << record.actorId << ",\"creator\":" << record.peerActorId << '}';
+                break;
+            case HOOK_ACTOR_DESTROY:
+                os << "\"name\":\"destroy actor\",\"cat\":\"actor\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"actor\":"
+                   << record.actorId << '}';
+                break;
+            case HOOK_LOOP:
+                os << "\"name\":\"loop\",\"cat\":\"loop\",\"ph\":\"i\",\"s\":\"t\"";
+                break;
+            case HOOK_CALLBACK:
+                os << "\"name\":\"callback\",\"cat\":\"callback\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"actor\":"
+                   << record.actorId << '}';
+                break;
+            case HOOK_DISPATCH_BEGIN:
+            case HOOK_UNDELIVERED_BEGIN:
+            {
+                writeJsonName(os, record, layouts);
+                os << ",\"cat\":\"" << (record.hook == HOOK_DISPATCH_BEGIN ? "dispatch" : "undelivered")
+                   << "\",\"ph\":\"B\",\"args\":{\"actor\":" << record.actorId << ",\"source\":\""
+                   << (unsigned)record.peerNodeId << '.' << record.peerActorId << '"';
+                const size_t contentRecordCount = readContent(records, j + 1, record.eventClassId, content);
+                const TraceLayoutMap::const_iterator layout = layouts.find(record.eventClassId);
+                if (contentRecordCount != 0 && layout != layouts.end() && layout->second.eventSize == content.size())
+                {
+                    os << ",\"content\":{";
+                    for (std::vector<TraceField>::const_iterator k = layout->second.fields.begin(),
+                                                                 endk = layout->second.fields.end();
+                         k != endk; ++k)
+                    {
+                        if (k != layout->second.fields.begin())
+                        {
+                            os << ',';
+                        }
+                        writeJsonString(os, k->name.data(), k->name.size());
+                        os << ':';
+                        writeJsonField(os, *k, content.data() + k->offset);
+                    }
+                    os << '}';
+                }
+                os << '}';
+                j += contentRecordCount;
+                break;
+            }
+            case HOOK_DISPATCH_END:
+            case HOOK_UNDELIVERED_END:
+                os << "\"ph\":\"E\"";
+                break;
+            case HOOK_PUSH:
+                writeJsonName(os, record, layouts);
+                os << ",\"cat\":\"push\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"actor\":" << record.actorId
+                   << ",\"destination\":\"" << (unsigned)record.peerNodeId << '.' << record.peerActorId << "\"}";
+                break;
+            default:
+                os << "\"name\":\"hook 0x" << std::hex << record.hook << std::dec << "\",\"ph\":\"i\",\"s\":\"t\"";
+                break;
+            }
+            os << ",\"pid\":1,\"tid\":" << ringHeaders[i].ringIndex << ",\"ts\":" << std::fixed
+               << (double)(record.tsc - baseTsc) / fileHeader.tscPerMicrosecond << std::defaultfloat << '}';
+        }
+    }
+    os << "\n]}\n";
+}
+
+} // namespace tredzone
@@ -0,0 +1,262 @@
+/**
+ * @file watchdog.cpp
+ * @brief event-loop stall watchdog
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <execinfo.h>
+#include <pthread.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <system_error>
+
+#include "trz/engine/watchdog.h"
+
+namespace tredzone
+{
+
+const unsigned Watchdog::BACKTRACE_TIMEOUT_MILLISECONDS;
+
+namespace
+{
+
+std::atomic<bool> watchdogRunningFlag(false);
+
+} // namespace
+
+void Watchdog::StallHandler::onStall(const Stall &stall) noexcept
+{
+    try
+    {
+        std::cerr << "tredzone::Watchdog: node " << (unsigned)stall.nodeId << " (core " << (unsigned)stall.coreId
+                  << ") stalled for " << stall.iterationMicroseconds << " us";
+        if (stall.dispatchFlag)
+        {
+            std::cerr << " in event#" << stall.dispatch.eventClassId << " handler of actor "
+                      << (unsigned)stall.dispatch.destinationNodeId << '.' << stall.dispatch.destinationNodeActorId
+                      << " (from " << (unsigned)stall.dispatch.sourceNodeId << '.' << stall.dispatch.sourceNodeActorId
+                      << ')';
+        }
+        else
+        {
+            std::cerr << " outside of any event handler";
+        }
+        std::cerr << '\n';
+        for (std::vector<std::string>::const_iterator i = stall.backtrace.begin(), endi = stall.backtrace.end();
+             i != endi; ++i)
+        {
+            std::cerr << "  " << *i << '\n';
+        }
+        std::cerr.flush();
+    }
+    catch (...)
+    {
+    }
+}
+
+/**
+ * throw (AlreadyRunningException, std::system_error)
+ */
+Watchdog::Watchdog(uint64_t pstallThresholdMicroseconds, StallHandler *pstallHandler, int pbacktraceSignal)
+    : stallThresholdMicroseconds(pstallThresholdMicroseconds),
+      stallHandler(pstallHandler == 0 ? defaultStallHandler : *pstallHandler), backtraceSignal(pbacktraceSignal),
+      stallCount(0), tscPerMillisecond(0), stopFlag(false)
+{
+    if (watchdogRunningFlag.exchange(true))
+    {
+        throw AlreadyRunningException();
+    }
+    // first backtrace() call may allocate (loads the unwinder), not to happen in the signal handler
+    void *addresses[1];
+    backtrace(addresses, 1);
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = &onBacktraceSignal;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(backtraceSignal, &action, &previousSignalAction) != 0)
+    {
+        watchdogRunningFlag.store(false);
+        throw std::system_error(errno, std::system_category());
+    }
+    try
+    {
+        thread = std::thread(&Watchdog::run, this);
+    }
+    catch (...)
+    {
+        sigaction(backtraceSignal, &previousSignalAction, 0);
+        watchdogRunningFlag.store(false);
+        throw;
+    }
+}
+
+Watchdog::~Watchdog() noexcept
+{
+    {
+        std::lock_guard<std::mutex> lock(stopMutex);
+        stopFlag = true;
+    }
+    stopCondition.notify_one();
+    thread.join();
+    sigaction(backtraceSignal, &previousSignalAction, 0);
+    watchdogRunningFlag.store(false);
+}
+
+void Watchdog::run() noexcept
+{
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+    const uint64_t startTsc = getTSC();
+    const std::chrono::microseconds samplePeriod(std::max(stallThresholdMicroseconds / 4, (uint64_t)100));
+    std::vector<std::pair<const FlightRecorder *, uint64_t>> reportedLoopTscs;
+    std::unique_lock<std::mutex> lock(stopMutex);
+    while (!stopCondition.wait_for(lock, samplePeriod, [this] { return stopFlag; }))
+    {
+        const uint64_t elapsedMilliseconds = (uint64_t)std::chrono::duration_cast<std::chrono::milliseconds>(
+                                                 std::chrono::steady_clock::now() - startTime).count();
+        if (elapsedMilliseconds >= 10)
+        {
+            tscPerMillisecond.store((getTSC() - startTsc) / elapsedMilliseconds, std::memory_order_relaxed);
+            lock.unlock();
+            sample(reportedLoopTscs);
+            lock.lock();
+        }
+    }
+}
+
+void Watchdog::sample(std::vector<std::pair<const FlightRecorder *, uint64_t>> &reportedLoopTscs) noexcept
+{
+    const uint64_t tscPerMicrosecond = std::max(tscPerMillisecond.load(std::memory_order_relaxed) / 1000, (uint64_t)1);
+    const uint64_t stallThresholdTsc = stallThresholdMicroseconds * tscPerMicrosecond;
+    std::vector<Stall> stalls;
+    try
+    {
+        std::vector<std::pair<const FlightRecorder *, uint64_t>> loopTscs;
+        std::lock_guard<std::mutex> registryLock(FlightRecorder::registryMutex);
+        for (size_t i = 0; i < FlightRecorder::MAX_RECORDER_COUNT; ++i)
+        {
+            FlightRecorder *flightRecorder = FlightRecorder::registry[i].load(std::memory_order_acquire);
+            if (flightRecorder == 0 || !flightRecorder->threadFlag.load(std::memory_order_acquire))
+            {
+                continue;
+            }
+            const uint64_t loopTsc = flightRecorder->getLoopTsc();
+            const uint64_t tsc = getTSC();
+            uint64_t reportedLoopTsc = 0;
+            for (size_t j = 0; j < reportedLoopTscs.size(); ++j)
+            {
+                if (reportedLoopTscs[j].first == flightRecorder)
+                {
+                    reportedLoopTsc = reportedLoopTscs[j].second;
+                }
+            }
+            if (tsc > loopTsc && tsc - loopTsc > stallThresholdTsc && loopTsc != reportedLoopTsc)
+            {
+                // report each stalled iteration once
+                reportedLoopTsc = loopTsc;
+                stalls.push_back(Stall());
+                Stall &stall = stalls.back();
+                stall.nodeId = flightRecorder->getNodeId();
+                stall.coreId = flightRecorder->getCoreId();
+                stall.iterationMicroseconds = (tsc - loopTsc) / tscPerMicrosecond;
+                stall.dispatchFlag = flightRecorder->getLastRecord(stall.dispatch) &&
+                                     stall.dispatch.durationTsc == FlightRecorder::Record::UNFINISHED;
+                captureBacktrace(*flightRecorder, stall);
+            }
+            loopTscs.push_back(std::make_pair(flightRecorder, reportedLoopTsc));
+        }
+        reportedLoopTscs.swap(loopTscs);
+    }
+    catch (...)
+    {
+        // std::bad_alloc: reports at next sample
+    }
+    for (std::vector<Stall>::const_iterator i = stalls.begin(), endi = stalls.end(); i != endi; ++i)
+    {
+        stallCount.fetch_add(1, std::memory_order_relaxed);
+        stallHandler.onStall(*i);
+    }
+}
+
+void Watchdog::captureBacktrace(FlightRecorder &flightRecorder, Stall &stall) const noexcept
+{
+    flightRecorder.backtraceSize.store(-1, std::memory_order_release);
+    if (pthread_kill(flightRecorder.thread, backtraceSignal) != 0)
+    {
+        flightRecorder.backtraceSize.store(0, std::memory_order_relaxed);
+        return;
+    }
+    const std::chrono::steady_clock::time_point timeOut =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(BACKTRACE_TIMEOUT_MILLISECONDS);
+    int size;
+    while ((size = flightRecorder.backtraceSize.load(std::memory_order_acquire)) < 0 &&
+           std::chrono::steady_clock::now() < timeOut)
+    {
+        std::this_thread::yield();
+    }
+    int expected = -1;
+    if (size < 0 && flightRecorder.backtraceSize.compare_exchange_strong(expected, 0))
+    {
+        return; // the event-loop thread did not respond
+    }
+    size = flightRecorder.backtraceSize.load(std::memory_order_acquire);
+    stall.backtrace = debugBacktrace(flightRecorder.backtraceAddresses, size);
+}
+
+void Watchdog::onBacktraceSignal(int) noexcept
+{
+    const int savedErrno = errno;
+    const thread_t self = threadCurrent();
+    FlightRecorder::RegistryWalkGuard registryWalkGuard;
+    for (size_t i = 0; i < FlightRecorder::MAX_RECORDER_COUNT; ++i)
+    {
+        FlightRecorder *flightRecorder = FlightRecorder::registry[i].load(std::memory_order_acquire);
+        if (flightRecorder != 0 && flightRecorder->backtraceSize.load(std::memory_order_acquire) < 0 &&
+            threadEqual(flightRecorder->thread, self))
+        {
+            const int size = backtrace(flightRecorder->backtraceAddresses, FlightRecorder::MAX_BACKTRACE_SIZE);
+            int expected = -1;
+            flightRecorder->backtraceSize.compare_exchange_strong(expected, size, std::memory_order_acq_rel);
+        }
+    }
+    errno = savedErrno;
+}
+
+/**
+ * throw (std::ios_base::failure)
+ */
+void Watchdog::dumpLoopHistograms(std::ostream &os) const
+{
+    const double tscPerMicrosecond = (double)tscPerMillisecond.load(std::memory_order_relaxed) / 1000.;
+    std::lock_guard<std::mutex> registryLock(FlightRecorder::registryMutex);
+    for (size_t i = 0; i < FlightRecorder::MAX_RECORDER_COUNT; ++i)
+    {
+        const FlightRecorder *flightRecorder = FlightRecorder::registry[i].load(std::memory_order_acquire);
+        if (flightRecorder == 0)
+        {
+            continue;
+        }
+        uint64_t histogram[FlightRecorder::LOOP_HISTOGRAM_SIZE];
+        os << "node " << (unsigned)flightRecorder->getNodeId() << " (core " << (unsigned)flightRecorder->getCoreId()
+           << "): " << flightRecorder->getLoopHistogram(histogram) << " iterations\n";
+        for (size_t j = 0; j < FlightRecorder::LOOP_HISTOGRAM_SIZE; ++j)
+        {
+            if (histogram[j] != 0)
+            {
+                os << "  < " << (2ull << j) << " cycles";
+                if (tscPerMicrosecond > 0)
+                {
+                    os << " (" << (double)(2ull << j) / tscPerMicrosecond << " us)";
+                }
+                os << ": " << histogram[j] << '\n';
+            }
+        }
+    }
+}
+
+} // namespace tredzone
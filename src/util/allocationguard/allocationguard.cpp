@@ -0,0 +1,335 @@
+/**
+ * @file allocationguard.cpp
+ * @brief steady-state zero-allocation verification of event-loop threads (global operator new and malloc()
+ * replacements, opt-in library)
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <execinfo.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+
+#include "trz/engine/allocationguard.h"
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t);
+void *__libc_calloc(size_t, size_t);
+void *__libc_realloc(void *, size_t);
+void *__libc_memalign(size_t, size_t);
+}
+#endif
+
+namespace tredzone
+{
+
+const size_t AllocationGuard::MAX_RECORD_COUNT;
+const int AllocationGuard::MAX_BACKTRACE_SIZE;
+
+namespace
+{
+
+struct Record
+{
+    std::atomic<bool> readyFlag;
+    AllocationGuard::Source source;
+    size_t size;
+    Actor::NodeId nodeId;
+    Actor::CoreId coreId;
+    int backtraceSize;
+    void *backtraceAddresses[AllocationGuard::MAX_BACKTRACE_SIZE];
+};
+
+// no constructors (allocations may be checked before static initialization)
+Record records[AllocationGuard::MAX_RECORD_COUNT];
+std::atomic<size_t> recordCount;
+std::atomic<uint64_t> counts[AllocationGuard::SOURCE_COUNT];
+std::atomic<int> trapMode;
+
+const char *const SOURCE_NAMES[AllocationGuard::SOURCE_COUNT] = {"operator new", "malloc", "node allocator page"};
+
+// async-signal-safe (no allocation) decimal write
+void writeNumber(int fd, uint64_t value) noexcept
+{
+    char buffer[24];
+    char *p = buffer + sizeof(buffer);
+    do
+    {
+        *--p = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    if (write(fd, p, (size_t)(buffer + sizeof(buffer) - p)) < 0)
+    {
+    }
+}
+
+void writeString(int fd, const char *s) noexcept
+{
+    if (write(fd, s, std::strlen(s)) < 0)
+    {
+    }
+}
+
+} // namespace
+
+void AllocationGuard::enterSteadyState(Mode mode) noexcept
+{
+    // first backtrace() call may allocate (loads the unwinder)
+    void *addresses[1];
+    backtrace(addresses, 1);
+    trapMode.store(mode == TRAP ? 1 : 0, std::memory_order_relaxed);
+    getHandler().store(handle, std::memory_order_release);
+}
+
+void AllocationGuard::leaveSteadyState() noexcept { getHandler().store(0, std::memory_order_release); }
+
+uint64_t AllocationGuard::getCount(Source source) noexcept { return counts[source].load(std::memory_order_relaxed); }
+
+uint64_t AllocationGuard::getCount() noexcept
+{
+    uint64_t ret = 0;
+    for (int i = 0; i < SOURCE_COUNT; ++i)
+    {
+        ret += getCount((Source)i);
+    }
+    return ret;
+}
+
+const char *AllocationGuard::getSourceName(Source source) noexcept { return SOURCE_NAMES[source]; }
+
+void AllocationGuard::clear() noexcept
+{
+    assert(!isSteadyState());
+    for (size_t i = 0; i < MAX_RECORD_COUNT; ++i)
+    {
+        records[i].readyFlag.store(false, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < SOURCE_COUNT; ++i)
+    {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+    recordCount.store(0, std::memory_order_release);
+}
+
+void AllocationGuard::handle(Source source, size_t size) noexcept
+{
+    ThreadState &threadState = getThreadState();
+    if (threadState.inHandlerFlag)
+    {
+        return;
+    }
+    threadState.inHandlerFlag = true;
+    counts[source].fetch_add(1, std::memory_order_relaxed);
+    const size_t index = recordCount.fetch_add(1, std::memory_order_relaxed);
+    if (index < MAX_RECORD_COUNT)
+    {
+        Record &record = records[index];
+        record.source = source;
+        record.size = size;
+        record.nodeId = threadState.nodeId;
+        record.coreId = threadState.coreId;
+        record.backtraceSize = backtrace(record.backtraceAddresses, MAX_BACKTRACE_SIZE);
+        record.readyFlag.store(true, std::memory_order_release);
+    }
+    if (trapMode.load(std::memory_order_relaxed) != 0)
+    {
+        // no allocation from here
+        writeString(2, "AllocationGuard: steady-state ");
+        writeString(2, SOURCE_NAMES[source]);
+        writeString(2, " of ");
+        writeNumber(2, size);
+        writeString(2, " bytes on node ");
+        writeNumber(2, threadState.nodeId);
+        writeString(2, " (core ");
+        writeNumber(2, threadState.coreId);
+        writeString(2, ")\n");
+        void *addresses[MAX_BACKTRACE_SIZE];
+        backtrace_symbols_fd(addresses, backtrace(addresses, MAX_BACKTRACE_SIZE), 2);
+        std::abort();
+    }
+    threadState.inHandlerFlag = false;
+}
+
+/**
+ * throw (std::bad_alloc)
+ */
+std::vector<AllocationGuard::Allocation> AllocationGuard::getAllocations()
+{
+    std::vector<Allocation> ret;
+    const size_t n = std::min(recordCount.load(std::memory_order_acquire), MAX_RECORD_COUNT);
+    ret.reserve(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        const Record &record = records[i];
+        if (!record.readyFlag.load(std::memory_order_acquire))
+        {
+            continue;
+        }
+        ret.push_back(Allocation());
+        Allocation &allocation = ret.back();
+        allocation.source = record.source;
+        allocation.size = record.size;
+        allocation.nodeId = record.nodeId;
+        allocation.coreId = record.coreId;
+        allocation.backtrace = debugBacktrace(record.backtraceAddresses, record.backtraceSize);
+    }
+    return ret;
+}
+
+/**
+ * throw (std::bad_alloc, std::ios_base::failure)
+ */
+void AllocationGuard::report(std::ostream &os)
+{
+    os << "steady-state allocations:";
+    for (int i = 0; i < SOURCE_COUNT; ++i)
+    {
+        os << ' ' << SOURCE_NAMES[i] << '=' << getCount((Source)i);
+    }
+    os << '\n';
+    const std::vector<Allocation> allocations = getAllocations();
+    for (std::vector<Allocation>::const_iterator i = allocations.begin(), endi = allocations.end(); i != endi; ++i)
+    {
+        os << "  " << SOURCE_NAMES[i->source] << " of " << i->size << " bytes on node " << (unsigned)i->nodeId
+           << " (core " << (unsigned)i->coreId << ")\n";
+        for (std::vector<std::string>::const_iterator j = i->backtrace.begin(), endj = i->backtrace.end();
+             j != endj; ++j)
+        {
+            os << "    " << *j << '\n';
+        }
+    }
+}
+
+} // namespace tredzone
+
+using tredzone::AllocationGuard;
+
+/**
+ * throw (std::bad_alloc)
+ */
+void *operator new(size_t size)
+{
+    AllocationGuard::onAllocation(AllocationGuard::OPERATOR_NEW, size);
+    for (;;)
+    {
+#if defined(__GLIBC__)
+        void *ret = __libc_malloc(size == 0 ? 1 : size);
+#else
+        void *ret = std::malloc(size == 0 ? 1 : size);
+#endif
+        if (ret != 0)
+        {
+            return ret;
+        }
+        std::new_handler handler = std::get_new_handler();
+        if (handler == 0)
+        {
+            throw std::bad_alloc();
+        }
+        handler();
+    }
+}
+
+/**
+ * throw (std::bad_alloc)
+ */
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return operator new(size);
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    try
+    {
+        return operator new(size);
+    }
+    catch (...)
+    {
+        return 0;
+    }
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+
+void operator delete[](void *p) noexcept { std::free(p); }
+
+void operator delete(void *p, size_t) noexcept { std::free(p); }
+
+void operator delete[](void *p, size_t) noexcept { std::free(p); }
+
+void operator delete(void *p, const std::nothrow_t &) noexcept { std::free(p); }
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept { std::free(p); }
+
+#if defined(__GLIBC__)
+
+extern "C" {
+
+void *malloc(size_t size) noexcept
+{
+    AllocationGuard::onAllocation(AllocationGuard::MALLOC, size);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) noexcept
+{
+    AllocationGuard::onAllocation(AllocationGuard::MALLOC, n * size);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size) noexcept
+{
+    AllocationGuard::onAllocation(AllocationGuard::MALLOC, size);
+    return __libc_realloc(p, size);
+}
+
+void *memalign(size_t alignment, size_t size) noexcept
+{
+    AllocationGuard::onAllocation(AllocationGuard::MALLOC, size);
+    return __libc_memalign(alignment, size);
+}
+
+void *aligned_alloc(size_t alignment, size_t size) noexcept
+{
+    AllocationGuard::onAllocation(AllocationGuard::MALLOC, size);
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void **ret, size_t alignment, size_t size) noexcept
+{
+    if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0)
+    {
+        return EINVAL;
+    }
+    AllocationGuard::onAllocation(AllocationGuard::MALLOC, size);
+    void *p = __libc_memalign(alignment, size);
+    if (p == 0)
+    {
+        return ENOMEM;
+    }
+    *ret = p;
+    return 0;
+}
+
+} // extern "C"
+
+#endif
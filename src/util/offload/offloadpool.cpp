@@ -0,0 +1,260 @@
+/**
+ * @file offloadpool.cpp
+ * @brief blocking-call offload thread pool
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include "trz/util/offloadpool.h"
+
+namespace tredzone
+{
+
+//---- OffloadPool -------------------------------------------------------------
+
+/**
+ * throw (std::bad_alloc, std::system_error)
+ */
+OffloadPool::OffloadPool(const Engine::CoreSet &engineCoreSet, size_t workerCount, size_t queueCapacity)
+    : queueMask(roundCapacity(queueCapacity) - 1), queueSequences(queueMask + 1), queueTasks(queueMask + 1, 0),
+      enqueuePosition(0), dequeuePosition(0), wakeSequence(0), idleWorkerCount(0), stopFlag(false)
+{
+    for (size_t i = 0; i <= queueMask; ++i)
+    {
+        queueSequences[i].store(i, std::memory_order_relaxed);
+    }
+    // workers run on the cpu-cores left over by the engine (unpinned if the engine uses them all)
+    cpuset_type cpuSet;
+    for (unsigned cpu = 0, cpuCount = (unsigned)cpuGetCount(); cpu < cpuCount && cpu < cpuSet.size(); ++cpu)
+    {
+        cpuSet.set(cpu);
+    }
+    for (size_t i = 0; i < engineCoreSet.size(); ++i)
+    {
+        cpuSet.reset(engineCoreSet.at((Actor::NodeId)i));
+    }
+    workers.reserve(workerCount);
+    try
+    {
+        for (size_t i = 0; i < workerCount; ++i)
+        {
+            workers.push_back(std::thread(&OffloadPool::runWorker, this, cpuSet));
+        }
+    }
+    catch (...)
+    {
+        stop();
+        throw;
+    }
+}
+
+OffloadPool::~OffloadPool() noexcept
+{
+    stop();
+    assert(tryDequeue() == 0);
+}
+
+void OffloadPool::stop() noexcept
+{
+    stopFlag.store(true, std::memory_order_seq_cst);
+    wakeSequence.fetch_add(1, std::memory_order_release);
+    futexWake(reinterpret_cast<uint32_t *>(&wakeSequence), std::numeric_limits<int>::max());
+    for (std::vector<std::thread>::iterator i = workers.begin(), endi = workers.end(); i != endi; ++i)
+    {
+        i->join();
+    }
+    workers.clear();
+}
+
+size_t OffloadPool::roundCapacity(size_t capacity) noexcept
+{
+    size_t ret = 2;
+    for (; ret < capacity; ret *= 2)
+    {
+    }
+    return ret;
+}
+
+/**
+ * @brief Multiple-producer side of the bounded submission queue (any event-loop).
+ * @return false if the queue is full.
+ */
+bool OffloadPool::tryEnqueue(TaskBase &task) noexcept
+{
+    size_t position = enqueuePosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        std::atomic<size_t> &sequence = queueSequences[position & queueMask];
+        const ptrdiff_t diff = (ptrdiff_t)sequence.load(std::memory_order_acquire) - (ptrdiff_t)position;
+        if (diff == 0)
+        {
+            if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                queueTasks[position & queueMask] = &task;
+                sequence.store(position + 1, std::memory_order_release);
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = enqueuePosition.load(std::memory_order_relaxed);
+        }
+    }
+    // pairs with the worker incrementing idleWorkerCount then re-checking the queue (one of both sees the other)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idleWorkerCount.load(std::memory_order_relaxed) != 0)
+    {
+        wakeSequence.fetch_add(1, std::memory_order_release);
+        futexWake(reinterpret_cast<uint32_t *>(&wakeSequence));
+    }
+    return true;
+}
+
+/**
+ * @brief Multiple-consumer side of the bounded submission queue (worker threads).
+ * @return null if the queue is empty.
+ */
+OffloadPool::TaskBase *OffloadPool::tryDequeue() noexcept
+{
+    size_t position = dequeuePosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        std::atomic<size_t> &sequence = queueSequences[position & queueMask];
+        const ptrdiff_t diff = (ptrdiff_t)sequence.load(std::memory_order_acquire) - (ptrdiff_t)(position + 1);
+        if (diff == 0)
+        {
+            if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                TaskBase *ret = queueTasks[position & queueMask];
+                sequence.store(position + queueMask + 1, std::memory_order_release);
+                return ret;
+            }
+        }
+        else if (diff < 0)
+        {
+            return 0;
+        }
+        else
+        {
+            position = dequeuePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void OffloadPool::runWorker(const cpuset_type &cpuSet) noexcept
+{
+    if (cpuSet.any())
+    {
+        try
+        {
+            threadSetAffinity(cpuSet);
+        }
+        catch (...)
+        {
+            // run unpinned
+        }
+    }
+    for (;;)
+    {
+        TaskBase *task = tryDequeue();
+        if (task == 0)
+        {
+            const uint32_t sequence = wakeSequence.load(std::memory_order_acquire);
+            idleWorkerCount.fetch_add(1, std::memory_order_seq_cst);
+            if ((task = tryDequeue()) == 0)
+            {
+                if (stopFlag.load(std::memory_order_acquire))
+                {
+                    idleWorkerCount.fetch_sub(1, std::memory_order_relaxed);
+                    return; // queue drained
+                }
+                futexWait(reinterpret_cast<uint32_t *>(&wakeSequence), sequence);
+            }
+            idleWorkerCount.fetch_sub(1, std::memory_order_relaxed);
+            if (task == 0)
+            {
+                continue;
+            }
+        }
+        task->run();
+        // the completion actor is kept alive by the in-flight task, and only yields when its core lags
+        while (!task->completionChannel->tryPush(task))
+        {
+            threadYield();
+        }
+    }
+}
+
+//---- CompletionActor ---------------------------------------------------------
+
+/**
+ * throw (std::bad_alloc)
+ */
+OffloadPool::CompletionActor::CompletionActor()
+    : completionChannel(getEngine(), getActorId(), CompletionChannel::DEFAULT_CAPACITY), inFlightCount(0)
+{
+    registerEventHandler<CompletionEvent>(*this);
+}
+
+/**
+ * throw (std::bad_alloc)
+ */
+void OffloadPool::CompletionActor::onEvent(const CompletionEvent &event)
+{
+    TaskBase &task = *event.task;
+    assert(inFlightCount != 0);
+    --inFlightCount;
+    Proxy *proxy = task.proxy;
+    if (proxy != 0)
+    {
+        proxy->inFlightTaskChain.remove(&task);
+        --proxy->inFlightCount;
+    }
+    // the result event refers to the task, which is released once it was delivered
+    retiredTaskChain[0].push_back(&task);
+    if (!isRegistered())
+    {
+        registerCallback(*this);
+    }
+    if (proxy != 0)
+    {
+        Event::Pipe pipe(*this, task.replyActorId);
+        task.reply(pipe);
+    }
+}
+
+/**
+ * @brief Releases the tasks replied 2 event-loop iterations ago
+ * (events pushed during an iteration are delivered during the next one, after the callbacks).
+ */
+void OffloadPool::CompletionActor::onCallback() noexcept
+{
+    while (!retiredTaskChain[1].empty())
+    {
+        retiredTaskChain[1].pop_front()->destroy(getAllocator());
+    }
+    retiredTaskChain[1].swap(retiredTaskChain[0]);
+    if (!retiredTaskChain[1].empty())
+    {
+        registerCallback(*this);
+    }
+}
+
+void OffloadPool::CompletionActor::onDestroyRequest() noexcept
+{
+    if (inFlightCount == 0 && !isRegistered())
+    {
+        acceptDestroy();
+    }
+    else
+    {
+        // in-flight tasks still refer to the completion channel
+        requestDestroy();
+    }
+}
+
+} // namespace tredzone
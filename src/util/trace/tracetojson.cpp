@@ -0,0 +1,52 @@
+/**
+ * @file tracetojson.cpp
+ * @brief converts a binary engine trace (see trz/util/trace.h) to Chrome trace-event/Perfetto JSON
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <fstream>
+#include <iostream>
+
+#include "trz/util/trace.h"
+
+using namespace std;
+using namespace tredzone;
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 3)
+    {
+        cerr << "usage: " << argv[0] << " <trace-file> [<json-file>]" << endl;
+        return 1;
+    }
+    ifstream is(argv[1], ios::binary);
+    if (!is)
+    {
+        cerr << argv[0] << ": cannot open " << argv[1] << endl;
+        return 1;
+    }
+    try
+    {
+        if (argc == 3)
+        {
+            ofstream os(argv[2]);
+            Trace::convertToJson(is, os);
+            if (!os)
+            {
+                cerr << argv[0] << ": cannot write " << argv[2] << endl;
+                return 1;
+            }
+        }
+        else
+        {
+            Trace::convertToJson(is, cout);
+        }
+    }
+    catch (exception &e)
+    {
+        cerr << argv[0] << ": " << argv[1] << ": " << e.what() << endl;
+        return 1;
+    }
+    return 0;
+}
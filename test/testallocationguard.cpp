@@ -0,0 +1,143 @@
+/**
+ * @file testallocationguard.cpp
+ * @brief test steady-state zero-allocation verification
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/allocationguard.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const size_t NODE_ALLOCATOR_SIZE = 1 << 20; // larger than any warm-up page
+
+void allocate()
+{
+    // volatile: not to be optimized out
+    int *volatile p = new int(0);
+    delete p;
+    void *volatile q = std::malloc(16);
+    std::free(q);
+}
+
+struct TestResult
+{
+    std::atomic<bool> allocateFlag;
+    WaitCondition warmUpCondition;
+    WaitCondition doneCondition;
+    inline TestResult() : allocateFlag(false) {}
+};
+
+struct TestActor : Actor, Actor::Callback
+{
+    TestResult &result;
+    bool warmUpFlag;
+
+    TestActor(TestResult *presult) : result(*presult), warmUpFlag(true) { registerCallback(*this); }
+    void onCallback()
+    {
+        if (warmUpFlag)
+        {
+            warmUpFlag = false;
+            result.warmUpCondition.notify();
+        }
+        if (!result.allocateFlag.load())
+        {
+            registerCallback(*this);
+            return;
+        }
+        allocate();
+        Allocator<char> allocator(getAllocator());
+        allocator.deallocate(allocator.allocate(NODE_ALLOCATOR_SIZE), NODE_ALLOCATOR_SIZE);
+        result.doneCondition.notify();
+    }
+};
+
+void runEngine(bool steadyStateFlag)
+{
+    TestResult result;
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<TestActor>(0, &result);
+    TestEngine engine(startSequence);
+    result.warmUpCondition.wait();
+    if (steadyStateFlag)
+    {
+        AllocationGuard::enterSteadyState();
+    }
+    result.allocateFlag.store(true);
+    result.doneCondition.wait();
+    AllocationGuard::leaveSteadyState();
+}
+
+void testSteadyState()
+{
+    AllocationGuard::clear();
+    runEngine(true);
+
+    ASSERT_LE(1u, AllocationGuard::getCount(AllocationGuard::OPERATOR_NEW));
+    ASSERT_LE(1u, AllocationGuard::getCount(AllocationGuard::NODE_ALLOCATOR_PAGE));
+#if defined(__GLIBC__)
+    ASSERT_LE(2u, AllocationGuard::getCount(AllocationGuard::MALLOC)); // malloc() and node allocator page
+#endif
+    const vector<AllocationGuard::Allocation> allocations = AllocationGuard::getAllocations();
+    ASSERT_EQ(AllocationGuard::getCount(), allocations.size());
+    bool nodeAllocatorPageFlag = false;
+    for (size_t i = 0; i < allocations.size(); ++i)
+    {
+        ASSERT_EQ(0u, allocations[i].nodeId);
+        ASSERT_EQ(0u, allocations[i].coreId);
+        ASSERT_FALSE(allocations[i].backtrace.empty());
+        nodeAllocatorPageFlag = nodeAllocatorPageFlag ||
+                                (allocations[i].source == AllocationGuard::NODE_ALLOCATOR_PAGE &&
+                                 allocations[i].size >= NODE_ALLOCATOR_SIZE);
+    }
+    ASSERT_TRUE(nodeAllocatorPageFlag);
+
+    ostringstream os;
+    AllocationGuard::report(os);
+    ASSERT_EQ(0u, os.str().find("steady-state allocations: operator new=")) << os.str();
+    ASSERT_NE(string::npos, os.str().find("  node allocator page of ")) << os.str();
+}
+
+void testNotSteadyState()
+{
+    AllocationGuard::clear();
+    runEngine(false);
+
+    ASSERT_EQ(0u, AllocationGuard::getCount());
+    ASSERT_TRUE(AllocationGuard::getAllocations().empty());
+}
+
+void testOtherThread()
+{
+    AllocationGuard::clear();
+    AllocationGuard::enterSteadyState();
+    ASSERT_TRUE(AllocationGuard::isSteadyState());
+    allocate();
+    AllocationGuard::leaveSteadyState();
+    ASSERT_FALSE(AllocationGuard::isSteadyState());
+
+    ASSERT_EQ(0u, AllocationGuard::getCount());
+}
+
+} // anonymous namespace
+
+TEST(AllocationGuard, steadyState) { testSteadyState(); }
+TEST(AllocationGuard, notSteadyState) { testNotSteadyState(); }
+TEST(AllocationGuard, otherThread) { testOtherThread(); }
@@ -0,0 +1,143 @@
+/**
+ * @file testask.cpp
+ * @brief test request/response with correlation and time-out
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include "gtest/gtest.h"
+
+#include "trz/util/ask.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const int ANSWERED_COUNT = 150; // more than one slab chunk pending at once
+static const int IGNORE_VALUE = -1;
+static const int REJECT_VALUE = -2;
+
+struct TestRequest : AskProxy::RequestEvent
+{
+    int value;
+    inline TestRequest(int pvalue) noexcept : value(pvalue) {}
+};
+
+struct TestResponse : AskProxy::ResponseEvent
+{
+    int value;
+    inline TestResponse(const TestRequest &request) noexcept
+        : AskProxy::ResponseEvent(request), value(2 * request.value)
+    {
+    }
+};
+
+struct TestResponderActor : Actor
+{
+    TestResponderActor() { registerEventHandler<TestRequest>(*this); }
+    void onEvent(const TestRequest &request)
+    {
+        if (request.value == REJECT_VALUE)
+        {
+            throw ReturnToSenderException();
+        }
+        if (request.value != IGNORE_VALUE)
+        {
+            Event::Pipe(*this, request.getSourceActorId()).push<TestResponse>(request);
+        }
+    }
+};
+
+struct TestAskActor : Actor
+{
+    struct Result
+    {
+        int okCount;
+        int timeOutCount;
+        int undeliveredCount;
+        int cancelledCount;
+        bool valueFlag;
+        bool pendingFlag;
+        WaitCondition doneCondition;
+        inline Result()
+            : okCount(0), timeOutCount(0), undeliveredCount(0), cancelledCount(0), valueFlag(true), pendingFlag(true)
+        {
+        }
+    };
+
+    Result &result;
+    AskProxy askProxy;
+
+    TestAskActor(Result *presult) : result(*presult), askProxy(*this, Time::Millisecond(1))
+    {
+        const ActorId &responderActorId = newReferencedActor<TestResponderActor>()->getActorId();
+        for (int i = 0; i < ANSWERED_COUNT; ++i)
+        {
+            askProxy.ask<TestRequest, TestResponse>(responderActorId, Time(),
+                                                    [this, i](AskProxy::Status status, const TestResponse *response) {
+                                                        result.valueFlag = result.valueFlag && status == AskProxy::OK &&
+                                                                           response != 0 && response->value == 2 * i;
+                                                        ++result.okCount;
+                                                        onCompletion();
+                                                    },
+                                                    i);
+        }
+        askProxy.ask<TestRequest, TestResponse>(responderActorId, Time::Millisecond(1000),
+                                                [this](AskProxy::Status status, const TestResponse *response) {
+                                                    result.valueFlag = result.valueFlag &&
+                                                                       status == AskProxy::UNDELIVERED && response == 0;
+                                                    ++result.undeliveredCount;
+                                                    onCompletion();
+                                                },
+                                                REJECT_VALUE);
+        askProxy.ask<TestRequest, TestResponse>(responderActorId, Time::Millisecond(3),
+                                                [this](AskProxy::Status status, const TestResponse *response) {
+                                                    result.valueFlag = result.valueFlag &&
+                                                                       status == AskProxy::TIMEOUT && response == 0;
+                                                    ++result.timeOutCount;
+                                                    onCompletion();
+                                                },
+                                                IGNORE_VALUE);
+        const AskProxy::CorrelationId cancelledId = askProxy.ask<TestRequest, TestResponse>(
+            responderActorId, Time::Millisecond(1),
+            [this](AskProxy::Status, const TestResponse *) { ++result.cancelledCount; }, IGNORE_VALUE);
+        result.pendingFlag = askProxy.isPending(cancelledId) && askProxy.getPendingCount() == ANSWERED_COUNT + 3 &&
+                             askProxy.cancel(cancelledId) && !askProxy.isPending(cancelledId) &&
+                             !askProxy.cancel(cancelledId);
+    }
+    void onCompletion()
+    {
+        if (result.okCount + result.timeOutCount + result.undeliveredCount == ANSWERED_COUNT + 2)
+        {
+            result.pendingFlag = result.pendingFlag && askProxy.getPendingCount() == 0;
+            requestDestroy();
+            result.doneCondition.notify();
+        }
+    }
+};
+
+void testAsk()
+{
+    TestAskActor::Result result;
+    {
+        Engine::StartSequence startSequence;
+        startSequence.addActor<TestAskActor>(0, &result);
+        TestEngine engine(startSequence);
+        result.doneCondition.wait();
+    }
+    ASSERT_EQ(ANSWERED_COUNT, result.okCount);
+    ASSERT_EQ(1, result.timeOutCount);
+    ASSERT_EQ(1, result.undeliveredCount);
+    ASSERT_EQ(0, result.cancelledCount);
+    ASSERT_TRUE(result.valueFlag);
+    ASSERT_TRUE(result.pendingFlag);
+}
+
+} // namespace
+
+TEST(Ask, ask) { testAsk(); }
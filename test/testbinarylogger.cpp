@@ -0,0 +1,159 @@
+/**
+ * @file testbinarylogger.cpp
+ * @brief test asynchronous per-core binary logger
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#define TREDZONE_LOG_MIN_SEVERITY 1 // debug entries filtered out
+#include "trz/util/binarylogger.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+const BinaryLogger::Format ENTRY_FORMAT = {BinaryLogger::SEVERITY_INFO, "entry {}"};
+
+enum TestSide
+{
+    BUY = 1,
+    SELL
+};
+
+struct TestFile
+{
+    char path[32];
+    int fd;
+
+    TestFile()
+    {
+        std::snprintf(path, sizeof(path), "/tmp/testbinaryloggerXXXXXX");
+        fd = mkstemp(path);
+    }
+    ~TestFile()
+    {
+        close(fd);
+        unlink(path);
+    }
+    string read() const
+    {
+        string ret;
+        FILE *file = fopen(path, "r");
+        char buffer[4096];
+        for (size_t n; file != 0 && (n = fread(buffer, 1, sizeof(buffer), file)) != 0;)
+        {
+            ret.append(buffer, n);
+        }
+        if (file != 0)
+        {
+            fclose(file);
+        }
+        return ret;
+    }
+};
+
+struct TestActor : Actor, Actor::Callback
+{
+    WaitCondition &doneCondition;
+
+    TestActor(WaitCondition *pdoneCondition) : doneCondition(*pdoneCondition) { registerCallback(*this); }
+    void onCallback()
+    {
+        const string name("ABC");
+        TREDZONE_LOG_INFO("order {} {} {} at {} x{} ({}) {}", 42, name, SELL, 1.5, (unsigned char)3, true, 'z');
+        TREDZONE_LOG_ERROR("no argument {}");
+        doneCondition.notify();
+    }
+};
+
+void testFormat()
+{
+    TestFile file;
+    ASSERT_NE(-1, file.fd);
+    {
+        BinaryLogger logger(file.fd);
+        ASSERT_THROW(BinaryLogger(file.fd), BinaryLogger::AlreadyRunningException);
+        WaitCondition doneCondition;
+        {
+            Engine::CoreSet coreSet;
+            coreSet.set(0);
+            Engine::StartSequence startSequence(coreSet);
+            startSequence.addActor<TestActor>(0, &doneCondition);
+            TestEngine engine(startSequence);
+            doneCondition.wait();
+        }
+        const char *nullString = 0;
+        int i = 0;
+        TREDZONE_LOG_WARNING("{} {} {}", -7, nullString, (const void *)0x1234);
+        TREDZONE_LOG_DEBUG("filtered out {}", ++i);
+        ASSERT_EQ(0, i);
+        TREDZONE_LOG_INFO("too many {}", 1, 2);
+        // destructor writes the pending entries
+    }
+    const string output = file.read();
+    ASSERT_NE(string::npos, output.find(" INFO    cpu")) << output;
+    ASSERT_NE(string::npos, output.find(" order 42 ABC 2 at 1.5 x3 (true) z\n")) << output;
+    ASSERT_NE(string::npos, output.find(" ERROR   cpu")) << output;
+    ASSERT_NE(string::npos, output.find(" no argument {}\n")) << output;
+    ASSERT_NE(string::npos, output.find(" WARNING cpu")) << output;
+    ASSERT_NE(string::npos, output.find(" -7  0x1234\n")) << output;
+    ASSERT_NE(string::npos, output.find(" too many 1\n")) << output;
+    ASSERT_EQ(string::npos, output.find("filtered out")) << output;
+    // "YYYY-MM-DD HH:MM:SS.nnnnnnnnn "
+    ASSERT_LT(30u, output.size());
+    ASSERT_EQ('-', output[4]);
+    ASSERT_EQ('.', output[19]);
+    ASSERT_EQ(' ', output[29]);
+}
+
+void testDrop()
+{
+    static const int ENTRY_COUNT = 100;
+    TestFile file;
+    ASSERT_NE(-1, file.fd);
+    const uint64_t droppedCount = BinaryLogger::getDroppedCount();
+    int loggedCount = 0;
+    BinaryLogger::setRingCapacity(256);
+    // new thread: new (small) ring, logged before the logger is running
+    std::thread thread([&loggedCount] {
+        for (int i = 0; i < ENTRY_COUNT; ++i)
+        {
+            if (BinaryLogger::log(ENTRY_FORMAT, ENTRY_FORMAT.text, i))
+            {
+                ++loggedCount;
+            }
+        }
+    });
+    thread.join();
+    BinaryLogger::setRingCapacity(BinaryLogger::DEFAULT_RING_CAPACITY);
+    ASSERT_LT(0, loggedCount);
+    ASSERT_GT(ENTRY_COUNT, loggedCount);
+    ASSERT_EQ((uint64_t)(ENTRY_COUNT - loggedCount), BinaryLogger::getDroppedCount() - droppedCount);
+    {
+        BinaryLogger logger(file.fd);
+    }
+    const string output = file.read();
+    ASSERT_NE(string::npos, output.find(" entry 0\n")) << output;
+    ASSERT_EQ(string::npos, output.find(" entry " + to_string(ENTRY_COUNT - 1) + "\n")) << output;
+    ASSERT_NE(string::npos, output.find(" " + to_string(ENTRY_COUNT - loggedCount) + " log entries dropped"))
+        << output;
+}
+
+} // anonymous namespace
+
+TEST(BinaryLogger, format) { testFormat(); }
+TEST(BinaryLogger, drop) { testDrop(); }
@@ -0,0 +1,168 @@
+/**
+ * @file testcoroutine.cpp
+ * @brief test C++20 coroutines for actor handlers
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <stdexcept>
+
+#include "gtest/gtest.h"
+
+#include "trz/util/coroutine.h"
+
+#include "testutil.h"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const int REJECT_VALUE = -1;
+static const int IGNORE_VALUE = -2;
+
+struct TestRequest : AskProxy::RequestEvent
+{
+    int value;
+    inline TestRequest(int pvalue) noexcept : value(pvalue) {}
+};
+
+struct TestResponse : AskProxy::ResponseEvent
+{
+    int value;
+    inline TestResponse(const TestRequest &request) noexcept
+        : AskProxy::ResponseEvent(request), value(2 * request.value)
+    {
+    }
+};
+
+struct TestResponderActor : Actor
+{
+    TestResponderActor() { registerEventHandler<TestRequest>(*this); }
+    void onEvent(const TestRequest &request)
+    {
+        if (request.value == REJECT_VALUE)
+        {
+            throw ReturnToSenderException();
+        }
+        if (request.value != IGNORE_VALUE)
+        {
+            Event::Pipe(*this, request.getSourceActorId()).push<TestResponse>(request);
+        }
+    }
+};
+
+struct TestCoroutineActor : Actor
+{
+    struct Result
+    {
+        int step;
+        int answer;
+        bool undeliveredFlag;
+        bool timeOutFlag;
+        bool exceptionFlag;
+        bool sleepFlag;
+        bool cancelFlag;
+        WaitCondition doneCondition;
+        inline Result()
+            : step(0), answer(0), undeliveredFlag(false), timeOutFlag(false), exceptionFlag(false), sleepFlag(false),
+              cancelFlag(false)
+        {
+        }
+    };
+
+    Result &result;
+    AskProxy askProxy;
+    ActorReference<TestResponderActor> responder;
+    const ActorId responderActorId;
+    coroutine::Task<> task;
+    coroutine::Task<> abandonedTask;
+
+    TestCoroutineActor(Result *presult)
+        : result(*presult), askProxy(*this), responder(newReferencedActor<TestResponderActor>()),
+          responderActorId(responder->getActorId())
+    {
+        task = run();
+        EXPECT_FALSE(task.isDone()); // lazily started
+        task.start();
+    }
+
+    coroutine::Task<int> twice(int value)
+    {
+        co_await coroutine::nextIteration(*this);
+        co_return 2 * value;
+    }
+    coroutine::Task<int> fail()
+    {
+        co_await coroutine::nextIteration(*this);
+        throw std::runtime_error("fail");
+    }
+    coroutine::Task<> waitForever()
+    {
+        co_await coroutine::ask<TestRequest, TestResponse>(askProxy, responderActorId, Time(), IGNORE_VALUE);
+    }
+    coroutine::Task<> run()
+    {
+        result.step = 1;
+        co_await coroutine::nextIteration(*this);
+        result.step = 2;
+        const int doubled = co_await twice(10);
+        coroutine::AskResult<TestResponse> reply =
+            co_await coroutine::ask<TestRequest, TestResponse>(askProxy, responderActorId, Time(), doubled);
+        result.answer = reply.status == AskProxy::OK ? reply.response->value : 0;
+        reply = co_await coroutine::ask<TestRequest, TestResponse>(askProxy, responderActorId, Time::Millisecond(500),
+                                                                   REJECT_VALUE);
+        result.undeliveredFlag = reply.status == AskProxy::UNDELIVERED && reply.response == 0;
+        reply = co_await coroutine::ask<TestRequest, TestResponse>(askProxy, responderActorId, Time::Millisecond(2),
+                                                                   IGNORE_VALUE);
+        result.timeOutFlag = reply.status == AskProxy::TIMEOUT && reply.response == 0;
+        try
+        {
+            co_await fail();
+        }
+        catch (std::runtime_error &)
+        {
+            result.exceptionFlag = true;
+        }
+        const Time startTime = HighResolutionTime()();
+        co_await coroutine::sleep(*this, Time::Millisecond(3));
+        result.sleepFlag = HighResolutionTime()() - startTime >= Time::Millisecond(3);
+        // destroying a suspended task cancels what it awaits
+        abandonedTask = waitForever();
+        abandonedTask.start();
+        result.cancelFlag = askProxy.getPendingCount() == 1;
+        abandonedTask = coroutine::Task<>();
+        result.cancelFlag = result.cancelFlag && askProxy.getPendingCount() == 0;
+        result.step = 3;
+        requestDestroy();
+        result.doneCondition.notify();
+    }
+};
+
+void testCoroutine()
+{
+    TestCoroutineActor::Result result;
+    {
+        Engine::StartSequence startSequence;
+        startSequence.addActor<TestCoroutineActor>(0, &result);
+        TestEngine engine(startSequence);
+        result.doneCondition.wait();
+    }
+    ASSERT_EQ(3, result.step);
+    ASSERT_EQ(40, result.answer);
+    ASSERT_TRUE(result.undeliveredFlag);
+    ASSERT_TRUE(result.timeOutFlag);
+    ASSERT_TRUE(result.exceptionFlag);
+    ASSERT_TRUE(result.sleepFlag);
+    ASSERT_TRUE(result.cancelFlag);
+}
+
+} // namespace
+
+TEST(Coroutine, task) { testCoroutine(); }
+
+#endif // __cpp_impl_coroutine
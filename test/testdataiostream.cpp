@@ -7,7 +7,9 @@
 
 #include <gtest/gtest.h>
 #include <iostream>
+#include <limits>
 #include <sstream>
+#include <vector>
 
 #include "trz/engine/internal/datastream.h"
 
@@ -76,4 +78,95 @@ void testInit()
     EXPECT_EQ(istruct.m_i32, ostruct.m_i32);
 }
 
+static
+void testBuffer()
+{
+    const TestStruct    istruct(0x01020304, "le string dans la raie", 0xffffffffffffff64ull, true, 0x0016u, -7);
+    
+    // stream -> buffer reader
+    ostringstream       oss;
+    DataOutputStream<>  dos(oss);
+    
+    dos << istruct;
+    
+    const string        serialized = oss.str();
+    DataBufferReader<>  reader(serialized.data(), serialized.size());
+    TestStruct          ostruct;
+    
+    reader >> ostruct.m_ui32 >> ostruct.m_s >> ostruct.m_ui64 >> ostruct.m_b >> ostruct.m_i16 >> ostruct.m_i32;
+    EXPECT_EQ(0u, reader.GetRemainingSize());
+    EXPECT_EQ(istruct.m_ui32, ostruct.m_ui32);
+    EXPECT_EQ(istruct.m_s, ostruct.m_s);
+    EXPECT_EQ(istruct.m_ui64, ostruct.m_ui64);
+    EXPECT_EQ(istruct.m_b, ostruct.m_b);
+    EXPECT_EQ(istruct.m_i16, ostruct.m_i16);
+    EXPECT_EQ(istruct.m_i32, ostruct.m_i32);
+    EXPECT_THROW(reader.Read8(), DataBufferOutOfBoundsException);
+    
+    // buffer writer -> same bytes as stream
+    char                buffer[256];
+    DataBufferWriter<>  writer(buffer, sizeof(buffer));
+    
+    writer << istruct.m_ui32 << istruct.m_s << istruct.m_ui64 << istruct.m_b << istruct.m_i16 << istruct.m_i32;
+    EXPECT_EQ(serialized, string(buffer, writer.GetSize()));
+    
+    // batched bounds check
+    DataBufferWriter<>  smallWriter(buffer, 6);
+    
+    EXPECT_THROW(smallWriter.Require(8), DataBufferOutOfBoundsException);
+    smallWriter.Require(6);
+    smallWriter.Put32(1).Put16(2);
+    EXPECT_THROW(smallWriter.Write8(3), DataBufferOutOfBoundsException);
+    EXPECT_THROW(DataBufferWriter<>(buffer, 8).WriteString(istruct.m_s), DataBufferOutOfBoundsException);
+}
+
+template <bool _SWAP_F>
+void testBufferArray()
+{
+    static const size_t N = 1000;
+    vector<uint16_t>    a16(N), b16(N);
+    vector<uint32_t>    a32(N), b32(N);
+    vector<uint64_t>    a64(N), b64(N);
+    
+    for (size_t i = 0; i < N; ++i)
+    {
+        a16[i] = (uint16_t)(i * 0x0101u);
+        a32[i] = (uint32_t)(i * 0x01020304u);
+        a64[i] = i * 0x0102030405060708ull;
+    }
+    
+    vector<char>                buffer(N * (2 + 4 + 8));
+    DataBufferWriter<_SWAP_F>   writer(buffer.data(), buffer.size());
+    
+    // element count whose byte size wraps around to 8
+    const size_t    overflowCount = numeric_limits<size_t>::max() / sizeof(uint64_t) + 2;
+    EXPECT_THROW(writer.Write64Array(a64.data(), overflowCount), DataBufferOutOfBoundsException);
+    writer.Write16Array(a16.data(), N).Write32Array(a32.data(), N).Write64Array(a64.data(), N);
+    EXPECT_EQ(buffer.size(), writer.GetSize());
+    EXPECT_THROW(writer.Write16Array(a16.data(), 1), DataBufferOutOfBoundsException);
+    
+    // arrays are read back element-wise by the stream
+    istringstream               iss(string(buffer.data(), buffer.size()));
+    DataInputStream<_SWAP_F>    dis(iss);
+    
+    EXPECT_EQ(a16[0], dis.Read16());
+    EXPECT_EQ(a16[1], dis.Read16());
+    
+    DataBufferReader<_SWAP_F>   reader(buffer.data(), buffer.size());
+    
+    EXPECT_THROW(reader.Read64Array(b64.data(), overflowCount), DataBufferOutOfBoundsException);
+    reader.Read16Array(b16.data(), N);
+    reader.Read32Array(b32.data(), N);
+    reader.Read64Array(b64.data(), 0);
+    EXPECT_THROW(reader.Read64Array(b64.data(), N + 1), DataBufferOutOfBoundsException);
+    reader.Read64Array(b64.data(), N);
+    EXPECT_EQ(a16, b16);
+    EXPECT_EQ(a32, b32);
+    EXPECT_EQ(a64, b64);
+    EXPECT_EQ(0u, reader.GetRemainingSize());
+}
+
 TEST(DataStream, init) { testInit(); }
+TEST(DataStream, buffer) { testBuffer(); }
+TEST(DataStream, bufferArray) { testBufferArray<false>(); }
+TEST(DataStream, bufferArraySwap) { testBufferArray<true>(); }
@@ -0,0 +1,156 @@
+/**
+ * @file testegress.cpp
+ * @brief test actor to external-thread egress channel
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/egress.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const unsigned VALUE_COUNT = 50000;
+
+void testSingleThread()
+{
+    EgressChannel<std::string> channel(3, false);
+    ASSERT_EQ(4u, channel.getCapacity());
+    ASSERT_TRUE(channel.empty());
+    std::string value;
+    ASSERT_FALSE(channel.tryPop(value));
+    ASSERT_TRUE(channel.tryPush("a"));
+    ASSERT_TRUE(channel.tryPush(3u, 'b'));
+    const char *batch[] = {"c", "d", "e"};
+    ASSERT_EQ(2u, channel.tryPushBatch(batch, batch + 3));
+    ASSERT_FALSE(channel.tryPush("f"));
+    ASSERT_EQ(4u, channel.size());
+    ASSERT_TRUE(channel.tryPop(value));
+    ASSERT_EQ("a", value);
+    std::vector<std::string> values;
+    ASSERT_EQ(2u, channel.popBatch(std::back_inserter(values), 2));
+    ASSERT_EQ("bbb", values[0]);
+    ASSERT_EQ("c", values[1]);
+    ASSERT_TRUE(channel.tryPush("f"));
+    size_t totalSize = 0;
+    ASSERT_EQ(2u, channel.consume([&totalSize](std::string &s) { totalSize += s.size(); }));
+    ASSERT_EQ(2u, totalSize);
+    ASSERT_TRUE(channel.empty());
+    ASSERT_FALSE(channel.wait());
+    ASSERT_TRUE(channel.tryPush("left in the channel on destruction"));
+}
+
+struct TestThrowingOutput
+{
+    std::vector<unsigned> &values;
+    size_t throwCount;
+
+    inline TestThrowingOutput(std::vector<unsigned> &pvalues, size_t pthrowCount)
+        : values(pvalues), throwCount(pthrowCount)
+    {
+    }
+    inline TestThrowingOutput &operator*() { return *this; }
+    inline TestThrowingOutput &operator++() { return *this; }
+    inline TestThrowingOutput &operator=(unsigned value)
+    {
+        if (values.size() == throwCount)
+        {
+            throw std::runtime_error("TestThrowingOutput");
+        }
+        values.push_back(value);
+        return *this;
+    }
+};
+
+void testPopBatchThrow()
+{
+    EgressChannel<unsigned> channel(4, false);
+    const unsigned batch[] = {1, 2, 3};
+    ASSERT_EQ(3u, channel.tryPushBatch(batch, batch + 3));
+    std::vector<unsigned> values;
+    ASSERT_THROW(channel.popBatch(TestThrowingOutput(values, 1), 3), std::runtime_error);
+    // the value that failed is left in the channel
+    ASSERT_EQ(2u, channel.size());
+    ASSERT_EQ(2u, channel.popBatch(TestThrowingOutput(values, 3), 3));
+    ASSERT_TRUE(channel.empty());
+    ASSERT_EQ(3u, values.size());
+    ASSERT_EQ(2u, values[1]);
+    ASSERT_EQ(3u, values[2]);
+}
+
+typedef EgressChannel<unsigned> TestEgressChannel;
+
+struct TestEgressActor : Actor, Actor::Callback
+{
+    TestEgressChannel &channel;
+    unsigned nextValue;
+
+    TestEgressActor(TestEgressChannel *pchannel) : channel(*pchannel), nextValue(0) { registerCallback(*this); }
+    void onCallback() noexcept
+    {
+        // push a burst per event-loop iteration, retry on full at next iteration
+        for (unsigned i = 0; i < 100 && nextValue < VALUE_COUNT && channel.tryPush(nextValue); ++i)
+        {
+            ++nextValue;
+        }
+        if (nextValue < VALUE_COUNT)
+        {
+            registerCallback(*this);
+        }
+        else
+        {
+            channel.close();
+            requestDestroy();
+        }
+    }
+};
+
+void consume(TestEgressChannel &channel, unsigned &receivedCount, bool &orderFlag)
+{
+    unsigned buffer[64];
+    while (channel.wait(Time(100 * 1000 * 1000)) || !channel.isClosed())
+    {
+        for (size_t i = 0, n = channel.popBatch(buffer, 64); i < n; ++i)
+        {
+            orderFlag = orderFlag && buffer[i] == receivedCount;
+            ++receivedCount;
+        }
+    }
+    receivedCount += (unsigned)channel.consume([](unsigned) {});
+}
+
+void testActorToThread(bool blockingFlag)
+{
+    TestEgressChannel channel(256, blockingFlag);
+    unsigned receivedCount = 0;
+    bool orderFlag = true;
+    std::thread consumer(consume, std::ref(channel), std::ref(receivedCount), std::ref(orderFlag));
+    {
+        Engine::StartSequence startSequence;
+        startSequence.addActor<TestEgressActor>(0, &channel);
+        TestEngine engine(startSequence);
+        consumer.join();
+    }
+    ASSERT_EQ(VALUE_COUNT, receivedCount);
+    ASSERT_TRUE(orderFlag);
+}
+
+} // namespace
+
+TEST(Egress, singleThread) { testSingleThread(); }
+TEST(Egress, popBatchThrow) { testPopBatchThrow(); }
+TEST(Egress, actorToBlockingThread) { testActorToThread(true); }
+TEST(Egress, actorToPollingThread) { testActorToThread(false); }
@@ -0,0 +1,196 @@
+/**
+ * @file testflatmap.cpp
+ * @brief test flat hash map/set & sorted flat map
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <map>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+
+#include "gtest/gtest.h"
+
+#include "trz/util/flathashmap.h"
+#include "trz/util/sortedflatmap.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+typedef FlatHashMap<uint64_t, string, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                    std::allocator<std::pair<const uint64_t, string>>>
+    TestFlatHashMap;
+typedef FlatHashSet<int, std::hash<int>, std::equal_to<int>, std::allocator<int>> TestFlatHashSet;
+typedef SortedFlatMap<int, string, std::less<int>, std::allocator<std::pair<int, string>>> TestSortedFlatMap;
+
+void testFlatHashMap()
+{
+    TestFlatHashMap map;
+    ASSERT_TRUE(map.empty());
+    ASSERT_EQ(0u, map.bucket_count());
+    ASSERT_TRUE(map.find(1) == map.end());
+    ASSERT_TRUE(map.begin() == map.end());
+
+    ASSERT_TRUE(map.insert(std::make_pair(1, string("one"))).second);
+    ASSERT_FALSE(map.insert(std::make_pair(1, string("uno"))).second);
+    ASSERT_EQ("one", map.at(1));
+    map[2] = "two";
+    ASSERT_EQ(2u, map.size());
+    ASSERT_EQ(1u, map.count(2));
+    ASSERT_EQ(0u, map.count(3));
+    ASSERT_THROW(map.at(3), std::out_of_range);
+    ASSERT_TRUE(map.try_emplace(3, 5, 'x').second);
+    ASSERT_EQ("xxxxx", map[3]);
+
+    // differential check against std::unordered_map, with erasures to exercise tombstones
+    std::unordered_map<uint64_t, string> reference(map.begin(), map.end());
+    for (uint64_t i = 0; i < 20000; ++i)
+    {
+        uint64_t key = (i * 7919) % 5003;
+        if (i % 3 == 0)
+        {
+            ASSERT_EQ(reference.erase(key), map.erase(key));
+        }
+        else
+        {
+            ASSERT_EQ(reference.insert(std::make_pair(key, std::to_string(i))).second,
+                      map.insert(std::make_pair(key, std::to_string(i))).second);
+        }
+        ASSERT_EQ(reference.size(), map.size());
+    }
+    size_t n = 0;
+    for (TestFlatHashMap::const_iterator i = map.begin(), endi = map.end(); i != endi; ++i, ++n)
+    {
+        ASSERT_EQ(reference.at(i->first), i->second);
+    }
+    ASSERT_EQ(reference.size(), n);
+    ASSERT_LE(map.load_factor(), 0.875f);
+
+    // erase while iterating
+    for (TestFlatHashMap::iterator i = map.begin(); i != map.end();)
+    {
+        i = (i->first % 2 == 0) ? map.erase(i) : ++i;
+    }
+    for (TestFlatHashMap::const_iterator i = map.begin(), endi = map.end(); i != endi; ++i)
+    {
+        ASSERT_EQ(1u, i->first % 2);
+    }
+
+    TestFlatHashMap copy(map);
+    ASSERT_EQ(map.size(), copy.size());
+    TestFlatHashMap moved(std::move(copy));
+    ASSERT_TRUE(copy.empty());
+    ASSERT_EQ(map.size(), moved.size());
+
+    size_t capacity = map.bucket_count();
+    map.clear();
+    ASSERT_TRUE(map.empty());
+    ASSERT_EQ(capacity, map.bucket_count());
+    map.reserve(1000);
+    size_t reserved = map.bucket_count();
+    for (uint64_t i = 0; i < 1000; ++i)
+    {
+        map[i];
+    }
+    ASSERT_EQ(reserved, map.bucket_count());
+}
+
+void testFlatHashSet()
+{
+    TestFlatHashSet set;
+    for (int i = 0; i < 1000; ++i)
+    {
+        ASSERT_TRUE(set.insert(i).second);
+    }
+    for (int i = 0; i < 1000; ++i)
+    {
+        ASSERT_FALSE(set.insert(i).second);
+        ASSERT_EQ(1u, set.count(i));
+    }
+    for (int i = 0; i < 1000; i += 2)
+    {
+        ASSERT_EQ(1u, set.erase(i));
+    }
+    ASSERT_EQ(500u, set.size());
+    ASSERT_EQ(0u, set.count(0));
+    ASSERT_EQ(1u, set.count(1));
+
+    // keys are not modifiable in place
+    static_assert(std::is_same<const int &, decltype(*set.begin())>::value, "const set iterator");
+    static_assert(std::is_same<const int &, decltype(*set.insert(0).first)>::value, "const set iterator");
+    TestFlatHashSet::iterator i = set.find(1);
+    ASSERT_EQ(1, *i);
+    i = set.erase(i);
+    ASSERT_EQ(0u, set.count(1));
+    size_t n = 0;
+    for (TestFlatHashSet::const_iterator j = set.begin(), endj = set.end(); j != endj; ++j, ++n)
+    {
+    }
+    ASSERT_EQ(499u, n);
+}
+
+void testSortedFlatMap()
+{
+    TestSortedFlatMap map;
+    map[5] = "five";
+    map[1] = "one";
+    map[3] = "three";
+    map[7] = "seven";
+    ASSERT_FALSE(map.insert(std::make_pair(3, string("drei"))).second);
+    ASSERT_EQ(4u, map.size());
+    int previous = 0;
+    for (TestSortedFlatMap::const_iterator i = map.begin(), endi = map.end(); i != endi; ++i)
+    {
+        ASSERT_LT(previous, i->first);
+        previous = i->first;
+    }
+    ASSERT_EQ("three", map.at(3));
+    ASSERT_EQ(5, map.lower_bound(4)->first);
+    ASSERT_EQ(7, map.upper_bound(5)->first);
+    ASSERT_TRUE(map.find(4) == map.end());
+    ASSERT_EQ(1u, map.erase(5));
+    ASSERT_EQ(0u, map.erase(5));
+    ASSERT_THROW(map.at(5), std::out_of_range);
+    ASSERT_EQ(3u, map.size());
+}
+
+struct TestActorAllocatorActor : Actor
+{
+    TestActorAllocatorActor()
+    {
+        FlatHashMap<int, int> hashMap(getAllocator());
+        FlatHashSet<int> hashSet(getAllocator());
+        SortedFlatMap<int, int> sortedMap(getAllocator());
+        for (int i = 0; i < 1000; ++i)
+        {
+            hashMap[i] = i;
+            hashSet.insert(i);
+            sortedMap[1000 - i] = i;
+        }
+        EXPECT_EQ(1000u, hashMap.size());
+        EXPECT_EQ(1000u, hashSet.size());
+        EXPECT_EQ(1000u, sortedMap.size());
+        EXPECT_EQ(1, sortedMap.begin()->first);
+    }
+};
+
+void testActorAllocator()
+{
+    Engine::StartSequence startSequence;
+    startSequence.addActor<TestActorAllocatorActor>(0);
+    TestEngine engine(startSequence);
+}
+
+} // namespace
+
+TEST(FlatMap, flatHashMap) { testFlatHashMap(); }
+TEST(FlatMap, flatHashSet) { testFlatHashSet(); }
+TEST(FlatMap, sortedFlatMap) { testSortedFlatMap(); }
+TEST(FlatMap, actorAllocator) { testActorAllocator(); }
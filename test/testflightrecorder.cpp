@@ -0,0 +1,142 @@
+/**
+ * @file testflightrecorder.cpp
+ * @brief test per-core record of the last dispatched events
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/flightrecorder.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const unsigned EVENT_COUNT = 10;
+
+struct TestEvent : Actor::Event
+{
+};
+struct TestLastEvent : Actor::Event
+{
+};
+
+struct TestResult
+{
+    Actor::ActorId sourceActorId;
+    Actor::ActorId destinationActorId;
+    unsigned eventCount;
+    string dumpInHandler;
+    WaitCondition doneCondition;
+    inline TestResult() : eventCount(0) {}
+};
+
+struct TestDestinationActor : Actor, Actor::Callback
+{
+    TestResult &result;
+
+    TestDestinationActor(TestResult *presult) : result(*presult)
+    {
+        registerEventHandler<TestEvent>(*this);
+        registerEventHandler<TestLastEvent>(*this);
+    }
+    void onEvent(const TestEvent &) { ++result.eventCount; }
+    void onEvent(const TestLastEvent &)
+    {
+        // this handler's record is not finished yet
+        ostringstream os;
+        FlightRecorder::dumpAll(os);
+        result.dumpInHandler = os.str();
+        registerCallback(*this);
+    }
+    void onCallback() { result.doneCondition.notify(); }
+};
+
+struct TestSourceActor : Actor, Actor::Callback
+{
+    TestResult &result;
+    ActorReference<TestDestinationActor> destination;
+
+    TestSourceActor(TestResult *presult)
+        : result(*presult), destination(newReferencedActor<TestDestinationActor>(presult))
+    {
+        result.sourceActorId = getActorId();
+        result.destinationActorId = destination->getActorId();
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        Event::Pipe pipe(*this, destination->getActorId());
+        for (unsigned i = 0; i < EVENT_COUNT; ++i)
+        {
+            pipe.push<TestEvent>();
+        }
+        pipe.push<TestLastEvent>();
+    }
+};
+
+string recordPrefix(const TestResult &result, Actor::EventId eventClassId)
+{
+    ostringstream os;
+    os << " event#" << eventClassId << ' ' << (unsigned)result.sourceActorId.getNodeId() << '.'
+       << result.sourceActorId.getNodeActorId() << " -> " << (unsigned)result.destinationActorId.getNodeId() << '.'
+       << result.destinationActorId.getNodeActorId() << ' ';
+    return os.str();
+}
+
+void testDump()
+{
+    TestResult result;
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<TestSourceActor>(0, &result);
+    TestEngine engine(startSequence);
+    result.doneCondition.wait();
+
+    ASSERT_EQ(EVENT_COUNT, result.eventCount);
+    const string eventPrefix = recordPrefix(result, Actor::Event::getClassId<TestEvent>());
+    const string lastEventPrefix = recordPrefix(result, Actor::Event::getClassId<TestLastEvent>());
+    ASSERT_EQ(0u, result.dumpInHandler.find("flight recorder of node 0 (core 0), "));
+    ASSERT_EQ(EVENT_COUNT, countOf(result.dumpInHandler, eventPrefix + "cycles="));
+    ASSERT_EQ(1u, countOf(result.dumpInHandler, lastEventPrefix + "unfinished\n"));
+
+    ostringstream os;
+    FlightRecorder::dumpAll(os);
+    ASSERT_EQ(EVENT_COUNT, countOf(os.str(), eventPrefix + "cycles="));
+    ASSERT_EQ(1u, countOf(os.str(), lastEventPrefix + "cycles="));
+
+    // on signal
+    int fd[2];
+    ASSERT_EQ(0, pipe(fd));
+    ASSERT_EQ(0, fcntl(fd[0], F_SETFL, O_NONBLOCK));
+    ASSERT_TRUE(FlightRecorder::installSignalHandler(SIGUSR2, fd[1]));
+    raise(SIGUSR2);
+    signal(SIGUSR2, SIG_DFL);
+    string signalDump;
+    char buffer[4096];
+    for (ssize_t n; (n = read(fd[0], buffer, sizeof(buffer))) > 0;)
+    {
+        signalDump.append(buffer, (size_t)n);
+    }
+    close(fd[0]);
+    close(fd[1]);
+    ASSERT_EQ(EVENT_COUNT, countOf(signalDump, eventPrefix + "cycles="));
+    ASSERT_EQ(1u, countOf(signalDump, lastEventPrefix + "cycles="));
+}
+
+} // anonymous namespace
+
+TEST(FlightRecorder, dump) { testDump(); }
@@ -0,0 +1,143 @@
+/**
+ * @file testhardwarecounters.cpp
+ * @brief test per-core hardware performance counters
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/hardwarecounters.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const unsigned EVENT_COUNT = 100;
+
+struct TestEvent : Actor::Event
+{
+};
+
+struct TestResult
+{
+    unsigned eventCount;
+    WaitCondition doneCondition;
+    inline TestResult() : eventCount(0) {}
+};
+
+struct TestDestinationActor : Actor, Actor::Callback
+{
+    TestResult &result;
+
+    TestDestinationActor(TestResult *presult) : result(*presult) { registerEventHandler<TestEvent>(*this); }
+    void onEvent(const TestEvent &)
+    {
+        if (++result.eventCount == EVENT_COUNT)
+        {
+            registerCallback(*this);
+        }
+    }
+    void onCallback() { result.doneCondition.notify(); }
+};
+
+struct TestSourceActor : Actor, Actor::Callback
+{
+    ActorReference<TestDestinationActor> destination;
+
+    TestSourceActor(TestResult *presult) : destination(newReferencedActor<TestDestinationActor>(presult))
+    {
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        Event::Pipe pipe(*this, destination->getActorId());
+        for (unsigned i = 0; i < EVENT_COUNT; ++i)
+        {
+            pipe.push<TestEvent>();
+        }
+    }
+};
+
+const HardwareCounters::Attribution *findAttribution(const vector<HardwareCounters::CoreSnapshot> &coreSnapshots)
+{
+    for (size_t i = 0; i < coreSnapshots.size(); ++i)
+    {
+        for (size_t j = 0; j < coreSnapshots[i].attributions.size(); ++j)
+        {
+            if (coreSnapshots[i].attributions[j].eventClassId == Actor::Event::getClassId<TestEvent>())
+            {
+                return &coreSnapshots[i].attributions[j];
+            }
+        }
+    }
+    return 0;
+}
+
+void testAttribution()
+{
+    HardwareCounters::enable();
+    TestResult result;
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<TestSourceActor>(0, &result);
+    TestEngine engine(startSequence);
+    result.doneCondition.wait();
+    HardwareCounters::disable();
+
+    const vector<HardwareCounters::CoreSnapshot> coreSnapshots = HardwareCounters::snapshot();
+    ASSERT_EQ(1u, coreSnapshots.size());
+    ASSERT_EQ(0u, coreSnapshots[0].coreId);
+    const HardwareCounters::Attribution *attribution = findAttribution(coreSnapshots);
+    ASSERT_NE((const HardwareCounters::Attribution *)0, attribution);
+    ASSERT_EQ(EVENT_COUNT, attribution->dispatchCount);
+    ASSERT_LT(0u, attribution->tsc);
+    ASSERT_NE(string::npos, attribution->getActorTypeName().find("TestDestinationActor"))
+        << attribution->getActorTypeName();
+    if (coreSnapshots[0].availableFlag)
+    {
+        ASSERT_LT(0u, coreSnapshots[0].counters[HardwareCounters::INSTRUCTIONS]);
+    }
+    if (coreSnapshots[0].dispatchAvailableFlag)
+    {
+        ASSERT_LT(0u, attribution->counters[HardwareCounters::INSTRUCTIONS]);
+    }
+
+    ostringstream os;
+    HardwareCounters::report(os);
+    ostringstream line;
+    line << " event#" << Actor::Event::getClassId<TestEvent>() << ": " << EVENT_COUNT << " calls, tsc/call=";
+    ASSERT_EQ(0u, os.str().find("node 0 (core 0):")) << os.str();
+    ASSERT_NE(string::npos, os.str().find(line.str())) << os.str();
+}
+
+void testDisabled()
+{
+    TestResult result;
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<TestSourceActor>(0, &result);
+    TestEngine engine(startSequence);
+    result.doneCondition.wait();
+
+    const vector<HardwareCounters::CoreSnapshot> coreSnapshots = HardwareCounters::snapshot();
+    ASSERT_EQ(1u, coreSnapshots.size());
+    ASSERT_FALSE(coreSnapshots[0].availableFlag);
+    ASSERT_TRUE(coreSnapshots[0].attributions.empty());
+}
+
+} // anonymous namespace
+
+TEST(HardwareCounters, attribution) { testAttribution(); }
+TEST(HardwareCounters, disabled) { testDisabled(); }
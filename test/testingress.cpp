@@ -0,0 +1,181 @@
+/**
+ * @file testingress.cpp
+ * @brief test external-thread ingress channel
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/ingress.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+struct TestIngressPayload
+{
+    unsigned producer;
+    unsigned sequence;
+    std::string text;
+    inline TestIngressPayload(unsigned pproducer, unsigned psequence)
+        : producer(pproducer), sequence(psequence), text(std::to_string(psequence))
+    {
+    }
+};
+
+struct TestIngressEvent : Actor::Event
+{
+    unsigned producer;
+    unsigned sequence;
+    bool textCheckFlag;
+    inline TestIngressEvent(TestIngressPayload &&payload)
+        : producer(payload.producer), sequence(payload.sequence),
+          textCheckFlag(payload.text == std::to_string(payload.sequence))
+    {
+    }
+};
+
+typedef IngressChannel<TestIngressEvent, TestIngressPayload> TestIngressChannel;
+
+static const unsigned PRODUCER_COUNT = 2;
+static const unsigned EVENT_COUNT_PER_PRODUCER = 20000;
+
+struct TestIngressActor : Actor
+{
+    struct Result
+    {
+        ActorId actorId;
+        unsigned receivedCount;
+        unsigned nextSequence[PRODUCER_COUNT];
+        bool orderFlag;
+        bool sourceFlag;
+        bool textFlag;
+        WaitCondition readyCondition;
+        WaitCondition doneCondition;
+        inline Result() : receivedCount(0), orderFlag(true), sourceFlag(true), textFlag(true)
+        {
+            for (unsigned i = 0; i < PRODUCER_COUNT; ++i)
+            {
+                nextSequence[i] = 0;
+            }
+        }
+    };
+
+    Result &result;
+
+    TestIngressActor(Result *presult) : result(*presult)
+    {
+        registerEventHandler<TestIngressEvent>(*this);
+        result.actorId = getActorId();
+        result.readyCondition.notify();
+    }
+    void onEvent(const TestIngressEvent &event)
+    {
+        result.sourceFlag = result.sourceFlag && IngressChannelBase::isIngressSourceActorId(event.getSourceActorId());
+        result.textFlag = result.textFlag && event.textCheckFlag;
+        result.orderFlag = result.orderFlag && event.producer < PRODUCER_COUNT &&
+                           result.nextSequence[event.producer] == event.sequence;
+        ++result.nextSequence[event.producer];
+        if (++result.receivedCount == PRODUCER_COUNT * EVENT_COUNT_PER_PRODUCER)
+        {
+            requestDestroy();
+            result.doneCondition.notify();
+        }
+    }
+};
+
+void produce(TestIngressChannel &channel, unsigned producer)
+{
+    for (unsigned i = 0; i < EVENT_COUNT_PER_PRODUCER; ++i)
+    {
+        while (!channel.tryPush(producer, i))
+        {
+            threadYield();
+        }
+    }
+}
+
+void testMultipleProducers()
+{
+    TestIngressActor::Result result;
+    {
+        Engine::StartSequence startSequence;
+        startSequence.addActor<TestIngressActor>(0, &result);
+        TestEngine engine(startSequence);
+        result.readyCondition.wait();
+
+        TestIngressChannel channel(engine, result.actorId, 64);
+        ASSERT_EQ(64u, channel.getCapacity());
+        ASSERT_EQ(result.actorId, channel.getDestinationActorId());
+        std::thread producers[PRODUCER_COUNT];
+        for (unsigned i = 0; i < PRODUCER_COUNT; ++i)
+        {
+            producers[i] = std::thread(produce, std::ref(channel), i);
+        }
+        for (unsigned i = 0; i < PRODUCER_COUNT; ++i)
+        {
+            producers[i].join();
+        }
+        result.doneCondition.wait();
+    }
+    ASSERT_EQ(PRODUCER_COUNT * EVENT_COUNT_PER_PRODUCER, result.receivedCount);
+    ASSERT_TRUE(result.orderFlag);
+    ASSERT_TRUE(result.sourceFlag);
+    ASSERT_TRUE(result.textFlag);
+}
+
+void testClosedChannelIsDrained()
+{
+    TestIngressActor::Result result;
+    Engine::StartSequence startSequence;
+    startSequence.addActor<TestIngressActor>(0, &result);
+    TestEngine engine(startSequence);
+    result.readyCondition.wait();
+    for (unsigned producer = 0; producer < PRODUCER_COUNT; ++producer)
+    {
+        // channel destroyed right after pushing: pending entries are still delivered
+        TestIngressChannel channel(engine, result.actorId, PRODUCER_COUNT * EVENT_COUNT_PER_PRODUCER);
+        produce(channel, producer);
+    }
+    result.doneCondition.wait();
+    ASSERT_TRUE(result.orderFlag);
+}
+
+void testFullAndUndelivered()
+{
+    TestIngressActor::Result result;
+    std::unique_ptr<TestIngressChannel> channel;
+    {
+        Engine::StartSequence startSequence;
+        startSequence.addActor<TestIngressActor>(0, &result);
+        TestEngine engine(startSequence);
+        result.readyCondition.wait();
+
+        Actor::ActorId invalidActorId;
+        ASSERT_THROW(TestIngressChannel invalidChannel(engine, invalidActorId),
+                     IngressChannelBase::InvalidDestinationException);
+
+        channel.reset(new TestIngressChannel(engine, result.actorId, 2));
+        // destination is gone after engine shutdown: entries are dropped, channel outlives the engine
+    }
+    ASSERT_TRUE(channel->tryPush(0u, 0u));
+    ASSERT_TRUE(channel->tryPush(0u, 1u));
+    ASSERT_FALSE(channel->tryPush(0u, 2u));
+    channel.reset();
+}
+
+} // namespace
+
+TEST(Ingress, multipleProducers) { testMultipleProducers(); }
+TEST(Ingress, closedChannelIsDrained) { testClosedChannelIsDrained(); }
+TEST(Ingress, fullAndUndelivered) { testFullAndUndelivered(); }
@@ -0,0 +1,200 @@
+/**
+ * @file testlatencytracker.cpp
+ * @brief test end-to-end causal latency tracking across actor hops
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/latencytracker.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const unsigned ORIGIN_COUNT = 4;
+
+struct TestRequestEvent : Actor::Event
+{
+};
+struct TestReplyEvent : Actor::Event
+{
+};
+struct TestUntracedEvent : Actor::Event
+{
+};
+
+struct TestResult
+{
+    unsigned tracedRequestCount;
+    unsigned tracedReplyCount;
+    unsigned replyCount;
+    unsigned untracedCount;
+    WaitCondition doneCondition;
+    inline TestResult() : tracedRequestCount(0), tracedReplyCount(0), replyCount(0), untracedCount(0) {}
+};
+
+struct TestReplyActor : Actor, Actor::Callback
+{
+    TestResult &result;
+
+    TestReplyActor(TestResult *presult) : result(*presult)
+    {
+        registerEventHandler<TestReplyEvent>(*this);
+        registerEventHandler<TestUntracedEvent>(*this);
+    }
+    void onEvent(const TestReplyEvent &event)
+    {
+        result.tracedReplyCount += event.getTraceId() != 0 ? 1 : 0;
+        if (++result.replyCount == ORIGIN_COUNT)
+        {
+            registerCallback(*this);
+        }
+    }
+    void onEvent(const TestUntracedEvent &event) { result.untracedCount += event.getTraceId() == 0 ? 1 : 0; }
+    void onCallback() { result.doneCondition.notify(); }
+};
+
+struct TestRequestActor : Actor
+{
+    TestResult &result;
+    ActorReference<TestReplyActor> replyActor;
+
+    TestRequestActor(TestResult *presult)
+        : result(*presult), replyActor(newReferencedActor<TestReplyActor>(presult))
+    {
+        registerEventHandler<TestRequestEvent>(*this);
+    }
+    void onEvent(const TestRequestEvent &event)
+    {
+        result.tracedRequestCount += event.getTraceId() != 0 ? 1 : 0;
+        // inherits the trace of the handled event, if any
+        Event::Pipe(*this, replyActor->getActorId()).push<TestReplyEvent>();
+    }
+};
+
+struct TestOriginActor : Actor, Actor::Callback
+{
+    ActorReference<TestRequestActor> requestActor;
+
+    TestOriginActor(TestResult *presult) : requestActor(newReferencedActor<TestRequestActor>(presult))
+    {
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        Event::Pipe pipe(*this, requestActor->getActorId());
+        for (unsigned i = 0; i < ORIGIN_COUNT; ++i)
+        {
+            LatencyTracker::TraceScope traceScope;
+            pipe.push<TestRequestEvent>();
+        }
+        Event::Pipe(*this, requestActor->replyActor->getActorId()).push<TestUntracedEvent>();
+    }
+};
+
+void runEngine(TestResult &result)
+{
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<TestOriginActor>(0, &result);
+    TestEngine engine(startSequence);
+    result.doneCondition.wait();
+}
+
+void testPath()
+{
+    LatencyTracker::clear();
+    LatencyTracker::enable();
+    TestResult result;
+    runEngine(result);
+    LatencyTracker::disable();
+
+    if (!LatencyTracker::isAvailable())
+    {
+        // compiled out (TREDZONE_LATENCY_TRACKER): enable() has no effect
+        ASSERT_EQ(0u, result.tracedRequestCount);
+        ASSERT_EQ(0u, result.tracedReplyCount);
+        ASSERT_TRUE(LatencyTracker::aggregate().empty());
+        return;
+    }
+
+    ASSERT_EQ(ORIGIN_COUNT, result.tracedRequestCount);
+    ASSERT_EQ(ORIGIN_COUNT, result.tracedReplyCount);
+    ASSERT_EQ(1u, result.untracedCount);
+
+    const vector<LatencyTracker::PathStats> pathStats = LatencyTracker::aggregate();
+    ASSERT_EQ(1u, pathStats.size());
+    ostringstream path;
+    path << "event#" << Actor::Event::getClassId<TestRequestEvent>() << "@0 > event#"
+         << Actor::Event::getClassId<TestReplyEvent>() << "@0";
+    ASSERT_EQ(path.str(), pathStats[0].path);
+    ASSERT_EQ(ORIGIN_COUNT, pathStats[0].traceCount);
+    ASSERT_EQ(2u, pathStats[0].hops.size());
+    ASSERT_EQ(Actor::Event::getClassId<TestRequestEvent>(), pathStats[0].hops[0].eventClassId);
+    ASSERT_EQ(Actor::Event::getClassId<TestReplyEvent>(), pathStats[0].hops[1].eventClassId);
+    for (size_t i = 0; i < pathStats[0].hops.size(); ++i)
+    {
+        ASSERT_LE(0., pathStats[0].hops[i].queueMicroseconds);
+        ASSERT_LE(0., pathStats[0].hops[i].waitMicroseconds);
+        ASSERT_LE(0., pathStats[0].hops[i].handlerMicroseconds);
+        ASSERT_LE(pathStats[0].hops[i].handlerMicroseconds, pathStats[0].meanEndToEndMicroseconds);
+    }
+    ASSERT_LE(pathStats[0].meanEndToEndMicroseconds, pathStats[0].maxEndToEndMicroseconds);
+
+    ostringstream os;
+    LatencyTracker::report(os);
+    ASSERT_EQ(0u, os.str().find(path.str() + ": 4 traces, end-to-end mean ")) << os.str();
+}
+
+void testSampling()
+{
+    LatencyTracker::clear();
+    LatencyTracker::enable(2);
+    TestResult result;
+    runEngine(result);
+    LatencyTracker::disable();
+
+    if (!LatencyTracker::isAvailable())
+    {
+        // compiled out (TREDZONE_LATENCY_TRACKER): enable() has no effect
+        ASSERT_EQ(0u, result.tracedRequestCount);
+        ASSERT_EQ(0u, result.tracedReplyCount);
+        ASSERT_TRUE(LatencyTracker::aggregate().empty());
+        return;
+    }
+
+    ASSERT_EQ(ORIGIN_COUNT / 2, result.tracedRequestCount);
+    ASSERT_EQ(ORIGIN_COUNT / 2, result.tracedReplyCount);
+    const vector<LatencyTracker::PathStats> pathStats = LatencyTracker::aggregate();
+    ASSERT_EQ(1u, pathStats.size());
+    ASSERT_EQ(ORIGIN_COUNT / 2, pathStats[0].traceCount);
+}
+
+void testDisabled()
+{
+    LatencyTracker::clear();
+    TestResult result;
+    runEngine(result);
+
+    ASSERT_EQ(0u, result.tracedRequestCount);
+    ASSERT_EQ(0u, result.tracedReplyCount);
+    ASSERT_TRUE(LatencyTracker::aggregate().empty());
+}
+
+} // anonymous namespace
+
+TEST(LatencyTracker, path) { testPath(); }
+TEST(LatencyTracker, sampling) { testSampling(); }
+TEST(LatencyTracker, disabled) { testDisabled(); }
@@ -0,0 +1,148 @@
+/**
+ * @file testlocalpipe.cpp
+ * @brief test synchronous same-core event pipe
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/localpipe.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const unsigned HOP_COUNT = 100;
+
+struct TestHopEvent : Actor::Event
+{
+    unsigned hop;
+    inline TestHopEvent(unsigned phop) noexcept : hop(phop) {}
+};
+struct TestUnhandledEvent : Actor::Event
+{
+};
+
+struct TestResult
+{
+    std::vector<unsigned> hops;
+    unsigned depth;
+    unsigned maxDepth;
+    unsigned undeliveredCount;
+    bool synchronousFlag;
+    WaitCondition doneCondition;
+    inline TestResult() : depth(0), maxDepth(0), undeliveredCount(0), synchronousFlag(false) {}
+};
+
+struct TestPeerActor : Actor
+{
+    TestResult &result;
+
+    TestPeerActor(TestResult *presult) : result(*presult)
+    {
+        registerEventHandler<TestHopEvent>(*this);
+    }
+    void onEvent(const TestHopEvent &event)
+    {
+        result.hops.push_back(event.hop);
+        result.maxDepth = std::max(++result.depth, result.maxDepth);
+        if (event.hop + 1 < HOP_COUNT)
+        {
+            // ping-pong between the two peers: deeper than LocalPipe::MAX_RECURSION_DEPTH
+            LocalPipe(*this, event.getSourceActorId()).push<TestHopEvent>(event.hop + 1);
+        }
+        --result.depth;
+    }
+};
+
+struct TestSourceActor : Actor, Actor::Callback
+{
+    TestResult &result;
+    ActorReference<TestPeerActor> peer;
+
+    TestSourceActor(TestResult *presult) : result(*presult), peer(newReferencedActor<TestPeerActor>(presult))
+    {
+        registerEventHandler<TestHopEvent>(*this);
+        registerUndeliveredEventHandler<TestUnhandledEvent>(*this);
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        LocalPipe pipe(*this, peer->getActorId());
+        pipe.push<TestHopEvent>(0u);
+        // all hops were handled, including the queued ones
+        result.synchronousFlag = result.hops.size() == HOP_COUNT && result.depth == 0;
+        // no handler registered by the destination: returned to the source, synchronously too
+        pipe.push<TestUnhandledEvent>();
+        EXPECT_EQ(1u, result.undeliveredCount);
+
+        requestDestroy();
+        result.doneCondition.notify();
+    }
+    void onEvent(const TestHopEvent &event)
+    {
+        result.hops.push_back(event.hop);
+        result.maxDepth = std::max(++result.depth, result.maxDepth);
+        if (event.hop + 1 < HOP_COUNT)
+        {
+            LocalPipe(*this, event.getSourceActorId()).push<TestHopEvent>(event.hop + 1);
+        }
+        --result.depth;
+    }
+    void onUndeliveredEvent(const TestUnhandledEvent &) { ++result.undeliveredCount; }
+};
+
+void testLocalPipe()
+{
+    TestResult result;
+    {
+        Engine::CoreSet coreSet;
+        coreSet.set(0);
+        Engine::StartSequence startSequence(coreSet);
+        startSequence.addActor<TestSourceActor>(0, &result);
+        TestEngine engine(startSequence);
+        result.doneCondition.wait();
+    }
+    ASSERT_TRUE(result.synchronousFlag);
+    ASSERT_EQ(HOP_COUNT, result.hops.size());
+    for (unsigned i = 0; i < HOP_COUNT; ++i)
+    {
+        ASSERT_EQ(i, result.hops[i]);
+    }
+    ASSERT_EQ(LocalPipe::MAX_RECURSION_DEPTH, result.maxDepth);
+    ASSERT_EQ(1u, result.undeliveredCount);
+}
+
+struct TestInvalidDestinationActor : Actor
+{
+    TestInvalidDestinationActor(WaitCondition *doneCondition)
+    {
+        EXPECT_THROW(LocalPipe(*this, ActorId()), LocalPipe::InvalidDestinationException);
+        requestDestroy();
+        doneCondition->notify();
+    }
+};
+
+void testInvalidDestination()
+{
+    WaitCondition doneCondition;
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<TestInvalidDestinationActor>(0, &doneCondition);
+    TestEngine engine(startSequence);
+    doneCondition.wait();
+}
+
+} // anonymous namespace
+
+TEST(LocalPipe, delivery) { testLocalPipe(); }
+TEST(LocalPipe, invalidDestination) { testInvalidDestination(); }
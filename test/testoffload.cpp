@@ -0,0 +1,132 @@
+/**
+ * @file testoffload.cpp
+ * @brief test blocking-call offload thread pool
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <stdexcept>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "trz/util/offloadpool.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const unsigned CALL_COUNT = 200;
+static const size_t MAX_IN_FLIGHT_COUNT = 4;
+
+struct TestOffloadActor : Actor
+{
+    struct Result
+    {
+        unsigned receivedCount;
+        unsigned exceptionCount;
+        bool boundFlag;
+        bool resultFlag;
+        bool threadFlag;
+        WaitCondition doneCondition;
+        inline Result() : receivedCount(0), exceptionCount(0), boundFlag(true), resultFlag(true), threadFlag(true) {}
+    };
+    struct Init
+    {
+        OffloadPool *pool;
+        Result *result;
+    };
+
+    Result &result;
+    OffloadPool::Proxy offload;
+    uint64_t requestIds[CALL_COUNT];
+    unsigned submittedCount;
+    const std::thread::id engineThreadId;
+
+    TestOffloadActor(const Init &init)
+        : result(*init.result), offload(*this, *init.pool, MAX_IN_FLIGHT_COUNT), submittedCount(0),
+          engineThreadId(std::this_thread::get_id())
+    {
+        registerEventHandler<OffloadPool::ResultEvent<std::string>>(*this);
+        submit();
+        // in-flight bound reached
+        result.boundFlag = offload.getInFlightCount() == MAX_IN_FLIGHT_COUNT &&
+                           offload.submit<std::string>([]() { return std::string(); }) == 0;
+    }
+    void submit()
+    {
+        for (; submittedCount < CALL_COUNT && offload.getInFlightCount() < MAX_IN_FLIGHT_COUNT; ++submittedCount)
+        {
+            const unsigned i = submittedCount;
+            const std::thread::id threadId = engineThreadId;
+            bool &threadFlag = result.threadFlag;
+            requestIds[i] = offload.submit<std::string>([i, threadId, &threadFlag]() {
+                threadFlag = threadFlag && std::this_thread::get_id() != threadId;
+                if (i % 10 == 3)
+                {
+                    throw std::runtime_error("offload");
+                }
+                return std::to_string(i);
+            });
+            ASSERT_NE(0u, requestIds[i]);
+        }
+    }
+    void onEvent(const OffloadPool::ResultEvent<std::string> &event)
+    {
+        const unsigned i = result.receivedCount++;
+        // single worker: results come back in submission order
+        result.resultFlag = result.resultFlag && event.getRequestId() == requestIds[i];
+        if (event.hasException())
+        {
+            ++result.exceptionCount;
+            result.resultFlag = result.resultFlag && event.getExceptionWhat() == "offload" && i % 10 == 3;
+        }
+        else
+        {
+            result.resultFlag = result.resultFlag && std::move(event.getResult()) == std::to_string(i);
+        }
+        submit();
+        if (result.receivedCount == CALL_COUNT)
+        {
+            requestDestroy();
+            result.doneCondition.notify();
+        }
+    }
+};
+
+void testResults()
+{
+    Engine::StartSequence startSequence;
+    OffloadPool pool(startSequence.getCoreSet(), 1, 16);
+    ASSERT_EQ(1u, pool.getWorkerCount());
+    TestOffloadActor::Result result;
+    {
+        TestOffloadActor::Init init = {&pool, &result};
+        startSequence.addActor<TestOffloadActor>(0, init);
+        TestEngine engine(startSequence);
+        result.doneCondition.wait();
+    }
+    ASSERT_EQ(CALL_COUNT, result.receivedCount);
+    ASSERT_EQ(CALL_COUNT / 10, result.exceptionCount);
+    ASSERT_TRUE(result.boundFlag);
+    ASSERT_TRUE(result.resultFlag);
+    ASSERT_TRUE(result.threadFlag);
+}
+
+void testIdlePool()
+{
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    OffloadPool pool(coreSet, 3);
+    ASSERT_EQ(3u, pool.getWorkerCount());
+}
+
+} // namespace
+
+TEST(Offload, results) { testResults(); }
+TEST(Offload, idlePool) { testIdlePool(); }
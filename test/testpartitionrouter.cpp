@@ -0,0 +1,234 @@
+/**
+ * @file testpartitionrouter.cpp
+ * @brief test key-partitioned router
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <map>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "trz/util/partitionrouter.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const uint64_t KEY_COUNT = 1000;
+static const uint32_t PARTITION_COUNT = 3;
+
+struct TestValueEvent : Actor::Event
+{
+    uint64_t key;
+    inline TestValueEvent(uint64_t pkey) noexcept : key(pkey) {}
+};
+struct TestStateEvent : Actor::Event
+{
+    uint64_t key;
+    unsigned count;
+    inline TestStateEvent(uint64_t pkey, unsigned pcount) noexcept : key(pkey), count(pcount) {}
+};
+struct TestFlushEvent : Actor::Event
+{
+};
+
+struct TestResult
+{
+    std::map<uint64_t, unsigned> counts[PARTITION_COUNT];
+    unsigned misroutedCount;   // held by a partition which is not the final owner
+    unsigned orderErrorCount;  // state received after an event for the same key
+    unsigned handoffCount;
+    WaitCondition doneCondition;
+    inline TestResult() : misroutedCount(0), orderErrorCount(0), handoffCount(0) {}
+};
+TestResult *testResult = 0;
+
+struct TestPartition : PartitionRouter::Partition
+{
+    std::map<uint64_t, unsigned> counts;
+
+    TestPartition(PartitionRouter::Directory *directory) : Partition(*directory)
+    {
+        registerEventHandler<TestValueEvent>(*this);
+        registerEventHandler<TestStateEvent>(*this);
+        registerEventHandler<TestFlushEvent>(*this);
+    }
+    virtual ~TestPartition() noexcept
+    {
+        for (std::map<uint64_t, unsigned>::const_iterator i = counts.begin(); i != counts.end(); ++i)
+        {
+            testResult->misroutedCount += isOwner(i->first) ? 0 : 1;
+        }
+        testResult->counts[getPartitionIndex()] = counts;
+    }
+    void onEvent(const TestValueEvent &event)
+    {
+        if (!forwardIfMoved(event.key, event))
+        {
+            ++counts[event.key];
+        }
+    }
+    void onEvent(const TestStateEvent &event)
+    {
+        ASSERT_TRUE(isOwner(event.key));
+        unsigned &count = counts[event.key];
+        testResult->orderErrorCount += count == 0 ? 0 : 1;
+        count += event.count;
+    }
+    void onEvent(const TestFlushEvent &event) { Event::Pipe(*this, event.getSourceActorId()).push<TestFlushEvent>(); }
+    virtual void onHandoff(uint32_t, uint32_t)
+    {
+        ++testResult->handoffCount;
+        for (std::map<uint64_t, unsigned>::iterator i = counts.begin(); i != counts.end();)
+        {
+            if (isOwner(i->first))
+            {
+                ++i;
+            }
+            else
+            {
+                Event::Pipe(*this, getPartitionActorId(getOwner(i->first))).push<TestStateEvent>(i->first, i->second);
+                counts.erase(i++);
+            }
+        }
+    }
+};
+
+struct TestSenderActor : Actor, Actor::Callback
+{
+    const PartitionRouter::Directory &directory;
+    PartitionRouter::Proxy router;
+    unsigned step;
+    unsigned flushCount;
+
+    TestSenderActor(const PartitionRouter::Directory *pdirectory)
+        : directory(*pdirectory), router(*this, directory), step(0), flushCount(0)
+    {
+        registerEventHandler<TestFlushEvent>(*this);
+        registerCallback(*this);
+    }
+    void pushAll()
+    {
+        for (uint64_t key = 0; key < KEY_COUNT; ++key)
+        {
+            router.push<TestValueEvent>(key, key);
+        }
+    }
+    void onCallback()
+    {
+        switch (step)
+        {
+        case 0:
+            pushAll();
+            ASSERT_TRUE(router.rebalance(2));
+            ASSERT_FALSE(router.rebalance(1)); // in progress
+            pushAll();                         // with the stale table: forwarded by the removed partition
+            ++step;
+            break;
+        case 1:
+            if (router.getActivePartitionCount() == 2)
+            {
+                pushAll();
+                ASSERT_TRUE(router.rebalance(PARTITION_COUNT));
+                ++step;
+            }
+            break;
+        case 2:
+            if (router.getActivePartitionCount() == PARTITION_COUNT)
+            {
+                pushAll();
+                for (uint32_t i = 0; i < PARTITION_COUNT; ++i)
+                {
+                    Event::Pipe(*this, directory.getPartitionActorId(i)).push<TestFlushEvent>();
+                }
+                ++step;
+            }
+            break;
+        }
+        if (step < 3)
+        {
+            registerCallback(*this);
+        }
+    }
+    void onEvent(const TestFlushEvent &)
+    {
+        if (++flushCount == PARTITION_COUNT)
+        {
+            requestDestroy();
+            testResult->doneCondition.notify();
+        }
+    }
+};
+
+void testJumpHash()
+{
+    unsigned bucketCounts[4] = {0, 0, 0, 0};
+    for (uint64_t key = 0; key < 100000; ++key)
+    {
+        const uint32_t bucket3 = PartitionRouter::jumpHash(key, 3);
+        const uint32_t bucket4 = PartitionRouter::jumpHash(key, 4);
+        ASSERT_LT(bucket4, 4u);
+        // keys only move to the added bucket
+        ASSERT_TRUE(bucket4 == bucket3 || bucket4 == 3);
+        ++bucketCounts[bucket4];
+        ASSERT_EQ(0u, PartitionRouter::jumpHash(key, 1));
+    }
+    for (int i = 0; i < 4; ++i)
+    {
+        ASSERT_GT(bucketCounts[i], 23000u);
+        ASSERT_LT(bucketCounts[i], 27000u);
+    }
+}
+
+void testRebalance()
+{
+    TestResult result;
+    testResult = &result;
+    PartitionRouter::Directory directory;
+    {
+        Engine::CoreSet coreSet;
+        coreSet.set(0);
+        Engine::StartSequence startSequence(coreSet);
+        for (uint32_t i = 0; i < PARTITION_COUNT; ++i)
+        {
+            directory.addPartition<TestPartition>(startSequence, 0);
+        }
+        startSequence.addActor<TestSenderActor>(0, &directory);
+        TestEngine engine(startSequence);
+        result.doneCondition.wait();
+        ASSERT_EQ(PARTITION_COUNT, directory.getPartitionCount());
+        ASSERT_EQ(PARTITION_COUNT, directory.getActivePartitionCount());
+    }
+    testResult = 0;
+    // 3 -> 2 (3 old partitions), then 2 -> 3 (2 old partitions)
+    ASSERT_EQ(5u, result.handoffCount);
+    ASSERT_EQ(0u, result.misroutedCount);
+    ASSERT_EQ(0u, result.orderErrorCount);
+    std::vector<unsigned> totals(KEY_COUNT, 0);
+    for (uint32_t i = 0; i < PARTITION_COUNT; ++i)
+    {
+        ASSERT_FALSE(result.counts[i].empty());
+        for (std::map<uint64_t, unsigned>::const_iterator j = result.counts[i].begin(); j != result.counts[i].end();
+             ++j)
+        {
+            ASSERT_EQ(0u, totals[j->first]); // a key is held by one partition only
+            totals[j->first] = j->second;
+        }
+    }
+    for (uint64_t key = 0; key < KEY_COUNT; ++key)
+    {
+        ASSERT_EQ(4u, totals[key]);
+    }
+}
+
+} // anonymous namespace
+
+TEST(PartitionRouter, jumpHash) { testJumpHash(); }
+TEST(PartitionRouter, rebalance) { testRebalance(); }
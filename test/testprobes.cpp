@@ -0,0 +1,115 @@
+/**
+ * @file testprobes.cpp
+ * @brief test USDT static tracepoints
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/internal/probes.h"
+
+#include "testutil.h"
+
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const unsigned EVENT_COUNT = 100;
+
+struct TestEvent : Actor::Event
+{
+};
+
+struct TestResult
+{
+    unsigned eventCount;
+    WaitCondition doneCondition;
+    inline TestResult() : eventCount(0) {}
+};
+
+struct TestDestinationActor : Actor, Actor::Callback
+{
+    TestResult &result;
+
+    TestDestinationActor(TestResult *presult) : result(*presult) { registerEventHandler<TestEvent>(*this); }
+    void onEvent(const TestEvent &)
+    {
+        if (++result.eventCount == EVENT_COUNT)
+        {
+            registerCallback(*this);
+        }
+    }
+    void onCallback() { result.doneCondition.notify(); }
+};
+
+struct TestSourceActor : Actor, Actor::Callback
+{
+    ActorReference<TestDestinationActor> destination;
+
+    TestSourceActor(TestResult *presult) : destination(newReferencedActor<TestDestinationActor>(presult))
+    {
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        Event::Pipe pipe(*this, destination->getActorId());
+        for (unsigned i = 0; i < EVENT_COUNT; ++i)
+        {
+            pipe.push<TestEvent>();
+        }
+    }
+};
+
+void runEngine()
+{
+    TestResult result;
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    startSequence.addActor<TestSourceActor>(0, &result);
+    TestEngine engine(startSequence);
+    result.doneCondition.wait();
+    ASSERT_EQ(EVENT_COUNT, result.eventCount);
+}
+
+void testDetached()
+{
+    ASSERT_FALSE(TREDZONE_PROBE_ENABLED(event_push));
+    ASSERT_FALSE(TREDZONE_PROBE_ENABLED(dispatch_enter));
+    runEngine();
+}
+
+void testAttached()
+{
+#if TREDZONE_USDT_ENABLED
+    // as done by a tracer attaching to every probe
+    ++TREDZONE_PROBE_SEMAPHORE(event_push);
+    ++TREDZONE_PROBE_SEMAPHORE(batch_write);
+    ++TREDZONE_PROBE_SEMAPHORE(batch_read);
+    ++TREDZONE_PROBE_SEMAPHORE(dispatch_enter);
+    ++TREDZONE_PROBE_SEMAPHORE(dispatch_exit);
+    ++TREDZONE_PROBE_SEMAPHORE(actor_new);
+    ++TREDZONE_PROBE_SEMAPHORE(actor_destroy);
+    ++TREDZONE_PROBE_SEMAPHORE(event_page);
+    ASSERT_TRUE(TREDZONE_PROBE_ENABLED(event_push));
+#endif
+    runEngine();
+#if TREDZONE_USDT_ENABLED
+    --TREDZONE_PROBE_SEMAPHORE(event_push);
+    --TREDZONE_PROBE_SEMAPHORE(batch_write);
+    --TREDZONE_PROBE_SEMAPHORE(batch_read);
+    --TREDZONE_PROBE_SEMAPHORE(dispatch_enter);
+    --TREDZONE_PROBE_SEMAPHORE(dispatch_exit);
+    --TREDZONE_PROBE_SEMAPHORE(actor_new);
+    --TREDZONE_PROBE_SEMAPHORE(actor_destroy);
+    --TREDZONE_PROBE_SEMAPHORE(event_page);
+#endif
+}
+
+} // anonymous namespace
+
+TEST(Probes, detached) { testDetached(); }
+TEST(Probes, attached) { testAttached(); }
@@ -0,0 +1,192 @@
+/**
+ * @file testreferencedata.cpp
+ * @brief test memory-mapped reference-data loader
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include "gtest/gtest.h"
+
+#include "trz/util/referencedata.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const uint32_t RECORD_COUNT = 1000;
+
+struct TestInstrument
+{
+    uint32_t id;
+    char symbol[16];
+    uint64_t price;
+};
+
+// uint32 id, uint32 symbol length, symbol, uint64 price
+size_t testInstrumentSize(const void *record, size_t maxByteCount)
+{
+    uint32_t symbolSize;
+    if (maxByteCount < 2 * sizeof(uint32_t))
+    {
+        return 0;
+    }
+    memcpy(&symbolSize, static_cast<const char *>(record) + sizeof(uint32_t), sizeof(symbolSize));
+    const size_t ret = 2 * sizeof(uint32_t) + symbolSize + sizeof(uint64_t);
+    return ret <= maxByteCount ? ret : 0;
+}
+
+void parseTestInstrument(DataBufferReader<> &reader, TestInstrument &instrument)
+{
+    instrument.id = reader.Read32();
+    const string symbol = reader.ReadString();
+    if (symbol.size() >= sizeof(instrument.symbol))
+    {
+        throw std::length_error("symbol");
+    }
+    memcpy(instrument.symbol, symbol.c_str(), symbol.size() + 1);
+    instrument.price = reader.Read64();
+}
+
+struct TestFile
+{
+    char path[32];
+
+    TestFile(const string &content)
+    {
+        std::snprintf(path, sizeof(path), "/tmp/testreferencedataXXXXXX");
+        const int fd = mkstemp(path);
+        EXPECT_NE(-1, fd);
+        EXPECT_EQ((ssize_t)content.size(), write(fd, content.data(), content.size()));
+        close(fd);
+    }
+    ~TestFile() { unlink(path); }
+};
+
+string testContent(uint32_t recordCount, const char *lastSymbol = 0)
+{
+    ostringstream oss;
+    DataOutputStream<> dos(oss);
+    for (uint32_t i = 0; i < recordCount; ++i)
+    {
+        dos << i << (i + 1 == recordCount && lastSymbol != 0 ? string(lastSymbol) : "SYM" + to_string(i))
+            << (uint64_t)i * 100;
+    }
+    return oss.str();
+}
+
+struct TestResult
+{
+    size_t recordCount;
+    bool contentFlag;
+    WaitCondition doneCondition;
+    inline TestResult() : recordCount(0), contentFlag(false) {}
+};
+
+struct TestInit
+{
+    ReferenceDataLoader<TestInstrument> *loader;
+    TestResult *result;
+};
+
+struct TestInstrumentActor : Actor
+{
+    const ReferenceDataLoader<TestInstrument>::View &instruments;
+
+    TestInstrumentActor(const TestInit &init) : instruments(init.loader->getView(getCore()))
+    {
+        init.result->recordCount = instruments.size();
+        init.result->contentFlag = true;
+        uint32_t i = 0;
+        for (const TestInstrument *instrument = instruments.begin(); instrument != instruments.end(); ++instrument, ++i)
+        {
+            init.result->contentFlag &= instrument->id == i && instrument->symbol == "SYM" + to_string(i) &&
+                                        instrument->price == (uint64_t)i * 100;
+        }
+        init.result->doneCondition.notify();
+    }
+};
+
+void testSplit()
+{
+    TestFile file(testContent(RECORD_COUNT));
+    ReferenceDataFile referenceDataFile(file.path);
+    const vector<ReferenceDataFile::Chunk> chunks = referenceDataFile.split(4, &testInstrumentSize);
+    ASSERT_EQ(4u, chunks.size());
+    const char *p = static_cast<const char *>(referenceDataFile.getData());
+    size_t recordCount = 0;
+    for (size_t i = 0; i < chunks.size(); ++i)
+    {
+        ASSERT_EQ(p, chunks[i].data);
+        ASSERT_LT(RECORD_COUNT / 4 - 10, chunks[i].recordCount);
+        ASSERT_GT(RECORD_COUNT / 4 + 10, chunks[i].recordCount);
+        // chunks start at record boundaries
+        uint32_t id;
+        memcpy(&id, chunks[i].data, sizeof(id));
+        ASSERT_EQ(recordCount, id);
+        p += chunks[i].byteCount;
+        recordCount += chunks[i].recordCount;
+    }
+    ASSERT_EQ(RECORD_COUNT, recordCount);
+    ASSERT_EQ(referenceDataFile.getSize(), (size_t)(p - static_cast<const char *>(referenceDataFile.getData())));
+
+    ASSERT_THROW(ReferenceDataFile("/nonexistent/testreferencedata"), std::system_error);
+}
+
+void testLoad()
+{
+    TestFile file(testContent(RECORD_COUNT));
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    ReferenceDataLoader<TestInstrument> loader(file.path, coreSet, &testInstrumentSize, &parseTestInstrument);
+    TestResult result;
+    {
+        Engine::StartSequence startSequence(coreSet);
+        TestInit init = {&loader, &result};
+        startSequence.addActor<TestInstrumentActor>(0, init);
+        TestEngine engine(startSequence);
+        result.doneCondition.wait();
+    }
+    ASSERT_EQ(RECORD_COUNT, result.recordCount);
+    ASSERT_TRUE(result.contentFlag);
+    ASSERT_EQ(&loader.getView(0), &loader.getView(0));
+    ASSERT_THROW(loader.getView(1), Engine::CoreSet::UndefinedCoreException);
+}
+
+void testCorrupt()
+{
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    {
+        // truncated last record
+        const string content = testContent(RECORD_COUNT);
+        TestFile file(content.substr(0, content.size() - 1));
+        ReferenceDataLoader<TestInstrument> loader(file.path, coreSet, &testInstrumentSize, &parseTestInstrument);
+        ASSERT_THROW(loader.getView(0), ReferenceDataFile::CorruptFileException);
+    }
+    {
+        // parse error: retried at the next call
+        TestFile file(testContent(RECORD_COUNT, "SYMBOL_TOO_LONG_FOR_RECORD"));
+        ReferenceDataLoader<TestInstrument> loader(file.path, coreSet, &testInstrumentSize, &parseTestInstrument);
+        ASSERT_THROW(loader.getView(0), std::length_error);
+        ASSERT_THROW(loader.getView(0), std::length_error);
+    }
+}
+
+} // anonymous namespace
+
+TEST(ReferenceData, split) { testSplit(); }
+TEST(ReferenceData, load) { testLoad(); }
+TEST(ReferenceData, corrupt) { testCorrupt(); }
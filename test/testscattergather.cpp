@@ -0,0 +1,151 @@
+/**
+ * @file testscattergather.cpp
+ * @brief test scatter-gather of a range across cores
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "trz/util/scattergather.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const size_t VALUE_COUNT = 100000;
+
+struct TestSumJob
+{
+    typedef uint64_t result_type;
+    const std::vector<uint64_t> *values;
+    size_t failingBegin; // chunk starting there throws
+    result_type map(size_t begin, size_t end) const
+    {
+        if (begin == failingBegin)
+        {
+            throw std::runtime_error("map");
+        }
+        uint64_t ret = 0;
+        for (size_t i = begin; i < end; ++i)
+        {
+            ret += (*values)[i];
+        }
+        return ret;
+    }
+    void reduce(result_type &accumulator, result_type &partial) const { accumulator += partial; }
+};
+
+struct TestCoordinatorActor : Actor
+{
+    struct Result
+    {
+        uint64_t sum;
+        uint64_t sumWithFailure;
+        size_t failedChunkCount;
+        size_t workerCount;
+        unsigned completedCount;
+        WaitCondition doneCondition;
+        inline Result() : sum(0), sumWithFailure(0), failedChunkCount(0), workerCount(0), completedCount(0) {}
+    };
+    struct Init
+    {
+        const ScatterGather::WorkerDirectory *directory;
+        const std::vector<uint64_t> *values;
+        Result *result;
+    };
+
+    Result &result;
+    ScatterGather scatterGather;
+
+    TestCoordinatorActor(const Init &init) : result(*init.result), scatterGather(*this, *init.directory)
+    {
+        result.workerCount = init.directory->size();
+        const TestSumJob job = {init.values, VALUE_COUNT};
+        scatterGather.scatter(job, 0, VALUE_COUNT, [this](uint64_t sum, size_t failedChunkCount) {
+            result.sum = failedChunkCount == 0 ? sum : 0;
+            onCompletion();
+        }, 8);
+        // 4 chunks of 25000, the second one fails
+        const TestSumJob failingJob = {init.values, VALUE_COUNT / 4};
+        scatterGather.scatter(failingJob, 0, VALUE_COUNT, [this](uint64_t sum, size_t failedChunkCount) {
+            result.sumWithFailure = sum;
+            result.failedChunkCount = failedChunkCount;
+            onCompletion();
+        }, 4 / init.directory->size());
+    }
+    void onCompletion()
+    {
+        if (++result.completedCount == 2)
+        {
+            requestDestroy();
+            result.doneCondition.notify();
+        }
+    }
+};
+
+void testSum()
+{
+    std::vector<uint64_t> values(VALUE_COUNT);
+    uint64_t expectedSum = 0;
+    uint64_t expectedFailedChunkSum = 0;
+    for (size_t i = 0; i < VALUE_COUNT; ++i)
+    {
+        expectedSum += (values[i] = i * 3 + 1);
+        if (i >= VALUE_COUNT / 4 && i < VALUE_COUNT / 2)
+        {
+            expectedFailedChunkSum += values[i];
+        }
+    }
+    ScatterGather::WorkerDirectory directory;
+    TestCoordinatorActor::Result result;
+    {
+        Engine::CoreSet coreSet;
+        coreSet.set(0);
+        Engine::StartSequence startSequence(coreSet);
+        directory.addWorkers(startSequence);
+        TestCoordinatorActor::Init init = {&directory, &values, &result};
+        startSequence.addActor<TestCoordinatorActor>(0, init);
+        TestEngine engine(startSequence);
+        result.doneCondition.wait();
+    }
+    ASSERT_EQ(1u, result.workerCount);
+    ASSERT_EQ(expectedSum, result.sum);
+    ASSERT_EQ(expectedSum - expectedFailedChunkSum, result.sumWithFailure);
+    ASSERT_EQ(1u, result.failedChunkCount);
+}
+
+struct TestIdleActor : Actor
+{
+    TestIdleActor(WaitCondition *readyCondition) { readyCondition->notify(); }
+};
+
+void testRedZoneCoreSkipped()
+{
+    ScatterGather::WorkerDirectory directory;
+    {
+        Engine::CoreSet coreSet;
+        coreSet.set(0);
+        Engine::StartSequence startSequence(coreSet);
+        startSequence.setRedZoneCore(0);
+        directory.addWorkers(startSequence);
+        WaitCondition readyCondition;
+        startSequence.addActor<TestIdleActor>(0, &readyCondition);
+        TestEngine engine(startSequence);
+        readyCondition.wait();
+    }
+    ASSERT_EQ(0u, directory.size());
+}
+
+} // namespace
+
+TEST(ScatterGather, sum) { testSum(); }
+TEST(ScatterGather, redZoneCoreSkipped) { testRedZoneCoreSkipped(); }
@@ -0,0 +1,131 @@
+/**
+ * @file testscratcharena.cpp
+ * @brief test per-core scratch arena
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/internal/node.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+void testBumpAndReset()
+{
+    ScratchArena arena(1024);
+    ASSERT_EQ(1024u, arena.getPageSize());
+    ASSERT_EQ(0u, arena.getGeneration());
+
+    char *p1 = static_cast<char *>(arena.allocate(10, 1));
+    char *p2 = static_cast<char *>(arena.allocate(16, 16));
+    ASSERT_EQ(0u, (uintptr_t)p2 % 16);
+    ASSERT_GE(p2, p1 + 10);
+    std::memset(p1, 1, 10);
+    std::memset(p2, 2, 16);
+
+    // LIFO roll-back
+    arena.deallocate(p2, 16);
+    ASSERT_EQ(p2, arena.allocate(16, 16));
+
+    // spill over several pages and a large block
+    for (int i = 0; i < 100; ++i)
+    {
+        std::memset(arena.allocate(100), 3, 100);
+    }
+    std::memset(arena.allocate(10000), 4, 10000);
+
+    arena.reset();
+    ASSERT_EQ(1u, arena.getGeneration());
+    ASSERT_EQ(p1, arena.allocate(10, 1));
+}
+
+void testPagesRetained()
+{
+    ScratchArena arena(256);
+    std::vector<void *> firstPass;
+    for (int i = 0; i < 50; ++i)
+    {
+        firstPass.push_back(arena.allocate(64, 8));
+    }
+    arena.reset();
+    for (int i = 0; i < 50; ++i)
+    {
+        ASSERT_EQ(firstPass[i], arena.allocate(64, 8));
+    }
+}
+
+struct TestScratchActor : Actor, Actor::Callback
+{
+    typedef std::vector<int, ScratchAllocator<int>> IntVector;
+
+    struct Result
+    {
+        unsigned loopCount;
+        WaitCondition doneCondition;
+        inline Result() : loopCount(0) {}
+    };
+
+    Result &result;
+    const int *previousData;
+    bool sameDataFlag;
+
+    TestScratchActor(Result *presult) : result(*presult), previousData(0), sameDataFlag(true)
+    {
+        registerCallback(*this);
+    }
+    ~TestScratchActor() noexcept
+    {
+        EXPECT_TRUE(sameDataFlag);
+    }
+    void onCallback() noexcept
+    {
+        IntVector v(getScratchAllocator());
+        for (int i = 0; i < 1000; ++i)
+        {
+            v.push_back(i);
+        }
+        EXPECT_EQ(999, v.back());
+        if (previousData != 0 && previousData != v.data())
+        {
+            sameDataFlag = false;
+        }
+        previousData = v.data();
+        if (++result.loopCount < 100)
+        {
+            registerCallback(*this);
+        }
+        else
+        {
+            requestDestroy();
+            result.doneCondition.notify();
+        }
+    }
+};
+
+void testActorScratchAllocator()
+{
+    TestScratchActor::Result result;
+    {
+        Engine::StartSequence startSequence;
+        startSequence.addActor<TestScratchActor>(0, &result);
+        TestEngine engine(startSequence);
+        result.doneCondition.wait();
+    }
+    ASSERT_EQ(100u, result.loopCount);
+}
+
+} // namespace
+
+TEST(ScratchArena, bumpAndReset) { testBumpAndReset(); }
+TEST(ScratchArena, pagesRetained) { testPagesRetained(); }
+TEST(ScratchArena, actorScratchAllocator) { testActorScratchAllocator(); }
@@ -0,0 +1,149 @@
+/**
+ * @file teststringstream.cpp
+ * @brief test output string streams (geometric growth, in-place event memory formatting)
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/internal/stringstream.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const size_t LINE_COUNT = 10000;
+
+typedef TestAllocator<char, TestMemory> TestCharAllocator;
+
+template <class _Stream> void testFormat(_Stream &s, string &expected)
+{
+    for (size_t i = 0; i < LINE_COUNT; ++i)
+    {
+        s << "line " << i << ' ' << 1.5 << '\n';
+        expected += "line " + to_string(i) + " 1.5\n";
+    }
+}
+
+struct TestStringEvent : Actor::Event
+{
+    const char *text;
+    inline TestStringEvent(const char *ptext) noexcept : text(ptext) {}
+};
+
+struct TestResult
+{
+    string text;
+    bool zeroCopyFlag;
+    WaitCondition doneCondition;
+    inline TestResult() : zeroCopyFlag(false) {}
+};
+
+struct TestDestinationActor : Actor
+{
+    TestResult &result;
+
+    TestDestinationActor(TestResult *presult) : result(*presult) { registerEventHandler<TestStringEvent>(*this); }
+    void onEvent(const TestStringEvent &event)
+    {
+        result.text = event.text;
+        result.doneCondition.notify();
+    }
+};
+
+struct TestSourceActor : Actor, Actor::Callback
+{
+    TestResult &result;
+    ActorReference<TestDestinationActor> destination;
+
+    TestSourceActor(TestResult *presult)
+        : result(*presult), destination(newReferencedActor<TestDestinationActor>(presult))
+    {
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        Event::Pipe pipe(*this, destination->getActorId());
+        Event::ostringstream_type s(pipe.getAllocator());
+        for (int i = 0; i < 1000; ++i)
+        {
+            s << "order " << i << ';';
+        }
+        const char *text = Event::newCString(pipe.getAllocator(), s);
+        result.zeroCopyFlag = text == s.c_str();
+        pipe.push<TestStringEvent>(text);
+    }
+};
+
+void testGeometricGrowth()
+{
+    TestMemory testMemory;
+    {
+        OutputStringStream<char, TestCharAllocator> s((TestCharAllocator(testMemory)));
+        string expected;
+        testFormat(s, expected);
+        ASSERT_EQ(expected.size(), s.size());
+        ASSERT_EQ(expected, s.c_str());
+        // geometric growth: buffer less than twice the content
+        ASSERT_GE(2 * (expected.size() + 1), testMemory.inUse);
+    }
+    {
+        // first write larger than the in-place buffer
+        OutputStringStream<char, TestCharAllocator> s((TestCharAllocator(testMemory)));
+        const string large(10 * TREDZONE_DEFAULT_STREAM_BUFFER_INCREMENT_SIZE, 'x');
+        s << large;
+        ASSERT_EQ(large, s.c_str());
+    }
+}
+
+void testInPlace()
+{
+    TestMemory testMemory;
+    {
+        InPlaceOutputStringStream<TestCharAllocator> s((TestCharAllocator(testMemory)));
+        ASSERT_EQ(0u, s.size());
+        ASSERT_EQ(0u, testMemory.inUse);
+        ASSERT_STREQ("", s.c_str());
+        string expected;
+        testFormat(s, expected);
+        ASSERT_EQ(expected.size(), s.size());
+        ASSERT_EQ(expected, s.c_str());
+        ASSERT_GE(2 * (expected.size() + 1), testMemory.inUse);
+    }
+    {
+        InPlaceOutputStringStream<TestCharAllocator, 4> s((TestCharAllocator(testMemory)));
+        s << 'a' << "bcdefgh" << 'i';
+        ASSERT_STREQ("abcdefghi", s.c_str());
+    }
+}
+
+void testEvent()
+{
+    TestResult result;
+    Engine::StartSequence startSequence;
+    startSequence.addActor<TestSourceActor>(0, &result);
+    TestEngine engine(startSequence);
+    result.doneCondition.wait();
+
+    string expected;
+    for (int i = 0; i < 1000; ++i)
+    {
+        expected += "order " + to_string(i) + ';';
+    }
+    ASSERT_EQ(expected, result.text);
+    ASSERT_TRUE(result.zeroCopyFlag);
+}
+
+} // anonymous namespace
+
+TEST(StringStream, geometricGrowth) { testGeometricGrowth(); }
+TEST(StringStream, inPlace) { testInPlace(); }
+TEST(StringStream, event) { testEvent(); }
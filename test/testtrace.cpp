@@ -0,0 +1,243 @@
+/**
+ * @file testtrace.cpp
+ * @brief test binary tracing of engine hook points
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+
+#include "trz/util/trace.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+void recordThread()
+{
+    Trace::record(Trace::HOOK_ACTOR_NEW, 0, 2, 1);
+    Trace::record(Trace::HOOK_PUSH, 7, 2, 3, 0);
+    Trace::onLoop();
+    Trace::onLoop(); // idle: not recorded
+    Trace::record(Trace::HOOK_DISPATCH_BEGIN, 7, 3, 2, 0);
+    Trace::onDispatchEnd(Trace::HOOK_DISPATCH_END);
+}
+
+void testConvert()
+{
+    std::thread(recordThread).join();
+    std::thread(recordThread).join();
+
+    stringstream binary;
+    Trace::dump(binary);
+    stringstream json;
+    Trace::convertToJson(binary, json);
+    const string s = json.str();
+
+    ASSERT_EQ(0u, s.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+    ASSERT_EQ(s.size() - 4, s.rfind("\n]}\n"));
+    // at least the two rings above (other tests of this process may have recorded too)
+    ASSERT_LE(2u, countOf(s, "\"thread_name\""));
+    ASSERT_LE(2u, countOf(s, "\"name\":\"new actor\",\"cat\":\"actor\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"actor\":2,"
+                             "\"creator\":1}"));
+    ASSERT_LE(2u, countOf(s, "\"name\":\"event#7\",\"cat\":\"push\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"actor\":2,"
+                             "\"destination\":\"0.3\"}"));
+    ASSERT_LE(2u, countOf(s, "\"name\":\"event#7\",\"cat\":\"dispatch\",\"ph\":\"B\",\"args\":{\"actor\":3,"
+                             "\"source\":\"0.2\"}"));
+    ASSERT_EQ(countOf(s, "\"ph\":\"B\""), countOf(s, "\"ph\":\"E\""));
+    ASSERT_EQ(countOf(s, "\"cat\":\"push\""), countOf(s, "\"name\":\"loop\""));
+}
+
+void testRingOverwrite()
+{
+    Trace::setRingCapacity(5); // rounded up to 8
+    std::thread([] {
+        for (unsigned i = 0; i < 20; ++i)
+        {
+            Trace::record(Trace::HOOK_CALLBACK, 0, 1000 + i);
+        }
+    }).join();
+    Trace::setRingCapacity(Trace::DEFAULT_RING_CAPACITY);
+
+    stringstream binary;
+    Trace::dump(binary);
+    stringstream json;
+    Trace::convertToJson(binary, json);
+    const string s = json.str();
+    // only the 8 most recent records were kept
+    ASSERT_EQ(string::npos, s.find("\"actor\":1011}"));
+    for (unsigned i = 12; i < 20; ++i)
+    {
+        ostringstream pattern;
+        pattern << "\"name\":\"callback\",\"cat\":\"callback\",\"ph\":\"i\",\"s\":\"t\",\"args\":{\"actor\":"
+                << 1000 + i << '}';
+        ASSERT_EQ(1u, countOf(s, pattern.str())) << pattern.str();
+    }
+}
+
+void testInvalidFile()
+{
+    stringstream json;
+    stringstream empty;
+    ASSERT_THROW(Trace::convertToJson(empty, json), Trace::InvalidFileException);
+    stringstream invalid("not a trace file, not a trace file");
+    ASSERT_THROW(Trace::convertToJson(invalid, json), Trace::InvalidFileException);
+
+    stringstream truncated;
+    std::thread([] { Trace::record(Trace::HOOK_CALLBACK, 0, 1); }).join();
+    Trace::dump(truncated);
+    const string s = truncated.str();
+    stringstream truncated2(s.substr(0, s.size() - 1));
+    ASSERT_THROW(Trace::convertToJson(truncated2, json), Trace::InvalidFileException);
+}
+
+enum TestSide : uint8_t
+{
+    TEST_SIDE_BUY = 1,
+    TEST_SIDE_SELL = 2
+};
+
+struct TestOrderEvent : Actor::Event
+{
+    uint64_t orderId;
+    double price;
+    int32_t quantity;
+    char type;
+    char symbol[8];
+    bool activeFlag;
+    TestSide side;
+    uint8_t raw[3];
+    inline TestOrderEvent(uint64_t porderId) noexcept
+        : orderId(porderId), price(1.5), quantity(-3), type('L'), activeFlag(true), side(TEST_SIDE_SELL)
+    {
+        std::strncpy(symbol, "AB\"C", sizeof(symbol));
+        raw[0] = 1;
+        raw[1] = 2;
+        raw[2] = 255;
+    }
+};
+
+struct TestResult
+{
+    uint64_t firstOrderId;
+    unsigned eventCount;
+    unsigned receivedCount;
+    WaitCondition doneCondition;
+    inline TestResult(uint64_t pfirstOrderId, unsigned peventCount)
+        : firstOrderId(pfirstOrderId), eventCount(peventCount), receivedCount(0)
+    {
+    }
+};
+
+struct TestDestinationActor : Actor
+{
+    TestResult &result;
+
+    TestDestinationActor(TestResult *presult) : result(*presult) { registerEventHandler<TestOrderEvent>(*this); }
+    void onEvent(const TestOrderEvent &event)
+    {
+        if (!Trace::isEnabled())
+        {
+            // otherwise recorded by the engine hook points
+            Trace::onDispatchBegin(Trace::HOOK_DISPATCH_BEGIN, static_cast<const Actor::Event *>(&event));
+            Trace::onDispatchEnd(Trace::HOOK_DISPATCH_END);
+        }
+        if (++result.receivedCount == result.eventCount)
+        {
+            result.doneCondition.notify();
+        }
+    }
+};
+
+struct TestSourceActor : Actor, Actor::Callback
+{
+    TestResult &result;
+    ActorReference<TestDestinationActor> destination;
+
+    TestSourceActor(TestResult *presult)
+        : result(*presult), destination(newReferencedActor<TestDestinationActor>(presult))
+    {
+        registerCallback(*this);
+    }
+    void onCallback()
+    {
+        Event::Pipe pipe(*this, destination->getActorId());
+        for (unsigned i = 0; i < result.eventCount; ++i)
+        {
+            const TestOrderEvent &event = pipe.push<TestOrderEvent>(result.firstOrderId + i);
+            if (!Trace::isEnabled())
+            {
+                Trace::onPush(&event, this); // otherwise recorded by the engine hook point
+            }
+        }
+    }
+};
+
+void runOrderEvents(uint64_t firstOrderId, unsigned eventCount)
+{
+    TestResult result(firstOrderId, eventCount);
+    Engine::StartSequence startSequence;
+    startSequence.addActor<TestSourceActor>(0, &result);
+    TestEngine engine(startSequence);
+    result.doneCondition.wait();
+}
+
+string orderEventContent(uint64_t orderId)
+{
+    ostringstream ret;
+    ret << "\"content\":{\"orderId\":" << orderId << ",\"price\":1.5,\"quantity\":-3,\"type\":\"L\","
+        << "\"symbol\":\"AB\\\"C\",\"activeFlag\":true,\"side\":2,\"raw\":\"0x0102ff\"}}";
+    return ret.str();
+}
+
+string dumpToJson()
+{
+    stringstream binary;
+    Trace::dump(binary);
+    stringstream json;
+    Trace::convertToJson(binary, json);
+    return json.str();
+}
+
+void testEventContent()
+{
+    Trace::registerEvent<TestOrderEvent>(
+        "TestOrderEvent", {TREDZONE_TRACE_FIELD(TestOrderEvent, orderId), TREDZONE_TRACE_FIELD(TestOrderEvent, price),
+                           TREDZONE_TRACE_FIELD(TestOrderEvent, quantity), TREDZONE_TRACE_FIELD(TestOrderEvent, type),
+                           TREDZONE_TRACE_FIELD(TestOrderEvent, symbol),
+                           TREDZONE_TRACE_FIELD(TestOrderEvent, activeFlag),
+                           TREDZONE_TRACE_FIELD(TestOrderEvent, side), TREDZONE_TRACE_FIELD(TestOrderEvent, raw)});
+    runOrderEvents(1001, 2);
+    string s = dumpToJson();
+    ASSERT_LE(1u, countOf(s, "\"name\":\"TestOrderEvent\",\"cat\":\"dispatch\",\"ph\":\"B\""));
+    ASSERT_LE(1u, countOf(s, orderEventContent(1001))) << s;
+    ASSERT_LE(1u, countOf(s, orderEventContent(1002)));
+    ASSERT_EQ(countOf(s, "\"ph\":\"B\""), countOf(s, "\"ph\":\"E\""));
+
+    // overwritten contents are skipped
+    const size_t recordCount = 2 + 1 + (sizeof(TestOrderEvent) + Trace::CONTENT_SLOT_SIZE - 1) /
+                                           Trace::CONTENT_SLOT_SIZE; // per dispatch
+    Trace::setRingCapacity(recordCount * 3);
+    runOrderEvents(2001, 10);
+    Trace::setRingCapacity(Trace::DEFAULT_RING_CAPACITY);
+    s = dumpToJson();
+    ASSERT_EQ(0u, countOf(s, orderEventContent(2001)));
+    ASSERT_EQ(1u, countOf(s, orderEventContent(2010)));
+}
+
+} // anonymous namespace
+
+TEST(Trace, convert) { testConvert(); }
+TEST(Trace, ringOverwrite) { testRingOverwrite(); }
+TEST(Trace, invalidFile) { testInvalidFile(); }
+TEST(Trace, eventContent) { testEventContent(); }
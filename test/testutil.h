@@ -33,6 +33,18 @@ std::string errorToString(const char*fileName, int sourceFileLine)
 	return s.str();
 }
 
+// number of (possibly overlapping) occurrences of pattern in s
+inline
+size_t countOf(const std::string& s, const std::string& pattern)
+{
+	size_t ret = 0;
+	for (size_t i = s.find(pattern); i != std::string::npos; i = s.find(pattern, i + 1))
+	{
+		++ret;
+	}
+	return ret;
+}
+
 #define _TREDZONE_TEST_EXIT_EXCEPTION_CATCH_BEGIN_ \
 	try {
 #define _TREDZONE_TEST_EXIT_EXCEPTION_CATCH_END_ \
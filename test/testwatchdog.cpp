@@ -0,0 +1,129 @@
+/**
+ * @file testwatchdog.cpp
+ * @brief test event-loop stall watchdog
+ * @copyright 2013-2019 Tredzone (www.tredzone.com). All rights reserved.
+ * Please see accompanying LICENSE file for licensing terms.
+ */
+
+#include <chrono>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "trz/engine/watchdog.h"
+
+#include "testutil.h"
+
+using namespace std;
+using namespace tredzone;
+
+// anonymous namespace to prevent gcc linker to confuse/mix identically-name classes
+namespace
+{
+
+static const uint64_t STALL_THRESHOLD_MICROSECONDS = 20000;
+static const unsigned SPIN_MILLISECONDS = 200;
+
+struct TestSpinEvent : Actor::Event
+{
+};
+
+struct TestStallHandler : Watchdog::StallHandler
+{
+    std::mutex mutex;
+    std::vector<Watchdog::Stall> stalls;
+
+    virtual void onStall(const Watchdog::Stall &stall) noexcept
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stalls.push_back(stall);
+    }
+};
+
+struct TestResult
+{
+    Actor::ActorId spinActorId;
+    WaitCondition doneCondition;
+};
+
+struct TestSpinActor : Actor, Actor::Callback
+{
+    TestResult &result;
+
+    TestSpinActor(TestResult *presult) : result(*presult)
+    {
+        result.spinActorId = getActorId();
+        registerEventHandler<TestSpinEvent>(*this);
+    }
+    void onEvent(const TestSpinEvent &)
+    {
+        const chrono::steady_clock::time_point end =
+            chrono::steady_clock::now() + chrono::milliseconds(SPIN_MILLISECONDS);
+        while (chrono::steady_clock::now() < end)
+        {
+        }
+        registerCallback(*this);
+    }
+    void onCallback() { result.doneCondition.notify(); }
+};
+
+struct TestSourceActor : Actor, Actor::Callback
+{
+    ActorReference<TestSpinActor> spinActor;
+
+    TestSourceActor(TestResult *presult) : spinActor(newReferencedActor<TestSpinActor>(presult))
+    {
+        registerCallback(*this);
+    }
+    void onCallback() { Event::Pipe(*this, spinActor->getActorId()).push<TestSpinEvent>(); }
+};
+
+void testStall()
+{
+    TestResult result;
+    TestStallHandler stallHandler;
+    Engine::CoreSet coreSet;
+    coreSet.set(0);
+    Engine::StartSequence startSequence(coreSet);
+    {
+        Watchdog watchdog(STALL_THRESHOLD_MICROSECONDS, &stallHandler);
+        ASSERT_THROW({ Watchdog other(STALL_THRESHOLD_MICROSECONDS); }, Watchdog::AlreadyRunningException);
+        // let the watchdog calibrate before the stall
+        this_thread::sleep_for(chrono::milliseconds(50));
+        startSequence.addActor<TestSourceActor>(0, &result);
+        TestEngine engine(startSequence);
+        result.doneCondition.wait();
+
+        ostringstream os;
+        watchdog.dumpLoopHistograms(os);
+        ASSERT_NE(string::npos, os.str().find("node 0 (core 0): ")) << os.str();
+        ASSERT_NE(string::npos, os.str().find(" us): ")) << os.str();
+        ASSERT_LE(1u, watchdog.getStallCount());
+    }
+
+    // other (preempted) iterations may also have been reported
+    std::lock_guard<std::mutex> lock(stallHandler.mutex);
+    const Watchdog::Stall *spinStall = 0;
+    for (size_t i = 0; i < stallHandler.stalls.size(); ++i)
+    {
+        if (stallHandler.stalls[i].dispatchFlag &&
+            stallHandler.stalls[i].dispatch.eventClassId == Actor::Event::getClassId<TestSpinEvent>())
+        {
+            ASSERT_EQ(0, spinStall);
+            spinStall = &stallHandler.stalls[i];
+        }
+    }
+    ASSERT_NE((const Watchdog::Stall *)0, spinStall);
+    ASSERT_EQ(0u, spinStall->nodeId);
+    ASSERT_EQ(0u, spinStall->coreId);
+    ASSERT_LE(STALL_THRESHOLD_MICROSECONDS, spinStall->iterationMicroseconds);
+    ASSERT_EQ(result.spinActorId.getNodeActorId(), spinStall->dispatch.destinationNodeActorId);
+    ASSERT_EQ(FlightRecorder::Record::UNFINISHED, spinStall->dispatch.durationTsc);
+    ASSERT_FALSE(spinStall->backtrace.empty());
+}
+
+} // anonymous namespace
+
+TEST(Watchdog, stall) { testStall(); }